@@ -0,0 +1,138 @@
+#!/bin/bash
+#
+# bench.sh - query replay benchmark over a synthetic corpus
+#
+# Usage: ./bench.sh [--pages n] [--words n] [--vocabulary v] [--zipf s] [--links n]
+#                   [--seed n] [--queries n] [--mix head,torso,tail] [--query-words min,max]
+#                   [--or p] [--log queryFile] [--concurrency c] [--repeat n]
+#                   [--rank count|bm25] [--top k] [--cache KB] [--dir directory]
+#                   [--corpus pageDirectory]
+#
+# Builds the indexer, the querier and the benchmark tools; writes a corpus
+# of --pages pages (default 2000) with gencorpus; indexes it with the
+# indexer; generates --queries queries (default 2000) with genqueries, or
+# takes the query log given by --log instead; starts the querier in server
+# mode with one worker per connection and its result cache off (--cache,
+# default 0, so every query is scored); and replays the queries at
+# --concurrency connections (default 4) with qbench. The corpus and query
+# options are passed on to gencorpus and genqueries (--query-words is
+# genqueries' --words); see those programs for their defaults. --corpus
+# indexes and queries an existing page directory (a crawl) instead of
+# writing one; give it --vocabulary if gencorpus wrote its pages.
+#
+# Build output goes to stderr. Prints one JSON object to stdout:
+#
+#   {"corpus": {"pages": ..., "bytes": ..., "seconds": ...},
+#    "index": {"bytes": ..., "seconds": ..., "docs_per_sec": ..., "mb_per_sec": ...},
+#    "querier": {"rank": ..., "top": ..., "cache": ..., "threads": ...},
+#    "replay": {...qbench's object...}}
+#
+# where the corpus's seconds (absent with --corpus) are gencorpus's, and
+# the indexer's rates are of the corpus's pages and bytes.
+#
+# The work directory (a temporary one, unless --dir names one) is removed
+# at the end unless --dir was given. Exits 0 on success, 1 on bad
+# arguments, 2 if a step fails.
+
+pages=2000; concurrency=4; repeat=1; queries=2000; rank=bm25; top=10; cache=0
+corpusArgs=(); queryArgs=(); log=""; dir=""; corpus=""
+while [ $# -gt 0 ]; do
+    if [ $# -lt 2 ]; then
+        set -- --usage
+    fi
+    case "$1" in
+        --pages) pages=$2 ;;
+        --words|--vocabulary|--zipf|--links) corpusArgs+=("$1" "$2") ;;
+        --seed) corpusArgs+=("$1" "$2"); queryArgs+=("$1" "$2") ;;
+        --queries) queries=$2 ;;
+        --mix|--or) queryArgs+=("$1" "$2") ;;
+        --query-words) queryArgs+=(--words "$2") ;;
+        --log) log=$2 ;;
+        --concurrency) concurrency=$2 ;;
+        --repeat) repeat=$2 ;;
+        --rank) rank=$2 ;;
+        --top) top=$2 ;;
+        --cache) cache=$2 ;;
+        --dir) dir=$2 ;;
+        --corpus) corpus=$2 ;;
+        *) sed -n '/^# Usage/,/^$/p' "$0" | sed 's/^# \{0,1\}//' >&2; exit 1 ;;
+    esac
+    shift 2
+done
+for arg in "${corpusArgs[@]}"; do
+    if [ "$arg" = "--vocabulary" ]; then
+        vocabularyNext=1
+    elif [ -n "$vocabularyNext" ]; then
+        queryArgs+=(--vocabulary "$arg"); vocabularyNext=""
+    fi
+done
+
+cd "$(dirname "$0")" || exit 2
+make -C ../indexer indexer >&2 && make -C ../querier querier >&2 && make all >&2 || exit 2
+
+keep=$dir
+dir=${dir:-$(mktemp -d)}
+pageDirectory=${corpus:-$dir/pages}
+mkdir -p "$dir" "$pageDirectory" || exit 2
+server=""
+cleanup() {
+    if [ -n "$server" ]; then
+        kill -INT $server 2>/dev/null
+        wait $server 2>/dev/null
+    fi
+    if [ -z "$keep" ]; then
+        rm -rf "$dir"
+    fi
+}
+trap cleanup EXIT
+
+# seconds since the epoch, to the nanosecond
+now() {
+    date +%s.%N
+}
+
+# seconds elapsed since $1, a time from now
+since() {
+    awk -v start=$1 -v end=$(now) 'BEGIN { printf "%.3f", end - start }'
+}
+
+corpusTime=""
+if [ -z "$corpus" ]; then
+    start=$(now)
+    ./gencorpus "$pageDirectory" $pages "${corpusArgs[@]}" || exit 2
+    corpusTime=", \"seconds\": $(since $start)"
+fi
+pages=$(ls "$pageDirectory" | grep -c '^[0-9]*$')
+corpusBytes=$(du -sb "$pageDirectory" | cut -f1)
+
+start=$(now)
+../indexer/indexer "$pageDirectory" "$dir/index.ndx" || exit 2
+indexSeconds=$(since $start)
+indexBytes=$(stat -c %s "$dir/index.ndx")
+indexRates=$(awk -v pages=$pages -v bytes=$corpusBytes -v seconds=$indexSeconds 'BEGIN {
+    if (seconds == 0) seconds = 0.001
+    printf "\"docs_per_sec\": %.1f, \"mb_per_sec\": %.2f", pages / seconds, bytes / 1048576 / seconds
+}')
+
+if [ -z "$log" ]; then
+    log="$dir/queries.txt"
+    ./genqueries $queries "${queryArgs[@]}" > "$log" || exit 2
+fi
+
+socket="$dir/querier.sock"
+../querier/querier "$pageDirectory" "$dir/index.ndx" --rank $rank --top $top --cache $cache \
+    --serve "$socket" --threads $concurrency 2>/dev/null &
+server=$!
+for i in $(seq 600); do
+    if [ -S "$socket" ] || ! kill -0 $server 2>/dev/null; then
+        break
+    fi
+    sleep 0.1
+done
+replay=$(./qbench "$socket" "$log" --concurrency $concurrency --repeat $repeat) || exit 2
+
+printf '{"corpus": {"pages": %d, "bytes": %d%s}, ' $pages $corpusBytes "$corpusTime"
+printf '"index": {"bytes": %d, "seconds": %s, %s}, ' $indexBytes $indexSeconds "$indexRates"
+printf '"querier": {"rank": "%s", "top": %d, "cache": %d, "threads": %d}, ' \
+    $rank $top $cache $concurrency
+printf '"replay": %s}\n' "$replay"
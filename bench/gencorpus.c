@@ -0,0 +1,133 @@
+/*
+ * gencorpus.c - synthetic page directory for benchmarks
+ *
+ * Usage: ./gencorpus pageDirectory numPages [--words n] [--vocabulary v] [--zipf s]
+ *                    [--links n] [--seed n] [--prefix url]
+ *
+ * Writes numPages pages, docIDs 1 to numPages, into the existing directory
+ * pageDirectory, in the Crawler's format (URL line, depth line, HTML), and
+ * marks the directory with a .crawler file, so the indexer and the querier
+ * take it for a crawl.
+ *
+ * Each page has between n/2 and 3n/2 words (--words, default 200), each
+ * drawn from a vocabulary of v words (--vocabulary, default 50000) with
+ * Zipf exponent s (--zipf, default 1.0); see zipf.h for how words are
+ * spelled. The pages form a crawl: page d links to pages 2d and 2d+1 (so
+ * page 1 reaches them all and page d sits at depth floor(log2 d)), plus n
+ * more links (--links, default 8) to pages drawn with Zipf skew, so a few
+ * pages are linked from nearly everywhere. Page d's URL, and every link to
+ * it, is the --prefix (default http://bench.example/page/) followed by
+ * "d.html"; webserver serves the pages under that prefix. --seed (default
+ * 1) picks the corpus; the same arguments always write the same pages.
+ *
+ * Exits 0 on success, 1 on bad arguments, 2 if a page cannot be written.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "zipf.h"
+
+#define DEFAULT_PREFIX "http://bench.example/page/"
+
+// Parses a non-negative number from arg into *value, which must hold no more than max.
+// Returns true if arg is such a number.
+static bool parseNumber(const char* arg, const double max, double* value) {
+    char* end;
+    *value = strtod(arg, &end);
+    return *arg != '\0' && *end == '\0' && *value >= 0 && *value <= max;
+}
+
+// Writes page docID of the corpus into pageDirectory.
+// Returns false if the file cannot be written.
+static bool writePage(const char* pageDirectory, const char* prefix, const int docID,
+                      const int numPages, const int numWords, const int numLinks,
+                      const zipf_t* words, const zipf_t* pages, uint64_t* state) {
+    char path[strlen(pageDirectory) + 16];
+    sprintf(path, "%s/%d", pageDirectory, docID);
+    FILE* fp = fopen(path, "w");
+    if (fp == NULL) {
+        return false;
+    }
+    int depth = 0;
+    while ((docID >> (depth + 1)) != 0) {
+        depth++;
+    }
+    fprintf(fp, "%s%d.html\n%d\n", prefix, docID, depth);
+    fprintf(fp, "<html>\n<head><title>Page %d</title></head>\n<body>\n<p>", docID);
+
+    int length = numWords / 2 + (int)zipf_uniform(state, numWords + 1);
+    char word[ZIPF_WORD_MAX];
+    for (int i = 0; i < length; i++) {
+        fputs(zipf_word(zipf_sample(words, state), word), fp);
+        fputs((i + 1) % 12 == 0 ? "\n" : " ", fp);
+    }
+    fprintf(fp, "</p>\n<ul>\n");
+    for (int child = 2 * docID; child <= 2 * docID + 1 && child <= numPages; child++) {
+        fprintf(fp, "<li><a href=\"%s%d.html\">next</a></li>\n", prefix, child);
+    }
+    for (int i = 0; i < numLinks; i++) {
+        fprintf(fp, "<li><a href=\"%s%d.html\">see also</a></li>\n", prefix,
+                zipf_sample(pages, state) + 1);
+    }
+    fprintf(fp, "</ul>\n</body>\n</html>\n");
+    return fclose(fp) == 0;
+}
+
+int main(const int argc, char* argv[]) {
+    double numPages = 0, numWords = 200, vocabulary = 50000, exponent = 1.0;
+    double numLinks = 8, seed = 1;
+    const char* prefix = DEFAULT_PREFIX;
+    bool ok = argc >= 3 && argc % 2 == 1 && parseNumber(argv[2], 1e8, &numPages)
+              && numPages >= 1;
+    for (int i = 3; ok && i < argc; i += 2) {
+        if (strcmp(argv[i], "--words") == 0) {
+            ok = parseNumber(argv[i + 1], 1e6, &numWords) && numWords >= 1;
+        } else if (strcmp(argv[i], "--vocabulary") == 0) {
+            ok = parseNumber(argv[i + 1], 1e8, &vocabulary) && vocabulary >= 1;
+        } else if (strcmp(argv[i], "--zipf") == 0) {
+            ok = parseNumber(argv[i + 1], 10, &exponent);
+        } else if (strcmp(argv[i], "--links") == 0) {
+            ok = parseNumber(argv[i + 1], 1e4, &numLinks);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            ok = parseNumber(argv[i + 1], 1e18, &seed);
+        } else if (strcmp(argv[i], "--prefix") == 0) {
+            prefix = argv[i + 1];
+            ok = strlen(prefix) < 200;
+        } else {
+            ok = false;
+        }
+    }
+    if (!ok) {
+        fprintf(stderr, "Usage: %s pageDirectory numPages [--words n] [--vocabulary v] "
+                "[--zipf s] [--links n] [--seed n] [--prefix url]\n", argv[0]);
+        exit(1);
+    }
+
+    char marker[strlen(argv[1]) + 16];
+    sprintf(marker, "%s/.crawler", argv[1]);
+    FILE* fp = fopen(marker, "w");
+    if (fp == NULL || fclose(fp) != 0) {
+        fprintf(stderr, "Cannot write to %s\n", argv[1]);
+        exit(2);
+    }
+    zipf_t* words = zipf_new((int)vocabulary, exponent);
+    zipf_t* pages = zipf_new((int)numPages, exponent);
+    if (words == NULL || pages == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(2);
+    }
+    uint64_t state = (uint64_t)seed;
+    for (int docID = 1; docID <= (int)numPages; docID++) {
+        if (!writePage(argv[1], prefix, docID, (int)numPages, (int)numWords, (int)numLinks,
+                       words, pages, &state)) {
+            fprintf(stderr, "Cannot write page %d to %s\n", docID, argv[1]);
+            exit(2);
+        }
+    }
+    zipf_delete(words);
+    zipf_delete(pages);
+    exit(0);
+}
@@ -0,0 +1,107 @@
+/*
+ * genqueries.c - synthetic query log for benchmarks
+ *
+ * Usage: ./genqueries numQueries [--vocabulary v] [--mix head,torso,tail]
+ *                     [--words min,max] [--or p] [--seed n]
+ *
+ * Prints numQueries queries, one per line, over the vocabulary of a corpus
+ * written by gencorpus with the same --vocabulary (default 50000).
+ *
+ * Every word of a query comes from one of three bands of the vocabulary's
+ * ranks: the head (the most frequent 0.1% of the words, which occur in most
+ * documents), the torso (the rest of the top 10%) and the tail (the other
+ * 90%, many of them in a handful of documents or none). --mix gives the
+ * bands' relative weights (default 20,50,30); within a band every word is
+ * equally likely. A query has between min and max words (--words, default
+ * 1,3), each joined to the previous one by "or" with probability p (--or,
+ * default 0.2) and by an implicit "and" otherwise. --seed (default 1) picks
+ * the queries; the same arguments always print the same queries.
+ *
+ * Exits 0 on success, 1 on bad arguments.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "zipf.h"
+
+// Parses a non-negative number from arg into *value, which must hold no more than max.
+// Returns true if arg is such a number.
+static bool parseNumber(const char* arg, const double max, double* value) {
+    char* end;
+    *value = strtod(arg, &end);
+    return *arg != '\0' && *end == '\0' && *value >= 0 && *value <= max;
+}
+
+// Parses count comma-separated non-negative numbers from arg into values.
+// Returns true if arg holds exactly count such numbers.
+static bool parseList(const char* arg, const int count, double values[]) {
+    for (int i = 0; i < count; i++) {
+        char* end;
+        values[i] = strtod(arg, &end);
+        if (end == arg || values[i] < 0 || *end != (i + 1 < count ? ',' : '\0')) {
+            return false;
+        }
+        arg = end + 1;
+    }
+    return true;
+}
+
+int main(const int argc, char* argv[]) {
+    double numQueries = 0, vocabulary = 50000, orProbability = 0.2, seed = 1;
+    double mix[3] = {20, 50, 30};
+    double words[2] = {1, 3};
+    bool ok = argc >= 2 && argc % 2 == 0 && parseNumber(argv[1], 1e9, &numQueries);
+    for (int i = 2; ok && i < argc; i += 2) {
+        if (strcmp(argv[i], "--vocabulary") == 0) {
+            ok = parseNumber(argv[i + 1], 1e8, &vocabulary) && vocabulary >= 1;
+        } else if (strcmp(argv[i], "--mix") == 0) {
+            ok = parseList(argv[i + 1], 3, mix) && mix[0] + mix[1] + mix[2] > 0;
+        } else if (strcmp(argv[i], "--words") == 0) {
+            ok = parseList(argv[i + 1], 2, words) && words[0] >= 1 && words[0] <= words[1]
+                 && words[1] <= 100;
+        } else if (strcmp(argv[i], "--or") == 0) {
+            ok = parseNumber(argv[i + 1], 1, &orProbability);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            ok = parseNumber(argv[i + 1], 1e18, &seed);
+        } else {
+            ok = false;
+        }
+    }
+    if (!ok) {
+        fprintf(stderr, "Usage: %s numQueries [--vocabulary v] [--mix head,torso,tail] "
+                "[--words min,max] [--or p] [--seed n]\n", argv[0]);
+        exit(1);
+    }
+
+    // The bands' ranks: [bounds[b], bounds[b+1]), each holding at least one word.
+    uint64_t v = (uint64_t)vocabulary;
+    uint64_t bounds[4] = {0, v / 1000, v / 10, v};
+    for (int b = 1; b < 3; b++) {
+        if (bounds[b] <= bounds[b - 1]) {
+            bounds[b] = bounds[b - 1] + 1 < v ? bounds[b - 1] + 1 : v;
+        }
+    }
+    double total = mix[0] + mix[1] + mix[2];
+    uint64_t state = (uint64_t)seed;
+    char word[ZIPF_WORD_MAX];
+    for (uint64_t q = 0; q < (uint64_t)numQueries; q++) {
+        int length = (int)words[0] + (int)zipf_uniform(&state, (int)words[1] - (int)words[0] + 1);
+        for (int w = 0; w < length; w++) {
+            double u = (zipf_random(&state) >> 11) * 0x1.0p-53 * total;
+            int band = u < mix[0] ? 0 : u < mix[0] + mix[1] ? 1 : 2;
+            while (bounds[band + 1] == bounds[band]) {
+                band--;  // an empty band (tiny vocabulary) gives way to a more frequent one
+            }
+            uint64_t rank = bounds[band] + zipf_uniform(&state, bounds[band + 1] - bounds[band]);
+            if (w > 0) {
+                fputs((zipf_random(&state) >> 11) * 0x1.0p-53 < orProbability ? " or " : " ", stdout);
+            }
+            fputs(zipf_word(rank, word), stdout);
+        }
+        putchar('\n');
+    }
+    exit(0);
+}
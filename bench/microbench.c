@@ -0,0 +1,660 @@
+/*
+ * microbench.c - microbenchmarks of the libcs50 modules
+ *
+ * Usage: ./microbench [--sizes n,n,...] [--min-time ms] [--only module]
+ *
+ * Times the operations of the libcs50 data structures the crawler, indexer
+ * and querier are built on, as linked into them (hashtable, intern, bloom
+ * and hash from source, the rest from libcs50-given.a): for each size n
+ * (--sizes, default 100,1000,10000) and each kind of key,
+ *
+ *   hashtable  insert, find-hit, find-zipf, find-miss, iterate, delete;
+ *              once with n slots and once with 200, the size the index
+ *              and crawler gave their tables
+ *   intern     insert (intern_add of new strings), find-hit, find-zipf,
+ *              find-miss, iterate (intern_string of every ID), delete
+ *   bloom      insert, find-hit, find-miss of each key's hash_bytes, in a
+ *              filter made for n keys
+ *   set        insert, find-hit, find-zipf, find-miss, iterate, delete
+ *   counters   add (new keys), add-zipf (existing keys), get-hit,
+ *              get-miss, iterate, delete
+ *   bag        insert, iterate, extract, delete
+ *   hash       hash_jenkins and hash_bytes of each key
+ *
+ * where insert builds a structure of n items from empty, find-hit looks up
+ * keys drawn uniformly from those present, find-zipf draws them with Zipf
+ * skew (as words and links are), find-miss looks up absent keys, iterate
+ * visits every item and delete frees the structure; each counts as one
+ * operation per item or lookup. String keys are "seq" (key00000001,
+ * key00000002, ...), "random" (6 to 16 random letters and the key's
+ * number) or "url" (URLs of about 60 bytes sharing the CS50 site's
+ * prefix); counters' keys are sequential or random integers. Then, once,
+ * the webpage module on a synthetic page of about 100 KB:
+ * webpage_getNextWord and webpage_getNextURL per word or link found, and
+ * normalizeURL per URL.
+ *
+ * Sets and counters are lists, so building one takes time quadratic in its
+ * size; they are skipped at sizes above 20000.
+ *
+ * Each benchmark is repeated until it has run --min-time milliseconds
+ * (default 100) in all, at least once. --only runs just the benchmarks of
+ * one module (hashtable, intern, bloom, set, counters, bag, hash, webpage).
+ * Prints one JSON object per benchmark to stdout:
+ *
+ *   {"benchmark": "set/find-zipf", "keys": "url", "n": 1000,
+ *    "ns_per_op": ..., "allocs_per_op": ..., "bytes_per_op": ...,
+ *    "ops": ...}
+ *
+ * with "slots" added for the hashtable, and for bloom/find-miss "positive",
+ * the fraction of absent keys the filter took for present. Allocations and
+ * their bytes are counted by wrapping malloc, calloc, realloc and strdup at
+ * link time (see the Makefile), so they count every allocation libcs50
+ * makes, and none made inside the C library itself.
+ *
+ * Exits 0 on success, 1 on bad arguments.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "../libcs50/hashtable.h"
+#include "../libcs50/intern.h"
+#include "../libcs50/bloom.h"
+#include "../libcs50/set.h"
+#include "../libcs50/counters.h"
+#include "../libcs50/bag.h"
+#include "../libcs50/hash.h"
+#include "../libcs50/webpage.h"
+#include "../common/latency.h"
+#include "zipf.h"
+
+#define MAX_SIZES 16
+#define MAX_SIZE 1000000    // largest --sizes; keeps random integer keys distinct
+#define MAX_LIST 20000      // largest size of the set and counters benchmarks
+#define INDEX_SLOTS 200     // slots the index and crawler used to give their tables
+#define PAGE_BYTES 100000   // size of the page the webpage benchmarks scan
+
+/**************** allocation counting ****************/
+
+// With -Wl,--wrap=malloc, every call to malloc outside the C library calls
+// __wrap_malloc, and __real_malloc is the C library's malloc; likewise for
+// the others.
+static uint64_t numAllocs;      // allocations so far
+static uint64_t allocBytes;     // bytes asked for by them
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    numAllocs++;
+    allocBytes += size;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    numAllocs++;
+    allocBytes += count * size;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    numAllocs++;
+    allocBytes += size;
+    return __real_realloc(ptr, size);
+}
+
+char* __wrap_strdup(const char* s) {
+    size_t size = strlen(s) + 1;
+    char* copy = __wrap_malloc(size);
+    return copy == NULL ? NULL : memcpy(copy, s, size);
+}
+
+/**************** measuring ****************/
+
+// The totals of one benchmark, over all its repetitions.
+typedef struct meter {
+    uint64_t ns;
+    uint64_t ops;
+    uint64_t allocs;
+    uint64_t bytes;
+} meter_t;
+
+static uint64_t startNs, startAllocs, startBytes;  // set by meterStart
+static double minTimeNs = 100e6;                    // --min-time
+
+// Starts timing a run of some operations.
+static void meterStart(void) {
+    startAllocs = numAllocs;
+    startBytes = allocBytes;
+    startNs = latency_now();
+}
+
+// Adds the run of ops operations started by meterStart to meter.
+static void meterStop(meter_t* meter, const uint64_t ops) {
+    uint64_t ns = latency_now() - startNs;
+    meter->ns += ns;
+    meter->ops += ops;
+    meter->allocs += numAllocs - startAllocs;
+    meter->bytes += allocBytes - startBytes;
+}
+
+// Returns true while the benchmarks measured by meters (count of them) should run
+// another round: until the first has run for --min-time, and at least once.
+static bool moreRounds(const meter_t* meters, const int count) {
+    uint64_t ns = 0;
+    for (int i = 0; i < count; i++) {
+        ns += meters[i].ns;
+    }
+    return meters[0].ops == 0 || ns < minTimeNs;
+}
+
+// Prints one benchmark's result as a line of JSON; extra is printed before
+// the measurements, and is "" or a list of fields ending with ", ".
+static void report(const char* benchmark, const char* keys, const int n, const char* extra,
+                   const meter_t* meter) {
+    double ops = meter->ops > 0 ? meter->ops : 1;
+    printf("{\"benchmark\": \"%s\", \"keys\": \"%s\", \"n\": %d, %s\"ns_per_op\": %.1f, "
+           "\"allocs_per_op\": %.2f, \"bytes_per_op\": %.1f, \"ops\": %llu}\n",
+           benchmark, keys, n, extra, meter->ns / ops, meter->allocs / ops,
+           meter->bytes / ops, (unsigned long long)meter->ops);
+    fflush(stdout);
+}
+
+/**************** keys ****************/
+
+// A set of n distinct keys, absent keys, and sequences of lookups.
+typedef struct keys {
+    const char* kind;   // "seq", "random" or "url"
+    int n;
+    char** present;     // present[i]: the i-th key inserted
+    char** absent;      // n keys never inserted
+    char** uniform;     // n lookups of present keys, uniformly drawn
+    char** skewed;      // n lookups of present keys, drawn with Zipf skew
+    int* ints;          // n distinct integer keys, for counters
+    int* intsAbsent;    // n integers not among them
+    int* intsSkewed;    // n lookups of ints, drawn with Zipf skew
+} keys_t;
+
+// Writes key i of kind into buf (at least 128 bytes); absent keys have
+// letters or numbers no present key has.
+static void makeKey(const char* kind, const int i, const bool absent, char* buf,
+                    uint64_t* state) {
+    if (strcmp(kind, "seq") == 0) {
+        sprintf(buf, "%s%08d", absent ? "yek" : "key", i);
+    } else if (strcmp(kind, "random") == 0) {
+        int length = 6 + (int)zipf_uniform(state, 11);
+        for (int c = 0; c < length; c++) {
+            buf[c] = (absent ? 'A' : 'a') + (char)zipf_uniform(state, 26);
+        }
+        sprintf(buf + length, "%d", i);  // distinct even if the letters are not
+    } else {
+        char word[ZIPF_WORD_MAX];
+        sprintf(buf, "http://cs50tse.cs.dartmouth.edu/tse/wikipedia/%s/%s%d.html",
+                zipf_word(zipf_uniform(state, 8000), word), absent ? "Missing_" : "", i);
+    }
+}
+
+// Creates the keys of kind for size n.
+static keys_t* makeKeys(const char* kind, const int n) {
+    keys_t* keys = calloc(1, sizeof(keys_t));
+    keys->kind = kind;
+    keys->n = n;
+    keys->present = malloc(n * sizeof(char*));
+    keys->absent = malloc(n * sizeof(char*));
+    keys->uniform = malloc(n * sizeof(char*));
+    keys->skewed = malloc(n * sizeof(char*));
+    keys->ints = malloc(n * sizeof(int));
+    keys->intsAbsent = malloc(n * sizeof(int));
+    keys->intsSkewed = malloc(n * sizeof(int));
+    uint64_t state = 1;
+    zipf_t* zipf = zipf_new(n, 1.0);
+    char buf[128];
+    for (int i = 0; i < n; i++) {
+        makeKey(kind, i, false, buf, &state);
+        keys->present[i] = strdup(buf);
+        makeKey(kind, i, true, buf, &state);
+        keys->absent[i] = strdup(buf);
+    }
+    for (int i = 0; i < n; i++) {
+        keys->uniform[i] = keys->present[zipf_uniform(&state, n)];
+        keys->skewed[i] = keys->present[zipf_sample(zipf, &state)];
+        // Random integer keys are distinct: i (or n + i if absent) in the low 22
+        // bits, noise in the 9 above.
+        bool sequential = strcmp(kind, "seq") == 0;
+        keys->ints[i] = sequential ? i : (int)(zipf_uniform(&state, 1 << 9) << 22 | i);
+        keys->intsAbsent[i] = sequential ? n + i
+                                         : (int)(zipf_uniform(&state, 1 << 9) << 22 | (n + i));
+    }
+    for (int i = 0; i < n; i++) {
+        keys->intsSkewed[i] = keys->ints[zipf_sample(zipf, &state)];
+    }
+    zipf_delete(zipf);
+    return keys;
+}
+
+// Frees keys.
+static void deleteKeys(keys_t* keys) {
+    for (int i = 0; i < keys->n; i++) {
+        free(keys->present[i]);
+        free(keys->absent[i]);
+    }
+    free(keys->present);
+    free(keys->absent);
+    free(keys->uniform);
+    free(keys->skewed);
+    free(keys->ints);
+    free(keys->intsAbsent);
+    free(keys->intsSkewed);
+    free(keys);
+}
+
+/**************** benchmarks ****************/
+
+static int visited;  // items seen by the iterators, so that they cannot be optimized out
+static void visitItem(void* arg, const char* key, void* item) { visited++; }
+static void visitCounter(void* arg, const int key, const int count) { visited++; }
+static void visitBagItem(void* arg, void* item) { visited++; }
+
+// Names of the operations of the string-keyed tables, in meter order.
+static const char* const TABLE_OPS[] = {"insert", "find-hit", "find-zipf", "find-miss",
+                                        "iterate", "delete"};
+
+// Benchmarks a hashtable of slots slots on keys.
+static void benchHashtable(const keys_t* keys, const int slots) {
+    meter_t meters[6] = {{0}};
+    int n = keys->n;
+    while (moreRounds(meters, 6)) {
+        meterStart();
+        hashtable_t* ht = hashtable_new(slots);
+        for (int i = 0; i < n; i++) {
+            hashtable_insert(ht, keys->present[i], keys->present[i]);
+        }
+        meterStop(&meters[0], n);
+        char** lookups[3] = {keys->uniform, keys->skewed, keys->absent};
+        for (int l = 0; l < 3; l++) {
+            meterStart();
+            for (int i = 0; i < n; i++) {
+                visited += hashtable_find(ht, lookups[l][i]) != NULL;
+            }
+            meterStop(&meters[1 + l], n);
+        }
+        meterStart();
+        hashtable_iterate(ht, NULL, visitItem);
+        meterStop(&meters[4], n);
+        meterStart();
+        hashtable_delete(ht, NULL);
+        meterStop(&meters[5], n);
+    }
+    char extra[32], name[32];
+    sprintf(extra, "\"slots\": %d, ", slots);
+    for (int m = 0; m < 6; m++) {
+        sprintf(name, "hashtable/%s", TABLE_OPS[m]);
+        report(name, keys->kind, n, extra, &meters[m]);
+    }
+}
+
+// Benchmarks an intern table on keys.
+static void benchIntern(const keys_t* keys) {
+    meter_t meters[6] = {{0}};
+    int n = keys->n;
+    while (moreRounds(meters, 6)) {
+        meterStart();
+        intern_t* intern = intern_new(NULL);
+        for (int i = 0; i < n; i++) {
+            intern_add(intern, keys->present[i]);
+        }
+        meterStop(&meters[0], n);
+        char** lookups[3] = {keys->uniform, keys->skewed, keys->absent};
+        for (int l = 0; l < 3; l++) {
+            meterStart();
+            for (int i = 0; i < n; i++) {
+                visited += intern_find(intern, lookups[l][i]) >= 0;
+            }
+            meterStop(&meters[1 + l], n);
+        }
+        meterStart();
+        for (int id = 0; id < intern_count(intern); id++) {
+            visited += intern_string(intern, id) != NULL;
+        }
+        meterStop(&meters[4], n);
+        meterStart();
+        intern_delete(intern);
+        meterStop(&meters[5], n);
+    }
+    char name[32];
+    for (int m = 0; m < 6; m++) {
+        sprintf(name, "intern/%s", TABLE_OPS[m]);
+        report(name, keys->kind, n, "", &meters[m]);
+    }
+}
+
+// Benchmarks a Bloom filter made for n keys on the hashes of keys, which
+// are computed beforehand, so that only the filter is timed.
+static void benchBloom(const keys_t* keys) {
+    int n = keys->n;
+    uint64_t* present = malloc(n * sizeof(uint64_t));
+    uint64_t* absent = malloc(n * sizeof(uint64_t));
+    for (int i = 0; i < n; i++) {
+        present[i] = hash_string(keys->present[i]);
+        absent[i] = hash_string(keys->absent[i]);
+    }
+    meter_t meters[3] = {{0}};
+    int positive = 0;
+    while (moreRounds(meters, 3)) {
+        meterStart();
+        bloom_t* bloom = bloom_new(n);
+        for (int i = 0; i < n; i++) {
+            bloom_insert(bloom, present[i]);
+        }
+        meterStop(&meters[0], n);
+        meterStart();
+        for (int i = 0; i < n; i++) {
+            visited += bloom_find(bloom, present[i]);
+        }
+        meterStop(&meters[1], n);
+        meterStart();
+        positive = 0;
+        for (int i = 0; i < n; i++) {
+            positive += bloom_find(bloom, absent[i]);
+        }
+        meterStop(&meters[2], n);
+        bloom_delete(bloom);
+    }
+    report("bloom/insert", keys->kind, n, "", &meters[0]);
+    report("bloom/find-hit", keys->kind, n, "", &meters[1]);
+    char extra[40];
+    sprintf(extra, "\"positive\": %.4f, ", (double)positive / n);
+    report("bloom/find-miss", keys->kind, n, extra, &meters[2]);
+    free(present);
+    free(absent);
+}
+
+// Benchmarks a set on keys.
+static void benchSet(const keys_t* keys) {
+    meter_t meters[6] = {{0}};
+    int n = keys->n;
+    while (moreRounds(meters, 6)) {
+        meterStart();
+        set_t* set = set_new();
+        for (int i = 0; i < n; i++) {
+            set_insert(set, keys->present[i], keys->present[i]);
+        }
+        meterStop(&meters[0], n);
+        char** lookups[3] = {keys->uniform, keys->skewed, keys->absent};
+        for (int l = 0; l < 3; l++) {
+            meterStart();
+            for (int i = 0; i < n; i++) {
+                visited += set_find(set, lookups[l][i]) != NULL;
+            }
+            meterStop(&meters[1 + l], n);
+        }
+        meterStart();
+        set_iterate(set, NULL, visitItem);
+        meterStop(&meters[4], n);
+        meterStart();
+        set_delete(set, NULL);
+        meterStop(&meters[5], n);
+    }
+    char name[32];
+    for (int m = 0; m < 6; m++) {
+        sprintf(name, "set/%s", TABLE_OPS[m]);
+        report(name, keys->kind, n, "", &meters[m]);
+    }
+}
+
+// Benchmarks counters on keys' integers.
+static void benchCounters(const keys_t* keys) {
+    static const char* const OPS[] = {"add", "add-zipf", "get-hit", "get-miss",
+                                      "iterate", "delete"};
+    meter_t meters[6] = {{0}};
+    int n = keys->n;
+    while (moreRounds(meters, 6)) {
+        meterStart();
+        counters_t* ctrs = counters_new();
+        for (int i = 0; i < n; i++) {
+            counters_add(ctrs, keys->ints[i]);
+        }
+        meterStop(&meters[0], n);
+        meterStart();
+        for (int i = 0; i < n; i++) {
+            counters_add(ctrs, keys->intsSkewed[i]);
+        }
+        meterStop(&meters[1], n);
+        meterStart();
+        for (int i = 0; i < n; i++) {
+            visited += counters_get(ctrs, keys->intsSkewed[i]);
+        }
+        meterStop(&meters[2], n);
+        meterStart();
+        for (int i = 0; i < n; i++) {
+            visited += counters_get(ctrs, keys->intsAbsent[i]);
+        }
+        meterStop(&meters[3], n);
+        meterStart();
+        counters_iterate(ctrs, NULL, visitCounter);
+        meterStop(&meters[4], n);
+        meterStart();
+        counters_delete(ctrs);
+        meterStop(&meters[5], n);
+    }
+    char name[32];
+    for (int m = 0; m < 6; m++) {
+        sprintf(name, "counters/%s", OPS[m]);
+        report(name, keys->kind, n, "", &meters[m]);
+    }
+}
+
+// Benchmarks a bag of n items.
+static void benchBag(const keys_t* keys) {
+    static const char* const OPS[] = {"insert", "iterate", "extract", "delete"};
+    meter_t meters[4] = {{0}};
+    int n = keys->n;
+    while (moreRounds(meters, 4)) {
+        meterStart();
+        bag_t* bag = bag_new();
+        for (int i = 0; i < n; i++) {
+            bag_insert(bag, keys->present[i]);
+        }
+        meterStop(&meters[0], n);
+        meterStart();
+        bag_iterate(bag, NULL, visitBagItem);
+        meterStop(&meters[1], n);
+        meterStart();
+        while (bag_extract(bag) != NULL) {
+            visited++;
+        }
+        meterStop(&meters[2], n);
+        for (int i = 0; i < n; i++) {
+            bag_insert(bag, keys->present[i]);
+        }
+        meterStart();
+        bag_delete(bag, NULL);
+        meterStop(&meters[3], n);
+    }
+    char name[32];
+    for (int m = 0; m < 4; m++) {
+        sprintf(name, "bag/%s", OPS[m]);
+        report(name, "items", n, "", &meters[m]);
+    }
+}
+
+// Benchmarks hash_jenkins and hash_bytes on keys.
+static void benchHash(const keys_t* keys) {
+    meter_t meter = {0};
+    while (moreRounds(&meter, 1)) {
+        meterStart();
+        for (int i = 0; i < keys->n; i++) {
+            visited += hash_jenkins(keys->present[i], INDEX_SLOTS) == 0;
+        }
+        meterStop(&meter, keys->n);
+    }
+    report("hash/jenkins", keys->kind, keys->n, "", &meter);
+
+    meter = (meter_t){0};
+    while (moreRounds(&meter, 1)) {
+        meterStart();
+        for (int i = 0; i < keys->n; i++) {
+            visited += hash_string(keys->present[i]) == 0;
+        }
+        meterStop(&meter, keys->n);
+    }
+    report("hash/bytes", keys->kind, keys->n, "", &meter);
+}
+
+// Returns a malloc'd page of about PAGE_BYTES of HTML: Zipf-distributed words
+// in paragraphs, with absolute and relative links.
+static char* makePage(void) {
+    char* html = malloc(PAGE_BYTES + 256);
+    size_t length = sprintf(html, "<html>\n<head><title>Benchmark</title></head>\n<body>\n");
+    zipf_t* zipf = zipf_new(50000, 1.0);
+    uint64_t state = 1;
+    char word[ZIPF_WORD_MAX];
+    for (int w = 1; length < PAGE_BYTES; w++) {
+        if (w % 40 == 0) {
+            length += sprintf(html + length, "<a href=\"http://cs50tse.cs.dartmouth.edu/tse/"
+                              "wikipedia/%s.html\">%s</a>\n",
+                              zipf_word(zipf_sample(zipf, &state), word), word);
+        } else if (w % 40 == 20) {
+            length += sprintf(html + length, "<a href=\"../%s/index.html#top\">up</a>\n",
+                              zipf_word(zipf_sample(zipf, &state), word));
+        } else {
+            length += sprintf(html + length, w % 12 == 0 ? "%s\n" : "%s ",
+                              zipf_word(zipf_sample(zipf, &state), word));
+        }
+    }
+    strcpy(html + length, "</body>\n</html>\n");
+    zipf_delete(zipf);
+    return html;
+}
+
+// Benchmarks the webpage module's scanning on a synthetic page. The page
+// scanned for words is not the one scanned for links, as webpage_getNextURL
+// strips the whitespace out of the page it scans.
+static void benchWebpage(void) {
+    static const char URL[] = "http://cs50tse.cs.dartmouth.edu/tse/wikipedia/Benchmark/index.html";
+    webpage_t* page = webpage_new(strdup(URL), 0, makePage());
+    webpage_t* linked = webpage_new(strdup(URL), 0, makePage());
+    int size = (int)strlen(webpage_getHTML(page));
+    int numURLs = 0;
+    char* urls[1024];
+    int pos = 0;
+    char* url;
+    while ((url = webpage_getNextURL(linked, &pos)) != NULL) {
+        if (numURLs < 1024) {
+            urls[numURLs++] = url;
+        } else {
+            free(url);
+        }
+    }
+
+    meter_t words = {0}, links = {0}, normalize = {0};
+    while (moreRounds(&words, 1)) {
+        uint64_t found = 0;
+        char* word;
+        meterStart();
+        for (pos = 0; (word = webpage_getNextWord(page, &pos)) != NULL; found++) {
+            free(word);
+        }
+        meterStop(&words, found);
+    }
+    while (moreRounds(&links, 1)) {
+        uint64_t found = 0;
+        meterStart();
+        for (pos = 0; (url = webpage_getNextURL(linked, &pos)) != NULL; found++) {
+            free(url);
+        }
+        meterStop(&links, found);
+    }
+    while (moreRounds(&normalize, 1)) {
+        meterStart();
+        for (int u = 0; u < numURLs; u++) {
+            free(normalizeURL(urls[u]));
+        }
+        meterStop(&normalize, numURLs);
+    }
+    report("webpage/getNextWord", "page", size, "", &words);
+    report("webpage/getNextURL", "page", size, "", &links);
+    report("webpage/normalizeURL", "url", numURLs, "", &normalize);
+    for (int u = 0; u < numURLs; u++) {
+        free(urls[u]);
+    }
+    webpage_delete(page);
+    webpage_delete(linked);
+}
+
+/**************** main ****************/
+
+int main(const int argc, char* argv[]) {
+    int sizes[MAX_SIZES] = {100, 1000, 10000};
+    int numSizes = 3;
+    const char* only = NULL;
+    bool ok = argc % 2 == 1;
+    for (int i = 1; ok && i < argc; i += 2) {
+        if (strcmp(argv[i], "--sizes") == 0) {
+            char* arg = argv[i + 1];
+            char* end;
+            numSizes = 0;
+            do {
+                long size = strtol(arg, &end, 10);
+                ok = end != arg && size >= 1 && size <= MAX_SIZE && numSizes < MAX_SIZES
+                     && (*end == ',' || *end == '\0');
+                if (ok) {
+                    sizes[numSizes++] = (int)size;
+                }
+                arg = end + 1;
+            } while (ok && *end == ',');
+        } else if (strcmp(argv[i], "--min-time") == 0) {
+            char* end;
+            minTimeNs = strtod(argv[i + 1], &end) * 1e6;
+            ok = *argv[i + 1] != '\0' && *end == '\0' && minTimeNs >= 0;
+        } else if (strcmp(argv[i], "--only") == 0) {
+            only = argv[i + 1];
+        } else {
+            ok = false;
+        }
+    }
+    if (!ok) {
+        fprintf(stderr, "Usage: %s [--sizes n,n,...] [--min-time ms] [--only module]\n"
+                "with at most %d sizes, each from 1 to %d\n", argv[0], MAX_SIZES, MAX_SIZE);
+        exit(1);
+    }
+
+    static const char* const KINDS[] = {"seq", "random", "url"};
+    for (int s = 0; s < numSizes; s++) {
+        for (int k = 0; k < 3; k++) {
+            keys_t* keys = makeKeys(KINDS[k], sizes[s]);
+            if (only == NULL || strcmp(only, "hashtable") == 0) {
+                benchHashtable(keys, sizes[s]);
+                benchHashtable(keys, INDEX_SLOTS);
+            }
+            if (only == NULL || strcmp(only, "intern") == 0) {
+                benchIntern(keys);
+            }
+            if (only == NULL || strcmp(only, "bloom") == 0) {
+                benchBloom(keys);
+            }
+            if (sizes[s] <= MAX_LIST && (only == NULL || strcmp(only, "set") == 0)) {
+                benchSet(keys);
+            }
+            if (k < 2 && sizes[s] <= MAX_LIST
+                && (only == NULL || strcmp(only, "counters") == 0)) {
+                benchCounters(keys);
+            }
+            if (k == 0 && (only == NULL || strcmp(only, "bag") == 0)) {
+                benchBag(keys);
+            }
+            if (only == NULL || strcmp(only, "hash") == 0) {
+                benchHash(keys);
+            }
+            deleteKeys(keys);
+        }
+    }
+    if (only == NULL || strcmp(only, "webpage") == 0) {
+        benchWebpage();
+    }
+    exit(visited == -1);  // never, but the compiler cannot know
+}
@@ -0,0 +1,106 @@
+#!/bin/bash
+#
+# pipeline.sh - crawl, index and query benchmark against a local web server
+#
+# Usage: ./pipeline.sh [--pages n] [--words n] [--vocabulary v] [--zipf s] [--links n]
+#                      [--seed n] [--depth d] [--port p] [--latency ms] [--bandwidth KB]
+#                      [--seen-dir dir] [--frontier-dir dir] [--frontier-max n]
+#                      [--output file] [bench.sh options...]
+#
+# Writes a site of --pages pages (default 1000) with gencorpus, serves it
+# with webserver on loopback port --port (default 8650) under the internal
+# prefix http://localhost:port/tse/, each response delayed --latency ms and
+# paced at --bandwidth KB/s (both default 0: none), and crawls it to depth
+# --depth (default 10) from its first page with a crawler built for that
+# prefix and without the crawler's one-second pause; with --seen-dir, the
+# crawler keeps its set of URLs seen on disk in dir, and with --frontier-dir
+# (and --frontier-max n), its URLs yet to crawl past the first n. Then runs
+# bench.sh on the crawl (--corpus), which indexes it and replays queries
+# against it; every other option is passed on to bench.sh (see it for its
+# settings).
+#
+# Writes one JSON object to --output (default stdout), for comparison
+# across commits:
+#
+#   {"commit": ..., "date": ...,
+#    "crawl": {"pages": ..., "bytes": ..., "seconds": ..., "pages_per_sec": ...,
+#              "latency_ms": ..., "bandwidth_kb": ...},
+#    "corpus": ..., "index": ..., "querier": ..., "replay": ...}
+#
+# where commit is the source tree's git commit (with "-dirty" if it has
+# changes), crawl counts the pages the crawler saved (those within --depth
+# links of the first page), and the rest is bench.sh's report.
+# Exits 0 on success, 1 on bad arguments, 2 if a step fails.
+
+pages=1000; depth=10; port=8650; latency=0; bandwidth=0; output=/dev/stdout
+corpusArgs=(); benchArgs=(); crawlerArgs=()
+while [ $# -gt 0 ]; do
+    if [ $# -lt 2 ]; then
+        set -- --usage
+    fi
+    case "$1" in
+        --pages) pages=$2 ;;
+        --words|--zipf|--links) corpusArgs+=("$1" "$2") ;;
+        --vocabulary|--seed) corpusArgs+=("$1" "$2"); benchArgs+=("$1" "$2") ;;
+        --depth) depth=$2 ;;
+        --port) port=$2 ;;
+        --latency) latency=$2 ;;
+        --bandwidth) bandwidth=$2 ;;
+        --seen-dir|--frontier-dir|--frontier-max) crawlerArgs+=("$1" "$2") ;;
+        --output) output=$2 ;;
+        --corpus|--dir|--usage) sed -n '/^# Usage/,/^$/p' "$0" | sed 's/^# \{0,1\}//' >&2; exit 1 ;;
+        *) benchArgs+=("$1" "$2") ;;
+    esac
+    shift 2
+done
+
+cd "$(dirname "$0")" || exit 2
+prefix="http://localhost:$port/tse/"
+make -B crawler PREFIX="$prefix" >&2 && make webserver gencorpus >&2 || exit 2
+
+dir=$(mktemp -d)
+server=""
+cleanup() {
+    if [ -n "$server" ]; then
+        kill $server 2>/dev/null
+        wait $server 2>/dev/null
+    fi
+    rm -rf "$dir"
+}
+trap cleanup EXIT
+
+# seconds since the epoch, to the nanosecond
+now() {
+    date +%s.%N
+}
+
+mkdir "$dir/site" "$dir/crawl" || exit 2
+./gencorpus "$dir/site" $pages --prefix "$prefix" "${corpusArgs[@]}" || exit 2
+./webserver "$dir/site" "$prefix" --latency $latency --bandwidth $bandwidth &
+server=$!
+for i in $(seq 50); do
+    if (exec 3<>/dev/tcp/127.0.0.1/$port) 2>/dev/null || ! kill -0 $server 2>/dev/null; then
+        break  # The server is listening, or failed to start.
+    fi
+    sleep 0.1
+done
+
+start=$(now)
+./crawler "${prefix}1.html" "$dir/crawl" $depth "${crawlerArgs[@]}" || exit 2
+crawl=$(awk -v start=$start -v end=$(now) -v pages=$(ls "$dir/crawl" | grep -c '^[0-9]*$') \
+            -v bytes=$(du -sb "$dir/crawl" | cut -f1) 'BEGIN {
+    seconds = end - start
+    printf "\"pages\": %d, \"bytes\": %d, \"seconds\": %.3f, \"pages_per_sec\": %.1f", \
+           pages, bytes, seconds, (seconds > 0 ? pages / seconds : 0)
+}')
+kill $server
+wait $server 2>/dev/null
+server=""
+
+report=$(./bench.sh --corpus "$dir/crawl" "${benchArgs[@]}") || exit 2
+commit=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+if [ -n "$(git status --porcelain --untracked-files=no -- .. 2>/dev/null)" ]; then
+    commit="$commit-dirty"
+fi
+printf '{"commit": "%s", "date": "%s", "crawl": {%s, "latency_ms": %s, "bandwidth_kb": %s}, %s\n' \
+    "$commit" "$(date -u +%Y-%m-%dT%H:%M:%SZ)" "$crawl" $latency $bandwidth "${report#\{}" > "$output"
@@ -0,0 +1,220 @@
+/*
+ * qbench.c - query replay load generator for the querier's server mode
+ *
+ * Usage: ./qbench address queryFile [--concurrency c] [--repeat n]
+ *
+ * Connects c times (--concurrency, default 1) to a querier started with
+ * --serve address and replays the queries of queryFile (one per line, "-"
+ * for stdin; blank lines are skipped) n times over (--repeat, default 1),
+ * in order, each connection sending its next query as soon as the previous
+ * one is answered. So c queries are in flight at all times: a closed loop
+ * at fixed concurrency, which measures the latency the server gives at the
+ * throughput it can sustain.
+ *
+ * Each query is timed from just before it is sent until its answer is
+ * received. When all are answered, prints one JSON object to stdout:
+ *
+ *   {"queries": ..., "concurrency": ..., "seconds": ..., "qps": ...,
+ *    "results": ..., "nomatch": ..., "invalid": ..., "errors": ...,
+ *    "latency_ms": {"mean": ..., "p50": ..., "p90": ..., "p99": ...,
+ *                   "p999": ..., "max": ...}}
+ *
+ * where results, nomatch and invalid count the answers of each kind (see
+ * protocol.h) and errors the queries that got no answer. Percentiles come
+ * from the latency module's histogram, so are within about 3% above the
+ * exact values.
+ *
+ * Exits 0 if every query was answered, 1 on bad arguments or if the server
+ * cannot be reached, 2 if a connection was lost.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "../common/protocol.h"
+#include "../common/latency.h"
+
+#define MAX_CONCURRENCY 1024
+
+// The replay shared by the connections' threads.
+typedef struct replay {
+    const char* address;
+    char** queries;         // the query log, without newlines
+    size_t* lengths;        // lengths[q]: length of queries[q]
+    size_t numQueries;
+    uint64_t total;         // numQueries times the repeat count
+    latency_t* latency;     // one phase: a query's round trip
+    pthread_mutex_t lock;   // guards everything below
+    uint64_t next;          // the next query to send, counting repeats
+    uint64_t counts[4];     // answers: results, nomatch, invalid; then errors
+    double totalNs;         // sum of the answered queries' round trips
+} replay_t;
+
+// Reads the non-blank lines of queryFile ("-" for stdin) into replay.
+// Returns false if the file cannot be read.
+static bool readQueries(replay_t* replay, const char* queryFile) {
+    FILE* fp = strcmp(queryFile, "-") == 0 ? stdin : fopen(queryFile, "r");
+    if (fp == NULL) {
+        return false;
+    }
+    size_t capacity = 0;
+    char* line = NULL;
+    size_t lineCap = 0;
+    ssize_t lineLength;
+    while ((lineLength = getline(&line, &lineCap, fp)) >= 0) {
+        if (lineLength > 0 && line[lineLength - 1] == '\n') {
+            line[--lineLength] = '\0';
+        }
+        if (lineLength == 0 || lineLength > PROTOCOL_MAX_QUERY) {
+            continue;
+        }
+        if (replay->numQueries == capacity) {
+            capacity = capacity == 0 ? 1024 : 2 * capacity;
+            replay->queries = realloc(replay->queries, capacity * sizeof(char*));
+            replay->lengths = realloc(replay->lengths, capacity * sizeof(size_t));
+            if (replay->queries == NULL || replay->lengths == NULL) {
+                fprintf(stderr, "Out of memory\n");
+                exit(2);
+            }
+        }
+        replay->queries[replay->numQueries] = strdup(line);
+        replay->lengths[replay->numQueries++] = lineLength;
+    }
+    free(line);
+    if (fp != stdin) {
+        fclose(fp);
+    }
+    return true;
+}
+
+// Sends queries over a connection of its own until the replay is done or the
+// connection is lost.
+static void* replayThread(void* arg) {
+    replay_t* replay = arg;
+    int fd = protocol_connect(replay->address);
+    uint64_t counts[4] = {0, 0, 0, 0};
+    double totalNs = 0;
+    for (;;) {
+        pthread_mutex_lock(&replay->lock);
+        uint64_t q = replay->next < replay->total ? replay->next++ : UINT64_MAX;
+        pthread_mutex_unlock(&replay->lock);
+        if (q == UINT64_MAX) {
+            break;
+        }
+        q %= replay->numQueries;
+        size_t length = 0;
+        char* reply = NULL;
+        uint64_t start = latency_now();
+        bool ok = fd >= 0 && protocol_send(fd, replay->queries[q], replay->lengths[q])
+                  && (reply = protocol_recv(fd, PROTOCOL_MAX_REPLY, &length)) != NULL
+                  && length > 0;
+        uint64_t ns = latency_now() - start;
+        if (!ok) {
+            counts[3]++;
+            free(reply);
+            if (fd >= 0) {
+                close(fd);
+            }
+            fd = -1;  // Count the rest of this thread's queries as errors.
+            continue;
+        }
+        latency_record(replay->latency, &ns);
+        totalNs += ns;
+        counts[reply[0] == PROTOCOL_RESULTS ? 0 : reply[0] == PROTOCOL_NOMATCH ? 1 : 2]++;
+        free(reply);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    pthread_mutex_lock(&replay->lock);
+    for (int i = 0; i < 4; i++) {
+        replay->counts[i] += counts[i];
+    }
+    replay->totalNs += totalNs;
+    pthread_mutex_unlock(&replay->lock);
+    return NULL;
+}
+
+int main(const int argc, char* argv[]) {
+    int concurrency = 1, repeat = 1;
+    bool ok = argc >= 3 && argc % 2 == 1;
+    for (int i = 3; ok && i < argc; i += 2) {
+        char* end;
+        long value = strtol(argv[i + 1], &end, 10);
+        ok = *argv[i + 1] != '\0' && *end == '\0' && value >= 1;
+        if (ok && strcmp(argv[i], "--concurrency") == 0 && value <= MAX_CONCURRENCY) {
+            concurrency = (int)value;
+        } else if (ok && strcmp(argv[i], "--repeat") == 0 && value <= 1000000) {
+            repeat = (int)value;
+        } else {
+            ok = false;
+        }
+    }
+    if (!ok) {
+        fprintf(stderr, "Usage: %s address queryFile [--concurrency c] [--repeat n]\n", argv[0]);
+        exit(1);
+    }
+
+    static const char* const PHASES[] = {"query"};
+    replay_t replay = {.address = argv[1], .latency = latency_new(1, PHASES)};
+    pthread_mutex_init(&replay.lock, NULL);
+    if (!readQueries(&replay, argv[2])) {
+        fprintf(stderr, "Cannot read %s: %s\n", argv[2], strerror(errno));
+        exit(1);
+    }
+    if (replay.latency == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(2);
+    }
+    int probe = protocol_connect(argv[1]);
+    if (probe < 0) {
+        fprintf(stderr, "Cannot connect to %s: %s\n", argv[1], strerror(errno));
+        exit(1);
+    }
+    close(probe);
+    replay.total = (uint64_t)replay.numQueries * repeat;
+
+    pthread_t threads[concurrency];
+    uint64_t start = latency_now();
+    for (int t = 0; t < concurrency; t++) {
+        if (pthread_create(&threads[t], NULL, replayThread, &replay) != 0) {
+            fprintf(stderr, "Cannot start thread %d\n", t);
+            exit(2);
+        }
+    }
+    for (int t = 0; t < concurrency; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    double seconds = (latency_now() - start) / 1e9;
+
+    uint64_t answered = replay.counts[0] + replay.counts[1] + replay.counts[2];
+    printf("{\"queries\": %llu, \"concurrency\": %d, \"seconds\": %.3f, \"qps\": %.1f, "
+           "\"results\": %llu, \"nomatch\": %llu, \"invalid\": %llu, \"errors\": %llu, "
+           "\"latency_ms\": {\"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, "
+           "\"p999\": %.3f, \"max\": %.3f}}\n",
+           (unsigned long long)replay.total, concurrency, seconds,
+           seconds > 0 ? answered / seconds : 0,
+           (unsigned long long)replay.counts[0], (unsigned long long)replay.counts[1],
+           (unsigned long long)replay.counts[2], (unsigned long long)replay.counts[3],
+           answered > 0 ? replay.totalNs / answered / 1e6 : 0,
+           latency_percentile(replay.latency, 0, 0.5) / 1e6,
+           latency_percentile(replay.latency, 0, 0.9) / 1e6,
+           latency_percentile(replay.latency, 0, 0.99) / 1e6,
+           latency_percentile(replay.latency, 0, 0.999) / 1e6,
+           latency_percentile(replay.latency, 0, 1.0) / 1e6);
+
+    for (size_t q = 0; q < replay.numQueries; q++) {
+        free(replay.queries[q]);
+    }
+    free(replay.queries);
+    free(replay.lengths);
+    latency_delete(replay.latency);
+    pthread_mutex_destroy(&replay.lock);
+    exit(replay.counts[3] == 0 ? 0 : 2);
+}
@@ -0,0 +1,251 @@
+/*
+ * webserver.c - local stand-in for the crawler's web server
+ *
+ * Usage: ./webserver pageDirectory prefix [--latency ms] [--bandwidth KB]
+ *
+ * Serves the pages of pageDirectory (in the Crawler's format, such as those
+ * gencorpus writes) over HTTP, so that the crawler can be run and timed
+ * without a live server. prefix is the site's internal prefix, of the form
+ * http://localhost:port/path/ or http://127.0.0.1:port/path/: the server
+ * listens on that loopback port and answers "GET /path/d.html" with the
+ * HTML of page d (the page file minus its URL and depth lines), and
+ * anything else with 404. A crawler built with the same prefix as its
+ * INTERNAL_PREFIX (see libcs50/webpage.h) crawls the pages, given the
+ * prefix followed by "1.html" as its seed, if gencorpus wrote the pages
+ * with that --prefix.
+ *
+ * Every response is held back --latency milliseconds (default 0; fractions
+ * allowed) before its first byte, and then sent at no more than --bandwidth
+ * kilobytes per second (default 0: as fast as the socket takes it), as a
+ * distant server would. Each connection is served by a thread of its own,
+ * so slow responses overlap. Runs until killed.
+ *
+ * Exits 1 on bad arguments, 2 if the port cannot be listened on.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include "../common/protocol.h"
+#include "../common/latency.h"
+
+#define MAX_REQUEST 8192
+#define CHUNKS_PER_SECOND 50   // paced responses go out in this many pieces a second
+
+// What every connection's thread needs.
+typedef struct site {
+    const char* pageDirectory;
+    const char* path;       // the prefix's path, from its first '/'
+    double latencyNs;       // delay before each response
+    double bytesPerNs;      // bandwidth; 0 is unlimited
+} site_t;
+
+// One accepted connection, handed to its thread.
+typedef struct connection {
+    const site_t* site;
+    int fd;
+} connection_t;
+
+// Sleeps until the monotonic clock reads deadline (in ns).
+static void sleepUntil(const uint64_t deadline) {
+    uint64_t now;
+    while ((now = latency_now()) < deadline) {
+        struct timespec wait = {(deadline - now) / 1000000000u, (deadline - now) % 1000000000u};
+        nanosleep(&wait, NULL);
+    }
+}
+
+// Writes len bytes from buf to fd. Returns false if the client went away.
+static bool writeAll(int fd, const char* buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Returns the HTML of page docID of pageDirectory in a malloc'd buffer, with
+// its length in *length, or NULL if there is no such page.
+static char* loadHTML(const char* pageDirectory, const int docID, size_t* length) {
+    char path[strlen(pageDirectory) + 16];
+    sprintf(path, "%s/%d", pageDirectory, docID);
+    FILE* fp = fopen(path, "r");
+    if (fp == NULL) {
+        return NULL;
+    }
+    int newlines = 0, c;
+    while (newlines < 2 && (c = getc(fp)) != EOF) {
+        newlines += c == '\n';  // Skip the URL and depth lines.
+    }
+    long start = ftell(fp);
+    fseek(fp, 0, SEEK_END);
+    long end = ftell(fp);
+    char* html = start >= 0 && end >= start ? malloc(end - start + 1) : NULL;
+    if (html != NULL) {
+        fseek(fp, start, SEEK_SET);
+        *length = fread(html, 1, end - start, fp);
+        html[*length] = '\0';
+    }
+    fclose(fp);
+    return html;
+}
+
+// Returns the docID that request (a request line and headers) asks for, or
+// 0 if it does not ask for a page under path.
+static int requestedPage(const char* request, const char* path) {
+    size_t pathLength = strlen(path);
+    if (strncmp(request, "GET ", 4) != 0 || strncmp(request + 4, path, pathLength) != 0) {
+        return 0;
+    }
+    int docID = 0, consumed = 0;
+    if (sscanf(request + 4 + pathLength, "%d.html%n", &docID, &consumed) != 1
+        || consumed == 0 || request[4 + pathLength + consumed] != ' ') {
+        return 0;
+    }
+    return docID > 0 ? docID : 0;
+}
+
+// Answers the one request of a connection, then closes it.
+static void* serveConnection(void* arg) {
+    connection_t* connection = arg;
+    const site_t* site = connection->site;
+    int fd = connection->fd;
+    free(connection);
+
+    char request[MAX_REQUEST + 1];
+    size_t length = 0;
+    while (length < MAX_REQUEST) {
+        ssize_t n = read(fd, request + length, MAX_REQUEST - length);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        length += n;
+        request[length] = '\0';
+        if (strstr(request, "\r\n\r\n") != NULL || strstr(request, "\n\n") != NULL) {
+            break;
+        }
+    }
+    request[length] = '\0';
+    uint64_t start = latency_now() + (uint64_t)site->latencyNs;
+
+    int docID = requestedPage(request, site->path);
+    size_t bodyLength = 0;
+    char* body = docID > 0 ? loadHTML(site->pageDirectory, docID, &bodyLength) : NULL;
+    static const char NOT_FOUND[] = "<html><body>Not found</body></html>\n";
+    char header[256];
+    int headerLength = snprintf(header, sizeof(header),
+                                "HTTP/1.1 %s\r\nContent-Type: text/html\r\n"
+                                "Content-Length: %zu\r\nConnection: close\r\n\r\n",
+                                body != NULL ? "200 OK" : "404 Not Found",
+                                body != NULL ? bodyLength : sizeof(NOT_FOUND) - 1);
+    const char* content = body != NULL ? body : NOT_FOUND;
+    size_t contentLength = body != NULL ? bodyLength : sizeof(NOT_FOUND) - 1;
+
+    sleepUntil(start);
+    bool ok = writeAll(fd, header, headerLength);
+    if (site->bytesPerNs == 0) {
+        ok = ok && writeAll(fd, content, contentLength);
+    } else {
+        // Send a chunk at a time, each once the bandwidth allows it and all before it.
+        size_t chunk = (size_t)(site->bytesPerNs * 1e9 / CHUNKS_PER_SECOND) + 1;
+        for (size_t sent = 0; ok && sent < contentLength; sent += chunk) {
+            size_t n = contentLength - sent < chunk ? contentLength - sent : chunk;
+            sleepUntil(start + (uint64_t)((headerLength + sent + n) / site->bytesPerNs));
+            ok = writeAll(fd, content + sent, n);
+        }
+    }
+    free(body);
+    close(fd);
+    return NULL;
+}
+
+// Parses an internal prefix "http://host:port/path/" into the listening
+// address "host:port" (at most addressSize bytes) and a pointer to the path.
+// Returns false if prefix is not of that form.
+static bool parsePrefix(const char* prefix, char* address, const size_t addressSize,
+                        const char** path) {
+    if (strncmp(prefix, "http://", 7) != 0) {
+        return false;
+    }
+    const char* host = prefix + 7;
+    const char* slash = strchr(host, '/');
+    size_t prefixLength = strlen(prefix);
+    if (slash == NULL || (size_t)(slash - host) >= addressSize || prefix[prefixLength - 1] != '/') {
+        return false;
+    }
+    memcpy(address, host, slash - host);
+    address[slash - host] = '\0';
+    *path = slash;
+    return strchr(address, ':') != NULL;
+}
+
+int main(const int argc, char* argv[]) {
+    site_t site = {.pageDirectory = argc > 1 ? argv[1] : NULL};
+    char address[64];
+    bool ok = argc >= 3 && argc % 2 == 1
+              && parsePrefix(argv[2], address, sizeof(address), &site.path);
+    for (int i = 3; ok && i < argc; i += 2) {
+        char* end;
+        double value = strtod(argv[i + 1], &end);
+        ok = *argv[i + 1] != '\0' && *end == '\0' && value >= 0 && value <= 1e9;
+        if (ok && strcmp(argv[i], "--latency") == 0) {
+            site.latencyNs = value * 1e6;
+        } else if (ok && strcmp(argv[i], "--bandwidth") == 0) {
+            site.bytesPerNs = value * 1024 / 1e9;
+        } else {
+            ok = false;
+        }
+    }
+    if (!ok) {
+        fprintf(stderr, "Usage: %s pageDirectory prefix [--latency ms] [--bandwidth KB]\n"
+                "where prefix is http://localhost:port/path/\n", argv[0]);
+        exit(1);
+    }
+    int listener = protocol_listen(address);
+    if (listener < 0) {
+        fprintf(stderr, "Cannot listen on %s: %s\n", address, strerror(errno));
+        exit(2);
+    }
+    signal(SIGPIPE, SIG_IGN);  // A client that hangs up just ends its thread's writes.
+
+    pthread_attr_t detached;
+    pthread_attr_init(&detached);
+    pthread_attr_setdetachstate(&detached, PTHREAD_CREATE_DETACHED);
+    for (;;) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) {
+            continue;  // EINTR, or a connection reset before it was accepted
+        }
+        connection_t* connection = malloc(sizeof(connection_t));
+        pthread_t thread;
+        if (connection == NULL) {
+            close(fd);
+            continue;
+        }
+        connection->site = &site;
+        connection->fd = fd;
+        if (pthread_create(&thread, &detached, serveConnection, connection) != 0) {
+            close(fd);
+            free(connection);
+        }
+    }
+}
@@ -0,0 +1,108 @@
+/*
+ * zipf.c - benchmark 'zipf' module
+ *
+ * see zipf.h for more information.
+ *
+ * A sampler keeps the cumulative distribution of its n ranks and draws a
+ * rank by binary search for a uniform number in it: O(n) memory once, and
+ * O(log n) per sample, which is plenty for vocabularies of millions.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "zipf.h"
+
+/**************** local constants ****************/
+static const char LETTERS[] = "bcdfghjklmnpqrstvwxz";  // no vowels: no "and", no "or"
+#define NUM_LETTERS 20
+#define MIN_LETTERS 3
+
+/**************** global types ****************/
+typedef struct zipf {
+    int n;          // number of ranks
+    double* cdf;    // cdf[r]: probability of a rank <= r; cdf[n-1] is 1
+} zipf_t;
+
+/**************** global functions ****************/
+
+uint64_t zipf_random(uint64_t* state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15u);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9u;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebu;
+    return z ^ (z >> 31);
+}
+
+uint64_t zipf_uniform(uint64_t* state, const uint64_t n)
+{
+    return n == 0 ? 0 : zipf_random(state) % n;
+}
+
+char* zipf_word(uint64_t r, char* buf)
+{
+    // Rank r is the r-th word in order of length, then of letters, so the
+    // most frequent words are the shortest, as in natural language.
+    int length = MIN_LETTERS;
+    uint64_t count = NUM_LETTERS * NUM_LETTERS * NUM_LETTERS;
+    while (r >= count && length < ZIPF_WORD_MAX - 1) {
+        r -= count;
+        count *= NUM_LETTERS;
+        length++;
+    }
+    buf[length] = '\0';
+    for (int i = length - 1; i >= 0; i--) {
+        buf[i] = LETTERS[r % NUM_LETTERS];
+        r /= NUM_LETTERS;
+    }
+    return buf;
+}
+
+zipf_t* zipf_new(const int n, const double s)
+{
+    if (n < 1 || s < 0) {
+        return NULL;
+    }
+    zipf_t* zipf = malloc(sizeof(zipf_t));
+    double* cdf = malloc(n * sizeof(double));
+    if (zipf == NULL || cdf == NULL) {
+        free(zipf);
+        free(cdf);
+        return NULL;
+    }
+    double sum = 0;
+    for (int r = 0; r < n; r++) {
+        sum += pow(r + 1, -s);
+        cdf[r] = sum;
+    }
+    for (int r = 0; r < n; r++) {
+        cdf[r] /= sum;
+    }
+    cdf[n - 1] = 1;
+    zipf->n = n;
+    zipf->cdf = cdf;
+    return zipf;
+}
+
+int zipf_sample(const zipf_t* zipf, uint64_t* state)
+{
+    double u = (zipf_random(state) >> 11) * 0x1.0p-53;  // uniform in [0, 1)
+    int lo = 0, hi = zipf->n - 1;
+    while (lo < hi) {  // the first rank whose cdf exceeds u
+        int mid = lo + (hi - lo) / 2;
+        if (zipf->cdf[mid] > u) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+}
+
+void zipf_delete(zipf_t* zipf)
+{
+    if (zipf != NULL) {
+        free(zipf->cdf);
+        free(zipf);
+    }
+}
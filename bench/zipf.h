@@ -0,0 +1,65 @@
+/*
+ * zipf.h - header file for the benchmark's 'zipf' module
+ *
+ * The synthetic corpus and the generated queries share one vocabulary: the
+ * word of rank r (0 for the most frequent) is zipf_word(r), and a corpus
+ * of vocabulary v draws rank r with probability proportional to 1/(r+1)^s.
+ * Words are spelled with consonants only, three or more of them, so every
+ * one survives the indexer (which drops shorter words) and none is a query
+ * operator ("and", "or").
+ *
+ * Random numbers come from a seeded generator (splitmix64), so a given
+ * seed always yields the same corpus and the same queries.
+ *
+ * Compilation requires: the math library (-lm).
+ */
+
+#ifndef __ZIPF_H
+#define __ZIPF_H
+
+#include <stdint.h>
+
+/*
+ * Struct definitions
+ */
+typedef struct zipf zipf_t;  // opaque to users of the module
+
+/*
+ * zipf_random - advances *state and returns the next 64 random bits.
+ * Any value, including 0, is a valid seed.
+ */
+uint64_t zipf_random(uint64_t* state);
+
+/*
+ * zipf_uniform - returns a random integer in 0 .. n-1, advancing *state;
+ * 0 if n is 0.
+ */
+uint64_t zipf_uniform(uint64_t* state, const uint64_t n);
+
+/*
+ * zipf_word - writes the word of rank r into buf (at least ZIPF_WORD_MAX
+ * bytes) and returns buf.
+ */
+#define ZIPF_WORD_MAX 24
+char* zipf_word(uint64_t r, char* buf);
+
+/*
+ * zipf_new - creates a sampler of ranks 0 .. n-1 with exponent s (s = 0 is
+ * uniform, s = 1 is classic Zipf; larger is more skewed).
+ *
+ * Returns the sampler, or NULL if n < 1, s < 0 or out of memory.
+ * The caller is responsible for later calling zipf_delete().
+ */
+zipf_t* zipf_new(const int n, const double s);
+
+/*
+ * zipf_sample - returns a random rank, advancing *state.
+ */
+int zipf_sample(const zipf_t* zipf, uint64_t* state);
+
+/*
+ * zipf_delete - frees the sampler; ignores NULL.
+ */
+void zipf_delete(zipf_t* zipf);
+
+#endif // __ZIPF_H
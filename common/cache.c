@@ -0,0 +1,334 @@
+/*
+ * cache.c - CS50 'cache' module
+ *
+ * see cache.h for more information.
+ *
+ * Entries live in a chained hash table for lookup and in a doubly linked
+ * list ordered by recency for eviction: a hit unlinks its entry and puts it
+ * back at the newest end, and eviction takes entries off the oldest end.
+ * Each entry is a single allocation holding the bookkeeping, the value and
+ * the key, and is charged that allocation's size against the budget. The
+ * table doubles whenever it holds more entries than buckets. Each entry
+ * keeps its key's 64-bit hash, so chains are walked comparing hashes and
+ * the table grows without rehashing keys.
+ *
+ * One mutex guards the whole cache. Every operation is a hash lookup and a
+ * few pointer updates (new entries are built before taking it), so the lock
+ * is held briefly and a finer scheme would not pay for itself.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include "cache.h"
+#include "../libcs50/hash.h"
+
+/**************** local types ****************/
+typedef struct entry {
+    struct entry* next;     // next entry in the same bucket
+    struct entry* newer;    // neighbours in recency order
+    struct entry* older;
+    char* key;              // points into data, after the value
+    uint64_t hash;          // hash_bytes of key
+    size_t size;            // bytes of value
+    size_t bytes;           // bytes charged against the budget
+    _Alignas(max_align_t) unsigned char data[];  // value, then key
+} entry_t;
+
+/**************** global types ****************/
+typedef struct cache {
+    pthread_mutex_t lock;   // guards everything below
+    entry_t** buckets;      // hash table of entries
+    int nbuckets;
+    int nentries;
+    entry_t* newest;        // most recently used entry
+    entry_t* oldest;        // least recently used entry, evicted first
+    size_t budget;          // bytes the entries may use
+    size_t used;            // bytes the entries do use
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    unsigned long invalidations;
+    bool watched;           // whether cache_watch has recorded a file
+    bool present;           // whether it existed at the last check
+    dev_t dev;              // the watched file's identity
+    ino_t ino;
+    off_t fileSize;
+    struct timespec mtime;
+} cache_t;
+
+/**************** local functions ****************/
+
+// Returns the slot of the bucket for a key of the given hash; nbuckets is a
+// power of two.
+static entry_t** bucket(cache_t* cache, const uint64_t hash)
+{
+    return &cache->buckets[hash & (cache->nbuckets - 1)];
+}
+
+// Returns the pointer that points at key's entry in its bucket chain, or at
+// the chain's terminating NULL if key is absent; hash is key's hash.
+static entry_t** findSlot(cache_t* cache, const char* key, const uint64_t hash)
+{
+    entry_t** slot = bucket(cache, hash);
+    while (*slot != NULL && ((*slot)->hash != hash || strcmp((*slot)->key, key) != 0)) {
+        slot = &(*slot)->next;
+    }
+    return slot;
+}
+
+// Takes entry out of the recency list.
+static void detach(cache_t* cache, entry_t* entry)
+{
+    if (entry->newer != NULL) {
+        entry->newer->older = entry->older;
+    } else {
+        cache->newest = entry->older;
+    }
+    if (entry->older != NULL) {
+        entry->older->newer = entry->newer;
+    } else {
+        cache->oldest = entry->newer;
+    }
+}
+
+// Puts entry at the newest end of the recency list.
+static void pushNewest(cache_t* cache, entry_t* entry)
+{
+    entry->newer = NULL;
+    entry->older = cache->newest;
+    if (cache->newest != NULL) {
+        cache->newest->newer = entry;
+    } else {
+        cache->oldest = entry;
+    }
+    cache->newest = entry;
+}
+
+// Removes entry from the table and the list and frees it.
+static void removeEntry(cache_t* cache, entry_t* entry)
+{
+    entry_t** slot = findSlot(cache, entry->key, entry->hash);
+    *slot = entry->next;
+    detach(cache, entry);
+    cache->used -= entry->bytes;
+    cache->nentries--;
+    free(entry);
+}
+
+// Doubles the hash table; keeps the old one if out of memory.
+static void grow(cache_t* cache)
+{
+    int nbuckets = cache->nbuckets * 2;
+    entry_t** buckets = calloc(nbuckets, sizeof(entry_t*));
+    if (buckets == NULL) {
+        return;
+    }
+    entry_t** old = cache->buckets;
+    int oldCount = cache->nbuckets;
+    cache->buckets = buckets;
+    cache->nbuckets = nbuckets;
+    for (int i = 0; i < oldCount; i++) {
+        entry_t* entry = old[i];
+        while (entry != NULL) {
+            entry_t* next = entry->next;
+            entry_t** slot = bucket(cache, entry->hash);
+            entry->next = *slot;
+            *slot = entry;
+            entry = next;
+        }
+    }
+    free(old);
+}
+
+// Frees every entry; the caller holds the lock.
+static void clearEntries(cache_t* cache)
+{
+    entry_t* entry = cache->newest;
+    while (entry != NULL) {
+        entry_t* older = entry->older;
+        free(entry);
+        entry = older;
+    }
+    memset(cache->buckets, 0, sizeof(entry_t*) * cache->nbuckets);
+    cache->newest = cache->oldest = NULL;
+    cache->nentries = 0;
+    cache->used = 0;
+}
+
+/**************** global functions ****************/
+
+cache_t* cache_new(const size_t budget)
+{
+    cache_t* cache = calloc(1, sizeof(cache_t));
+    if (cache == NULL) {
+        return NULL;
+    }
+    cache->nbuckets = 64;
+    cache->buckets = calloc(cache->nbuckets, sizeof(entry_t*));
+    if (cache->buckets == NULL) {
+        free(cache);
+        return NULL;
+    }
+    cache->budget = budget;
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+bool cache_get(cache_t* cache, const char* key, void** value, size_t* size)
+{
+    if (cache == NULL || key == NULL || value == NULL || size == NULL) {
+        return false;
+    }
+    uint64_t hash = hash_string(key);
+    pthread_mutex_lock(&cache->lock);
+    entry_t* entry = *findSlot(cache, key, hash);
+    void* copy = NULL;
+    bool found = entry != NULL && (entry->size == 0 || (copy = malloc(entry->size)) != NULL);
+    if (found) {
+        if (copy != NULL) {
+            memcpy(copy, entry->data, entry->size);
+        }
+        detach(cache, entry);
+        pushNewest(cache, entry);
+        cache->hits++;
+        *value = copy;
+        *size = entry->size;
+    } else if (entry == NULL) {
+        cache->misses++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return found;
+}
+
+bool cache_put(cache_t* cache, const char* key, const void* value, const size_t size)
+{
+    if (cache == NULL || key == NULL || (value == NULL && size > 0)) {
+        return false;
+    }
+    size_t keyLength = strlen(key) + 1;
+    uint64_t hash = hash_bytes(key, keyLength - 1);
+    size_t bytes = sizeof(entry_t) + size + keyLength;
+    entry_t* entry = bytes <= cache->budget ? malloc(bytes) : NULL;
+    if (entry != NULL) {
+        if (size > 0) {
+            memcpy(entry->data, value, size);
+        }
+        entry->key = (char*)entry->data + size;
+        memcpy(entry->key, key, keyLength);
+        entry->hash = hash;
+        entry->size = size;
+        entry->bytes = bytes;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    entry_t* old = *findSlot(cache, key, hash);
+    if (old != NULL) {
+        removeEntry(cache, old);
+    }
+    if (entry == NULL) {
+        pthread_mutex_unlock(&cache->lock);
+        return false;
+    }
+    while (cache->used + bytes > cache->budget) {
+        removeEntry(cache, cache->oldest);
+        cache->evictions++;
+    }
+    if (cache->nentries >= cache->nbuckets) {
+        grow(cache);
+    }
+    entry_t** slot = bucket(cache, hash);
+    entry->next = *slot;
+    *slot = entry;
+    pushNewest(cache, entry);
+    cache->used += bytes;
+    cache->nentries++;
+    pthread_mutex_unlock(&cache->lock);
+    return true;
+}
+
+int cache_recent(cache_t* cache, char* keys[], const int max)
+{
+    if (cache == NULL || keys == NULL) {
+        return 0;
+    }
+    int count = 0;
+    pthread_mutex_lock(&cache->lock);
+    for (entry_t* entry = cache->newest; entry != NULL && count < max; entry = entry->older) {
+        if ((keys[count] = strdup(entry->key)) == NULL) {
+            break;
+        }
+        count++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return count;
+}
+
+void cache_clear(cache_t* cache)
+{
+    if (cache != NULL) {
+        pthread_mutex_lock(&cache->lock);
+        clearEntries(cache);
+        pthread_mutex_unlock(&cache->lock);
+    }
+}
+
+bool cache_watch(cache_t* cache, const char* filename)
+{
+    if (cache == NULL || filename == NULL) {
+        return false;
+    }
+    struct stat st;
+    bool present = stat(filename, &st) == 0;
+    pthread_mutex_lock(&cache->lock);
+    bool changed = cache->watched
+                   && (present != cache->present
+                       || (present && (cache->dev != st.st_dev || cache->ino != st.st_ino
+                                       || cache->fileSize != st.st_size
+                                       || cache->mtime.tv_sec != st.st_mtim.tv_sec
+                                       || cache->mtime.tv_nsec != st.st_mtim.tv_nsec)));
+    cache->watched = true;
+    cache->present = present;
+    if (present) {
+        cache->dev = st.st_dev;
+        cache->ino = st.st_ino;
+        cache->fileSize = st.st_size;
+        cache->mtime = st.st_mtim;
+    }
+    if (changed) {
+        clearEntries(cache);
+        cache->invalidations++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return changed;
+}
+
+void cache_stats(cache_t* cache, FILE* fp)
+{
+    if (cache == NULL || fp == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&cache->lock);
+    unsigned long lookups = cache->hits + cache->misses;
+    fprintf(fp, "cache: %lu hits, %lu misses (%.1f%% hit rate), %lu evictions, "
+            "%lu invalidations, %d entries, %zu of %zu bytes\n",
+            cache->hits, cache->misses, lookups > 0 ? 100.0 * cache->hits / lookups : 0.0,
+            cache->evictions, cache->invalidations, cache->nentries, cache->used, cache->budget);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void cache_delete(cache_t* cache)
+{
+    if (cache != NULL) {
+        clearEntries(cache);
+        pthread_mutex_destroy(&cache->lock);
+        free(cache->buckets);
+        free(cache);
+    }
+}
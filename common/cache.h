@@ -0,0 +1,98 @@
+/*
+ * cache.h - header file for the 'cache' module
+ *
+ * A cache maps string keys to byte-string values (copied in and out) and
+ * keeps the most recently used entries that fit in a fixed memory budget.
+ * Every entry is charged its key, its value and its bookkeeping; when a new
+ * entry does not fit, the least recently used entries are evicted until it
+ * does. The querier uses it to keep the ranked results of recent queries,
+ * keyed by the query's canonical form.
+ *
+ * A cache can watch one file (an index file) and empties itself when the
+ * file is replaced or modified, so that it never serves results computed
+ * from an index that is no longer on disk. Hits, misses, evictions and
+ * invalidations are counted for cache_stats(). All operations may be called
+ * from several threads at once.
+ *
+ * Compilation requires: hash.h (libcs50)
+ */
+
+#ifndef __CACHE_H
+#define __CACHE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Struct definitions
+ */
+typedef struct cache cache_t;  // opaque to users of the module
+
+/*
+ * cache_new - creates an empty cache that holds at most budget bytes.
+ *
+ * A budget of 0 gives a cache that stores nothing (every lookup misses) but
+ * still watches a file with cache_watch().
+ *
+ * Returns the new cache, or NULL if out of memory.
+ * The caller is responsible for later calling cache_delete().
+ */
+cache_t* cache_new(const size_t budget);
+
+/*
+ * cache_get - looks up key.
+ *
+ * On a hit, marks the entry most recently used, stores a malloc'd copy of
+ * its value in *value (NULL for an empty value) and its length in *size, and
+ * returns true; the caller frees *value. On a miss (or if out of memory)
+ * returns false and leaves *value and *size alone.
+ */
+bool cache_get(cache_t* cache, const char* key, void** value, size_t* size);
+
+/*
+ * cache_put - stores a copy of size bytes of value under key.
+ *
+ * Replaces any entry already under key, and evicts least recently used
+ * entries until the new one fits the budget. Returns true if the value was
+ * stored, false if it can never fit the budget or memory runs out.
+ */
+bool cache_put(cache_t* cache, const char* key, const void* value, const size_t size);
+
+/*
+ * cache_recent - copies up to max of the most recently used keys into keys[],
+ * newest first, as malloc'd strings the caller frees. Neither the entries'
+ * recency nor the statistics change. Returns the number of keys copied (fewer
+ * if out of memory).
+ */
+int cache_recent(cache_t* cache, char* keys[], const int max);
+
+/*
+ * cache_clear - evicts every entry; the statistics are kept.
+ */
+void cache_clear(cache_t* cache);
+
+/*
+ * cache_watch - checks whether filename has changed since the last call.
+ *
+ * The file is identified by its device, inode, size and modification time,
+ * so both rewriting it in place and renaming a new file over it count as a
+ * change, as does the file going missing. On a change the cache is cleared.
+ * The first call only records the file.
+ *
+ * Returns true if the file changed (and the cache was cleared), else false.
+ */
+bool cache_watch(cache_t* cache, const char* filename);
+
+/*
+ * cache_stats - prints one line of statistics to fp: hits, misses, hit rate,
+ * evictions, invalidations, entries held and bytes used of the budget.
+ */
+void cache_stats(cache_t* cache, FILE* fp);
+
+/*
+ * cache_delete - frees the cache and every entry; ignores NULL.
+ */
+void cache_delete(cache_t* cache);
+
+#endif // __CACHE_H
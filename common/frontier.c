@@ -0,0 +1,285 @@
+/*
+ * frontier.c - CS50 'frontier' module
+ *
+ * see frontier.h for more information.
+ *
+ * The head is a ring of (URL, depth) entries, doubled as it fills, up to
+ * headMax. A URL pushed while the ring is full, or while any URL is on
+ * disk, is written as a line "depth URL" to the segment being written,
+ * and freed; normalized URLs hold no newlines or spaces. A segment that
+ * reaches FRONTIER_SEGMENT bytes is flushed, rewound and queued for
+ * reading, and the next push starts a new one. When the ring empties, it
+ * is refilled with as many URLs as it can hold from the segment being
+ * read, then the queued ones, then the one being written, which is
+ * queued early if need be; a segment read to its end is closed.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "frontier.h"
+
+/**************** local constants ****************/
+#define FIRST_RING 1024         // entries of the ring when first made
+
+/**************** global types ****************/
+
+// One URL in the head.
+typedef struct entry {
+    char* url;
+    int depth;
+} entry_t;
+
+// A segment written in full, waiting to be read.
+typedef struct segment {
+    FILE* fp;               // rewound to its start
+    struct segment* next;   // the next newer segment
+} segment_t;
+
+typedef struct frontier {
+    entry_t* ring;          // the head: numHead entries from first, wrapping
+    size_t ringSize;        // at most headMax
+    size_t first;
+    size_t numHead;
+    size_t headMax;
+    char* directory;        // where segments are made; NULL for none
+    size_t numDisk;         // URLs in all segments, not yet read
+    FILE* reading;          // the segment being read; NULL if none
+    segment_t* oldest;      // the segments waiting, oldest first
+    segment_t* newest;
+    FILE* writing;          // the segment being written; NULL if none
+    size_t written;         // its bytes
+    char* line;             // a line read from a segment
+    size_t lineSize;
+} frontier_t;
+
+/**************** local functions ****************/
+
+// Creates a file in directory, and removes its name, so that it lasts until
+// closed. Returns it opened for writing and reading, or NULL on error.
+static FILE* tempFile(const char* directory)
+{
+    char path[strlen(directory) + 20];
+    sprintf(path, "%s/.frontierXXXXXX", directory);
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return NULL;
+    }
+    unlink(path);
+    FILE* fp = fdopen(fd, "w+");
+    if (fp == NULL) {
+        close(fd);
+    }
+    return fp;
+}
+
+// Adds url at depth to the back of the ring, growing it if need be; the
+// head must have room for it (numHead < headMax). Returns false if out of
+// memory.
+static bool ringPush(frontier_t* frontier, char* url, const int depth)
+{
+    if (frontier->numHead == frontier->ringSize) {
+        size_t size = frontier->ringSize * 2;
+        if (size > frontier->headMax || size < frontier->ringSize) {
+            size = frontier->headMax;
+        }
+        entry_t* ring = malloc(size * sizeof(entry_t));
+        if (ring == NULL) {
+            return false;
+        }
+        for (size_t i = 0; i < frontier->numHead; i++) {
+            ring[i] = frontier->ring[(frontier->first + i) % frontier->ringSize];
+        }
+        free(frontier->ring);
+        frontier->ring = ring;
+        frontier->ringSize = size;
+        frontier->first = 0;
+    }
+    entry_t* entry = &frontier->ring[(frontier->first + frontier->numHead) % frontier->ringSize];
+    entry->url = url;
+    entry->depth = depth;
+    frontier->numHead++;
+    return true;
+}
+
+// Flushes the segment being written and queues it for reading. Returns
+// false if it cannot be flushed.
+static bool sealSegment(frontier_t* frontier)
+{
+    segment_t* segment = malloc(sizeof(segment_t));
+    if (segment == NULL || fflush(frontier->writing) != 0) {
+        free(segment);
+        return false;
+    }
+    rewind(frontier->writing);
+    segment->fp = frontier->writing;
+    segment->next = NULL;
+    if (frontier->newest == NULL) {
+        frontier->oldest = segment;
+    } else {
+        frontier->newest->next = segment;
+    }
+    frontier->newest = segment;
+    frontier->writing = NULL;
+    frontier->written = 0;
+    return true;
+}
+
+// Appends url at depth to the segment being written, starting one if need
+// be, and frees url. Returns false on a file error, if url was not written;
+// a full segment that cannot be sealed yet is sealed when it is needed.
+static bool spill(frontier_t* frontier, char* url, const int depth)
+{
+    if (frontier->writing == NULL) {
+        frontier->writing = tempFile(frontier->directory);
+    }
+    int n = frontier->writing != NULL ? fprintf(frontier->writing, "%d %s\n", depth, url) : -1;
+    free(url);
+    if (n < 0) {
+        return false;
+    }
+    frontier->numDisk++;
+    frontier->written += n;
+    if (frontier->written >= FRONTIER_SEGMENT) {
+        sealSegment(frontier);
+    }
+    return true;
+}
+
+// Fills the ring from the segments, in order, until it is full or they are
+// all read. Stops early, leaving the rest on disk, if a segment cannot be
+// read, or out of memory.
+static void refill(frontier_t* frontier)
+{
+    while (frontier->numDisk > 0 && frontier->numHead < frontier->headMax) {
+        if (frontier->reading == NULL) {
+            if (frontier->oldest == NULL && (frontier->writing == NULL || !sealSegment(frontier))) {
+                return;  // URLs are missing
+            }
+            segment_t* segment = frontier->oldest;
+            frontier->oldest = segment->next;
+            if (frontier->oldest == NULL) {
+                frontier->newest = NULL;
+            }
+            frontier->reading = segment->fp;
+            free(segment);
+        }
+        ssize_t len = getline(&frontier->line, &frontier->lineSize, frontier->reading);
+        if (len < 0) {
+            fclose(frontier->reading);  // read to its end, so removed
+            frontier->reading = NULL;
+            continue;
+        }
+        char* space = strchr(frontier->line, ' ');
+        if (space == NULL || frontier->line[len - 1] != '\n') {
+            return;
+        }
+        frontier->line[len - 1] = '\0';
+        char* url = malloc(len - (space - frontier->line) - 1);
+        if (url == NULL) {
+            return;
+        }
+        strcpy(url, space + 1);
+        if (!ringPush(frontier, url, atoi(frontier->line))) {
+            free(url);
+            return;
+        }
+        frontier->numDisk--;
+    }
+}
+
+/**************** global functions ****************/
+
+frontier_t* frontier_new(const char* directory, const size_t headMax)
+{
+    if (headMax == 0) {
+        return NULL;
+    }
+    frontier_t* frontier = calloc(1, sizeof(frontier_t));
+    if (frontier == NULL) {
+        return NULL;
+    }
+    frontier->headMax = directory != NULL ? headMax : SIZE_MAX;
+    frontier->ringSize = frontier->headMax < FIRST_RING ? frontier->headMax : FIRST_RING;
+    frontier->ring = malloc(frontier->ringSize * sizeof(entry_t));
+    if (directory != NULL) {
+        frontier->directory = malloc(strlen(directory) + 1);
+    }
+    if (frontier->ring == NULL || (directory != NULL && frontier->directory == NULL)) {
+        frontier_delete(frontier);
+        return NULL;
+    }
+    if (directory != NULL) {
+        strcpy(frontier->directory, directory);
+    }
+    return frontier;
+}
+
+bool frontier_push(frontier_t* frontier, char* url, const int depth)
+{
+    if (frontier == NULL || url == NULL) {
+        free(url);
+        return false;
+    }
+    if (frontier->numDisk == 0 && frontier->numHead < frontier->headMax) {
+        if (!ringPush(frontier, url, depth)) {
+            free(url);
+            return false;
+        }
+        return true;
+    }
+    return spill(frontier, url, depth);
+}
+
+char* frontier_pop(frontier_t* frontier, int* depth)
+{
+    if (frontier == NULL || depth == NULL) {
+        return NULL;
+    }
+    if (frontier->numHead == 0) {
+        refill(frontier);
+    }
+    if (frontier->numHead == 0) {
+        return NULL;
+    }
+    entry_t* entry = &frontier->ring[frontier->first];
+    frontier->first = (frontier->first + 1) % frontier->ringSize;
+    frontier->numHead--;
+    *depth = entry->depth;
+    return entry->url;
+}
+
+size_t frontier_count(frontier_t* frontier)
+{
+    return frontier != NULL ? frontier->numHead + frontier->numDisk : 0;
+}
+
+void frontier_delete(frontier_t* frontier)
+{
+    if (frontier == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < frontier->numHead; i++) {
+        free(frontier->ring[(frontier->first + i) % frontier->ringSize].url);
+    }
+    free(frontier->ring);
+    if (frontier->reading != NULL) {
+        fclose(frontier->reading);
+    }
+    while (frontier->oldest != NULL) {
+        segment_t* next = frontier->oldest->next;
+        fclose(frontier->oldest->fp);
+        free(frontier->oldest);
+        frontier->oldest = next;
+    }
+    if (frontier->writing != NULL) {
+        fclose(frontier->writing);
+    }
+    free(frontier->line);
+    free(frontier->directory);
+    free(frontier);
+}
@@ -0,0 +1,77 @@
+/*
+ * frontier.h - header file for the 'frontier' module
+ *
+ * The crawler's queue of the URLs it has yet to crawl, each with its
+ * depth, taken out in the order they were put in, so that the crawl is
+ * breadth-first and each page is found at its least depth.
+ *
+ * The head of the queue, up to a given number of URLs, is kept in memory.
+ * Past that, if the frontier has a directory, newer URLs are appended to
+ * segment files there, as lines of text, each segment at most
+ * FRONTIER_SEGMENT bytes; as the head drains, it is refilled from the
+ * oldest segment, read in order, and each segment is closed once read.
+ * So a crawl of any size holds at most that many URLs in memory, and the
+ * segments on disk hold only the URLs not yet crawled. Every URL in
+ * memory is older than every URL on disk, so the order is kept. The
+ * segments are removed as soon as they are created, so they vanish when
+ * they are read, or the frontier deleted, or the crawler exits, however
+ * it exits. Without a directory, the head grows without bound.
+ *
+ * Compilation requires: POSIX files.
+ */
+
+#ifndef __FRONTIER_H
+#define __FRONTIER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#define FRONTIER_HEAD 65536             // URLs in memory by default, with a directory
+#define FRONTIER_SEGMENT (64 << 20)     // bytes of URLs per segment file
+
+/*
+ * Struct definitions
+ */
+typedef struct frontier frontier_t;  // opaque to users of the module
+
+/*
+ * frontier_new - creates an empty frontier, all in memory if directory is
+ * NULL, else holding at most headMax (at least 1) URLs in memory and the
+ * rest in (removed) segment files in directory.
+ *
+ * Returns the new frontier, or NULL if out of memory or headMax is 0. The
+ * caller is responsible for later calling frontier_delete().
+ */
+frontier_t* frontier_new(const char* directory, const size_t headMax);
+
+/*
+ * frontier_push - adds url, found at depth, to the back of the frontier.
+ *
+ * url must be malloc'd; the frontier takes it over, and frees it if it
+ * goes to disk or cannot be added. Returns false if it cannot be added
+ * (out of memory, or a file error).
+ */
+bool frontier_push(frontier_t* frontier, char* url, const int depth);
+
+/*
+ * frontier_pop - takes the URL at the front of the frontier.
+ *
+ * Returns the URL, malloc'd, for the caller to free, and its depth in
+ * *depth; or NULL if the frontier is empty, or its next segment cannot
+ * be read (when frontier_count is not 0).
+ */
+char* frontier_pop(frontier_t* frontier, int* depth);
+
+/*
+ * frontier_count - returns the number of URLs in the frontier, in memory
+ * and on disk; 0 if frontier is NULL.
+ */
+size_t frontier_count(frontier_t* frontier);
+
+/*
+ * frontier_delete - frees the frontier and the URLs in it, and closes (so
+ * removes) its segments; ignores NULL.
+ */
+void frontier_delete(frontier_t* frontier);
+
+#endif // __FRONTIER_H
@@ -11,85 +11,158 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
-#include "../libcs50/hashtable.h"
-#include "../libcs50/counters.h"
+#include <stdint.h>
+#include "../libcs50/intern.h"
+#include "../libcs50/arena.h"
 #include "../libcs50/mem.h"
+#include "postings.h"
+#include "index.h"
 
-typedef struct index {
-    hashtable_t *ht; 
-} index_t;
-
-const int num_slots = 200; 
 const int MaxWordLength = 100;
 
 index_t *index_new() 
 {
-    if (num_slots > 0) {
-        // Allocate memory for index
-        index_t *index = mem_malloc(sizeof(index_t));
-        if (index == NULL) {
-            return NULL;
-        }
-
-        index->ht = hashtable_new(num_slots);
+    // Allocate memory for index
+    index_t *index = mem_malloc(sizeof(index_t));
+    if (index == NULL) {
+        return NULL;
+    }
 
-        // Make sure memory was properly allocated
-        if (index == NULL ) { return NULL; }
-        if (index->ht == NULL) {
-            mem_free(index);
-            return NULL;
-        }
-        return index;
+    index->arena = arena_new(0);
+    index->words = index->arena != NULL ? intern_new(index->arena) : NULL;
+    index->postings = NULL;
+    index->postingsCap = 0;
+    index->docLengths = NULL;
+    index->docNorms = NULL;
+    index->numDocs = 0;
+    index->docCap = 0;
+    index->totalWords = 0;
+    index->minNorm = 0;
+    index->statsFrom = NULL;
+    index->shards = NULL;
+    index->numShards = 0;
 
-    } else {
-        return NULL; // If invalid table length
+    // Make sure memory was properly allocated
+    if (index->words == NULL) {
+        arena_delete(index->arena);
+        mem_free(index);
+        return NULL;
     }
-}
-
-/*
- * itemdelete_wrapper - a wrapper function for deleting counter sets.
- *
- * Designed to be passed to hashtable_delete as a parameter to specify how
- * to deal with the items (counters sets) stored in the hashtable.
- *
- * Parameters:
- *  - item: a pointer to the item (counters set) to be deleted.
- */
-static void itemdelete_wrapper(void *item) {
-    counters_delete((counters_t *)item);
+    return index;
 }
 
 
 void index_delete(index_t *index) {
     if (index != NULL) {
-        hashtable_delete(index->ht, itemdelete_wrapper);  
+        int numWords = intern_count(index->words);
+        for (int id = 0; id < numWords && id < index->postingsCap; id++) {
+            postings_delete(index->postings[id]);
+        }
+        free(index->postings);
+        intern_delete(index->words);
+        arena_delete(index->arena);  // the words and postings lists
+        free(index->docLengths);
+        free(index->docNorms);
         free(index); // Don't forget to free the index itself after deleting its contents
     }
 }
 
-counters_t *index_find(index_t *index, const char *word) {
+postings_t *index_find(index_t *index, const char *word) {
     if (index != NULL && word != NULL) {
-        // Use hashtable_find to retrieve the counters set for the word
-        return (counters_t *)hashtable_find(index->ht, word);
+        // A word's ID indexes its postings list
+        int id = intern_find(index->words, word);
+        return id >= 0 && id < index->postingsCap ? index->postings[id] : NULL;
     }
     return NULL; // Return NULL if index or word is NULL
 }
 
+// insertWord: stores the postings list of a word the index has no list for.
+// Returns false if the word already has one, or out of memory.
+static bool insertWord(index_t *index, const char *word, postings_t *postings) {
+    int id = intern_add(index->words, word);
+    if (id < 0) {
+        return false;
+    }
+    if (id >= index->postingsCap) {
+        int postingsCap = index->postingsCap == 0 ? 64 : index->postingsCap;
+        while (postingsCap <= id) {
+            postingsCap *= 2;
+        }
+        postings_t **grown = realloc(index->postings, sizeof(postings_t *) * postingsCap);
+        if (grown == NULL) {
+            return false;
+        }
+        memset(grown + index->postingsCap, 0,
+               sizeof(postings_t *) * (postingsCap - index->postingsCap));
+        index->postings = grown;
+        index->postingsCap = postingsCap;
+    }
+    if (index->postings[id] != NULL) {
+        return false;
+    }
+    index->postings[id] = postings;
+    return true;
+}
+
+// reserveDoc: makes room for document docID's length.
+// Returns false if out of memory.
+static bool reserveDoc(index_t *index, int docID) {
+    if (docID >= index->docCap) {
+        int docCap = index->docCap == 0 ? 64 : index->docCap;
+        while (docCap <= docID) {
+            docCap *= 2;
+        }
+        int *grown = realloc(index->docLengths, sizeof(int) * docCap);
+        if (grown == NULL) {
+            return false;
+        }
+        memset(grown + index->docCap, 0, sizeof(int) * (docCap - index->docCap));
+        index->docLengths = grown;
+        index->docCap = docCap;
+    }
+    return true;
+}
+
+// countWord: records one more word in document docID's length, for which
+// reserveDoc has made room.
+static void countWord(index_t *index, int docID) {
+    index->docLengths[docID]++;
+    index->numDocs = docID > index->numDocs ? docID : index->numDocs;
+    index->totalWords++;
+}
+
 bool index_add(index_t *index, const char *word, int docID) 
 {
-    if (index != NULL && docID >= 0) {
-        counters_t *wordInfo = hashtable_find(index->ht, word); // Attempt to find the word in the hashtable
+    bool added = false;
+    // Room for the length is made first, and the word counted only once it is in
+    // its postings list, so a failed add leaves the document statistics as they were
+    if (index != NULL && docID >= 0 && reserveDoc(index, docID)) {
+        postings_t *wordInfo = index_find(index, word); // Attempt to find the word in the index
         if (wordInfo != NULL) { // If the word is already in the index
-            if (counters_add(wordInfo, docID) > 0) { return true; } // Increment the count for the docID
+            added = postings_add(wordInfo, docID) > 0; // Increment the count for the docID
         } else { // If the word is not in the index
-            wordInfo = counters_new(); // Create a new counter set for the word
-            if (wordInfo != NULL && counters_add(wordInfo, docID) > 0) { // Initialize the counter set
-                if (hashtable_insert(index->ht, word, wordInfo)) { return true; } // Add the new word to the hashtable
-                else { counters_delete(wordInfo); } // Clean up if insertion fails
+            wordInfo = postings_newInArena(index->arena); // Create a new postings list for the word
+            if (wordInfo != NULL && postings_add(wordInfo, docID) > 0) { // Initialize the postings list
+                added = insertWord(index, word, wordInfo); // Add the new word to the index
+                if (!added) { postings_delete(wordInfo); } // Clean up if insertion fails
             }
         }
     }
-    return false; // Return false if adding failed
+    if (added) {
+        countWord(index, docID);
+    }
+    return added; // false if adding failed
+}
+
+
+// finish_itemfunc: packs the pending entries of one postings list.
+static void finish_itemfunc(void *arg, const char *key, void *item) {
+    postings_finish((postings_t *)item);
+}
+
+
+void index_finish(index_t *index) {
+    index_iterate(index, NULL, finish_itemfunc);
 }
 
 
@@ -99,7 +172,12 @@ void (*itemfunc)(void *arg, const char *key, void *item) ) {
         return;
     }
 
-    hashtable_iterate(index->ht, arg, itemfunc);
+    int numWords = intern_count(index->words);
+    for (int id = 0; id < numWords && id < index->postingsCap; id++) {
+        if (index->postings[id] != NULL) {
+            (*itemfunc)(arg, intern_string(index->words, id), index->postings[id]);
+        }
+    }
 }
 
 
@@ -111,22 +189,351 @@ void counterToFile(void *arg, const int key, const int count) {
 
 void entryToFile(void *arg, const char *key, void *item) {
     FILE *fp = (FILE *)arg;
-    counters_t *counters = (counters_t *)item;
+    postings_t *postings = (postings_t *)item;
 
     fprintf(fp, "%s", key);  // Write the word
-    counters_iterate(counters, fp, counterToFile);  // Write its counters
+    postings_iterate(postings, fp, counterToFile);  // Write its postings
     fprintf(fp, "\n");  // New line for next word
 }
 
 
-void indexToFile(index_t *index, const char *filename) {
+bool indexToFile(index_t *index, const char *filename) {
     FILE *fp = fopen(filename, "w");
     if (fp == NULL) {
         perror("Error opening file");
-        return;
+        return false;
     }
     index_iterate(index, fp, entryToFile);
+    bool ok = !ferror(fp);
+    return fclose(fp) == 0 && ok;
+}
+
+// saveEntry: writes one word and its postings in the binary format.
+// arg points to a FILE* that is set to NULL once a write fails.
+static void saveEntry(void *arg, const char *key, void *item) {
+    FILE **fp = (FILE **)arg;
+    int len = strlen(key);
+    if (*fp != NULL && (fwrite(&len, sizeof(int), 1, *fp) != 1
+                        || fwrite(key, 1, len, *fp) != (size_t)len
+                        || !postings_save((postings_t *)item, *fp))) {
+        *fp = NULL;
+    }
+}
+
+
+bool index_save(index_t *index, const char *filename) {
+    FILE *fp = fopen(filename, "wb");
+    if (fp == NULL) {
+        perror("Error opening file");
+        return false;
+    }
+    FILE *out = fp;
+    fwrite(INDEX_MAGIC, 1, strlen(INDEX_MAGIC), fp);
+    index_iterate(index, &out, saveEntry);
+    int end = 0;  // a zero-length word ends the file
+    bool ok = out != NULL && fwrite(&end, sizeof(int), 1, fp) == 1;
+    if (fclose(fp) != 0) {
+        ok = false;
+    }
+    return ok;
+}
+
+bool index_saveStats(index_t *index, const char *filename) {
+    if (index == NULL || filename == NULL || index->docLengths == NULL) {
+        return false;
+    }
+    char path[strlen(filename) + strlen(INDEX_STATS_SUFFIX) + 1];
+    sprintf(path, "%s%s", filename, INDEX_STATS_SUFFIX);
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) {
+        perror("Error opening file");
+        return false;
+    }
+    // A shard carries its collection's counts, and lists only its own documents
+    index_t *stats = index->statsFrom != NULL ? index->statsFrom : index;
+    fprintf(fp, "%d %ld\n", stats->numDocs, stats->totalWords);
+    for (int docID = 1; docID <= index->numDocs; docID++) {
+        if (stats == index || index->docLengths[docID] > 0) {
+            fprintf(fp, "%d %d\n", docID, index->docLengths[docID]);
+        }
+    }
+    return fclose(fp) == 0;
+}
+
+bool index_loadStats(index_t *index, const char *filename) {
+    if (index == NULL || filename == NULL) {
+        return false;
+    }
+    char path[strlen(filename) + strlen(INDEX_STATS_SUFFIX) + 1];
+    sprintf(path, "%s%s", filename, INDEX_STATS_SUFFIX);
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        return false;
+    }
+
+    int numDocs = 0;
+    long totalWords = 0;
+    bool ok = fscanf(fp, "%d %ld", &numDocs, &totalWords) == 2 && numDocs > 0 && totalWords > 0;
+    int *docLengths = ok ? calloc(numDocs + 1, sizeof(int)) : NULL;
+    ok = docLengths != NULL;
+    int docID = 0, length = 0;
+    while (ok && fscanf(fp, "%d %d", &docID, &length) == 2) {
+        ok = docID >= 1 && docID <= numDocs && length >= 0;
+        if (ok) {
+            docLengths[docID] = length;
+        }
+    }
+    fclose(fp);
+    if (!ok) {
+        free(docLengths);
+        return false;
+    }
+
+    free(index->docLengths);
+    index->docLengths = docLengths;
+    index->numDocs = numDocs;
+    index->docCap = numDocs + 1;
+    index->totalWords = totalWords;
+    return index_computeNorms(index, NULL);
+}
+
+bool index_computeNorms(index_t *index, index_t *statsFrom) {
+    if (index == NULL || index->docLengths == NULL) {
+        return false;
+    }
+    index_t *stats = statsFrom != NULL ? statsFrom : index;
+    if (stats->numDocs < 1 || stats->totalWords < 1) {
+        return false;
+    }
+    float *docNorms = malloc(sizeof(float) * (index->numDocs + 1));
+    if (docNorms == NULL) {
+        return false;
+    }
+
+    // BM25's length normalization, k1 * (1 - b + b * length / average length).
+    // Documents without words (or, in a shard, held by other shards) have no
+    // postings here, so they do not lower the smallest norm the score bounds use.
+    double average = (double)stats->totalWords / stats->numDocs;
+    index->minNorm = BM25_K1;
+    for (int docID = 0; docID <= index->numDocs; docID++) {
+        docNorms[docID] = BM25_K1 * (1 - BM25_B + BM25_B * index->docLengths[docID] / average);
+        if (index->docLengths[docID] > 0 && docNorms[docID] < index->minNorm) {
+            index->minNorm = docNorms[docID];
+        }
+    }
+    free(index->docNorms);
+    index->docNorms = docNorms;
+    index->statsFrom = statsFrom;
+    return true;
+}
+
+int index_shardOf(const int docID, const int numDocs, const int numShards, const bool byHash) {
+    if (byHash) {
+        // Fibonacci hashing, scaled onto 0..numShards-1 by the hash's high bits
+        uint32_t hash = (uint32_t)docID * 2654435769u;
+        return (int)(((uint64_t)hash * (uint32_t)numShards) >> 32);
+    }
+    return (int)((long)(docID - 1) * numShards / numDocs);
+}
+
+bool index_saveShards(const char *filename, const int numShards, const bool byHash) {
+    FILE *fp = fopen(filename, "w");
+    if (fp == NULL) {
+        perror("Error opening file");
+        return false;
+    }
+    fprintf(fp, "%s%d %s\n", INDEX_SHARDS_MAGIC, numShards, byHash ? "hash" : "range");
+    return fclose(fp) == 0;
+}
+
+int index_loadShards(const char *filename) {
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) {
+        return -1;
+    }
+    char magic[sizeof(INDEX_SHARDS_MAGIC)] = "";
+    int numShards = 0;
+    char scheme[8] = "";
+    if (fread(magic, 1, strlen(INDEX_SHARDS_MAGIC), fp) != strlen(INDEX_SHARDS_MAGIC)
+        || strcmp(magic, INDEX_SHARDS_MAGIC) != 0) {
+        numShards = 0; // An ordinary index file, or too short to be a manifest
+    } else if (fscanf(fp, "%d %7s", &numShards, scheme) != 2 || numShards < 1
+               || numShards > INDEX_MAX_SHARDS
+               || (strcmp(scheme, "range") != 0 && strcmp(scheme, "hash") != 0)) {
+        numShards = -1;
+    }
     fclose(fp);
+    return numShards;
+}
+
+void index_joinShards(index_t **shards, const int numShards) {
+    for (int i = 0; i < numShards; i++) {
+        shards[i]->shards = shards;
+        shards[i]->numShards = numShards;
+    }
+}
+
+// a list being merged by index_merge, and where its entries go
+typedef struct merge {
+    index_t *merged;        // the index being built
+    index_t *other;         // the segment while walking the base, else NULL
+    const int *replaced;    // docIDs whose base entries are dropped, sorted
+    int numReplaced;
+} merge_t;
+
+// collects the (docID, count) entries of a postings list into an array
+typedef struct collect {
+    int *docs;
+    int *counts;
+    int n;
+} collect_t;
+
+static void collectEntry(void *arg, const int docID, const int count) {
+    collect_t *c = arg;
+    c->docs[c->n] = docID;
+    c->counts[c->n++] = count;
+}
+
+static int compareInts(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// mergeWord: builds a word's merged list from its base and segment lists (either
+// may be NULL), dropping the base's entries for replaced docIDs, and inserts it.
+static void mergeWord(merge_t *m, const char *word, postings_t *base, postings_t *segment) {
+    int nb = postings_size(base), ns = postings_size(segment);
+    collect_t b = { malloc(sizeof(int) * (nb + 1)), malloc(sizeof(int) * (nb + 1)), 0 };
+    collect_t s = { malloc(sizeof(int) * (ns + 1)), malloc(sizeof(int) * (ns + 1)), 0 };
+    postings_t *postings = postings_newInArena(m->merged->arena);
+    bool ok = b.docs != NULL && b.counts != NULL && s.docs != NULL && s.counts != NULL
+              && postings != NULL;
+    if (ok) {
+        postings_iterate(base, &b, collectEntry);
+        postings_iterate(segment, &s, collectEntry);
+        int i = 0, j = 0;
+        while (ok && (i < b.n || j < s.n)) {
+            if (j >= s.n || (i < b.n && b.docs[i] < s.docs[j])) {
+                if (bsearch(&b.docs[i], m->replaced, m->numReplaced, sizeof(int),
+                            compareInts) == NULL) {
+                    ok = postings_append(postings, b.docs[i], b.counts[i]);
+                }
+                i++;
+            } else {
+                if (i < b.n && b.docs[i] == s.docs[j]) {
+                    i++;  // the segment's entry replaces the base's
+                }
+                ok = postings_append(postings, s.docs[j], s.counts[j]);
+                j++;
+            }
+        }
+    }
+    if (ok && postings_size(postings) > 0) {
+        postings_finish(postings);
+        if (!(ok = insertWord(m->merged, word, postings))) {
+            postings_delete(postings);
+        }
+    } else {
+        postings_delete(postings);  // every entry was replaced, or out of memory
+    }
+    if (!ok) {
+        m->merged = NULL;  // reported by index_merge
+    }
+    free(b.docs);
+    free(b.counts);
+    free(s.docs);
+    free(s.counts);
+}
+
+// mergeBaseWord: merges a base word with the segment's list for it.
+static void mergeBaseWord(void *arg, const char *key, void *item) {
+    merge_t *m = arg;
+    if (m->merged != NULL) {
+        mergeWord(m, key, item, index_find(m->other, key));
+    }
+}
+
+// mergeSegmentWord: adds a segment word the base does not have.
+static void mergeSegmentWord(void *arg, const char *key, void *item) {
+    merge_t *m = arg;
+    if (m->merged != NULL && index_find(m->other, key) == NULL) {
+        mergeWord(m, key, NULL, item);
+    }
+}
+
+index_t *index_merge(index_t *base, index_t *segment, const int *docIDs, const int numDocIDs) {
+    if (base == NULL || segment == NULL || (docIDs == NULL && numDocIDs > 0)) {
+        return NULL;
+    }
+    index_t *merged = index_new();
+    if (merged == NULL) {
+        return NULL;
+    }
+    merge_t m = { merged, segment, docIDs, numDocIDs };
+    index_iterate(base, &m, mergeBaseWord);
+    m.other = base;
+    index_iterate(segment, &m, mergeSegmentWord);
+    if (m.merged == NULL) {
+        index_delete(merged);
+        return NULL;
+    }
+
+    // Document lengths: the base's, with the segment's documents replacing theirs.
+    if (base->docLengths != NULL) {
+        // A segment document without words is in docIDs but not counted in segment->numDocs.
+        int numDocs = base->numDocs > segment->numDocs ? base->numDocs : segment->numDocs;
+        for (int i = 0; i < numDocIDs; i++) {
+            numDocs = docIDs[i] > numDocs ? docIDs[i] : numDocs;
+        }
+        merged->docLengths = calloc(numDocs + 1, sizeof(int));
+        if (merged->docLengths == NULL) {
+            index_delete(merged);
+            return NULL;
+        }
+        memcpy(merged->docLengths, base->docLengths, sizeof(int) * (base->numDocs + 1));
+        merged->numDocs = numDocs;
+        merged->docCap = numDocs + 1;
+        merged->totalWords = base->totalWords;
+        for (int i = 0; i < numDocIDs; i++) {
+            int docID = docIDs[i];
+            int old = docID <= base->numDocs ? base->docLengths[docID] : 0;
+            int length = segment->docLengths != NULL && docID <= segment->numDocs
+                         ? segment->docLengths[docID] : 0;
+            merged->docLengths[docID] = length;
+            merged->totalWords += length - old;
+        }
+    }
+    return merged;
+}
+
+// loadBinary: reads the words and postings that follow INDEX_MAGIC.
+static index_t* loadBinary(index_t* index, FILE* fp) {
+    char word[MaxWordLength];
+    int len = 0;
+    while (fread(&len, sizeof(int), 1, fp) == 1 && len > 0) {
+        if (len >= MaxWordLength || fread(word, 1, len, fp) != (size_t)len) {
+            return NULL;
+        }
+        word[len] = '\0';
+        postings_t *postings = postings_loadInArena(fp, index->arena);
+        if (postings == NULL) {
+            return NULL;
+        }
+        if (!insertWord(index, word, postings)) {
+            postings_delete(postings);
+        }
+    }
+    return len == 0 ? index : NULL;
+}
+
+// a (docID, count) pair read from one line of a text index file
+typedef struct entry {
+    int docID;
+    int count;
+} entry_t;
+
+static int compareEntries(const void *a, const void *b) {
+    return ((const entry_t *)a)->docID - ((const entry_t *)b)->docID;
 }
 
 //take in an index file in the correct format and convert it into an index structure 
@@ -137,26 +544,73 @@ index_t* fileToIndex(index_t* index, char* oldf) {
         return NULL;
     }
 
+    // Binary index files are recognized by their header
+    char magic[sizeof(INDEX_MAGIC)] = "";
+    if (fread(magic, 1, strlen(INDEX_MAGIC), old) == strlen(INDEX_MAGIC)
+        && strcmp(magic, INDEX_MAGIC) == 0) {
+        index_t *loaded = loadBinary(index, old);
+        if (loaded == NULL) {
+            fprintf(stderr, "%s is not a valid index file.\n", oldf);
+        }
+        fclose(old);
+        return loaded;
+    }
+    if (strcmp(magic, INDEX_SHARDS_MAGIC) == 0) {
+        fprintf(stderr, "%s is a shard manifest; load its shards (%s.0 and on) instead.\n",
+                oldf, oldf);
+        fclose(old);
+        return NULL;
+    }
+    rewind(old);
+
     char word[MaxWordLength]; 
     int docID = 0;
     int count = 0;
+    int numEntries = 0;
+    int maxEntries = 64;
+    entry_t *entries = malloc(sizeof(entry_t) * maxEntries);
+    if (entries == NULL) {
+        fclose(old);
+        return NULL;
+    }
 
-    while (fscanf(old, "%s", word) == 1) {
+    while (fscanf(old, "%99s", word) == 1) {
         // Read docID and count until the end of line
+        numEntries = 0;
         while (fscanf(old, "%d %d", &docID, &count) == 2) {
-            counters_t *wordInfo = index_find(index, word); // Find word in index
-            if (wordInfo == NULL) { // If word doesn't exist in index
-                wordInfo = counters_new(); // Create a new counter set
-                if (wordInfo != NULL) {
-                    counters_set(wordInfo, docID, count); // Set the count for the docID
-                    hashtable_insert(index->ht, word, wordInfo); // Insert word into index
+            if (numEntries == maxEntries) {
+                maxEntries *= 2;
+                entry_t *grown = realloc(entries, sizeof(entry_t) * maxEntries);
+                if (grown == NULL) {
+                    break;
                 }
-            } else { // If word exists in index
-                counters_set(wordInfo, docID, count); // Update the count for the docID
+                entries = grown;
+            }
+            entries[numEntries].docID = docID;
+            entries[numEntries].count = count;
+            numEntries++;
+        }
+
+        // Postings are kept in docID order; a repeated docID is collapsed to one entry
+        qsort(entries, numEntries, sizeof(entry_t), compareEntries);
+        postings_t *wordInfo = index_find(index, word); // Find word in index
+        if (wordInfo == NULL) { // If word doesn't exist in index
+            wordInfo = postings_newInArena(index->arena); // Create a new postings list
+            if (wordInfo == NULL || !insertWord(index, word, wordInfo)) {
+                postings_delete(wordInfo);
+                continue;
+            }
+        }
+        for (int i = 0; i < numEntries; i++) {
+            if (i + 1 < numEntries && entries[i + 1].docID == entries[i].docID) {
+                continue;
             }
+            postings_append(wordInfo, entries[i].docID, entries[i].count);
         }
+        postings_finish(wordInfo);
     } 
 
+    free(entries);
     fclose(old);
     return index;
 }
@@ -4,12 +4,45 @@
  * The 'index' module defines a data structure for efficiently storing
  * and accessing a word index. The index maps words to document IDs and
  * the frequency of occurrences within those documents. This is implemented
- * using a hashtable, where each key is a word, and its value is a
- * counters set tracking the document IDs and occurrence counts.
+ * with an intern table (see libcs50/intern.h), which numbers the distinct
+ * words, and an array indexed by those word IDs of compressed postings
+ * lists (see postings.h) of document IDs and occurrence counts. Words are
+ * iterated, and so saved, in the order they were first added.
  *
  * This module supports creating a new index, adding words with document
  * IDs, finding the occurrence count of words, iterating over index items,
- * and saving/loading the index from/to a file.
+ * and saving/loading the index from/to a file. Index files come in two
+ * formats: the text format ("word docID count docID count ...", one word
+ * per line) and a binary format that stores the postings exactly as they
+ * are held in memory, so loading it needs no parsing or re-encoding.
+ *
+ * While words are added the index also counts the words of every document.
+ * These document statistics are saved next to the index file (in
+ * indexFilename followed by INDEX_STATS_SUFFIX, as "numDocs totalWords" and
+ * then "docID length" lines) and loaded back by the querier, which turns
+ * them into per-document BM25 length norms once, at startup.
+ *
+ * A small index of recently added documents (a segment, kept next to a large
+ * base index until the two are merged with index_merge) can borrow the base's
+ * collection statistics, so that BM25 scores its documents on the same scale
+ * as the base's: see index_computeNorms.
+ *
+ * A collection too large for one index file can be split into shards, each
+ * an index of some of the documents (by docID range or by a hash of the
+ * docID) with its own words and postings, written to indexFilename followed
+ * by "." and the shard's number. A shard's statistics file holds the whole
+ * collection's document count and word total, so a shard loaded on its own
+ * ranks its documents on the collection's scale; shards loaded together and
+ * joined with index_joinShards also add up their document frequencies, and
+ * score every document exactly as one unsharded index would. A short
+ * manifest, written at indexFilename itself, says how many shards there are:
+ * see index_saveShards and index_loadShards.
+ *
+ * An index owns an arena (see libcs50/arena.h) that holds its words, packed
+ * end to end by the intern table, and its postings lists, each list's
+ * compressed form once finished or loaded; so building one takes few
+ * mallocs, and index_delete releases nearly all of its memory in a few
+ * munmap calls.
  *
  * The index is crucial for search engine operations, enabling efficient
  * keyword searches through documents.
@@ -18,32 +51,57 @@
  * Updated by Tasnim Chowdhury, February 2024
  *
  * Compilation requires: 
- * - libcs50 (hashtable.h, counters.h)
+ * - libcs50 (intern.h, arena.h)
+ * - postings.h
  */
 
 #ifndef __INDEX_H
 #define __INDEX_H
 
-#include "../libcs50/hashtable.h"
-#include "../libcs50/counters.h"
+#include <stdbool.h>
+#include "../libcs50/intern.h"
+#include "../libcs50/arena.h"
+#include "postings.h"
 
 /* 
  * Global variables
  */
-#define NUM_SLOTS 200  // Default number of slots in hashtable
+#define INDEX_MAGIC "TSEIDX3\n"  // First bytes of a binary index file
+#define INDEX_STATS_SUFFIX ".stats"  // Document statistics file: indexFilename + suffix
+#define INDEX_SHARDS_MAGIC "TSESHRD\n"  // First bytes of a shard manifest
+#define INDEX_SHARD_FORMAT "%s.%d"  // Shard file: manifest filename, shard number
+#define INDEX_MAX_SHARDS 256  // Most shards a manifest may list
+#define BM25_K1 1.2  // BM25 term-frequency saturation
+#define BM25_B 0.75  // BM25 document-length normalization strength
 
 /* 
  * Struct definitions
  */
 typedef struct index {
-    hashtable_t *ht;  // Hashtable: words as keys, counters as values
+    intern_t *words;  // The distinct words, numbered in the order first added
+    postings_t **postings;  // Postings list of each word, by word ID (NULL if none)
+    int postingsCap;  // Entries allocated in postings
+    arena_t *arena;   // Holds the words' bytes and the postings lists
+    int *docLengths;  // Words indexed in each document, by docID (NULL if unknown)
+    float *docNorms;  // BM25 length norm of each document, by docID (NULL until loaded)
+    int numDocs;      // Largest docID with a length
+    int docCap;       // Entries allocated in docLengths
+    long totalWords;  // Words indexed in all documents
+    float minNorm;    // Smallest entry of docNorms
+    struct index *statsFrom;  // Index whose document count and average length
+                              // BM25 uses, and whose document frequencies it adds;
+                              // NULL for this one
+    struct index **shards;  // Every shard of the collection, this one included,
+                            // whose document frequencies BM25 adds up; NULL
+                            // unless joined by index_joinShards
+    int numShards;
 } index_t;
 
 /* 
  * index_new: Creates and initializes a new, empty index.
  *
- * Allocates memory for an index structure and initializes a hashtable
- * with a predefined number of slots for storing word occurrences.
+ * Allocates memory for an index structure and its arena, and initializes
+ * an intern table for its words, whose bytes come from the arena.
  *
  * Returns:
  *   - A pointer to the new index, or NULL if an error occurs.
@@ -53,8 +111,9 @@ index_t *index_new(void);
 /*
  * index_delete - frees the memory allocated for an index and its contents.
  *
- * Deletes the hashtable within the index, freeing all associated memory,
- * and then frees the memory allocated for the index structure itself.
+ * Deletes the postings lists and word table within the index, then its
+ * arena, freeing all associated memory, and then frees the index
+ * structure itself.
  *
  * Parameters:
  *  - index: a pointer to the index to be deleted.
@@ -62,24 +121,26 @@ index_t *index_new(void);
 void index_delete(index_t *index);
 
 /*
- * index_find - retrieves the counter set associated with a given word.
+ * index_find - retrieves the postings list associated with a given word.
  *
- * Searches the index's hashtable for a counter set corresponding to the given word.
+ * Looks the word's ID up in the index's intern table, and returns the
+ * postings list stored under that ID.
  *
  * Parameters:
  *  - index: a pointer to the index being searched.
- *  - word: the word for which to find the counter set.
+ *  - word: the word for which to find the postings.
  *
- * Returns a pointer to the counter set associated with the word, or NULL if
+ * Returns a pointer to the postings list associated with the word, or NULL if
  * the word is not found in the index.
  */
-counters_t *index_find(index_t *index, const char *word);
+postings_t *index_find(index_t *index, const char *word);
 
 /*
  * index_add - adds a word occurrence to the index.
  *
  * If the word is already in the index, increments the count for the given docID.
  * If the word is not in the index, adds it with the given docID and a count of 1.
+ * Pages must be added in nondecreasing docID order, as indexBuild does.
  *
  * Parameters:
  *  - index: a pointer to the index to which the word occurrence should be added.
@@ -90,10 +151,22 @@ counters_t *index_find(index_t *index, const char *word);
  */
 bool index_add(index_t *index, const char *word, int docID);
 
+/*
+ * index_finish - packs every postings list into its final compressed form.
+ *
+ * Call once all pages have been added; it releases the per-word build
+ * buffers. The index may still be added to afterwards.
+ *
+ * Parameters:
+ *  - index: a pointer to the index to be finished.
+ */
+void index_finish(index_t *index);
+
 /*
  * index_iterate - iterates over all items in the index.
  *
- * Calls the given function for each item (word and its counter set) in the index.
+ * Calls the given function for each item (word and its postings list) in the index,
+ * in the order the words were first added.
  *
  * Parameters:
  *  - index: a pointer to the index to be iterated over.
@@ -110,13 +183,136 @@ void index_iterate(index_t *index, void *arg, void (*itemfunc)(void *arg, const
  * Parameters:
  *  - index: a pointer to the index to be written.
  *  - filename: the name of the file to which the index should be written.
+ *
+ * Returns true on success, false if the file could not be written.
+ */
+bool indexToFile(index_t *index, const char *filename);
+
+/*
+ * index_save - writes the index to a file in the binary format.
+ *
+ * The file starts with INDEX_MAGIC; fileToIndex recognizes it and loads the
+ * compressed postings directly.
+ *
+ * Parameters:
+ *  - index: a pointer to the index to be written.
+ *  - filename: the name of the file to which the index should be written.
+ *
+ * Returns true on success, false if the file could not be written.
+ */
+bool index_save(index_t *index, const char *filename);
+
+/*
+ * index_saveStats - writes the document statistics next to an index file.
+ *
+ * Writes indexFilename followed by INDEX_STATS_SUFFIX: the number of
+ * documents and of words indexed, then each document's word count. For a
+ * shard, whose statsFrom holds the whole collection's counts, the first two
+ * are the collection's and only the shard's documents are listed.
+ *
+ * Parameters:
+ *  - index: a pointer to an index built with index_add.
+ *  - filename: the name of the index file the statistics belong to.
+ *
+ * Returns true on success, false if the file could not be written.
+ */
+bool index_saveStats(index_t *index, const char *filename);
+
+/*
+ * index_loadStats - reads the document statistics saved next to an index file.
+ *
+ * Replaces the index's document lengths with those saved by index_saveStats
+ * and computes every document's BM25 length norm (docNorms) from them, so
+ * that scoring needs no further file access.
+ *
+ * Parameters:
+ *  - index: a pointer to the index.
+ *  - filename: the name of the index file the statistics belong to.
+ *
+ * Returns true on success, false if the file is missing or malformed.
+ */
+bool index_loadStats(index_t *index, const char *filename);
+
+/*
+ * index_computeNorms - computes the BM25 length norm of every document.
+ *
+ * Uses the document lengths counted by index_add (or loaded by
+ * index_loadStats) and the average document length of statsFrom, or of the
+ * index itself if statsFrom is NULL. With statsFrom set, BM25 also takes the
+ * number of documents from statsFrom, and counts a word's documents in both
+ * indexes; statsFrom must outlive the index.
+ *
+ * Parameters:
+ *  - index: a pointer to the index.
+ *  - statsFrom: the index with the collection statistics, or NULL.
+ *
+ * Returns true on success, false without document lengths or out of memory.
+ */
+bool index_computeNorms(index_t *index, index_t *statsFrom);
+
+/*
+ * index_merge - merges a segment of documents into a base index.
+ *
+ * Builds a new index holding every entry of both: the base's entries for
+ * the documents listed in docIDs are dropped in favour of the segment's (a
+ * document indexed again replaces its old version). Document lengths are
+ * merged the same way when the base has them. The merged postings are
+ * finished; neither input is changed.
+ *
+ * Parameters:
+ *  - base: the large index.
+ *  - segment: the index of the new documents.
+ *  - docIDs: the documents the segment holds, in increasing order.
+ *  - numDocIDs: the number of docIDs.
+ *
+ * Returns the merged index, or NULL if out of memory.
+ */
+index_t *index_merge(index_t *base, index_t *segment, const int *docIDs, const int numDocIDs);
+
+/*
+ * index_shardOf - returns the shard, of numShards, that holds docID.
+ *
+ * Documents are numbered 1..numDocs. By range, shard s holds a contiguous
+ * run of about numDocs / numShards docIDs, in order; by hash, each docID
+ * goes to a shard picked by a multiplicative hash of it, which spreads any
+ * run of docIDs (a crawl's neighbourhoods) evenly over the shards.
+ */
+int index_shardOf(const int docID, const int numDocs, const int numShards, const bool byHash);
+
+/*
+ * index_saveShards - writes the manifest of a sharded index.
+ *
+ * The manifest, at filename, is INDEX_SHARDS_MAGIC followed by a line
+ * "numShards range" or "numShards hash"; the shards themselves are the index
+ * files named by INDEX_SHARD_FORMAT, with their statistics files. Write it
+ * after the shards, so that a querier watching filename sees them complete.
+ *
+ * Returns true on success, false if the file could not be written.
+ */
+bool index_saveShards(const char *filename, const int numShards, const bool byHash);
+
+/*
+ * index_loadShards - reads the manifest of a sharded index.
+ *
+ * Returns the number of shards listed at filename (1..INDEX_MAX_SHARDS), 0
+ * if filename is an ordinary index file, or -1 if it cannot be read or is a
+ * malformed manifest.
+ */
+int index_loadShards(const char *filename);
+
+/*
+ * index_joinShards - makes numShards loaded shards score as one index.
+ *
+ * Every shard keeps a pointer to shards, which must outlive them, and BM25
+ * counts a word's documents in all of them. The document count and average
+ * length already come from each shard's statistics file.
  */
-void indexToFile(index_t *index, const char *filename);
+void index_joinShards(index_t **shards, const int numShards);
 
 /*
  * counterToFile - writes a single document ID and count to a file.
  *
- * Designed to be called by counters_iterate for each item in a counter set.
+ * Designed to be called by postings_iterate for each item in a postings list.
  *
  * Parameters:
  *  - arg: a pointer to the file to which the data should be written.
@@ -126,14 +322,14 @@ void indexToFile(index_t *index, const char *filename);
 void counterToFile(void *arg, const int key, const int count);
 
 /*
- * entryToFile - writes a single index entry (word and its counter set) to a file.
+ * entryToFile - writes a single index entry (word and its postings) to a file.
  *
- * Designed to be called by hashtable_iterate for each item in the index.
+ * Designed to be called by index_iterate for each item in the index.
  *
  * Parameters:
  *  - arg: a pointer to the file to which the data should be written.
  *  - key: the word.
- *  - item: a pointer to the counter set associated with the word.
+ *  - item: a pointer to the postings list associated with the word.
  */
 void entryToFile(void *arg, const char *key, void *item);
 
@@ -142,7 +338,9 @@ void entryToFile(void *arg, const char *key, void *item);
  *
  * This function opens and reads an index from a given file ('oldf'), reconstructing
  * the index structure in memory by parsing the word-documentID-count triples contained
- * within. The loaded index can then be manipulated or queried as required by the application.
+ * within. Files written by index_save are recognized by their INDEX_MAGIC header and
+ * loaded without parsing; a shard manifest is refused (load its shards instead). The loaded index can then be manipulated or queried as
+ * required by the application.
  * 
  * Parameters:
  *  - index: a pointer to a new index the to load the original index into
@@ -0,0 +1,180 @@
+/*
+ * latency.c - CS50 'latency' module
+ *
+ * see latency.h for more information.
+ *
+ * A duration v below 64 ns has a bucket of its own. Any longer duration,
+ * with its highest set bit at position e (6 to 63), is counted in bucket
+ * (e - 5) * 32 + (v >> (e - 5)): its top six bits select one of the 32
+ * buckets covering 2^e .. 2^(e+1)-1, each 2^(e-5) wide. So the buckets run
+ * in increasing order of duration with no gaps, and a bucket is never wider
+ * than 1/32 of the durations it holds.
+ *
+ * Each phase's counts sit in one row of a single array. One mutex guards
+ * everything: a sample is a handful of additions per phase, far shorter
+ * than anything worth timing.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include "latency.h"
+
+/**************** local constants ****************/
+#define SUB_BITS 5                      // log2 of the buckets per power of two
+#define NUM_BUCKETS ((64 - SUB_BITS + 1) << SUB_BITS)
+
+/**************** global types ****************/
+typedef struct latency {
+    pthread_mutex_t lock;       // guards everything below
+    int numPhases;
+    const char* const* names;   // names[p] is phase p's name
+    uint64_t* counts;           // counts[p * NUM_BUCKETS + b]: phase p's bucket b
+    uint64_t samples;           // samples recorded, in every phase
+    double* totals;             // totals[p]: sum of phase p's samples, in ns
+    uint64_t* maxima;           // maxima[p]: phase p's largest sample
+} latency_t;
+
+/**************** local functions ****************/
+
+// Returns the bucket that counts a duration of ns nanoseconds.
+static int bucketOf(const uint64_t ns)
+{
+    if (ns < (2u << SUB_BITS)) {
+        return (int)ns;
+    }
+    int e = SUB_BITS + 1;
+    while (e < 63 && (ns >> (e + 1)) != 0) {
+        e++;
+    }
+    return ((e - SUB_BITS) << SUB_BITS) + (int)(ns >> (e - SUB_BITS));
+}
+
+// Returns the longest duration bucket b counts.
+static uint64_t bucketEnd(const int b)
+{
+    if (b < (2 << SUB_BITS)) {
+        return (uint64_t)b;
+    }
+    int shift = (b >> SUB_BITS) - 1;
+    uint64_t top = (uint64_t)((b & ((1 << SUB_BITS) - 1)) + (1 << SUB_BITS)) + 1;
+    return (top << shift) - 1;
+}
+
+// Returns latency_percentile's answer; the caller holds the lock.
+static uint64_t percentile(latency_t* latency, const int phase, const double fraction)
+{
+    if (latency->samples == 0) {
+        return 0;
+    }
+    double wanted = fraction * latency->samples;
+    uint64_t rank = wanted < 1 ? 1 : (uint64_t)wanted;
+    rank += rank < wanted && rank < latency->samples;  // round up
+    const uint64_t* counts = &latency->counts[(size_t)phase * NUM_BUCKETS];
+    uint64_t seen = 0;
+    for (int b = 0; b < NUM_BUCKETS; b++) {
+        seen += counts[b];
+        if (seen >= rank) {
+            uint64_t end = bucketEnd(b);
+            return end < latency->maxima[phase] ? end : latency->maxima[phase];
+        }
+    }
+    return latency->maxima[phase];
+}
+
+/**************** global functions ****************/
+
+latency_t* latency_new(const int numPhases, const char* const names[])
+{
+    if (numPhases < 1 || names == NULL) {
+        return NULL;
+    }
+    latency_t* latency = calloc(1, sizeof(latency_t));
+    if (latency == NULL) {
+        return NULL;
+    }
+    latency->counts = calloc((size_t)numPhases * NUM_BUCKETS, sizeof(uint64_t));
+    latency->totals = calloc(numPhases, sizeof(double));
+    latency->maxima = calloc(numPhases, sizeof(uint64_t));
+    if (latency->counts == NULL || latency->totals == NULL || latency->maxima == NULL) {
+        latency_delete(latency);
+        return NULL;
+    }
+    latency->numPhases = numPhases;
+    latency->names = names;
+    pthread_mutex_init(&latency->lock, NULL);
+    return latency;
+}
+
+uint64_t latency_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+void latency_record(latency_t* latency, const uint64_t ns[])
+{
+    if (latency == NULL || ns == NULL) {
+        return;
+    }
+    int buckets[latency->numPhases];
+    for (int p = 0; p < latency->numPhases; p++) {
+        buckets[p] = bucketOf(ns[p]);
+    }
+    pthread_mutex_lock(&latency->lock);
+    for (int p = 0; p < latency->numPhases; p++) {
+        latency->counts[(size_t)p * NUM_BUCKETS + buckets[p]]++;
+        latency->totals[p] += ns[p];
+        if (ns[p] > latency->maxima[p]) {
+            latency->maxima[p] = ns[p];
+        }
+    }
+    latency->samples++;
+    pthread_mutex_unlock(&latency->lock);
+}
+
+uint64_t latency_percentile(latency_t* latency, const int phase, const double fraction)
+{
+    if (latency == NULL || phase < 0 || phase >= latency->numPhases) {
+        return 0;
+    }
+    pthread_mutex_lock(&latency->lock);
+    uint64_t ns = percentile(latency, phase, fraction);
+    pthread_mutex_unlock(&latency->lock);
+    return ns;
+}
+
+void latency_print(latency_t* latency, FILE* fp)
+{
+    if (latency == NULL || fp == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&latency->lock);
+    for (int p = 0; p < latency->numPhases; p++) {
+        double mean = latency->samples > 0 ? latency->totals[p] / latency->samples : 0;
+        fprintf(fp, "latency %s: %llu samples, mean %.3f, p50 %.3f, p90 %.3f, p99 %.3f, "
+                "p99.9 %.3f, max %.3f ms\n", latency->names[p],
+                (unsigned long long)latency->samples, mean / 1e6,
+                percentile(latency, p, 0.5) / 1e6, percentile(latency, p, 0.9) / 1e6,
+                percentile(latency, p, 0.99) / 1e6, percentile(latency, p, 0.999) / 1e6,
+                latency->maxima[p] / 1e6);
+    }
+    pthread_mutex_unlock(&latency->lock);
+}
+
+void latency_delete(latency_t* latency)
+{
+    if (latency != NULL) {
+        if (latency->names != NULL) {
+            pthread_mutex_destroy(&latency->lock);  // initialized along with names
+        }
+        free(latency->counts);
+        free(latency->totals);
+        free(latency->maxima);
+        free(latency);
+    }
+}
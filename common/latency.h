@@ -0,0 +1,71 @@
+/*
+ * latency.h - header file for the 'latency' module
+ *
+ * A latency recorder keeps one histogram of durations per named phase of
+ * some operation (the querier's phases of answering a query: parsing,
+ * looking up the cache, scoring, printing) and reports their percentiles.
+ * Durations are nanoseconds of the monotonic clock (latency_now).
+ *
+ * The histograms are log-linear, like HdrHistogram's: every power of two
+ * is cut into 32 buckets of equal width, so any duration from 1 ns to
+ * centuries is counted in a fixed number of buckets and every percentile is
+ * reported within about 3% of the true value, never below it. Recording is
+ * a few additions, under a lock shared by all the phases, so that one
+ * sample of every phase is recorded at once; any number of threads may
+ * record and report at the same time.
+ *
+ * Compilation requires: POSIX clock_gettime and threads.
+ */
+
+#ifndef __LATENCY_H
+#define __LATENCY_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * Struct definitions
+ */
+typedef struct latency latency_t;  // opaque to users of the module
+
+/*
+ * latency_new - creates a recorder of numPhases phases, named names[0 ..
+ * numPhases-1] in reports; the names must outlive the recorder.
+ *
+ * Returns the new recorder, or NULL if numPhases < 1 or out of memory.
+ * The caller is responsible for later calling latency_delete().
+ */
+latency_t* latency_new(const int numPhases, const char* const names[]);
+
+/*
+ * latency_now - returns the monotonic clock (CLOCK_MONOTONIC) in nanoseconds.
+ * Only differences between its values mean anything.
+ */
+uint64_t latency_now(void);
+
+/*
+ * latency_record - adds one sample to every phase's histogram: ns[p]
+ * nanoseconds for phase p, where ns has numPhases entries.
+ */
+void latency_record(latency_t* latency, const uint64_t ns[]);
+
+/*
+ * latency_percentile - returns the duration, in nanoseconds, that fraction
+ * (0 to 1: 0.5 for the median, 0.999 for p99.9) of phase's samples do not
+ * exceed, rounded up to the end of its bucket but never past the largest
+ * sample; or 0 if phase has no samples or is out of range.
+ */
+uint64_t latency_percentile(latency_t* latency, const int phase, const double fraction);
+
+/*
+ * latency_print - prints one line per phase to fp: its name, the number of
+ * samples, and their mean, p50, p90, p99, p99.9 and maximum in milliseconds.
+ */
+void latency_print(latency_t* latency, FILE* fp);
+
+/*
+ * latency_delete - frees the recorder; ignores NULL.
+ */
+void latency_delete(latency_t* latency);
+
+#endif // __LATENCY_H
@@ -12,6 +12,7 @@
 #include <stdbool.h>
 #include "../libcs50/webpage.h"
 #include "../libcs50/file.h"
+#include "pagedir.h"
 #include <dirent.h>
 #define _POSIX_C_SOURCE 200809L
 
@@ -86,7 +87,24 @@ webpage_t* pagedir_load(const char* dir, int docID) {
     // Construct the full pathname for the file corresponding to the given docID
     char filename[256];
     snprintf(filename, sizeof(filename), "%s/%d", dir, docID);
+    return pagedir_loadFile(filename);
+}
+
+int pagedir_count(const char* dir) {
+    int numPages = 0;
+    for (;;) {
+        char filename[pathLength];
+        snprintf(filename, sizeof(filename), "%s/%d", dir, numPages + 1);
+        FILE* file = fopen(filename, "r");
+        if (file == NULL) {
+            return numPages;
+        }
+        fclose(file);
+        numPages++;
+    }
+}
 
+webpage_t* pagedir_loadFile(const char* filename) {
     // Attempt to open the file for reading
     FILE* file = fopen(filename, "r");
     if (file == NULL) {
@@ -15,6 +15,7 @@
  * - pagedir_validate() to check if a directory contains a .crawler file, indicating
  *   it was created by the crawler.
  * - pagedir_load() to load a saved webpage from a file, given its document ID.
+ * - pagedir_loadFile() to load a saved webpage from a file, given its path.
  *
  * These functions are instrumental in managing the storage and retrieval of webpages
  * by the crawler and potentially by other components that need to access the crawled
@@ -107,4 +108,30 @@ bool pagedir_validate(const char* dir);
  */
 webpage_t* pagedir_load(const char* dir, int docID); 
 
+/*
+ * Loads a webpage from the file at a given path, in the format pagedir_save
+ * writes; pagedir_load uses it once it has built the path.
+ *
+ * Parameters:
+ *  - filename: The path of the page file.
+ *
+ * Returns:
+ *  - A pointer to a new webpage_t object, which must be freed by calling
+ *    webpage_delete(); NULL if the file could not be opened or read.
+ */
+webpage_t* pagedir_loadFile(const char* filename);
+
+/*
+ * Counts the pages in a directory produced by the Crawler: the documents
+ * numbered 1, 2, ... up to the first number without a file. Nothing is read
+ * from the files, so it is cheap next to loading them.
+ *
+ * Parameters:
+ *  - dir: A string representing the path to the page directory.
+ *
+ * Returns:
+ *  - The number of pages, 0 if there are none.
+ */
+int pagedir_count(const char* dir);
+
 #endif // PAGEDIR_H
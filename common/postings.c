@@ -0,0 +1,1220 @@
+/*
+ * postings.c - CS50 'postings' module
+ *
+ * see postings.h for more information.
+ *
+ * Layout of a full block (POSTINGS_BLOCK entries):
+ *   1 byte   width of the docID gaps, in bits (0..32)
+ *   1 byte   width of the counts, in bits (0..32)
+ *   16*w     gaps (docID - previous docID - 1), bit-packed
+ *   16*w     counts minus one, bit-packed
+ * Packed values are interleaved over four 32-bit lanes: value i lives in lane
+ * i%4 at position i/4, so one 128-bit load feeds four values at a time.
+ * The partial block at the end of a finished list is stored as pairs of
+ * variable-byte numbers (gap, count minus one).
+ *
+ * Dense lists (see postings.h) keep their docIDs in a bitmap instead. The
+ * bitmap is split into chunks of 2^16 docIDs, Roaring style: chunks without
+ * documents are left out and each chunk's words stop at its last document.
+ * The counts live in a side array of frames, one per POSTINGS_BLOCK
+ * documents in docID order:
+ *   1 byte   width of the counts, in bits (0..32)
+ *   16*w     counts minus one, bit-packed as above (last frame zero-padded)
+ * and the skip table points at the frames, so a cursor walks a dense list
+ * block by block exactly as it walks a packed one, taking docIDs from the
+ * bitmap and counts from the frame.
+ *
+ * The compressed form of a list in an arena (data, skips, chunks and bits)
+ * is copied into the arena, exactly sized, when the list is finished, and
+ * copied back out to malloc'd buffers before the list grows again; the
+ * pending buffer is always malloc'd.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "postings.h"
+
+/**************** local types ****************/
+typedef struct skip {
+    int lastDocID;          // largest docID in the block
+    unsigned int offset;    // byte offset of the block within data
+    int maxCount;           // largest count in the block
+} skip_t;
+
+typedef struct chunk {
+    int key;                // docID >> 16, shared by every document in the chunk
+    int nwords;             // bitmap words, up to the chunk's last document
+    unsigned int word;      // index of the chunk's first word in bits
+} chunk_t;
+
+/**************** global types ****************/
+typedef struct postings {
+    unsigned char* data;    // packed blocks, then the vbyte tail once finished
+    size_t len;             // bytes of data in use
+    size_t cap;             // bytes of data allocated
+    skip_t* skips;          // skip table, one entry per packed block
+    int nblocks;            // number of packed blocks
+    int skipcap;            // skip entries allocated
+    int ndocs;              // number of documents in the list
+    int lastDocID;          // largest docID in the list, 0 if empty
+    int ntail;              // entries in the vbyte tail (finished lists only)
+    int maxCount;           // largest count in the list
+    int tailMax;            // largest count in the vbyte tail
+    int* pendDocs;          // entries not yet packed (lists being built)
+    int* pendCounts;
+    int npend;
+    int pendcap;
+    chunk_t* chunks;        // bitmap chunks of a dense list (NULL otherwise)
+    int nchunks;
+    uint64_t* bits;         // bitmap words of all chunks
+    int nwords;
+    arena_t* arena;         // arena holding the header; NULL if malloc'd
+    bool inArena;           // whether data, skips, chunks and bits are in the arena
+} postings_t;
+
+/**************** local functions ****************/
+
+// Number of bits needed to represent v.
+static int bitsNeeded(uint32_t v)
+{
+    int bits = 0;
+    while (v != 0) {
+        bits++;
+        v >>= 1;
+    }
+    return bits;
+}
+
+// Packs POSTINGS_BLOCK values of the given width into out (16*bits bytes).
+static void pack128(const uint32_t* in, const int bits, unsigned char* out)
+{
+    if (bits == 0) {
+        return;
+    }
+    uint32_t words[32 * 4];
+    memset(words, 0, sizeof(uint32_t) * 4 * bits);
+    for (int lane = 0; lane < 4; lane++) {
+        int bitpos = 0;
+        for (int i = 0; i < POSTINGS_BLOCK / 4; i++) {
+            uint32_t v = in[4 * i + lane];
+            int word = bitpos >> 5;
+            int shift = bitpos & 31;
+            words[4 * word + lane] |= v << shift;
+            if (shift + bits > 32) {
+                words[4 * (word + 1) + lane] |= v >> (32 - shift);
+            }
+            bitpos += bits;
+        }
+    }
+    memcpy(out, words, sizeof(uint32_t) * 4 * bits);
+}
+
+// Unpacks POSTINGS_BLOCK values of the given width from in.
+static void unpack128(const unsigned char* in, const int bits, uint32_t* out)
+{
+    if (bits == 0) {
+        memset(out, 0, sizeof(uint32_t) * POSTINGS_BLOCK);
+        return;
+    }
+#ifdef __SSE2__
+    const __m128i mask = _mm_set1_epi32(bits == 32 ? -1 : (int)((1u << bits) - 1));
+    const __m128i* words = (const __m128i*)in;
+    __m128i cur = _mm_loadu_si128(words++);
+    int shift = 0;
+    for (int i = 0; i < POSTINGS_BLOCK / 4; i++) {
+        __m128i v = _mm_srl_epi32(cur, _mm_cvtsi32_si128(shift));
+        shift += bits;
+        if (shift >= 32) {
+            // the value straddles two words, or the current word is used up
+            shift -= 32;
+            if (i < POSTINGS_BLOCK / 4 - 1) {
+                cur = _mm_loadu_si128(words++);
+                if (shift > 0) {
+                    v = _mm_or_si128(v, _mm_sll_epi32(cur, _mm_cvtsi32_si128(bits - shift)));
+                }
+            }
+        }
+        _mm_storeu_si128((__m128i*)(out + 4 * i), _mm_and_si128(v, mask));
+    }
+#else
+    const uint32_t mask = bits == 32 ? 0xFFFFFFFFu : (1u << bits) - 1;
+    uint32_t words[32 * 4 + 4];
+    memcpy(words, in, sizeof(uint32_t) * 4 * bits);
+    memset(words + 4 * bits, 0, sizeof(uint32_t) * 4);
+    for (int lane = 0; lane < 4; lane++) {
+        int bitpos = 0;
+        for (int i = 0; i < POSTINGS_BLOCK / 4; i++) {
+            int word = bitpos >> 5;
+            int shift = bitpos & 31;
+            uint64_t v = words[4 * word + lane];
+            v |= (uint64_t)words[4 * (word + 1) + lane] << 32;
+            out[4 * i + lane] = (uint32_t)(v >> shift) & mask;
+            bitpos += bits;
+        }
+    }
+#endif
+}
+
+// Turns the gaps of one block into docIDs, in place: docs[i] becomes
+// base + (gaps[0]+1) + ... + (gaps[i]+1).
+static void prefixSum128(uint32_t* docs, const int base)
+{
+#ifdef __SSE2__
+    const __m128i ones = _mm_set1_epi32(1);
+    __m128i run = _mm_set1_epi32(base);
+    for (int i = 0; i < POSTINGS_BLOCK; i += 4) {
+        __m128i x = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(docs + i)), ones);
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi32(x, run);
+        _mm_storeu_si128((__m128i*)(docs + i), x);
+        run = _mm_shuffle_epi32(x, 0xFF);
+    }
+#else
+    uint32_t run = base;
+    for (int i = 0; i < POSTINGS_BLOCK; i++) {
+        run += docs[i] + 1;
+        docs[i] = run;
+    }
+#endif
+}
+
+// Decodes the docIDs of the packed block starting at in.
+static void blockDocs(const unsigned char* in, const int base, int* docs)
+{
+    unpack128(in + 2, in[0], (uint32_t*)docs);
+    prefixSum128((uint32_t*)docs, base);
+}
+
+// Decodes the counts of the packed block starting at in.
+static void blockCounts(const unsigned char* in, int* counts)
+{
+    unpack128(in + 2 + 16 * in[0], in[1], (uint32_t*)counts);
+    for (int i = 0; i < POSTINGS_BLOCK; i++) {
+        counts[i]++;
+    }
+}
+
+// Decodes the counts of the dense-list count frame starting at in.
+static void frameCounts(const unsigned char* in, int* counts)
+{
+    unpack128(in + 1, in[0], (uint32_t*)counts);
+    for (int i = 0; i < POSTINGS_BLOCK; i++) {
+        counts[i]++;
+    }
+}
+
+// dst &= src over n 64-bit words, two words per SSE2 operation.
+static void andWords(uint64_t* dst, const uint64_t* src, const int n)
+{
+    int i = 0;
+#ifdef __SSE2__
+    for (; i + 2 <= n; i += 2) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_and_si128(a, b));
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] &= src[i];
+    }
+}
+
+// dst |= src over n 64-bit words, two words per SSE2 operation.
+static void orWords(uint64_t* dst, const uint64_t* src, const int n)
+{
+    int i = 0;
+#ifdef __SSE2__
+    for (; i + 2 <= n; i += 2) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(a, b));
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] |= src[i];
+    }
+}
+
+// Fills docs with up to want docIDs >= start from a dense list's bitmap;
+// returns how many it found.
+static int extractBits(postings_t* postings, const int start, const int want, int* docs)
+{
+    // binary search for the first chunk that can hold start
+    int lo = 0, hi = postings->nchunks;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (postings->chunks[mid].key < (start >> 16)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    int n = 0;
+    for (int c = lo; c < postings->nchunks && n < want; c++) {
+        const chunk_t* chunk = &postings->chunks[c];
+        const uint64_t* words = postings->bits + chunk->word;
+        int base = chunk->key << 16;
+        int w = 0;
+        uint64_t x = words[0];
+        if (chunk->key == (start >> 16)) {
+            w = (start & 0xFFFF) >> 6;
+            x = w < chunk->nwords ? words[w] & (~0ULL << (start & 63)) : 0;
+        }
+        while (w < chunk->nwords && n < want) {
+            while (x != 0 && n < want) {
+                docs[n++] = base + 64 * w + __builtin_ctzll(x);
+                x &= x - 1;
+            }
+            if (++w < chunk->nwords) {
+                x = words[w];
+            }
+        }
+    }
+    return n;
+}
+
+// Frees the compressed form (data, skips, chunks and bits) unless it is in
+// the arena; the caller replaces the pointers.
+static void freeBuffers(postings_t* postings)
+{
+    if (!postings->inArena) {
+        free(postings->data);
+        free(postings->skips);
+        free(postings->chunks);
+        free(postings->bits);
+    }
+    postings->inArena = false;
+}
+
+// Copies the compressed form, exactly sized, into the arena (toArena) or out
+// of it into malloc'd buffers, and frees the malloc'd originals. Returns
+// false, leaving the list as it was, if out of memory.
+static bool moveBuffers(postings_t* postings, const bool toArena)
+{
+    void* from[4] = { postings->data, postings->skips, postings->chunks, postings->bits };
+    size_t sizes[4] = { postings->len, sizeof(skip_t) * postings->nblocks,
+                        sizeof(chunk_t) * postings->nchunks, sizeof(uint64_t) * postings->nwords };
+    void* to[4] = { NULL, NULL, NULL, NULL };
+    bool ok = true;
+    for (int i = 0; ok && i < 4; i++) {
+        if (sizes[i] > 0) {
+            to[i] = toArena ? arena_alloc(postings->arena, sizes[i]) : malloc(sizes[i]);
+            if ((ok = to[i] != NULL)) {
+                memcpy(to[i], from[i], sizes[i]);
+            }
+        }
+    }
+    if (!ok) {
+        for (int i = 0; !toArena && i < 4; i++) {
+            free(to[i]);
+        }
+        return false;
+    }
+    freeBuffers(postings);
+    postings->data = to[0];
+    postings->skips = to[1];
+    postings->chunks = to[2];
+    postings->bits = to[3];
+    postings->cap = postings->len;
+    postings->skipcap = postings->nblocks;
+    postings->inArena = toArena;
+    return true;
+}
+
+// Makes room for extra more bytes of data.
+static bool reserveData(postings_t* postings, const size_t extra)
+{
+    if (postings->len + extra <= postings->cap) {
+        return true;
+    }
+    size_t cap = postings->cap == 0 ? 64 : postings->cap;
+    while (cap < postings->len + extra) {
+        cap *= 2;
+    }
+    unsigned char* data = realloc(postings->data, cap);
+    if (data == NULL) {
+        return false;
+    }
+    postings->data = data;
+    postings->cap = cap;
+    return true;
+}
+
+// Packs the (full) pending buffer into a new block.
+static bool packPending(postings_t* postings)
+{
+    if (postings->nblocks == postings->skipcap) {
+        int skipcap = postings->skipcap == 0 ? 4 : postings->skipcap * 2;
+        skip_t* skips = realloc(postings->skips, sizeof(skip_t) * skipcap);
+        if (skips == NULL) {
+            return false;
+        }
+        postings->skips = skips;
+        postings->skipcap = skipcap;
+    }
+
+    uint32_t gaps[POSTINGS_BLOCK];
+    uint32_t counts[POSTINGS_BLOCK];
+    uint32_t maxGap = 0, maxCount = 0;
+    int blockMax = 0;
+    int prev = postings->nblocks > 0 ? postings->skips[postings->nblocks - 1].lastDocID : 0;
+    for (int i = 0; i < POSTINGS_BLOCK; i++) {
+        gaps[i] = postings->pendDocs[i] - prev - 1;
+        counts[i] = postings->pendCounts[i] - 1;
+        prev = postings->pendDocs[i];
+        maxGap |= gaps[i];
+        maxCount |= counts[i];
+        blockMax = postings->pendCounts[i] > blockMax ? postings->pendCounts[i] : blockMax;
+    }
+    int dbits = bitsNeeded(maxGap);
+    int cbits = bitsNeeded(maxCount);
+    if (!reserveData(postings, 2 + 16 * (dbits + cbits))) {
+        return false;
+    }
+
+    unsigned char* out = postings->data + postings->len;
+    out[0] = (unsigned char)dbits;
+    out[1] = (unsigned char)cbits;
+    pack128(gaps, dbits, out + 2);
+    pack128(counts, cbits, out + 2 + 16 * dbits);
+
+    postings->skips[postings->nblocks].lastDocID = prev;
+    postings->skips[postings->nblocks].offset = (unsigned int)postings->len;
+    postings->skips[postings->nblocks].maxCount = blockMax;
+    postings->nblocks++;
+    postings->len += 2 + 16 * (dbits + cbits);
+    postings->npend = 0;
+    return true;
+}
+
+// Adds one entry to the pending buffer, packing a full buffer first.
+static bool pushPending(postings_t* postings, const int docID, const int count)
+{
+    if (postings->npend == POSTINGS_BLOCK && !packPending(postings)) {
+        return false;
+    }
+    if (postings->npend == postings->pendcap) {
+        int pendcap = postings->pendcap == 0 ? 4 : postings->pendcap * 2;
+        int* docs = realloc(postings->pendDocs, sizeof(int) * pendcap);
+        if (docs == NULL) {
+            return false;
+        }
+        postings->pendDocs = docs;
+        int* counts = realloc(postings->pendCounts, sizeof(int) * pendcap);
+        if (counts == NULL) {
+            return false;
+        }
+        postings->pendCounts = counts;
+        postings->pendcap = pendcap;
+    }
+    postings->pendDocs[postings->npend] = docID;
+    postings->pendCounts[postings->npend] = count;
+    postings->npend++;
+    return true;
+}
+
+static void putVbyte(unsigned char** out, uint32_t v)
+{
+    while (v >= 0x80) {
+        *(*out)++ = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    *(*out)++ = (unsigned char)v;
+}
+
+static uint32_t getVbyte(const unsigned char** in)
+{
+    uint32_t v = 0;
+    int shift = 0;
+    unsigned char byte;
+    do {
+        byte = *(*in)++;
+        v |= (uint32_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return v;
+}
+
+// Offset at which the vbyte tail starts (the end of the packed blocks).
+static size_t tailOffset(postings_t* postings)
+{
+    if (postings->ntail == 0) {
+        return postings->len;
+    }
+    const skip_t* last = postings->nblocks > 0 ? &postings->skips[postings->nblocks - 1] : NULL;
+    if (last == NULL) {
+        return 0;
+    }
+    const unsigned char* block = postings->data + last->offset;
+    return last->offset + 2 + 16 * (block[0] + block[1]);
+}
+
+static void loadBlock(postings_cursor_t* cursor, const int b);
+static void cursorCounts(postings_cursor_t* cursor);
+
+// Rewrites a finished packed list as a dense one (bitmap plus count frames).
+static bool toDense(postings_t* postings)
+{
+    int nframes = (postings->ndocs + POSTINGS_BLOCK - 1) / POSTINGS_BLOCK;
+    postings_cursor_t cursor;
+    size_t len = 0;
+    int nchunks = 0, nwords = 0, key = -1, prev = 0;
+
+    // first pass: size the count frames and the bitmap chunks
+    postings_open(&cursor, postings);
+    for (int b = 0; b < nframes; b++) {
+        cursorCounts(&cursor);
+        uint32_t maxCount = 0;
+        for (int i = 0; i < cursor.n; i++) {
+            maxCount |= cursor.counts[i] - 1;
+            if ((cursor.docs[i] >> 16) != key) {
+                if (key >= 0) {
+                    nwords += ((prev & 0xFFFF) >> 6) + 1;
+                }
+                key = cursor.docs[i] >> 16;
+                nchunks++;
+            }
+            prev = cursor.docs[i];
+        }
+        len += 1 + 16 * bitsNeeded(maxCount);
+        loadBlock(&cursor, b + 1);
+    }
+    nwords += ((prev & 0xFFFF) >> 6) + 1;
+
+    unsigned char* data = malloc(len);
+    skip_t* skips = malloc(sizeof(skip_t) * nframes);
+    chunk_t* chunks = malloc(sizeof(chunk_t) * nchunks);
+    uint64_t* bits = calloc(nwords, sizeof(uint64_t));
+    if (data == NULL || skips == NULL || chunks == NULL || bits == NULL) {
+        free(data);
+        free(skips);
+        free(chunks);
+        free(bits);
+        return false;
+    }
+
+    // second pass: fill them in
+    size_t offset = 0;
+    int c = -1;
+    unsigned int word = 0;
+    postings_open(&cursor, postings);
+    for (int b = 0; b < nframes; b++) {
+        cursorCounts(&cursor);
+        uint32_t counts[POSTINGS_BLOCK] = { 0 };
+        uint32_t maxCount = 0;
+        int frameMax = 0;
+        for (int i = 0; i < cursor.n; i++) {
+            int docID = cursor.docs[i];
+            counts[i] = cursor.counts[i] - 1;
+            maxCount |= counts[i];
+            frameMax = cursor.counts[i] > frameMax ? cursor.counts[i] : frameMax;
+            if (c < 0 || (docID >> 16) != chunks[c].key) {
+                if (c >= 0) {
+                    word += chunks[c].nwords;
+                }
+                c++;
+                chunks[c].key = docID >> 16;
+                chunks[c].word = word;
+            }
+            chunks[c].nwords = ((docID & 0xFFFF) >> 6) + 1;
+            bits[word + ((docID & 0xFFFF) >> 6)] |= 1ULL << (docID & 63);
+        }
+        int cbits = bitsNeeded(maxCount);
+        data[offset] = (unsigned char)cbits;
+        pack128(counts, cbits, data + offset + 1);
+        skips[b].lastDocID = cursor.docs[cursor.n - 1];
+        skips[b].offset = (unsigned int)offset;
+        skips[b].maxCount = frameMax;
+        offset += 1 + 16 * cbits;
+        loadBlock(&cursor, b + 1);
+    }
+
+    freeBuffers(postings);
+    postings->data = data;
+    postings->len = postings->cap = len;
+    postings->skips = skips;
+    postings->nblocks = postings->skipcap = nframes;
+    postings->ntail = 0;
+    postings->tailMax = 0;
+    postings->chunks = chunks;
+    postings->nchunks = nchunks;
+    postings->bits = bits;
+    postings->nwords = nwords;
+    return true;
+}
+
+// Rewrites a dense list in the packed form, with every entry pending.
+static bool toPacked(postings_t* postings)
+{
+    postings_t* packed = postings_new();
+    if (packed == NULL) {
+        return false;
+    }
+    postings_cursor_t cursor;
+    for (postings_open(&cursor, postings); postings_docID(&cursor) != POSTINGS_END;
+         postings_next(&cursor)) {
+        if (!postings_append(packed, postings_docID(&cursor), postings_count(&cursor))) {
+            postings_delete(packed);
+            return false;
+        }
+    }
+    freeBuffers(postings);
+    arena_t* arena = postings->arena;
+    *postings = *packed;
+    postings->arena = arena;
+    free(packed);
+    return true;
+}
+
+// Moves a finished list's tail back into the pending buffer so it can grow.
+// With needLast, also unpacks the final block if the tail is empty, so that
+// the last entry is always pending (postings_add may need to bump it).
+static bool reopen(postings_t* postings, const bool needLast)
+{
+    if (postings->chunks != NULL) {
+        return toPacked(postings);
+    }
+    if (postings->inArena && !moveBuffers(postings, false)) {
+        return false;
+    }
+    if (postings->ntail > 0) {
+        size_t start = tailOffset(postings);
+        const unsigned char* in = postings->data + start;
+        int prev = postings->nblocks > 0 ? postings->skips[postings->nblocks - 1].lastDocID : 0;
+        int ntail = postings->ntail;
+        postings->ntail = 0;
+        postings->len = start;
+        for (int i = 0; i < ntail; i++) {
+            int docID = prev + (int)getVbyte(&in) + 1;
+            int count = (int)getVbyte(&in) + 1;
+            if (!pushPending(postings, docID, count)) {
+                return false;
+            }
+            prev = docID;
+        }
+    } else if (needLast && postings->npend == 0 && postings->nblocks > 0) {
+        skip_t* last = &postings->skips[postings->nblocks - 1];
+        int docs[POSTINGS_BLOCK];
+        int counts[POSTINGS_BLOCK];
+        int base = postings->nblocks > 1 ? postings->skips[postings->nblocks - 2].lastDocID : 0;
+        blockDocs(postings->data + last->offset, base, docs);
+        blockCounts(postings->data + last->offset, counts);
+        postings->len = last->offset;
+        postings->nblocks--;
+        for (int i = 0; i < POSTINGS_BLOCK; i++) {
+            if (!pushPending(postings, docs[i], counts[i])) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// First block at or after from whose last docID is >= target, or nblocks
+// if there is none: gallops forward from 'from', then binary searches.
+static int skipSearch(postings_t* postings, int from, const int target)
+{
+    int hi = from;
+    int step = 1;
+    while (hi < postings->nblocks && postings->skips[hi].lastDocID < target) {
+        from = hi + 1;
+        hi += step;
+        step *= 2;
+    }
+    if (hi > postings->nblocks) {
+        hi = postings->nblocks;
+    }
+    while (from < hi) {
+        int mid = (from + hi) / 2;
+        if (postings->skips[mid].lastDocID < target) {
+            from = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return from;
+}
+
+// Fills the cursor's buffer with block b (or the tail, when b == nblocks).
+static void fillBlock(postings_cursor_t* cursor, const int b)
+{
+    postings_t* postings = cursor->postings;
+    cursor->block = b;
+    cursor->pos = 0;
+    if (postings->chunks != NULL) {
+        // dense list: docIDs come from the bitmap, counts from frame b
+        cursor->countsDecoded = false;
+        cursor->n = 0;
+        if (b < postings->nblocks) {
+            int start = b > 0 ? postings->skips[b - 1].lastDocID + 1 : 1;
+            int want = postings->ndocs - b * POSTINGS_BLOCK;
+            cursor->n = extractBits(postings, start, want < POSTINGS_BLOCK ? want : POSTINGS_BLOCK,
+                                    cursor->docs);
+        }
+        return;
+    }
+    if (b < postings->nblocks) {
+        int base = b > 0 ? postings->skips[b - 1].lastDocID : 0;
+        blockDocs(postings->data + postings->skips[b].offset, base, cursor->docs);
+        cursor->n = POSTINGS_BLOCK;
+        cursor->countsDecoded = false;
+        return;
+    }
+    if (postings->npend > 0) {
+        memcpy(cursor->docs, postings->pendDocs, sizeof(int) * postings->npend);
+        memcpy(cursor->counts, postings->pendCounts, sizeof(int) * postings->npend);
+        cursor->n = postings->npend;
+    } else {
+        const unsigned char* in = postings->data + tailOffset(postings);
+        int prev = postings->nblocks > 0 ? postings->skips[postings->nblocks - 1].lastDocID : 0;
+        for (int i = 0; i < postings->ntail; i++) {
+            prev += (int)getVbyte(&in) + 1;
+            cursor->docs[i] = prev;
+            cursor->counts[i] = (int)getVbyte(&in) + 1;
+        }
+        cursor->n = postings->ntail;
+    }
+    cursor->countsDecoded = true;
+}
+
+// Loads block b into the cursor's buffer; the last block of a cursor's range
+// keeps only the entries up to the range's last docID.
+static void loadBlock(postings_cursor_t* cursor, const int b)
+{
+    fillBlock(cursor, b);
+    cursor->blocksRead++;
+    cursor->entriesRead += cursor->n;
+    if (b >= cursor->lastBlock) {
+        while (cursor->n > 0 && cursor->docs[cursor->n - 1] > cursor->last) {
+            cursor->n--;
+        }
+    }
+}
+
+// Decodes the counts of the cursor's current block, if not done yet.
+static void cursorCounts(postings_cursor_t* cursor)
+{
+    if (!cursor->countsDecoded) {
+        postings_t* postings = cursor->postings;
+        const unsigned char* block = postings->data + postings->skips[cursor->block].offset;
+        if (postings->chunks != NULL) {
+            frameCounts(block, cursor->counts);
+        } else {
+            blockCounts(block, cursor->counts);
+        }
+        cursor->countsDecoded = true;
+    }
+}
+
+/**************** global functions ****************/
+
+postings_t* postings_new(void)
+{
+    return postings_newInArena(NULL);
+}
+
+postings_t* postings_newInArena(arena_t* arena)
+{
+    postings_t* postings = arena != NULL ? arena_alloc(arena, sizeof(postings_t))
+                                         : calloc(1, sizeof(postings_t));
+    if (postings != NULL) {
+        postings->arena = arena;
+    }
+    return postings;
+}
+
+int postings_add(postings_t* postings, const int docID)
+{
+    if (postings == NULL || docID < 1 || docID < postings->lastDocID) {
+        return 0;
+    }
+    if (!reopen(postings, true)) {
+        return 0;
+    }
+    if (postings->ndocs > 0 && docID == postings->lastDocID) {
+        int count = ++postings->pendCounts[postings->npend - 1];
+        postings->maxCount = count > postings->maxCount ? count : postings->maxCount;
+        return count;
+    }
+    if (!pushPending(postings, docID, 1)) {
+        return 0;
+    }
+    postings->ndocs++;
+    postings->lastDocID = docID;
+    postings->maxCount = postings->maxCount > 1 ? postings->maxCount : 1;
+    return 1;
+}
+
+bool postings_append(postings_t* postings, const int docID, const int count)
+{
+    if (postings == NULL || docID <= postings->lastDocID || count < 1) {
+        return false;
+    }
+    if (!reopen(postings, false) || !pushPending(postings, docID, count)) {
+        return false;
+    }
+    postings->ndocs++;
+    postings->lastDocID = docID;
+    postings->maxCount = count > postings->maxCount ? count : postings->maxCount;
+    return true;
+}
+
+void postings_finish(postings_t* postings)
+{
+    if (postings == NULL || postings->chunks != NULL) {
+        return;
+    }
+    if (postings->npend == 0) {
+        // nothing pending
+    } else if (postings->npend == POSTINGS_BLOCK) {
+        packPending(postings);
+    } else if (reserveData(postings, (size_t)postings->npend * 10)) {
+        // the partial block: vbyte gaps and counts
+        unsigned char* out = postings->data + postings->len;
+        int prev = postings->nblocks > 0 ? postings->skips[postings->nblocks - 1].lastDocID : 0;
+        postings->tailMax = 0;
+        for (int i = 0; i < postings->npend; i++) {
+            putVbyte(&out, postings->pendDocs[i] - prev - 1);
+            putVbyte(&out, postings->pendCounts[i] - 1);
+            prev = postings->pendDocs[i];
+            if (postings->pendCounts[i] > postings->tailMax) {
+                postings->tailMax = postings->pendCounts[i];
+            }
+        }
+        postings->len = out - postings->data;
+        postings->ntail = postings->npend;
+        postings->npend = 0;
+    }
+    if (postings->npend > 0) {
+        return;  // out of memory; keep the pending buffer
+    }
+
+    // release the build-time slack
+    free(postings->pendDocs);
+    free(postings->pendCounts);
+    postings->pendDocs = postings->pendCounts = NULL;
+    postings->pendcap = 0;
+    if (postings->len > 0 && postings->len < postings->cap) {
+        unsigned char* data = realloc(postings->data, postings->len);
+        if (data != NULL) {
+            postings->data = data;
+            postings->cap = postings->len;
+        }
+    }
+    if (postings->nblocks > 0 && postings->nblocks < postings->skipcap) {
+        skip_t* skips = realloc(postings->skips, sizeof(skip_t) * postings->nblocks);
+        if (skips != NULL) {
+            postings->skips = skips;
+            postings->skipcap = postings->nblocks;
+        }
+    }
+
+    // switch to a bitmap if the list covers enough of its docID range
+    if (postings->ndocs >= POSTINGS_BLOCK
+        && (long)postings->ndocs * POSTINGS_DENSE >= postings->lastDocID) {
+        toDense(postings);
+    }
+    if (postings->arena != NULL && !postings->inArena) {
+        moveBuffers(postings, true);  // out of memory: the list stays malloc'd
+    }
+}
+
+int postings_get(postings_t* postings, const int docID)
+{
+    if (postings == NULL || docID < 1 || docID > postings->lastDocID) {
+        return 0;
+    }
+    postings_cursor_t cursor;
+    postings_open(&cursor, postings);
+    if (postings_advanceTo(&cursor, docID) != docID) {
+        return 0;
+    }
+    return postings_count(&cursor);
+}
+
+int postings_size(postings_t* postings)
+{
+    return postings == NULL ? 0 : postings->ndocs;
+}
+
+size_t postings_bytes(postings_t* postings)
+{
+    if (postings == NULL) {
+        return 0;
+    }
+    return sizeof(postings_t) + postings->cap + sizeof(skip_t) * postings->skipcap
+           + 2 * sizeof(int) * postings->pendcap + sizeof(chunk_t) * postings->nchunks
+           + sizeof(uint64_t) * postings->nwords;
+}
+
+void postings_iterate(postings_t* postings, void* arg,
+                      void (*itemfunc)(void* arg, const int key, const int count))
+{
+    if (postings == NULL || itemfunc == NULL) {
+        return;
+    }
+    postings_cursor_t cursor;
+    for (postings_open(&cursor, postings); postings_docID(&cursor) != POSTINGS_END;
+         postings_next(&cursor)) {
+        (*itemfunc)(arg, postings_docID(&cursor), postings_count(&cursor));
+    }
+}
+
+int postings_maxCount(postings_t* postings)
+{
+    return postings != NULL ? postings->maxCount : 0;
+}
+
+int postings_shallowMax(postings_cursor_t* cursor, const int target, int* last)
+{
+    postings_t* postings = cursor->postings;
+    if (postings == NULL || target > postings->lastDocID) {
+        *last = POSTINGS_END - 1;
+        return 0;
+    }
+    int b = cursor->block;
+    if (b < postings->nblocks && postings->skips[b].lastDocID < target) {
+        b = skipSearch(postings, b + 1, target);
+    }
+    if (b < postings->nblocks) {
+        *last = postings->skips[b].lastDocID;
+        return postings->skips[b].maxCount;
+    }
+    *last = postings->lastDocID;
+    return postings->npend > 0 ? postings->maxCount : postings->tailMax;
+}
+
+bool postings_isDense(postings_t* postings)
+{
+    return postings != NULL && postings->chunks != NULL;
+}
+
+void postings_bitmapAnd(postings_t* postings, uint64_t* words, const int nwords)
+{
+    if (postings == NULL || words == NULL) {
+        return;
+    }
+    if (postings->chunks == NULL) {
+        // packed list: keep only the set bits that the list contains
+        postings_cursor_t cursor;
+        postings_open(&cursor, postings);
+        for (int w = 0; w < nwords; w++) {
+            for (uint64_t x = words[w]; x != 0; x &= x - 1) {
+                int docID = 64 * w + __builtin_ctzll(x);
+                if (postings_advanceTo(&cursor, docID) != docID) {
+                    words[w] &= ~(1ULL << (docID & 63));
+                }
+            }
+        }
+        return;
+    }
+    int next = 0;  // first word not yet combined
+    for (int c = 0; c < postings->nchunks; c++) {
+        const chunk_t* chunk = &postings->chunks[c];
+        int first = chunk->key << 10;
+        if (first >= nwords) {
+            break;
+        }
+        memset(words + next, 0, sizeof(uint64_t) * (first - next));
+        int n = nwords - first < chunk->nwords ? nwords - first : chunk->nwords;
+        andWords(words + first, postings->bits + chunk->word, n);
+        next = first + n;
+    }
+    memset(words + next, 0, sizeof(uint64_t) * (nwords - next));
+}
+
+void postings_bitmapOr(postings_t* postings, uint64_t* words, const int nwords)
+{
+    if (postings == NULL || words == NULL) {
+        return;
+    }
+    if (postings->chunks == NULL) {
+        postings_cursor_t cursor;
+        for (postings_open(&cursor, postings); postings_docID(&cursor) < 64 * nwords;
+             postings_next(&cursor)) {
+            int docID = postings_docID(&cursor);
+            words[docID >> 6] |= 1ULL << (docID & 63);
+        }
+        return;
+    }
+    for (int c = 0; c < postings->nchunks; c++) {
+        const chunk_t* chunk = &postings->chunks[c];
+        int first = chunk->key << 10;
+        if (first >= nwords) {
+            break;
+        }
+        int n = nwords - first < chunk->nwords ? nwords - first : chunk->nwords;
+        orWords(words + first, postings->bits + chunk->word, n);
+    }
+}
+
+void postings_open(postings_cursor_t* cursor, postings_t* postings)
+{
+    cursor->postings = postings;
+    cursor->pos = cursor->n = 0;
+    cursor->blocksRead = cursor->entriesRead = 0;
+    cursor->last = POSTINGS_END - 1;
+    if (postings == NULL) {
+        cursor->block = cursor->lastBlock = 0;
+        return;
+    }
+    cursor->lastBlock = postings->nblocks;
+    loadBlock(cursor, 0);
+}
+
+void postings_openRange(postings_cursor_t* cursor, postings_t* postings, const int first,
+                        const int last)
+{
+    cursor->postings = postings;
+    cursor->pos = cursor->n = 0;
+    cursor->blocksRead = cursor->entriesRead = 0;
+    cursor->last = last;
+    if (postings == NULL || first > last || first > postings->lastDocID) {
+        cursor->block = cursor->lastBlock = 0;
+        return;
+    }
+    cursor->lastBlock = skipSearch(postings, 0, last);
+    loadBlock(cursor, skipSearch(postings, 0, first));
+    postings_advanceTo(cursor, first);
+}
+
+int postings_lastDocID(postings_t* postings)
+{
+    return postings != NULL ? postings->lastDocID : 0;
+}
+
+void postings_reads(postings_cursor_t* cursor, int* blocks, int* entries)
+{
+    *blocks = cursor->blocksRead;
+    *entries = cursor->entriesRead;
+}
+
+int postings_docID(postings_cursor_t* cursor)
+{
+    return cursor->pos < cursor->n ? cursor->docs[cursor->pos] : POSTINGS_END;
+}
+
+int postings_count(postings_cursor_t* cursor)
+{
+    if (cursor->pos >= cursor->n) {
+        return 0;
+    }
+    cursorCounts(cursor);
+    return cursor->counts[cursor->pos];
+}
+
+int postings_next(postings_cursor_t* cursor)
+{
+    if (cursor->pos >= cursor->n) {
+        return POSTINGS_END;
+    }
+    if (++cursor->pos == cursor->n && cursor->block < cursor->lastBlock) {
+        loadBlock(cursor, cursor->block + 1);
+    }
+    return postings_docID(cursor);
+}
+
+int postings_advanceTo(postings_cursor_t* cursor, const int target)
+{
+    while (cursor->pos < cursor->n) {
+        if (cursor->docs[cursor->n - 1] >= target) {
+            // target is in this buffer: binary search the rest of it
+            int lo = cursor->pos, hi = cursor->n - 1;
+            while (lo < hi) {
+                int mid = (lo + hi) / 2;
+                if (cursor->docs[mid] < target) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            cursor->pos = lo;
+            return cursor->docs[lo];
+        }
+        if (cursor->block >= cursor->lastBlock) {
+            cursor->pos = cursor->n;  // past the tail, or the end of the range
+            break;
+        }
+        int b = skipSearch(cursor->postings, cursor->block + 1, target);
+        loadBlock(cursor, b < cursor->lastBlock ? b : cursor->lastBlock);
+    }
+    return POSTINGS_END;
+}
+
+bool postings_save(postings_t* postings, FILE* fp)
+{
+    if (postings == NULL || fp == NULL) {
+        return false;
+    }
+    postings_finish(postings);
+    if (postings->npend > 0) {
+        return false;
+    }
+    int header[9] = { postings->ndocs, postings->lastDocID, postings->nblocks,
+                      postings->ntail, (int)postings->len, postings->nchunks, postings->nwords,
+                      postings->maxCount, postings->tailMax };
+    return fwrite(header, sizeof(int), 9, fp) == 9
+        && (postings->nblocks == 0
+            || fwrite(postings->skips, sizeof(skip_t), postings->nblocks, fp) == (size_t)postings->nblocks)
+        && (postings->len == 0 || fwrite(postings->data, 1, postings->len, fp) == postings->len)
+        && (postings->nchunks == 0
+            || fwrite(postings->chunks, sizeof(chunk_t), postings->nchunks, fp) == (size_t)postings->nchunks)
+        && (postings->nwords == 0
+            || fwrite(postings->bits, sizeof(uint64_t), postings->nwords, fp) == (size_t)postings->nwords);
+}
+
+postings_t* postings_load(FILE* fp)
+{
+    return postings_loadInArena(fp, NULL);
+}
+
+// Returns true if every block (or dense frame) the skip table points at,
+// and the vbyte tail, lie within data, with widths of at most 32 bits; if
+// the docIDs of the skip table and of the tail increase and end at
+// lastDocID; and if no count exceeds its block's maxCount, nor that the
+// list's. So a list loaded from a corrupt or truncated file is never
+// decoded past its end, and advanceTo and the WAND bounds can trust it.
+static bool validData(postings_t* postings)
+{
+    const unsigned char* data = postings->data;
+    size_t len = postings->len;
+    bool dense = postings->nchunks > 0;
+    size_t end = 0;
+    long long prev = 0;  // the largest docID so far
+    uint32_t values[POSTINGS_BLOCK];
+    for (int b = 0; b < postings->nblocks; b++) {
+        const skip_t* skip = &postings->skips[b];
+        size_t offset = skip->offset;
+        size_t header = dense ? 1 : 2;
+        if (skip->lastDocID <= prev || skip->maxCount < 1 || skip->maxCount > postings->maxCount
+            || offset + header > len || data[offset] > 32 || (!dense && data[offset + 1] > 32)) {
+            return false;
+        }
+        end = offset + header + 16 * (data[offset] + (dense ? 0 : data[offset + 1]));
+        if (end > len) {
+            return false;
+        }
+        if (!dense) {
+            // the gaps must lead to the block's lastDocID
+            unpack128(data + offset + 2, data[offset], values);
+            for (int i = 0; i < POSTINGS_BLOCK; i++) {
+                prev += (long long)values[i] + 1;
+            }
+            if (prev != skip->lastDocID) {
+                return false;
+            }
+        }
+        prev = skip->lastDocID;
+        unpack128(data + end - 16 * data[offset + (dense ? 0 : 1)],
+                  data[offset + (dense ? 0 : 1)], values);
+        for (int i = 0; i < POSTINGS_BLOCK; i++) {
+            if ((long long)values[i] + 1 > skip->maxCount) {
+                return false;
+            }
+        }
+    }
+    // the tail: ntail pairs of variable-byte numbers of at most 5 bytes each
+    for (int i = 0; i < 2 * postings->ntail; i++) {
+        long long value = 0;
+        int bytes = 0;
+        do {
+            if (end >= len || ++bytes > 5) {
+                return false;
+            }
+            value |= (long long)(data[end] & 0x7F) << (7 * (bytes - 1));
+        } while (data[end++] & 0x80);
+        if (i % 2 == 0) {
+            prev += value + 1;
+        } else if (value + 1 > postings->tailMax) {
+            return false;
+        }
+    }
+    return prev == postings->lastDocID && postings->tailMax <= postings->maxCount;
+}
+
+// Allocates size bytes from arena, or with malloc if arena is NULL.
+static void* allocate(arena_t* arena, const size_t size)
+{
+    return arena != NULL ? arena_alloc(arena, size) : malloc(size);
+}
+
+postings_t* postings_loadInArena(FILE* fp, arena_t* arena)
+{
+    int header[9];
+    if (fp == NULL || fread(header, sizeof(int), 9, fp) != 9) {
+        return NULL;
+    }
+    int ndocs = header[0], lastDocID = header[1], nblocks = header[2], ntail = header[3];
+    int len = header[4], nchunks = header[5], nwords = header[6];
+    if (nblocks < 0 || ntail < 0 || ntail >= POSTINGS_BLOCK || len < 0 || nchunks < 0
+        || nwords < 0 || (nchunks > 0) != (nwords > 0)) {
+        return NULL;
+    }
+    if (nchunks == 0 ? ndocs != (long long)nblocks * POSTINGS_BLOCK + ntail
+                     : (ntail != 0 || nblocks != (ndocs + POSTINGS_BLOCK - 1) / POSTINGS_BLOCK)) {
+        return NULL;
+    }
+
+    postings_t* postings = postings_newInArena(arena);
+    if (postings == NULL) {
+        return NULL;
+    }
+    postings->inArena = arena != NULL;
+    postings->skips = nblocks > 0 ? allocate(arena, sizeof(skip_t) * nblocks) : NULL;
+    postings->data = len > 0 ? allocate(arena, len) : NULL;
+    postings->nblocks = postings->skipcap = nblocks;
+    postings->len = postings->cap = len;
+    postings->ndocs = ndocs;
+    postings->lastDocID = lastDocID;
+    postings->ntail = ntail;
+    postings->maxCount = header[7];
+    postings->tailMax = header[8];
+    postings->chunks = nchunks > 0 ? allocate(arena, sizeof(chunk_t) * nchunks) : NULL;
+    postings->bits = nwords > 0 ? allocate(arena, sizeof(uint64_t) * nwords) : NULL;
+    postings->nchunks = nchunks;
+    postings->nwords = nwords;
+    if ((nblocks > 0 && postings->skips == NULL) || (len > 0 && postings->data == NULL)
+        || (nchunks > 0 && (postings->chunks == NULL || postings->bits == NULL))
+        || (nblocks > 0 && fread(postings->skips, sizeof(skip_t), nblocks, fp) != (size_t)nblocks)
+        || (len > 0 && fread(postings->data, 1, len, fp) != (size_t)len)
+        || (nchunks > 0 && fread(postings->chunks, sizeof(chunk_t), nchunks, fp) != (size_t)nchunks)
+        || (nwords > 0 && fread(postings->bits, sizeof(uint64_t), nwords, fp) != (size_t)nwords)) {
+        postings_delete(postings);
+        return NULL;
+    }
+    if (!validData(postings)) {
+        postings_delete(postings);
+        return NULL;
+    }
+    // chunks in increasing order, each within the list's docIDs and the bitmap
+    for (int c = 0; c < nchunks; c++) {
+        const chunk_t* chunk = &postings->chunks[c];
+        if (chunk->key < (c > 0 ? postings->chunks[c - 1].key + 1 : 0)
+            || chunk->key > lastDocID >> 16 || chunk->nwords < 1 || chunk->nwords > 1024
+            || (long long)chunk->word + chunk->nwords > nwords) {
+            postings_delete(postings);
+            return NULL;
+        }
+    }
+    return postings;
+}
+
+void postings_delete(postings_t* postings)
+{
+    if (postings != NULL) {
+        freeBuffers(postings);
+        free(postings->pendDocs);
+        free(postings->pendCounts);
+        if (postings->arena == NULL) {
+            free(postings);
+        }
+    }
+}
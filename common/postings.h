@@ -0,0 +1,287 @@
+/*
+ * postings.h - header file for the 'postings' module
+ *
+ * A postings list records, for one word, the documents it occurs in and how
+ * many times it occurs in each one: a list of (docID, count) pairs kept in
+ * increasing docID order.
+ *
+ * Postings are stored compressed, in the same form in memory and on disk.
+ * Entries are grouped into blocks of POSTINGS_BLOCK documents; each full block
+ * stores its docID gaps and its counts bit-packed at the smallest width that
+ * fits the block, in a 4-lane interleaved layout that the decoder unpacks with
+ * SSE2 when the compiler provides it (and a portable loop otherwise). A final
+ * partial block is stored as variable-byte gaps and counts. A skip table holds
+ * the largest docID and the byte offset of every full block, so that lookups
+ * only decode the one block that can hold a given docID.
+ *
+ * Every list also records its largest count, and every block (in its skip
+ * table entry) the largest count within the block. These are upper bounds
+ * on any score a document can get from the word, which lets top-k query
+ * evaluation skip documents that cannot make the cut; see
+ * postings_maxCount() and postings_shallowMax().
+ *
+ * Lists that hold a large share of their docID range (at least one document
+ * in POSTINGS_DENSE, like "the" or "and") are switched to a dense form when
+ * finished: a Roaring-style chunked bitmap of docIDs with the counts in a
+ * bit-packed side array. Cursors read both forms the same way, and dense
+ * lists can be combined a whole bitmap word at a time with
+ * postings_bitmapAnd() and postings_bitmapOr().
+ *
+ * While an index is being built, the newest entries sit in a small pending
+ * buffer until a block fills; postings_finish() packs whatever remains.
+ *
+ * A list made with postings_newInArena() or postings_loadInArena() lives in
+ * an arena (see libcs50/arena.h): its header at once, and its compressed
+ * form once finished (or loaded), when it no longer changes size. Such a
+ * list is freed with the arena, not by postings_delete(), which only frees
+ * whatever it holds outside the arena. Adding to it again first copies
+ * the compressed form back out of the arena.
+ *
+ * A postings cursor walks one list in docID order. Besides stepping to the
+ * next entry, it can jump to the first entry at or after a given docID; the
+ * jump searches the skip table (galloping, then binary search) and decodes
+ * only the block it lands in, so intersecting a short list with a long one
+ * touches a number of long-list blocks proportional to the short list.
+ * A cursor can also be opened on a range of docIDs (postings_openRange): it
+ * starts at the range's first entry and reports POSTINGS_END past its last,
+ * never loading a block beyond the range, so that several threads can walk
+ * disjoint parts of one list.
+ *
+ * Compilation requires: libcs50 (arena.h); SSE2 is optional.
+ */
+
+#ifndef __POSTINGS_H
+#define __POSTINGS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <stdint.h>
+#include "../libcs50/arena.h"
+
+/*
+ * Global variables
+ */
+#define POSTINGS_BLOCK 128  // documents per bit-packed block
+#define POSTINGS_END INT_MAX  // docID reported by a cursor past the last entry
+#define POSTINGS_DENSE 4  // lists with at least 1 docID in 4 of their range become bitmaps
+
+/*
+ * Struct definitions
+ */
+typedef struct postings postings_t;  // opaque to users of the module
+
+/*
+ * A cursor over one postings list. Declare it anywhere (no allocation is
+ * involved) and set it up with postings_open(); its fields are private to
+ * the module. The list must not change while a cursor is open on it.
+ */
+typedef struct postings_cursor {
+    postings_t* postings;         // list being walked
+    int block;                    // block in the buffer; the tail counts as the last block
+    int lastBlock;                // last block the cursor may load
+    int last;                     // largest docID the cursor reports
+    int pos;                      // position of the current entry in the buffer
+    int n;                        // entries in the buffer
+    bool countsDecoded;           // whether counts[] holds this block's counts
+    int blocksRead;               // blocks loaded since the cursor was opened
+    int entriesRead;              // entries in them
+    int docs[POSTINGS_BLOCK];     // decoded docIDs of the current block
+    int counts[POSTINGS_BLOCK];   // decoded counts of the current block
+} postings_cursor_t;
+
+/*
+ * postings_new - creates a new, empty postings list.
+ *
+ * Returns:
+ *   - A pointer to the new postings list, or NULL if out of memory.
+ * The caller is responsible for later calling postings_delete().
+ */
+postings_t* postings_new(void);
+
+/*
+ * postings_newInArena - creates a new, empty postings list in arena (or
+ * with malloc, like postings_new, if arena is NULL); see above.
+ *
+ * Returns:
+ *   - A pointer to the new postings list, or NULL if out of memory.
+ * The arena must outlive the list.
+ */
+postings_t* postings_newInArena(arena_t* arena);
+
+/*
+ * postings_add - counts one more occurrence in document docID.
+ *
+ * DocIDs must arrive in nondecreasing order, as they do when pages are
+ * indexed one after another: a docID equal to the last one added bumps its
+ * count, a larger docID starts a new entry with a count of 1.
+ *
+ * Returns the new count for docID, or 0 on error (NULL list, docID < 1,
+ * docID smaller than the last one added, or out of memory).
+ */
+int postings_add(postings_t* postings, const int docID);
+
+/*
+ * postings_append - appends a new (docID, count) entry.
+ *
+ * docID must be larger than every docID already in the list and count must
+ * be positive. Used when loading an index whose counts are already known.
+ *
+ * Returns true on success, false on error.
+ */
+bool postings_append(postings_t* postings, const int docID, const int count);
+
+/*
+ * postings_finish - packs any pending entries into their compressed form.
+ *
+ * Call once a list is complete; it releases the pending buffer, and switches
+ * the list to the dense form if it is at least POSTINGS_BLOCK documents long
+ * and dense enough. Adding to a finished list is still allowed and simply
+ * reopens its last partial block (or unpacks a dense list).
+ */
+void postings_finish(postings_t* postings);
+
+/*
+ * postings_get - returns the count for docID, or 0 if docID is not present
+ * (or the list is NULL). Uses the skip table to decode at most one block.
+ */
+int postings_get(postings_t* postings, const int docID);
+
+/*
+ * postings_size - returns the number of documents in the list (the word's
+ * document frequency), or 0 for a NULL list.
+ */
+int postings_size(postings_t* postings);
+
+/*
+ * postings_bytes - returns the number of bytes of memory held by the list,
+ * including its header; useful when reporting index size.
+ */
+size_t postings_bytes(postings_t* postings);
+
+/*
+ * postings_iterate - calls itemfunc(arg, docID, count) for every entry,
+ * in increasing docID order. Does nothing if postings or itemfunc is NULL.
+ */
+void postings_iterate(postings_t* postings, void* arg,
+                      void (*itemfunc)(void* arg, const int key, const int count));
+
+/*
+ * postings_maxCount - returns the largest count in the list, or 0 for a
+ * NULL or empty list.
+ */
+int postings_maxCount(postings_t* postings);
+
+/*
+ * postings_shallowMax - returns an upper bound on the count of target in
+ * the cursor's list: the largest count of the block that would hold target
+ * (0 if target is past the end of the list). The bound holds for every
+ * docID from target through *last, which is set to the last docID of that
+ * block (POSTINGS_END - 1 past the end). Only the skip table is searched;
+ * the cursor does not move and nothing is decoded. target should not be
+ * behind the cursor's current block.
+ */
+int postings_shallowMax(postings_cursor_t* cursor, const int target, int* last);
+
+/*
+ * postings_isDense - returns true if the list is held as a bitmap.
+ */
+bool postings_isDense(postings_t* postings);
+
+/*
+ * postings_bitmapAnd - intersects a flat bitmap with the list.
+ *
+ * words[] is a caller-owned bitmap of docIDs 0 .. 64*nwords-1 (bit d%64 of
+ * words[d/64] stands for docID d). Bits for docIDs not in the list are
+ * cleared. For dense lists this runs over whole words with SSE2; packed
+ * lists are probed with a cursor, one set bit at a time.
+ */
+void postings_bitmapAnd(postings_t* postings, uint64_t* words, const int nwords);
+
+/*
+ * postings_bitmapOr - sets the bits of every docID in the list (below
+ * 64*nwords) in the flat bitmap words[]; whole words at a time for dense
+ * lists.
+ */
+void postings_bitmapOr(postings_t* postings, uint64_t* words, const int nwords);
+
+/*
+ * postings_open - positions cursor on the first entry of postings.
+ * A NULL or empty list gives a cursor that is already at POSTINGS_END.
+ */
+void postings_open(postings_cursor_t* cursor, postings_t* postings);
+
+/*
+ * postings_openRange - positions cursor on the first entry of postings
+ * whose docID is >= first, and makes it stop (report POSTINGS_END) after
+ * the last entry whose docID is <= last. Only the skip table is searched to
+ * find the blocks at either end. An empty range gives a cursor that is
+ * already at POSTINGS_END.
+ */
+void postings_openRange(postings_cursor_t* cursor, postings_t* postings, const int first,
+                        const int last);
+
+/*
+ * postings_lastDocID - returns the largest docID in the list, or 0 for a
+ * NULL or empty list.
+ */
+int postings_lastDocID(postings_t* postings);
+
+/*
+ * postings_reads - stores in *blocks the number of blocks (the tail counts
+ * as one) the cursor has decoded since it was opened, and in *entries the
+ * number of entries they held; a block decoded twice counts twice.
+ */
+void postings_reads(postings_cursor_t* cursor, int* blocks, int* entries);
+
+/*
+ * postings_docID - returns the cursor's current docID, or POSTINGS_END
+ * once the cursor has moved past the last entry.
+ */
+int postings_docID(postings_cursor_t* cursor);
+
+/*
+ * postings_count - returns the count of the cursor's current entry, or 0 at
+ * POSTINGS_END. Counts are decoded only for blocks where this is called.
+ */
+int postings_count(postings_cursor_t* cursor);
+
+/*
+ * postings_next - moves the cursor to the next entry and returns its docID,
+ * or POSTINGS_END if there is none.
+ */
+int postings_next(postings_cursor_t* cursor);
+
+/*
+ * postings_advanceTo - moves the cursor forward to the first entry whose
+ * docID is >= target and returns that docID (POSTINGS_END if none).
+ * The cursor never moves backward: if it is already at or past target it
+ * stays where it is.
+ */
+int postings_advanceTo(postings_cursor_t* cursor, const int target);
+
+/*
+ * postings_save - writes the compressed list to an open binary file.
+ * Finishes the list first. Returns true on success.
+ */
+bool postings_save(postings_t* postings, FILE* fp);
+
+/*
+ * postings_load - reads one list written by postings_save() from fp.
+ * Returns the new list, or NULL on a read error or malformed input.
+ */
+postings_t* postings_load(FILE* fp);
+
+/*
+ * postings_loadInArena - postings_load, with the list in arena (or with
+ * malloc if arena is NULL).
+ */
+postings_t* postings_loadInArena(FILE* fp, arena_t* arena);
+
+/*
+ * postings_delete - frees the list and everything it holds; ignores NULL.
+ * Of a list in an arena, frees only what it holds outside the arena.
+ */
+void postings_delete(postings_t* postings);
+
+#endif // __POSTINGS_H
@@ -0,0 +1,204 @@
+/*
+ * protocol.c - CS50 'protocol' module
+ *
+ * see protocol.h for more information.
+ *
+ * Messages go out with writev, so a length and its payload normally leave
+ * in one segment; reads and writes are retried until complete or until the
+ * peer goes away (EINTR is retried, anything else is an error).
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "protocol.h"
+
+/**************** local functions ****************/
+
+// Fills a TCP address from "localhost:port" or "127.0.0.1:port".
+// Returns false if address is not of that form.
+static bool tcpAddress(const char* address, struct sockaddr_in* in)
+{
+    const char* colon = strrchr(address, ':');
+    if (colon == NULL) {
+        return false;
+    }
+    size_t hostLength = colon - address;
+    if (!(hostLength == 9 && strncmp(address, "localhost", 9) == 0)
+        && !(hostLength == 9 && strncmp(address, "127.0.0.1", 9) == 0)) {
+        return false;
+    }
+    int port;
+    char excess;
+    if (sscanf(colon + 1, "%d%c", &port, &excess) != 1 || port < 1 || port > 65535) {
+        return false;
+    }
+    memset(in, 0, sizeof(*in));
+    in->sin_family = AF_INET;
+    in->sin_port = htons(port);
+    in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return true;
+}
+
+// Fills a Unix domain address from a path. Returns false if it is too long.
+static bool unixAddress(const char* address, struct sockaddr_un* un)
+{
+    if (strlen(address) >= sizeof(un->sun_path)) {
+        return false;
+    }
+    memset(un, 0, sizeof(*un));
+    un->sun_family = AF_UNIX;
+    strcpy(un->sun_path, address);
+    return true;
+}
+
+// Opens a socket for address and either binds and listens on it or connects
+// it. Returns the descriptor, or -1.
+static int openSocket(const char* address, const bool listening)
+{
+    struct sockaddr_in in;
+    struct sockaddr_un un;
+    bool tcp = strchr(address, '/') == NULL && tcpAddress(address, &in);
+    if (!tcp && !unixAddress(address, &un)) {
+        errno = EINVAL;
+        return -1;
+    }
+    struct sockaddr* sa = tcp ? (struct sockaddr*)&in : (struct sockaddr*)&un;
+    socklen_t salen = tcp ? sizeof(in) : sizeof(un);
+
+    int fd = socket(tcp ? AF_INET : AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int one = 1;
+    if (tcp) {
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    bool ok;
+    if (listening) {
+        struct stat st;
+        if (tcp) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        } else if (stat(address, &st) == 0 && S_ISSOCK(st.st_mode)) {
+            unlink(address);
+        }
+        ok = bind(fd, sa, salen) == 0 && listen(fd, SOMAXCONN) == 0;
+    } else {
+        ok = connect(fd, sa, salen) == 0;
+    }
+    if (!ok) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    return fd;
+}
+
+// Reads exactly len bytes. Returns false at end of stream or on error.
+static bool readFully(int fd, void* buf, size_t len)
+{
+    unsigned char* p = buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Writes all the pieces in iov[0..n-1]. Returns false on error.
+static bool writeFully(int fd, struct iovec* iov, int n)
+{
+    while (n > 0) {
+        ssize_t written = writev(fd, iov, n);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written < 0) {
+            return false;
+        }
+        while (n > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            n--;
+        }
+        if (n > 0) {
+            iov->iov_base = (char*)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+    return true;
+}
+
+/**************** global functions ****************/
+
+int protocol_listen(const char* address)
+{
+    return address != NULL ? openSocket(address, true) : -1;
+}
+
+int protocol_connect(const char* address)
+{
+    return address != NULL ? openSocket(address, false) : -1;
+}
+
+bool protocol_send(int fd, const void* buf, const size_t len)
+{
+    if (len > UINT32_MAX || (buf == NULL && len > 0)) {
+        return false;
+    }
+    uint32_t header = htonl((uint32_t)len);
+    struct iovec iov[2] = { { &header, sizeof(header) }, { (void*)buf, len } };
+    return writeFully(fd, iov, len > 0 ? 2 : 1);
+}
+
+bool protocol_sendReply(int fd, const char status, const char* text, const size_t len)
+{
+    if (len >= UINT32_MAX || (text == NULL && len > 0)) {
+        return false;
+    }
+    uint32_t header = htonl((uint32_t)len + 1);
+    char code = status;
+    struct iovec iov[3] = { { &header, sizeof(header) }, { &code, 1 }, { (void*)text, len } };
+    return writeFully(fd, iov, len > 0 ? 3 : 2);
+}
+
+char* protocol_recv(int fd, const size_t max, size_t* len)
+{
+    uint32_t header;
+    if (len == NULL || !readFully(fd, &header, sizeof(header))) {
+        return NULL;
+    }
+    size_t length = ntohl(header);
+    if (length > max) {
+        return NULL;
+    }
+    char* buf = malloc(length + 1);
+    if (buf == NULL || !readFully(fd, buf, length)) {
+        free(buf);
+        return NULL;
+    }
+    buf[length] = '\0';
+    *len = length;
+    return buf;
+}
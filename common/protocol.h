@@ -0,0 +1,84 @@
+/*
+ * protocol.h - header file for the 'protocol' module
+ *
+ * The query server and its client talk over a stream socket, either a Unix
+ * domain socket (an address that is a path) or TCP on the loopback
+ * interface (an address of the form "localhost:port" or "127.0.0.1:port").
+ *
+ * Every message, in either direction, is a 4-byte length in network byte
+ * order followed by that many bytes. The client sends one query per
+ * message, as typed; the server answers each with one message whose first
+ * byte says what the rest is:
+ *
+ *   PROTOCOL_RESULTS  the "Query:" line and the ranked documents, exactly
+ *                     as the querier prints them to stdout
+ *   PROTOCOL_NOMATCH  a valid query that matched nothing; the rest is the
+ *                     querier's message for stderr
+ *   PROTOCOL_INVALID  a rejected query; the rest is the message for stderr
+ *
+ * A request whose first byte is PROTOCOL_CONTROL is not a query but a command
+ * to the server ("!reload", "!ingest docID pageFile", "!flush"); queries
+ * never start with it, as they hold only letters and spaces. Commands are
+ * answered like queries: PROTOCOL_RESULTS when they succeed,
+ * PROTOCOL_INVALID when they fail or are unknown.
+ *
+ * A connection carries any number of request/response pairs, one at a time,
+ * and ends when either side closes it.
+ *
+ * Compilation requires: nothing beyond the C library and POSIX sockets.
+ */
+
+#ifndef __PROTOCOL_H
+#define __PROTOCOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Global variables
+ */
+#define PROTOCOL_RESULTS 'R'  // response holds results, for stdout
+#define PROTOCOL_NOMATCH 'N'  // response holds a no-match message, for stderr
+#define PROTOCOL_INVALID 'I'  // response holds a rejection, for stderr
+#define PROTOCOL_CONTROL '!'  // request is a command, not a query
+#define PROTOCOL_MAX_QUERY 4096  // longest request a server accepts
+#define PROTOCOL_MAX_REPLY (256u << 20)  // longest response a client accepts
+
+/*
+ * protocol_listen - opens a listening socket on address.
+ *
+ * A Unix socket path that already exists as a socket (left by a server that
+ * died) is replaced; TCP addresses bind to 127.0.0.1 only.
+ *
+ * Returns the socket's file descriptor, or -1 (with errno set) on error.
+ */
+int protocol_listen(const char* address);
+
+/*
+ * protocol_connect - connects to a server listening on address.
+ * Returns the socket's file descriptor, or -1 (with errno set) on error.
+ */
+int protocol_connect(const char* address);
+
+/*
+ * protocol_send - sends one message of len bytes from buf.
+ * Returns true once all of it is written, false on error.
+ */
+bool protocol_send(int fd, const void* buf, const size_t len);
+
+/*
+ * protocol_sendReply - sends one response: the status byte, then len bytes
+ * of text. Returns true once all of it is written, false on error.
+ */
+bool protocol_sendReply(int fd, const char status, const char* text, const size_t len);
+
+/*
+ * protocol_recv - receives one message of at most max bytes.
+ *
+ * Returns the message in a malloc'd buffer with a '\0' appended (not
+ * counted in *len), or NULL at end of stream, on error, or if the message is
+ * longer than max. The caller frees the buffer.
+ */
+char* protocol_recv(int fd, const size_t max, size_t* len);
+
+#endif // __PROTOCOL_H
@@ -0,0 +1,1110 @@
+/*
+ * query.c - CS50 'query' module
+ *
+ * see query.h for more information.
+ *
+ * The planner runs between compiling and evaluating: it drops words that are
+ * not in the index, and with them every AND node they belong to and every OR
+ * branch that is left with nothing to match; collapses operators left with
+ * a single operand; drops repeated words within an AND (min(x, x) is x); and
+ * sorts AND operands from rarest to commonest by document frequency, so the
+ * rarest list proposes the candidates whatever order the words were typed in.
+ *
+ * query_top uses block-max WAND over the OR branches. Each branch has a
+ * largest possible score (from postings_maxCount). With the branches sorted
+ * by current docID, the pivot is the first branch at which their bounds add
+ * up to more than the k-th best score so far: no document before the
+ * pivot's can make the top k, so lagging branches jump straight to it. The
+ * block maxima (postings_shallowMax) then bound every branch over a run of
+ * docIDs from the pivot; if even that sum cannot beat the k-th score the
+ * whole run is skipped without decoding a count. Ties go to the lower docID,
+ * which comes first, so a candidate must score strictly more than the k-th
+ * best to displace it. BM25 bounds are computed for the shortest document in
+ * the index, the one where a given count weighs the most.
+ *
+ * Every node keeps the docID it is positioned on. Moving a node forward
+ * (nodeAdvance) never moves it backward, and a node's score is computed only
+ * when the root lands on a match, so counts are decoded only for documents
+ * that are returned.
+ *
+ * Everything a query allocates (nodes, cursors, filters, query_top's
+ * heap, query_alloc's memory) is carved from the query's scratch block, and
+ * nothing is freed until query_delete. A deleted query is kept by the thread
+ * that deleted it, block and all, for that thread's next query_new; if the
+ * block ran short (the rest came from malloc) it is regrown first. So once a
+ * thread has run a few queries of a given size, compiling and evaluating
+ * another calls malloc not at all.
+ *
+ * An analyzed query (query_newAnalyzed) counts and times every move of
+ * every node: nodeStart and nodeAdvance read the monotonic clock around the
+ * move, inclusive of the subtree, and nodeNext goes through nodeAdvance. A
+ * query that is not analyzed pays one test of a flag per move.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <limits.h>
+#include <math.h>
+#include "query.h"
+#include "latency.h"
+
+/**************** local types ****************/
+typedef enum { NODE_TERM, NODE_AND, NODE_OR } nodeType_t;
+
+typedef struct node {
+    nodeType_t type;
+    int docID;                  // current document, POSTINGS_END once exhausted
+    int df;                     // estimated number of matching documents
+    queryRank_t rank;           // how documents are scored
+    double maxScore;            // largest score the node can give any document
+    postings_t* postings;       // TERM: the word's list, NULL if not in the index
+    postings_cursor_t* cursor;  // TERM: cursor over postings
+    const float* norms;         // TERM, BM25: the index's per-document length norms
+    int numNorms;               // TERM, BM25: docIDs covered by norms (1 .. numNorms)
+    double idf;                 // TERM, BM25: inverse document frequency
+    double minNorm;             // TERM, BM25: smallest length norm in the index
+    int order;                  // TERM: rank of its word among the query's words
+    struct node** children;     // AND, OR: operands; an OR keeps them as a min-heap by docID
+    struct node** operands;     // AND: the operands by word, OR: in query order;
+                                // for summing scores
+    int nchildren;
+    uint64_t* filter;           // AND: docIDs set in every dense child, OR: in any, or NULL
+    int nwords;                 // AND, OR: words in filter
+    const char* word;           // TERM: the word, copied, for query_explain
+    bool analyze;               // whether moves are counted and timed
+    long moves;                 // analyzed: times the node was moved (started included)
+    long produced;              // analyzed: moves that landed on a document
+    uint64_t ns;                // analyzed: time spent moving the node and its subtree
+} node_t;
+
+typedef struct overflow {
+    struct overflow* next;      // the query's previous overflow, or NULL
+    max_align_t data[];         // the memory handed out
+} overflow_t;
+
+/**************** global types ****************/
+typedef struct query {
+    node_t* root;               // NULL if the planner found the query cannot match
+    node_t* plan;               // root as planned, kept for query_explain after query_top
+    bool started;               // whether query_next has returned a match yet
+    bool analyze;               // whether the nodes count and time their moves
+    long scored;                // analyzed: documents scored
+    long skips;                 // analyzed: runs of docIDs query_top skipped by block maxima
+    uint64_t ns;                // analyzed: time spent in query_next and query_top
+    char* block;                // scratch memory: every allocation of the query
+    size_t cap;                 // bytes in block
+    size_t used;                // bytes of block handed out
+    size_t wanted;              // bytes asked for since query_new, in block or not
+    overflow_t* overflow;       // allocations that did not fit in block, newest first
+    struct query* nextSpare;    // next deleted query kept by the same thread
+} query_t;
+
+/**************** local constants ****************/
+static const size_t SCRATCH_MIN = 16384;     // smallest block a query keeps
+static const size_t SCRATCH_MAX = 1 << 22;   // largest block a query keeps
+static const int SCRATCH_SPARES = 2;         // deleted queries a thread keeps
+
+/**************** file-local global variables ****************/
+static pthread_key_t spares;     // each thread's deleted queries, a list by nextSpare
+static pthread_once_t sparesOnce = PTHREAD_ONCE_INIT;
+static bool sparesReady;         // whether the key exists
+
+/**************** local functions ****************/
+static void nodeAdvance(node_t* node, const int target);
+static double sumOperands(node_t* node, const int docID);
+static int nodeLast(node_t* node);
+
+// Returns size bytes of the query's scratch memory, aligned for any type, or
+// NULL if out of memory. Past the end of the block they come from malloc,
+// and the block is regrown to fit when the query is deleted.
+static void* scratchAlloc(query_t* query, size_t size)
+{
+    size = (size + sizeof(max_align_t) - 1) / sizeof(max_align_t) * sizeof(max_align_t);
+    query->wanted += size;
+    if (size <= query->cap - query->used) {
+        void* memory = query->block + query->used;
+        query->used += size;
+        return memory;
+    }
+    overflow_t* extra = malloc(sizeof(overflow_t) + size);
+    if (extra == NULL) {
+        return NULL;
+    }
+    extra->next = query->overflow;
+    query->overflow = extra;
+    return extra->data;
+}
+
+// Frees a query and its block.
+static void freeQuery(void* query)
+{
+    if (query != NULL) {
+        free(((query_t*)query)->block);
+        free(query);
+    }
+}
+
+// Frees a thread's deleted queries when the thread exits.
+static void freeSpares(void* list)
+{
+    for (query_t* query = list; query != NULL; ) {
+        query_t* next = query->nextSpare;
+        freeQuery(query);
+        query = next;
+    }
+}
+
+static void makeSpares(void)
+{
+    sparesReady = pthread_key_create(&spares, freeSpares) == 0;
+}
+
+// Returns an empty query, one this thread deleted earlier if it kept one.
+static query_t* takeQuery(void)
+{
+    pthread_once(&sparesOnce, makeSpares);
+    query_t* query = sparesReady ? pthread_getspecific(spares) : NULL;
+    if (query != NULL) {
+        pthread_setspecific(spares, query->nextSpare);
+    } else {
+        query = calloc(1, sizeof(query_t));
+        if (query == NULL) {
+            return NULL;
+        }
+    }
+    query->root = query->plan = NULL;
+    query->started = query->analyze = false;
+    query->scored = query->skips = 0;
+    query->ns = 0;
+    query->nextSpare = NULL;
+    return query;
+}
+
+// Returns a TERM node's score for a document where the word occurs count
+// times; norm is the document's BM25 length norm.
+static double termScore(const node_t* node, const int count, const double norm)
+{
+    if (node->rank == QUERY_COUNT) {
+        return count;
+    }
+    return node->idf * count * (BM25_K1 + 1) / (count + norm);
+}
+
+// Returns an upper bound on a TERM node's score in any document where the
+// word occurs at most count times. BM25 bounds get a little headroom so
+// that rounding can never make a bound smaller than a score it covers.
+static double termBound(const node_t* node, const int count)
+{
+    if (node->rank == QUERY_COUNT) {
+        return count;
+    }
+    return termScore(node, count, node->minNorm) * (1 + 1e-9);
+}
+
+static node_t* newTerm(query_t* query, index_t* index, const char* word, const queryRank_t rank)
+{
+    node_t* node = scratchAlloc(query, sizeof(node_t));
+    if (node == NULL) {
+        return NULL;
+    }
+    memset(node, 0, sizeof(node_t));
+    node->type = NODE_TERM;
+    node->rank = rank;
+    node->analyze = query->analyze;
+    size_t length = strlen(word) + 1;
+    char* copy = scratchAlloc(query, length);
+    if (copy == NULL) {
+        return NULL;
+    }
+    node->word = memcpy(copy, word, length);
+    node->postings = index_find(index, word);
+    node->df = postings_size(node->postings);
+    if (rank == QUERY_BM25) {
+        // A segment scores with its base's collection statistics (index_computeNorms),
+        // counting its own documents too, so that a word new to the base is not rated
+        // as rare as a word that appears nowhere. A shard counts the documents of
+        // every shard it is joined with, so each rates a word as the whole collection does.
+        index_t* stats = index->statsFrom != NULL ? index->statsFrom : index;
+        int df = stats == index ? node->df
+                 : node->df + postings_size(index_find(stats, word));
+        if (index->shards != NULL) {
+            df = 0;
+            for (int i = 0; i < index->numShards; i++) {
+                df += postings_size(index_find(index->shards[i], word));
+            }
+        }
+        node->norms = index->docNorms;
+        node->numNorms = index->numDocs;
+        node->minNorm = index->minNorm;
+        node->idf = log(1 + (stats->numDocs - df + 0.5) / (df + 0.5));
+    }
+    node->maxScore = termBound(node, postings_maxCount(node->postings));
+    node->cursor = scratchAlloc(query, sizeof(postings_cursor_t));
+    return node->cursor != NULL ? node : NULL;
+}
+
+// Sets an AND or OR node's estimated number of matches and score bound
+// from its children: the rarest operand's for AND and the sum for OR; the
+// bound is the sum of the operands' bounds, except for an AND ranked by
+// count, whose score is its smallest operand's.
+static void estimate(node_t* node)
+{
+    bool minimum = node->type == NODE_AND && node->rank == QUERY_COUNT;
+    long df = node->type == NODE_AND ? INT_MAX : 0;
+    double maxScore = minimum ? INFINITY : 0;
+    for (int i = 0; i < node->nchildren; i++) {
+        node_t* child = node->children[i];
+        if (node->type == NODE_AND) {
+            df = child->df < df ? child->df : df;
+        } else {
+            df += child->df;
+        }
+        if (minimum) {
+            maxScore = child->maxScore < maxScore ? child->maxScore : maxScore;
+        } else {
+            maxScore += child->maxScore;
+        }
+    }
+    node->df = df < INT_MAX ? (int)df : INT_MAX;
+    node->maxScore = maxScore;
+}
+
+// Creates an AND or OR node over a copy of children[].
+static node_t* newOperator(query_t* query, const nodeType_t type, node_t* children[],
+                           const int nchildren, const queryRank_t rank)
+{
+    node_t* node = scratchAlloc(query, sizeof(node_t));
+    node_t** copy = scratchAlloc(query, sizeof(node_t*) * nchildren);
+    node_t** operands = scratchAlloc(query, sizeof(node_t*) * nchildren);
+    if (node == NULL || copy == NULL || operands == NULL) {
+        return NULL;
+    }
+    memset(node, 0, sizeof(node_t));
+    node->analyze = query->analyze;
+    node->type = type;
+    node->rank = rank;
+    node->children = copy;
+    node->operands = operands;
+    node->nchildren = nchildren;
+    for (int i = 0; i < nchildren; i++) {
+        copy[i] = children[i];
+    }
+    estimate(node);
+    return node;
+}
+
+// Compares two nodes by estimated matches, for qsort.
+static int compareDf(const void* a, const void* b)
+{
+    const node_t* x = *(node_t* const*)a;
+    const node_t* y = *(node_t* const*)b;
+    if (x->df != y->df) {
+        return (x->df > y->df) - (x->df < y->df);
+    }
+    // break ties by word, so the same words end up in the same order however typed
+    return (x->order > y->order) - (x->order < y->order);
+}
+
+// Compares two TERM nodes by word, for qsort.
+static int compareOrder(const void* a, const void* b)
+{
+    const node_t* x = *(node_t* const*)a;
+    const node_t* y = *(node_t* const*)b;
+    return (x->order > y->order) - (x->order < y->order);
+}
+
+// Compares two words for qsort.
+static int compareWords(const void* a, const void* b)
+{
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// Returns true if one of the first n children is a TERM over the same list as term.
+static bool repeatsTerm(node_t* children[], const int n, const node_t* term)
+{
+    for (int i = 0; i < n; i++) {
+        if (children[i]->type == NODE_TERM && children[i]->postings == term->postings) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Rewrites the subtree rooted at node into the form it will be evaluated in
+// (see the top of this file). Returns the new subtree, or NULL if the subtree
+// cannot match any document. Dropped nodes stay in the query's scratch memory.
+static node_t* plan(node_t* node)
+{
+    if (node->type == NODE_TERM) {
+        return node->df > 0 ? node : NULL;
+    }
+
+    bool empty = false;  // an AND operand matches nothing
+    int n = 0;
+    for (int i = 0; i < node->nchildren; i++) {
+        node_t* child = plan(node->children[i]);
+        if (child == NULL) {
+            empty = empty || node->type == NODE_AND;
+        } else if (node->type == NODE_AND && child->type == NODE_TERM
+                   && repeatsTerm(node->children, n, child)) {
+            continue;
+        } else {
+            node->children[n++] = child;
+        }
+    }
+    node->nchildren = n;
+    if (empty || n == 0) {
+        return NULL;
+    }
+    if (n == 1) {
+        return node->children[0];
+    }
+    if (node->type == NODE_AND) {
+        // Evaluate rarest first, but add scores up by word, an order that does not
+        // depend on the index (or shard) the query runs on
+        qsort(node->children, n, sizeof(node_t*), compareDf);
+        memcpy(node->operands, node->children, sizeof(node_t*) * n);
+        qsort(node->operands, n, sizeof(node_t*), compareOrder);
+    }
+    estimate(node);
+    return node;
+}
+
+// Restores the OR node's heap property below position i.
+static void siftDown(node_t* node, int i)
+{
+    node_t** heap = node->children;
+    for (;;) {
+        int least = i;
+        int left = 2 * i + 1, right = 2 * i + 2;
+        if (left < node->nchildren && heap[left]->docID < heap[least]->docID) {
+            least = left;
+        }
+        if (right < node->nchildren && heap[right]->docID < heap[least]->docID) {
+            least = right;
+        }
+        if (least == i) {
+            return;
+        }
+        node_t* swap = heap[i];
+        heap[i] = heap[least];
+        heap[least] = swap;
+        i = least;
+    }
+}
+
+// Builds the node's filter, a bitmap of docIDs combined a word at a time.
+// An AND whose rarest child is a dense list, and at least one other child
+// too, ANDs their bitmaps, and only documents left in the filter are tried.
+// An OR whose children are all dense lists ORs their bitmaps, and walks the
+// filter instead of its heap. The filter stops at last, the end of the
+// query's docID range.
+static void buildFilter(query_t* query, node_t* node, const int last)
+{
+    node_t* rarest = node->children[0];
+    int numDense = 0;
+    for (int i = 0; i < node->nchildren; i++) {
+        node_t* child = node->children[i];
+        if (child->df < rarest->df) {
+            rarest = child;
+        }
+        numDense += child->type == NODE_TERM && postings_isDense(child->postings);
+    }
+    if (node->type == NODE_OR) {
+        if (numDense < node->nchildren) {
+            return;
+        }
+        node->nwords = nodeLast(node) / 64 + 1;
+    } else {
+        if (numDense < 2 || rarest->type != NODE_TERM || !postings_isDense(rarest->postings)) {
+            return;
+        }
+        // A dense list ends by POSTINGS_DENSE times its length, so that bounds the filter.
+        node->nwords = POSTINGS_DENSE * rarest->df / 64 + 1;
+    }
+    if (node->nwords > last / 64 + 1) {
+        node->nwords = last / 64 + 1;
+    }
+    node->filter = scratchAlloc(query, sizeof(uint64_t) * node->nwords);
+    if (node->filter == NULL) {
+        return;
+    }
+    memset(node->filter, 0, sizeof(uint64_t) * node->nwords);
+    postings_bitmapOr(rarest->postings, node->filter, node->nwords);
+    for (int i = 0; i < node->nchildren; i++) {
+        node_t* child = node->children[i];
+        if (child == rarest || child->type != NODE_TERM || !postings_isDense(child->postings)) {
+            continue;
+        }
+        if (node->type == NODE_OR) {
+            postings_bitmapOr(child->postings, node->filter, node->nwords);
+        } else {
+            postings_bitmapAnd(child->postings, node->filter, node->nwords);
+        }
+    }
+    if (node->nwords == last / 64 + 1 && last % 64 < 63) {
+        node->filter[node->nwords - 1] &= ~0ULL >> (63 - last % 64);  // nothing past last
+    }
+}
+
+// Returns the first docID >= target set in the node's filter.
+static int filterNext(node_t* node, const int target)
+{
+    int w = target >> 6;
+    if (w >= node->nwords) {
+        return POSTINGS_END;
+    }
+    uint64_t bits = node->filter[w] & (~0ULL << (target & 63));
+    while (bits == 0) {
+        if (++w == node->nwords) {
+            return POSTINGS_END;
+        }
+        bits = node->filter[w];
+    }
+    return 64 * w + __builtin_ctzll(bits);
+}
+
+// Leapfrog: moves the AND node's children, round robin, to the first
+// document >= target that they all agree on.
+static void andAlign(node_t* node, const int target)
+{
+    int docID = target;
+    int agree = 0;  // children known to sit on docID
+    for (int i = 0; agree < node->nchildren; i = (i + 1) % node->nchildren) {
+        if (node->filter != NULL) {
+            int candidate = filterNext(node, docID);
+            if (candidate != docID) {
+                docID = candidate;
+                agree = 0;
+            }
+            if (docID == POSTINGS_END) {
+                break;
+            }
+        }
+        node_t* child = node->children[i];
+        nodeAdvance(child, docID);
+        if (child->docID == POSTINGS_END) {
+            docID = POSTINGS_END;
+            break;
+        }
+        if (child->docID == docID) {
+            agree++;
+        } else {
+            docID = child->docID;
+            agree = 1;
+        }
+    }
+    node->docID = docID;
+}
+
+// Moves the OR node to the first document >= target in its filter, and the
+// children that hold it onto it.
+static void orAlign(node_t* node, const int target)
+{
+    node->docID = filterNext(node, target);
+    for (int i = 0; i < node->nchildren && node->docID != POSTINGS_END; i++) {
+        nodeAdvance(node->children[i], node->docID);
+    }
+}
+
+// Positions a freshly built node (and its subtree) on its first match in
+// first .. last; every cursor stops at last.
+static void nodeStart(query_t* query, node_t* node, const int first, const int last)
+{
+    uint64_t start = node->analyze ? latency_now() : 0;
+    switch (node->type) {
+    case NODE_TERM:
+        postings_openRange(node->cursor, node->postings, first, last);
+        node->docID = postings_docID(node->cursor);
+        break;
+    case NODE_AND:
+        for (int i = 0; i < node->nchildren; i++) {
+            nodeStart(query, node->children[i], first, last);
+        }
+        buildFilter(query, node, last);
+        andAlign(node, first);
+        break;
+    case NODE_OR:
+        for (int i = 0; i < node->nchildren; i++) {
+            nodeStart(query, node->children[i], first, last);
+            node->operands[i] = node->children[i];
+        }
+        buildFilter(query, node, last);
+        if (node->filter != NULL) {
+            orAlign(node, first);
+            break;
+        }
+        for (int i = node->nchildren / 2 - 1; i >= 0; i--) {
+            siftDown(node, i);
+        }
+        node->docID = node->children[0]->docID;
+        break;
+    }
+    if (node->analyze) {
+        node->ns += latency_now() - start;
+        node->moves++;
+        node->produced += node->docID != POSTINGS_END;
+    }
+}
+
+// Moves the node to its first match at or after target, which is ahead of it.
+static void moveNode(node_t* node, const int target)
+{
+    switch (node->type) {
+    case NODE_TERM:
+        node->docID = postings_advanceTo(node->cursor, target);
+        break;
+    case NODE_AND:
+        andAlign(node, target);
+        break;
+    case NODE_OR:
+        if (node->filter != NULL) {
+            orAlign(node, target);
+            break;
+        }
+        while (node->children[0]->docID < target) {
+            nodeAdvance(node->children[0], target);
+            siftDown(node, 0);
+        }
+        node->docID = node->children[0]->docID;
+        break;
+    }
+}
+
+// Moves the node to its first match at or after target; never moves back.
+static void nodeAdvance(node_t* node, const int target)
+{
+    if (node->docID >= target) {
+        return;
+    }
+    if (!node->analyze) {
+        moveNode(node, target);
+        return;
+    }
+    uint64_t start = latency_now();
+    moveNode(node, target);
+    node->ns += latency_now() - start;
+    node->moves++;
+    node->produced += node->docID != POSTINGS_END;
+}
+
+// Moves the node to its next match.
+static void nodeNext(node_t* node)
+{
+    if (node->docID == POSTINGS_END) {
+        return;
+    }
+    if (node->type == NODE_TERM && !node->analyze) {
+        node->docID = postings_next(node->cursor);
+    } else {
+        nodeAdvance(node, node->docID + 1);
+    }
+}
+
+// Returns the score of the document the node is positioned on. Operands
+// are always added up in the same order (an AND's by word, an OR's as
+// typed), so a document's score does not depend on how it was reached, nor
+// on which index or shard it was found in.
+static double nodeScore(node_t* node)
+{
+    double score = 0;
+    switch (node->type) {
+    case NODE_TERM:
+        score = termScore(node, postings_count(node->cursor),
+                          node->docID <= node->numNorms ? node->norms[node->docID]
+                                                        : node->minNorm);
+        break;
+    case NODE_AND:
+        for (int i = 0; i < node->nchildren; i++) {
+            double childScore = nodeScore(node->operands[i]);
+            if (node->rank != QUERY_COUNT) {
+                score += childScore;
+            } else if (i == 0 || childScore < score) {
+                score = childScore;
+            }
+        }
+        break;
+    case NODE_OR:
+        score = sumOperands(node, node->docID);
+        break;
+    }
+    return score;
+}
+
+// Adds up the scores of the OR node's operands that sit on docID.
+static double sumOperands(node_t* node, const int docID)
+{
+    double score = 0;
+    for (int i = 0; i < node->nchildren; i++) {
+        if (node->operands[i]->docID == docID) {
+            score += nodeScore(node->operands[i]);
+        }
+    }
+    return score;
+}
+
+// Returns an upper bound on the node's score for every document from docID
+// (which must not be behind the node) through *last, lowering *last as
+// needed: 0 up to the node's next match if it has moved past docID, and
+// otherwise the block maxima of the blocks that would hold docID.
+static double nodeBound(node_t* node, const int docID, int* last)
+{
+    if (node->docID > docID) {
+        *last = node->docID - 1 < *last ? node->docID - 1 : *last;
+        return 0;
+    }
+    double bound = 0;
+    int blockLast;
+    switch (node->type) {
+    case NODE_TERM:
+        bound = termBound(node, postings_shallowMax(node->cursor, docID, &blockLast));
+        *last = blockLast < *last ? blockLast : *last;
+        break;
+    case NODE_AND:
+        bound = node->rank == QUERY_COUNT ? INFINITY : 0;
+        for (int i = 0; i < node->nchildren; i++) {
+            double childBound = nodeBound(node->children[i], docID, last);
+            if (childBound == 0) {
+                return 0;  // an operand that cannot match sinks the AND
+            }
+            if (node->rank != QUERY_COUNT) {
+                bound += childBound;
+            } else if (childBound < bound) {
+                bound = childBound;
+            }
+        }
+        break;
+    case NODE_OR:
+        for (int i = 0; i < node->nchildren; i++) {
+            bound += nodeBound(node->children[i], docID, last);
+        }
+        break;
+    }
+    return bound;
+}
+
+// Returns the largest docID the node can match: the last docID of a word's
+// list, the smallest of an AND's operands, the largest of an OR's.
+static int nodeLast(node_t* node)
+{
+    if (node->type == NODE_TERM) {
+        return postings_lastDocID(node->postings);
+    }
+    int last = nodeLast(node->children[0]);
+    for (int i = 1; i < node->nchildren; i++) {
+        int childLast = nodeLast(node->children[i]);
+        if (node->type == NODE_AND ? childLast < last : childLast > last) {
+            last = childLast;
+        }
+    }
+    return last;
+}
+
+// Insertion-sorts nodes by current docID; they are nearly sorted already.
+static void sortByDocID(node_t* nodes[], const int n)
+{
+    for (int i = 1; i < n; i++) {
+        node_t* node = nodes[i];
+        int j = i;
+        for (; j > 0 && nodes[j - 1]->docID > node->docID; j--) {
+            nodes[j] = nodes[j - 1];
+        }
+        nodes[j] = node;
+    }
+}
+
+// One result in query_top's heap.
+typedef struct hit {
+    int docID;
+    double score;
+} hit_t;
+
+// Returns true if a ranks below b: a lower score, or a higher docID on a tie.
+static bool worse(const hit_t* a, const hit_t* b)
+{
+    return a->score < b->score || (a->score == b->score && a->docID > b->docID);
+}
+
+// Restores the min-heap (worst hit on top) below position i.
+static void hitSiftDown(hit_t* heap, const int size, int i)
+{
+    for (;;) {
+        int least = i;
+        int left = 2 * i + 1, right = 2 * i + 2;
+        if (left < size && worse(&heap[left], &heap[least])) {
+            least = left;
+        }
+        if (right < size && worse(&heap[right], &heap[least])) {
+            least = right;
+        }
+        if (least == i) {
+            return;
+        }
+        hit_t swap = heap[i];
+        heap[i] = heap[least];
+        heap[least] = swap;
+        i = least;
+    }
+}
+
+// Adds a hit to a heap of at most k hits, evicting the worst when full.
+static void hitPush(hit_t* heap, int* size, const int k, const hit_t hit)
+{
+    if (*size == k) {
+        heap[0] = hit;
+        hitSiftDown(heap, k, 0);
+        return;
+    }
+    int i = (*size)++;
+    while (i > 0 && worse(&hit, &heap[(i - 1) / 2])) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = hit;
+}
+
+// Orders hits best first, for qsort.
+static int compareHits(const void* a, const void* b)
+{
+    return worse(b, a) ? -1 : worse(a, b) ? 1 : 0;
+}
+
+// Compiles, plans and starts a query as query_newRange does; if analyze, its
+// nodes count and time their moves from the start.
+static query_t* build(index_t* index, char* words[], const int numWords,
+                      const queryRank_t rank, const int first, const int last,
+                      const bool analyze)
+{
+    if (index == NULL || words == NULL || numWords <= 0
+        || (rank == QUERY_BM25 && index->docNorms == NULL)) {
+        return NULL;
+    }
+    query_t* query = takeQuery();
+    if (query == NULL) {
+        return NULL;
+    }
+    query->analyze = analyze;
+    node_t* branches[numWords];  // one per AND sequence
+    node_t* terms[numWords];     // words of the current AND sequence
+    int numBranches = 0, numTerms = 0;
+    bool ok = true;
+
+    for (int i = 0; i <= numWords && ok; i++) {
+        if (i == numWords || strcmp(words[i], "or") == 0) {
+            if (numTerms > 0) {
+                node_t* branch = numTerms == 1 ? terms[0]
+                                               : newOperator(query, NODE_AND, terms, numTerms,
+                                                             rank);
+                numTerms = 0;
+                ok = branch != NULL;
+                branches[numBranches++] = branch;
+            }
+        } else if (strcmp(words[i], "and") != 0) {
+            terms[numTerms] = newTerm(query, index, words[i], rank);
+            ok = terms[numTerms] != NULL;
+            for (int j = 0; ok && j < numWords; j++) {
+                terms[numTerms]->order += strcmp(words[j], words[i]) < 0;
+            }
+            numTerms++;
+        }
+    }
+
+    if (ok && numBranches > 0) {
+        query->root = numBranches == 1 ? branches[0]
+                                       : newOperator(query, NODE_OR, branches, numBranches, rank);
+    }
+    if (query->root == NULL) {
+        query_delete(query);
+        return NULL;
+    }
+    query->root = query->plan = plan(query->root);
+    if (query->root != NULL) {
+        nodeStart(query, query->root, first, last);
+    }
+    return query;
+}
+
+// Prints the subtree rooted at node for query_explain, one node per line,
+// indented by depth: its type, its estimated matches and largest score, and
+// once analyzed how it moved and, for a TERM, what it read.
+static void explainNode(node_t* node, const int depth, FILE* fp)
+{
+    fprintf(fp, "%*s", 2 * depth, "");
+    if (node->type == NODE_TERM) {
+        fprintf(fp, "TERM %s: %d documents, %s", node->word, node->df,
+                postings_isDense(node->postings) ? "bitmap" : "compressed");
+    } else {
+        fprintf(fp, "%s of %d: at most %d documents", node->type == NODE_AND ? "AND" : "OR",
+                node->nchildren, node->df);
+        if (node->filter != NULL) {
+            fprintf(fp, ", bitmap filter of %d words", node->nwords);
+        }
+    }
+    fprintf(fp, ", max score %g", node->maxScore);
+    if (node->moves > 0) {
+        fprintf(fp, "; moved %ld times onto %ld documents", node->moves, node->produced);
+        if (node->type == NODE_TERM) {
+            int blocks, entries;
+            postings_reads(node->cursor, &blocks, &entries);
+            fprintf(fp, ", decoded %d postings in %d blocks", entries, blocks);
+        }
+        fprintf(fp, ", %.3f ms", node->ns / 1e6);
+    }
+    fprintf(fp, "\n");
+    for (int i = 0; i < node->nchildren; i++) {
+        // an AND tries its children in this order; an OR's heap is shown as typed
+        explainNode(node->type == NODE_AND ? node->children[i] : node->operands[i], depth + 1,
+                    fp);
+    }
+}
+
+/**************** global functions ****************/
+
+query_t* query_new(index_t* index, char* words[], const int numWords, const queryRank_t rank)
+{
+    return query_newRange(index, words, numWords, rank, 1, POSTINGS_END - 1);
+}
+
+query_t* query_newRange(index_t* index, char* words[], const int numWords,
+                        const queryRank_t rank, const int first, const int last)
+{
+    return build(index, words, numWords, rank, first, last, false);
+}
+
+query_t* query_newAnalyzed(index_t* index, char* words[], const int numWords,
+                           const queryRank_t rank)
+{
+    return build(index, words, numWords, rank, 1, POSTINGS_END - 1, true);
+}
+
+bool query_span(query_t* query, int* first, int* last)
+{
+    if (query == NULL || query->root == NULL || query->started
+        || query->root->docID == POSTINGS_END) {
+        return false;
+    }
+    *first = query->root->docID;
+    *last = nodeLast(query->root);
+    return true;
+}
+
+int query_next(query_t* query, double* score)
+{
+    if (query == NULL || query->root == NULL) {
+        return POSTINGS_END;
+    }
+    uint64_t start = query->analyze ? latency_now() : 0;
+    if (query->started) {
+        nodeNext(query->root);
+    }
+    query->started = true;
+    bool scoring = query->root->docID != POSTINGS_END && score != NULL;
+    if (scoring) {
+        *score = nodeScore(query->root);
+    }
+    if (query->analyze) {
+        query->ns += latency_now() - start;
+        query->scored += scoring;
+    }
+    return query->root->docID;
+}
+
+int query_top(query_t* query, const int k, int docs[], double scores[])
+{
+    if (query == NULL || query->root == NULL || k <= 0 || query->started) {
+        return 0;
+    }
+    query->started = true;
+    uint64_t start = query->analyze ? latency_now() : 0;
+    node_t* root = query->root;
+    int n = root->type == NODE_OR ? root->nchildren : 1;
+    node_t* branches[n];  // kept sorted by current docID
+    for (int i = 0; i < n; i++) {
+        branches[i] = root->type == NODE_OR ? root->children[i] : root;
+    }
+
+    hit_t* heap = scratchAlloc(query, sizeof(hit_t) * k);
+    if (heap == NULL) {
+        return -1;
+    }
+    int size = 0;
+    for (;;) {
+        double threshold = size == k ? heap[0].score : 0;
+        sortByDocID(branches, n);
+
+        // pivot: the first branch at which the bounds of the branches so far
+        // could beat the k-th score; no document before its docID can
+        int pivot = -1;
+        double reach = 0;
+        for (int i = 0; i < n && branches[i]->docID != POSTINGS_END; i++) {
+            reach += branches[i]->maxScore;
+            if (reach > threshold) {
+                pivot = i;
+                break;
+            }
+        }
+        if (pivot < 0) {
+            break;
+        }
+        int docID = branches[pivot]->docID;
+        while (pivot + 1 < n && branches[pivot + 1]->docID == docID) {
+            pivot++;
+        }
+
+        // block maxima bound every branch from docID through last; if even
+        // that cannot beat the k-th score, skip the whole range
+        int last = POSTINGS_END - 1;
+        double total = 0;
+        for (int i = 0; i < n; i++) {
+            total += nodeBound(branches[i], docID, &last);
+        }
+        if (total <= threshold) {
+            for (int i = 0; i <= pivot; i++) {
+                nodeAdvance(branches[i], last + 1);
+            }
+            query->skips++;
+        } else if (branches[0]->docID == docID) {
+            // every branch up to the pivot sits on docID: score it
+            double score = root->type == NODE_OR ? sumOperands(root, docID) : nodeScore(root);
+            query->scored++;
+            if (score > threshold) {
+                hit_t hit = { docID, score };
+                hitPush(heap, &size, k, hit);
+            }
+            for (int i = 0; i <= pivot; i++) {
+                nodeNext(branches[i]);
+            }
+        } else {
+            // bring the branches behind the pivot up to it
+            for (int i = 0; i < pivot && branches[i]->docID < docID; i++) {
+                nodeAdvance(branches[i], docID);
+            }
+        }
+    }
+
+    qsort(heap, size, sizeof(hit_t), compareHits);
+    for (int i = 0; i < size; i++) {
+        docs[i] = heap[i].docID;
+        scores[i] = heap[i].score;
+    }
+    query->root = NULL;  // the branches have moved independently; the tree is spent
+    if (query->analyze) {
+        query->ns += latency_now() - start;
+    }
+    return size;
+}
+
+char* query_canonical(char* words[], const int numWords)
+{
+    if (words == NULL || numWords <= 0) {
+        return NULL;
+    }
+    size_t length = 1;
+    for (int i = 0; i < numWords; i++) {
+        length += strlen(words[i]) + 1;
+    }
+    char* key = malloc(length);
+    if (key == NULL) {
+        return NULL;
+    }
+    char* end = key;
+    *end = '\0';
+    const char* sequence[numWords];
+    int n = 0;
+    for (int i = 0; i <= numWords; i++) {
+        if (i < numWords && strcmp(words[i], "or") != 0) {
+            if (strcmp(words[i], "and") != 0) {
+                sequence[n++] = words[i];
+            }
+            continue;
+        }
+        // end of an AND sequence: its words in order, each once
+        qsort(sequence, n, sizeof(char*), compareWords);
+        if (n > 0 && end != key) {
+            end += sprintf(end, "or ");
+        }
+        for (int j = 0; j < n; j++) {
+            if (j == 0 || strcmp(sequence[j], sequence[j - 1]) != 0) {
+                end += sprintf(end, "%s ", sequence[j]);
+            }
+        }
+        n = 0;
+    }
+    if (end != key) {
+        end[-1] = '\0';
+    }
+    return key;
+}
+
+void query_explain(query_t* query, FILE* fp)
+{
+    if (query == NULL || fp == NULL) {
+        return;
+    }
+    if (query->plan == NULL) {
+        fprintf(fp, "Nothing can match: every AND sequence has a word missing from the index.\n");
+    } else {
+        explainNode(query->plan, 0, fp);
+    }
+    if (query->analyze && query->started) {
+        fprintf(fp, "Evaluated in %.3f ms: %ld documents scored", query->ns / 1e6, query->scored);
+        if (query->skips > 0) {
+            fprintf(fp, ", %ld runs of docIDs skipped by block maxima", query->skips);
+        }
+        fprintf(fp, "\n");
+    }
+}
+
+void* query_alloc(query_t* query, const size_t size)
+{
+    return query != NULL ? scratchAlloc(query, size) : NULL;
+}
+
+void query_delete(query_t* query)
+{
+    if (query == NULL) {
+        return;
+    }
+
+    // Drop what did not fit, and regrow the block so that it would have.
+    bool overflowed = query->overflow != NULL;
+    while (query->overflow != NULL) {
+        overflow_t* next = query->overflow->next;
+        free(query->overflow);
+        query->overflow = next;
+    }
+    if (overflowed && query->cap < SCRATCH_MAX) {
+        size_t cap = query->wanted * 2 < SCRATCH_MIN ? SCRATCH_MIN : query->wanted * 2;
+        free(query->block);
+        query->cap = cap < SCRATCH_MAX ? cap : SCRATCH_MAX;
+        query->block = malloc(query->cap);
+        query->cap = query->block != NULL ? query->cap : 0;
+    }
+    query->used = 0;
+    query->wanted = 0;
+
+    // Keep it for this thread's next query, unless the thread has enough.
+    query_t* list = sparesReady ? pthread_getspecific(spares) : NULL;
+    int kept = 0;
+    for (query_t* spare = list; spare != NULL; spare = spare->nextSpare) {
+        kept++;
+    }
+    query->nextSpare = list;
+    if (!sparesReady || kept >= SCRATCH_SPARES || pthread_setspecific(spares, query) != 0) {
+        freeQuery(query);
+    }
+}
+
+void query_freeSpares(void)
+{
+    if (sparesReady) {
+        freeSpares(pthread_getspecific(spares));
+        pthread_setspecific(spares, NULL);
+    }
+}
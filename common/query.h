@@ -0,0 +1,191 @@
+/*
+ * query.h - header file for the 'query' module
+ *
+ * A query is compiled into a tree of operator nodes: a TERM node reads one
+ * word's postings through a cursor, an AND node matches documents that all
+ * of its children match, and an OR node matches documents that any of its
+ * children match. Documents are ranked one of two ways (queryRank_t):
+ *
+ *   - QUERY_COUNT: a document's score is the word's count at a TERM node,
+ *     the minimum of the children's scores at an AND node, and the sum of
+ *     the matching children's scores at an OR node, so "a b or c" scores a
+ *     document as min(count(a), count(b)) + count(c).
+ *   - QUERY_BM25: a TERM node scores the word with Okapi BM25, using the
+ *     index's document statistics (see index_loadStats), and both AND and
+ *     OR nodes add up their matching children's scores.
+ *
+ * Either way a word repeated within an AND sequence counts once.
+ *
+ * The tree is evaluated document-at-a-time: every node sits on one
+ * document, and asking the root for the next match moves only the cursors
+ * that have to move. AND nodes leapfrog (each child jumps to the document
+ * the others agree on, via postings_advanceTo), OR nodes keep their
+ * children in a min-heap ordered by current docID. Nothing is materialized
+ * per word or per operator, so evaluation needs memory proportional to the
+ * query, not to the number of matching documents, and matches come out in
+ * increasing docID order as they are found.
+ *
+ * Before evaluation a planner rewrites the tree using each word's document
+ * frequency: AND operands are tried from the rarest word to the commonest
+ * (so "the zebra" costs what "zebra the" does), an AND with a word missing
+ * from the index is dropped without reading any postings, as is every OR
+ * branch that can no longer contribute, and one-operand operators vanish.
+ *
+ * For EXPLAIN ANALYZE, a query built by query_newAnalyzed counts and times
+ * every move of every node, and query_explain prints the planned tree with
+ * each word's document frequency and, once the query has run, what each
+ * node did.
+ *
+ * Compilation requires: index.h, postings.h, latency.h
+ */
+
+#ifndef __QUERY_H
+#define __QUERY_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "index.h"
+#include "postings.h"
+
+/*
+ * Struct definitions
+ */
+typedef struct query query_t;  // opaque to users of the module
+
+typedef enum { QUERY_COUNT, QUERY_BM25 } queryRank_t;  // how matches are scored
+
+/*
+ * query_new - compiles a tokenized query into an operator tree over index.
+ *
+ * words[] holds numWords lower-case tokens as produced by the querier's
+ * tokenizer: words, with "and" and "or" as operators. Adjacent words are
+ * ANDed, "or" separates AND sequences, and "and" binds tighter than "or".
+ * Words missing from the index compile to empty TERM nodes. rank selects the
+ * scoring; QUERY_BM25 needs the index's document statistics to be loaded.
+ *
+ * Returns the compiled and planned query, positioned before its first match
+ * (a query the planner proves empty simply has no matches), or NULL if there
+ * are no words, BM25 is asked for without statistics, or memory runs out.
+ * The index must outlive the query.
+ * The caller is responsible for later calling query_delete().
+ */
+query_t* query_new(index_t* index, char* words[], const int numWords, const queryRank_t rank);
+
+/*
+ * query_newRange - like query_new, but the query only matches documents
+ * with docIDs in first .. last: every postings cursor is opened on that
+ * range (postings_openRange), so no block outside it is decoded. Queries on
+ * disjoint ranges of one index may be evaluated by different threads at
+ * once, and together they find exactly the matches (and scores) of the
+ * whole query; merging their top k gives the whole query's top k.
+ */
+query_t* query_newRange(index_t* index, char* words[], const int numWords,
+                        const queryRank_t rank, const int first, const int last);
+
+/*
+ * query_newAnalyzed - like query_new, but every node of the query counts
+ * how often it is moved (including the first positioning, done here) and
+ * how many of those moves land on a document, and times them on the
+ * monotonic clock, inclusive of its subtree; query_next and query_top count
+ * the documents they score and time themselves. For query_explain: the
+ * clock reads make evaluation noticeably slower than query_new's.
+ */
+query_t* query_newAnalyzed(index_t* index, char* words[], const int numWords,
+                           const queryRank_t rank);
+
+/*
+ * query_span - bounds the docIDs a fresh query can match.
+ *
+ * Stores in *first the docID of its first match and in *last an upper bound
+ * on the docID of its last one (the largest docID of any word's list that
+ * can still match), without moving the query. Returns false, storing
+ * nothing, if the query has no matches or has been started.
+ */
+bool query_span(query_t* query, int* first, int* last);
+
+/*
+ * query_next - moves to the next matching document.
+ *
+ * Returns its docID, and stores its score in *score (if score is not NULL),
+ * or returns POSTINGS_END once there are no more matches. DocIDs come out
+ * in increasing order.
+ */
+int query_next(query_t* query, double* score);
+
+/*
+ * query_top - finds the k best matches without scoring every match.
+ *
+ * Fills docs[] and scores[] (each with room for k entries) best first:
+ * higher scores first, and lower docIDs first among equal scores. The
+ * result is exactly the first k entries of the full ranked list, but branches
+ * of an OR whose largest possible score cannot lift a document into the top
+ * k are only consulted for documents that might still make it (MaxScore
+ * with per-block score bounds).
+ *
+ * Must be called on a fresh query, instead of query_next; the query has no
+ * further matches afterwards.
+ *
+ * Returns the number of matches found (at most k), or -1 if out of memory.
+ */
+int query_top(query_t* query, const int k, int docs[], double scores[]);
+
+/*
+ * query_canonical - returns a canonical form of a tokenized query.
+ *
+ * Queries that always give the same results get the same form: "and" is
+ * dropped, the words of each AND sequence are sorted and repeats removed,
+ * and the sequences are joined with " or " in the order typed (that order
+ * fixes how BM25 scores are added up). So "b and a a" and "a b" are both
+ * "a b", and "a or b c" is "a or b c". Used as a result cache key.
+ *
+ * Returns a malloc'd string the caller frees, or NULL if there are no words
+ * or memory runs out.
+ */
+char* query_canonical(char* words[], const int numWords);
+
+/*
+ * query_explain - prints the query's plan to fp, one node per line with
+ * its operands indented below it: AND operands in the order they are tried
+ * (rarest first), OR operands as typed, and for each node its estimated
+ * number of matches (exact for a TERM, with its list's encoding), its
+ * largest possible score, and whether an AND or OR uses a bitmap filter.
+ *
+ * For a query from query_newAnalyzed that has been evaluated (by query_next
+ * or query_top; it may be finished), each node also shows its moves, the
+ * documents they landed on (its candidates) and their time, each TERM the
+ * postings and blocks its cursor decoded, and a last line the total time
+ * and the documents scored (and query_top's skips). query_top moves the
+ * branches of a root OR itself, so the root counts only its first
+ * positioning.
+ */
+void query_explain(query_t* query, FILE* fp);
+
+/*
+ * query_alloc - returns size bytes of memory, aligned for any type, that
+ * stay valid until the query is deleted, or NULL if out of memory. For a
+ * caller's per-query working space: it comes from the query's scratch
+ * memory (see query_delete), so it usually costs no call to malloc and
+ * must not be freed.
+ */
+void* query_alloc(query_t* query, const size_t size);
+
+/*
+ * query_delete - frees the operator tree; ignores NULL.
+ *
+ * The query's scratch memory (its nodes, cursors and query_alloc's memory)
+ * is kept by the calling thread for its next query_new, and grown if this
+ * query outgrew it, so that a thread answering a stream of queries stops
+ * calling malloc for them. A thread keeps the memory of at most two deleted
+ * queries, and frees it when the thread exits.
+ */
+void query_delete(query_t* query);
+
+/*
+ * query_freeSpares - frees the scratch memory the calling thread kept from
+ * its deleted queries. The main thread's is not freed when it exits, so
+ * call this before exiting from main once no query is left.
+ */
+void query_freeSpares(void);
+
+#endif // __QUERY_H
@@ -0,0 +1,343 @@
+/*
+ * seen.c - CS50 'seen' module
+ *
+ * see seen.h for more information.
+ *
+ * In memory, a URL is added with a single intern_add, which is new if it
+ * gets the next ID.
+ *
+ * On disk, every URL is hashed once, with hash_bytes, for both the filter
+ * and the table. A URL the filter has certainly not seen is appended to
+ * the log and put in the pending batch, a small open-addressing table in
+ * memory, without touching the table on disk. Once SEEN_BATCH URLs are
+ * pending they are merged into the table in order of their hashes: a
+ * URL's home slot is the top bits of its hash, so the merge sweeps the
+ * table once from start to end rather than faulting in a page per URL. A
+ * URL the filter may have seen is looked up in the batch and then in the
+ * table, where each slot with the URL's hash has its logged URL read back
+ * and compared, a chunk at a time.
+ *
+ * The table is probed linearly, and doubles before it would be more than
+ * half full: a new, larger file is mapped and the slots moved by their
+ * saved hashes, again in one sweep, without reading the log. The log is
+ * written with pwrite and read with pread, unbuffered, so nothing of a
+ * URL stays in the crawler's memory once the batch holding it is merged.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "../libcs50/bloom.h"
+#include "../libcs50/intern.h"
+#include "../libcs50/hash.h"
+#include "seen.h"
+
+/**************** local constants ****************/
+#define TABLE_BITS 16           // log2 of the slots of the first table on disk
+#define PENDING_BITS 13         // log2 of the batch's slots: twice SEEN_BATCH
+#define COMPARE_CHUNK 512       // bytes of a logged URL read back at a time
+
+/**************** global types ****************/
+
+// One slot of the table on disk, or of the pending batch.
+typedef struct slot {
+    uint64_t hash;          // hash_bytes of the URL
+    uint64_t offset;        // one more than the URL's offset in the log; 0 if free
+} slot_t;
+
+typedef struct seen {
+    size_t count;           // URLs in the set
+    intern_t* urls;         // the set, in memory; NULL if on disk
+    // on disk
+    bloom_t* filter;        // every URL in the set, inexactly
+    size_t capacity;        // URLs the filter is made for
+    char* directory;        // where the files are made
+    int logFd;              // the URLs, each followed by '\0', in the order added
+    uint64_t logBytes;      // the log's length
+    int tableFd;            // the table's file
+    slot_t* slots;          // the table, mapped from tableFd
+    int bits;               // log2 of its slots; at least twice count of them
+    slot_t* pending;        // the batch: URLs in the log but not yet in the table
+    int numPending;
+} seen_t;
+
+/**************** local functions ****************/
+
+// Creates a file in directory, and removes its name, so that it lasts until
+// closed. Returns its descriptor, or -1 if it cannot be created.
+static int tempFile(const char* directory)
+{
+    char path[strlen(directory) + 16];
+    sprintf(path, "%s/.seenXXXXXX", directory);
+    int fd = mkstemp(path);
+    if (fd >= 0) {
+        unlink(path);
+    }
+    return fd;
+}
+
+// Maps a new, zero-filled table of 2^bits slots from a file of its own in
+// directory, whose descriptor goes in *fd. Returns NULL on error.
+static slot_t* mapTable(const char* directory, const int bits, int* fd)
+{
+    *fd = tempFile(directory);
+    if (*fd < 0) {
+        return NULL;
+    }
+    size_t bytes = ((size_t)1 << bits) * sizeof(slot_t);
+    void* slots = MAP_FAILED;
+    if (ftruncate(*fd, (off_t)bytes) == 0) {  // sparse: no blocks until written
+        slots = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, *fd, 0);
+    }
+    if (slots == MAP_FAILED) {
+        close(*fd);
+        *fd = -1;
+        return NULL;
+    }
+    return slots;
+}
+
+// Returns true if the log holds url (of length len, and then its '\0') at offset.
+static bool logged(seen_t* seen, uint64_t offset, const char* url, size_t len)
+{
+    char chunk[COMPARE_CHUNK];
+    len++;
+    while (len > 0) {
+        size_t n = len < COMPARE_CHUNK ? len : COMPARE_CHUNK;
+        ssize_t got = pread(seen->logFd, chunk, n, (off_t)offset);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got != (ssize_t)n || memcmp(chunk, url, n) != 0) {
+            return false;
+        }
+        url += n;
+        offset += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Returns the slot of url among the 2^bits slots, or the free slot where it
+// would go: probing starts at the slot the top bits of hash pick. Logged
+// URLs are compared only if compare is true; else url is known to be
+// absent, and only its free slot is sought.
+static slot_t* findSlot(seen_t* seen, slot_t* slots, const int bits, const char* url,
+                        const size_t len, const uint64_t hash, const bool compare)
+{
+    size_t mask = ((size_t)1 << bits) - 1;
+    for (size_t i = hash >> (64 - bits); ; i = (i + 1) & mask) {
+        slot_t* slot = &slots[i];
+        if (slot->offset == 0
+            || (compare && slot->hash == hash && logged(seen, slot->offset - 1, url, len))) {
+            return slot;
+        }
+    }
+}
+
+// Doubles the table, moving the slots to a new file. Returns false, keeping
+// the old table, if the new one cannot be made.
+static bool growTable(seen_t* seen)
+{
+    int fd;
+    slot_t* slots = mapTable(seen->directory, seen->bits + 1, &fd);
+    if (slots == NULL) {
+        return false;
+    }
+    size_t numSlots = (size_t)1 << seen->bits;
+    for (size_t i = 0; i < numSlots; i++) {
+        if (seen->slots[i].offset != 0) {
+            *findSlot(seen, slots, seen->bits + 1, NULL, 0, seen->slots[i].hash, false)
+                = seen->slots[i];
+        }
+    }
+    munmap(seen->slots, numSlots * sizeof(slot_t));
+    close(seen->tableFd);
+    seen->slots = slots;
+    seen->tableFd = fd;
+    seen->bits++;
+    return true;
+}
+
+static int compareSlots(const void* a, const void* b)
+{
+    uint64_t x = ((const slot_t*)a)->hash, y = ((const slot_t*)b)->hash;
+    return (x > y) - (x < y);
+}
+
+// Merges the pending batch into the table, growing it first if need be.
+// Returns false if the table cannot take the batch.
+static bool mergePending(seen_t* seen)
+{
+    while (seen->count * 2 > (size_t)1 << seen->bits && growTable(seen)) {
+    }
+    if (seen->count >= (size_t)1 << seen->bits) {
+        return false;  // the table must keep a free slot to end probes
+    }
+    // Gather the batch at the front of its slots, and add it in slot order.
+    int n = 0;
+    for (int i = 0; i < 1 << PENDING_BITS; i++) {
+        if (seen->pending[i].offset != 0) {
+            seen->pending[n++] = seen->pending[i];
+        }
+    }
+    qsort(seen->pending, n, sizeof(slot_t), compareSlots);
+    for (int i = 0; i < n; i++) {
+        *findSlot(seen, seen->slots, seen->bits, NULL, 0, seen->pending[i].hash, false)
+            = seen->pending[i];
+    }
+    memset(seen->pending, 0, sizeof(slot_t) << PENDING_BITS);
+    seen->numPending = 0;
+    return true;
+}
+
+// Rebuilds the filter twice as large, from the hashes in the table and the
+// batch. If there is no memory for it, the old filter stays, erring more often.
+static void growFilter(seen_t* seen)
+{
+    bloom_t* filter = bloom_new(seen->capacity * 2);
+    if (filter == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < (size_t)1 << seen->bits; i++) {
+        if (seen->slots[i].offset != 0) {
+            bloom_insert(filter, seen->slots[i].hash);
+        }
+    }
+    for (int i = 0; i < 1 << PENDING_BITS; i++) {
+        if (seen->pending[i].offset != 0) {
+            bloom_insert(filter, seen->pending[i].hash);
+        }
+    }
+    bloom_delete(seen->filter);
+    seen->filter = filter;
+    seen->capacity *= 2;
+}
+
+// Adds url to the log and the batch unless it is in the set; maybe is the
+// filter's answer. Returns as seen_insert does.
+static int insertOnDisk(seen_t* seen, const char* url, const size_t len,
+                        const uint64_t hash, const bool maybe)
+{
+    if (maybe && (findSlot(seen, seen->pending, PENDING_BITS, url, len, hash, true)->offset != 0
+                  || findSlot(seen, seen->slots, seen->bits, url, len, hash, true)->offset != 0)) {
+        return 0;
+    }
+    if (seen->numPending == SEEN_BATCH && !mergePending(seen)) {
+        return -1;
+    }
+    const char* bytes = url;
+    size_t left = len + 1;
+    uint64_t offset = seen->logBytes;
+    while (left > 0) {
+        ssize_t n = pwrite(seen->logFd, bytes, left, (off_t)offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        bytes += n;
+        offset += n;
+        left -= n;
+    }
+    slot_t* slot = findSlot(seen, seen->pending, PENDING_BITS, url, len, hash, false);
+    slot->hash = hash;
+    slot->offset = seen->logBytes + 1;
+    seen->numPending++;
+    seen->logBytes = offset;
+    return 1;
+}
+
+/**************** global functions ****************/
+
+seen_t* seen_new(const char* directory)
+{
+    seen_t* seen = calloc(1, sizeof(seen_t));
+    if (seen == NULL) {
+        return NULL;
+    }
+    seen->logFd = seen->tableFd = -1;
+    bool ok;
+    if (directory == NULL) {
+        seen->urls = intern_new(NULL);
+        ok = seen->urls != NULL;
+    } else {
+        seen->capacity = SEEN_CAPACITY;
+        seen->filter = bloom_new(seen->capacity);
+        seen->directory = malloc(strlen(directory) + 1);
+        seen->pending = calloc((size_t)1 << PENDING_BITS, sizeof(slot_t));
+        ok = seen->filter != NULL && seen->directory != NULL && seen->pending != NULL;
+        if (ok) {
+            strcpy(seen->directory, directory);
+            seen->logFd = tempFile(directory);
+            seen->bits = TABLE_BITS;
+            seen->slots = mapTable(directory, seen->bits, &seen->tableFd);
+            ok = seen->logFd >= 0 && seen->slots != NULL;
+        }
+    }
+    if (!ok) {
+        seen_delete(seen);
+        return NULL;
+    }
+    return seen;
+}
+
+int seen_insert(seen_t* seen, const char* url)
+{
+    if (seen == NULL || url == NULL) {
+        return -1;
+    }
+    if (seen->urls != NULL) {
+        int count = intern_count(seen->urls);
+        int id = intern_add(seen->urls, url);
+        if (id < 0) {
+            return -1;
+        }
+        seen->count += id == count;
+        return id == count ? 1 : 0;  // a new URL gets the next ID
+    }
+
+    size_t len = strlen(url);
+    uint64_t hash = hash_bytes(url, len);
+    int added = insertOnDisk(seen, url, len, hash, bloom_find(seen->filter, hash));
+    if (added == 1) {
+        bloom_insert(seen->filter, hash);
+        if (++seen->count > seen->capacity) {
+            growFilter(seen);
+        }
+    }
+    return added;
+}
+
+size_t seen_count(seen_t* seen)
+{
+    return seen != NULL ? seen->count : 0;
+}
+
+void seen_delete(seen_t* seen)
+{
+    if (seen == NULL) {
+        return;
+    }
+    intern_delete(seen->urls);
+    bloom_delete(seen->filter);
+    if (seen->slots != NULL) {
+        munmap(seen->slots, ((size_t)1 << seen->bits) * sizeof(slot_t));
+    }
+    if (seen->tableFd >= 0) {
+        close(seen->tableFd);
+    }
+    if (seen->logFd >= 0) {
+        close(seen->logFd);
+    }
+    free(seen->pending);
+    free(seen->directory);
+    free(seen);
+}
@@ -0,0 +1,71 @@
+/*
+ * seen.h - header file for the 'seen' module
+ *
+ * The crawler's set of the URLs it has seen, which it asks about every
+ * link of every page it scans.
+ *
+ * The set is kept either in memory, in an intern table (see
+ * libcs50/intern.h), or, for crawls too large for that, in a pair of files
+ * in a directory: an append-only log of the URLs, and an open-addressing
+ * table of their hashes and offsets in the log, mapped into memory so
+ * that the kernel pages it to and from disk as it likes. On disk, a Bloom
+ * filter (see libcs50/bloom.h) in front of the files answers "not seen"
+ * for nearly every new URL, which is then appended to the log and to a
+ * batch of SEEN_BATCH URLs merged into the table all at once, so that it
+ * touches neither file's pages at random. The files are read only to
+ * confirm the filter's "perhaps": a slot or two of the table and the URL
+ * a slot points to. So the crawler's own memory holds the filter,
+ * BLOOM_BITS to twice that many bits per URL, and the batch. Both files
+ * are removed as soon as they are created, so they vanish when the set is
+ * deleted or the crawler exits, however it exits.
+ *
+ * The filter is made for SEEN_CAPACITY URLs, and rebuilt twice as large
+ * each time the set outgrows it, from the hashes in the table. In memory
+ * there is no filter: the intern table itself answers most lookups of a
+ * new URL with one probe, as fast as a filter would.
+ *
+ * Compilation requires: libcs50 (bloom.h, intern.h, hash.h) and POSIX
+ * files and mmap.
+ */
+
+#ifndef __SEEN_H
+#define __SEEN_H
+
+#include <stddef.h>
+
+#define SEEN_CAPACITY (1 << 16)  // URLs the first filter is made for
+#define SEEN_BATCH 4096          // new URLs merged into the table on disk at once
+
+/*
+ * Struct definitions
+ */
+typedef struct seen seen_t;  // opaque to users of the module
+
+/*
+ * seen_new - creates an empty set, with its exact set in memory if
+ * directory is NULL, else on disk in (removed) files in directory.
+ *
+ * Returns the new set, or NULL if out of memory or the files cannot be
+ * created. The caller is responsible for later calling seen_delete().
+ */
+seen_t* seen_new(const char* directory);
+
+/*
+ * seen_insert - adds url to the set, unless it is already there.
+ *
+ * Returns 1 if url was not in the set and now is, 0 if it already was,
+ * or -1 if it could not be added (out of memory, or a file error).
+ */
+int seen_insert(seen_t* seen, const char* url);
+
+/*
+ * seen_count - returns the number of URLs in the set; 0 if seen is NULL.
+ */
+size_t seen_count(seen_t* seen);
+
+/*
+ * seen_delete - frees the set, and closes (so removes) its files; ignores NULL.
+ */
+void seen_delete(seen_t* seen);
+
+#endif // __SEEN_H
@@ -2,10 +2,16 @@
  * crawler.c - CS50 'crawler' module
  *
  * see crawler.h for more information.
- * Usage: ./crawler seedURL pageDirectory maxDepth
+ * Usage: ./crawler seedURL pageDirectory maxDepth [--seen-dir dir] [--frontier-dir dir]
+ *                  [--frontier-max n]
  * seedURL is an ‘internal’ directory, to be used as the initial URL
  * pageDirectory is the (existing) directory in which to write downloaded webpages
  * maxDepth is an integer in range [0..10] indicating the maximum crawl depth.
+ * With --seen-dir, the set of URLs seen is kept in files in the (existing) directory
+ * dir, with only its Bloom filter in memory (see seen.h), for crawls too large for memory.
+ * With --frontier-dir, at most --frontier-max (default FRONTIER_HEAD) of the URLs yet to
+ * crawl are kept in memory, and the rest in files in the (existing) directory dir (see
+ * frontier.h); without it, all of them are kept in memory.
  *
  * Tasnim Chowdhury, 1/31/24
  */
@@ -19,15 +25,15 @@
 #include "../common/pagedir.h"
 #include "../libcs50/webpage.h"
 #include "../libcs50/mem.h"
-#include "../libcs50/hashtable.h"
-#include "../libcs50/bag.h"
-
-const int tableSize = 200;
+#include "../common/seen.h"
+#include "../common/frontier.h"
 
 // Prototypes for functions used
-static void crawl(char* seedURL, char* pageDirectory, const int maxDepth);
-static void pageScan(webpage_t* page, bag_t* pagesToCrawl, hashtable_t* pagesSeen);
-static void parseArgs(const int argc, char* argv[], char** seedURL, char** pageDirectory, int* maxDepth);
+static void crawl(char* seedURL, char* pageDirectory, const int maxDepth, const char* seenDirectory,
+                  const char* frontierDirectory, const size_t frontierMax);
+static void pageScan(webpage_t* page, frontier_t* pagesToCrawl, seen_t* pagesSeen);
+static void parseArgs(const int argc, char* argv[], char** seedURL, char** pageDirectory, int* maxDepth,
+                      char** seenDirectory, char** frontierDirectory, size_t* frontierMax);
 static void logr(const char *word, const int depth, const char *url);
 
 
@@ -51,16 +57,21 @@ static void logr(const char *word, const int depth, const char *url);
  *  - It handles incorrect number of arguments by displaying usage information.
  */
 int main(const int argc, char* argv[]) {
-    if (argc != 4) {
-        fprintf(stderr, "Usage: ./crawler seedURL pageDirectory maxDepth\n");
+    if (argc < 4 || (argc - 4) % 2 != 0) {
+        fprintf(stderr, "Usage: ./crawler seedURL pageDirectory maxDepth [--seen-dir dir] "
+                "[--frontier-dir dir] [--frontier-max n]\n");
         exit(1);
     }
     char* normalizedSeedURL = NULL;
     char* pageDirectory = NULL;
+    char* seenDirectory = NULL;
+    char* frontierDirectory = NULL;
+    size_t frontierMax;
     int maxDepth;
 
-    parseArgs(argc, argv, &normalizedSeedURL, &pageDirectory, &maxDepth);
-    crawl(normalizedSeedURL, pageDirectory, maxDepth);
+    parseArgs(argc, argv, &normalizedSeedURL, &pageDirectory, &maxDepth, &seenDirectory,
+              &frontierDirectory, &frontierMax);
+    crawl(normalizedSeedURL, pageDirectory, maxDepth, seenDirectory, frontierDirectory, frontierMax);
     exit(0);
 }
 
@@ -90,12 +101,44 @@ static void logr(const char *word, const int depth, const char *url)
  *  - seedURL: Pointer to store the normalized seed URL
  *  - pageDirectory: Pointer to store the page directory path
  *  - maxDepth: Pointer to store the maximum crawl depth
+ *  - seenDirectory: Pointer to store the --seen-dir directory, or NULL without one
+ *  - frontierDirectory: Pointer to store the --frontier-dir directory, or NULL without one
+ *  - frontierMax: Pointer to store --frontier-max, or FRONTIER_HEAD without it
  *
  * Exits:
  *  - Program exits if any argument is invalid with an error message.
  */
 static void parseArgs(const int argc, char* argv[], 
-                      char** seedURL, char** pageDirectory, int* maxDepth) {
+                      char** seedURL, char** pageDirectory, int* maxDepth,
+                      char** seenDirectory, char** frontierDirectory, size_t* frontierMax) {
+
+    /* Parse the options, in pairs after the three arguments */
+    *seenDirectory = NULL;
+    *frontierDirectory = NULL;
+    *frontierMax = FRONTIER_HEAD;
+    bool maxGiven = false;
+    for (int i = 4; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--seen-dir") == 0) {
+            *seenDirectory = argv[i + 1];
+        } else if (strcmp(argv[i], "--frontier-dir") == 0) {
+            *frontierDirectory = argv[i + 1];
+        } else if (strcmp(argv[i], "--frontier-max") == 0) {
+            long max = atol(argv[i + 1]);
+            if (max <= 0) {
+                fprintf(stderr, "--frontier-max must be a positive integer.\n");
+                exit(1);
+            }
+            *frontierMax = max;
+            maxGiven = true;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            exit(1);
+        }
+    }
+    if (maxGiven && *frontierDirectory == NULL) {
+        fprintf(stderr, "--frontier-max needs --frontier-dir.\n");
+        exit(1);
+    }
 
     /* Normalize the seed URL and check if it's an internal URL */
     char* normalizedSeedURL = normalizeURL(argv[1]);
@@ -132,47 +175,41 @@ static void parseArgs(const int argc, char* argv[],
  * Function: pageScan
  * -------------------
  * Scans a given webpage for URLs and processes each found URL. 
- * It extracts URLs, filters out non-internal ones, checks for duplicates using a hashtable, 
- * and adds new URLs to both the hashtable and a bag for further crawling.
+ * It extracts URLs, filters out non-internal ones, checks for duplicates using the set of
+ * URLs seen, and adds new URLs to both that set and the frontier for further crawling.
  *
  * Parameters:
  *  - page: The webpage to be scanned for URLs
- *  - pagesToCrawl: The bag where new webpages to be crawled are added
- *  - pagesSeen: The hashtable used to track URLs that have already been seen
+ *  - pagesToCrawl: The frontier where the URLs of new webpages to be crawled are added
+ *  - pagesSeen: The set used to track URLs that have already been seen
  *
  * Notes:
  *  - The function ignores URLs that are either non-internal or already seen.
- *  - New URLs are duplicated, added to the hashtable, and wrapped in a new webpage object
- *    before being added to the bag.
+ *  - Each URL is looked up and, if new, copied into the seen set in one call; the
+ *    extracted string itself is handed to the frontier with its depth, and only
+ *    made into a webpage object when it is taken out to be crawled.
  *  - The function handles memory allocation failures and avoids duplicate entries.
  */
-static void pageScan(webpage_t* page, bag_t* pagesToCrawl, hashtable_t* pagesSeen) {
+static void pageScan(webpage_t* page, frontier_t* pagesToCrawl, seen_t* pagesSeen) {
     int pos = 0;
     char *result;
 
     while ((result = webpage_getNextURL(page, &pos)) != NULL) {
         if (isInternalURL(result)) {
-            if (hashtable_find(pagesSeen, result) == NULL) {
-                char* urlForWebpage = strdup(result);
-                if (urlForWebpage == NULL) {
-                    fprintf(stderr, "Failed to duplicate URL.\n");
-                    free(result);
-                    continue;
-                }
-                if (!hashtable_insert(pagesSeen, urlForWebpage, urlForWebpage)) {
-                    free(urlForWebpage); // Clean up if insertion fails
-                } else {
-                    webpage_t *newPage = webpage_new(urlForWebpage, webpage_getDepth(page) + 1, NULL);
-                    if (newPage == NULL) {
-                        continue;
-                    }
-                    bag_insert(pagesToCrawl, newPage);
-                    logr("Added", webpage_getDepth(page) + 1, urlForWebpage); 
+            int added = seen_insert(pagesSeen, result);
+            if (added < 0) {
+                fprintf(stderr, "Failed to record URL.\n");
+                free(result); // Clean up if insertion fails
+            } else if (added > 0) {
+                logr("Added", webpage_getDepth(page) + 1, result);
+                // The frontier takes over result
+                if (!frontier_push(pagesToCrawl, result, webpage_getDepth(page) + 1)) {
+                    fprintf(stderr, "Failed to queue URL.\n");
                 }
             } else {
                 logr("IgnDupl", webpage_getDepth(page), result);
+                free(result); // Free the result
             }
-            free(result); // Free the result
         } else {
             logr("IgnExtrn", webpage_getDepth(page), result);
             free(result);
@@ -186,8 +223,9 @@ static void pageScan(webpage_t* page, bag_t* pagesToCrawl, hashtable_t* pagesSee
  * Crawls webpages starting from a seed URL up to a specified maximum depth,
  * and saves each webpage to the given page directory.
  *
- * This function initializes necessary data structures (a hashtable and a bag)
- * to keep track of visited URLs and URLs to visit. It performs the crawling 
+ * This function initializes necessary data structures (a seen set and a frontier)
+ * to keep track of visited URLs and URLs to visit, which it visits in the order
+ * found, so breadth-first. It performs the crawling 
  * process by fetching webpages, scanning for new URLs, and saving the content.
  * In case of failure in fetching a webpage, it logs an error message.
  *
@@ -195,50 +233,68 @@ static void pageScan(webpage_t* page, bag_t* pagesToCrawl, hashtable_t* pagesSee
  *  - seedURL: The initial URL from which to start crawling
  *  - pageDirectory: The directory where the webpages are saved
  *  - maxDepth: The maximum depth for crawling
+ *  - seenDirectory: Where to keep the set of URLs seen, or NULL to keep it in memory
+ *  - frontierDirectory: Where to spill URLs to visit, or NULL to keep them all in memory
+ *  - frontierMax: URLs to visit kept in memory, with a frontierDirectory
  *
  * Notes:
- *  - The function uses hashtable and bag data structures from libcs50.
+ *  - The function uses the seen set and the frontier of common.
  *  - Each webpage is assigned a unique document ID as it's saved.
  *  - Crawling is paused for 1 second between fetching webpages to avoid overloading servers.
  *  - The function handles errors in data structure creation and webpage fetching.
  */
-static void crawl(char* seedURL, char* pageDirectory, const int maxDepth) 
+static void crawl(char* seedURL, char* pageDirectory, const int maxDepth, const char* seenDirectory,
+                  const char* frontierDirectory, const size_t frontierMax)
 {
-    /* Initialize hashtable and bag */
-    hashtable_t* ht = hashtable_new(tableSize);
-    if (ht == NULL) {
-        fprintf(stderr, "Failed to create hashtable.\n");
+    /* Initialize seen set and frontier */
+    seen_t* seen = seen_new(seenDirectory);
+    if (seen == NULL) {
+        fprintf(stderr, "Failed to create the set of URLs seen%s%s.\n",
+                seenDirectory != NULL ? " in " : "", seenDirectory != NULL ? seenDirectory : "");
+        free(seedURL);
         return;
     }
 
-    bag_t* bag = bag_new();
-    if (bag == NULL) {
-        fprintf(stderr, "Failed to create bag.\n");
-        hashtable_delete(ht, webpage_delete);
+    frontier_t* frontier = frontier_new(frontierDirectory, frontierMax);
+    if (frontier == NULL) {
+        fprintf(stderr, "Failed to create frontier.\n");
+        seen_delete(seen);
+        free(seedURL);
         return;
     }
 
-    /* Create and add seed webpage to bag */
-    webpage_t *seed = webpage_new(seedURL, 0, NULL);
-    if (seed == NULL) {
-        fprintf(stderr, "Failed to create seed webpage.\n");
-        hashtable_delete(ht, webpage_delete);
-        bag_delete(bag, NULL);
+    /* Mark seed URL seen, and add it to frontier, which takes it over */
+    int added = seen_insert(seen, seedURL);
+    if (added < 0) {
+        free(seedURL); // Not handed to the frontier
+    }
+    if (added < 0 || !frontier_push(frontier, seedURL, 0)) {
+        fprintf(stderr, "Failed to queue seed URL.\n");
+        seen_delete(seen);
+        frontier_delete(frontier);
         return;
     }
-    bag_insert(bag, seed);
     int docID = 1; // Start document ID from 1
 
     /* Crawl process */
-    webpage_t *curr;
-    while ((curr = bag_extract(bag)) != NULL) {
+    char* url;
+    int depth;
+    while ((url = frontier_pop(frontier, &depth)) != NULL) {
+        webpage_t *curr = webpage_new(url, depth, NULL);  // takes over url
+        if (curr == NULL) {
+            fprintf(stderr, "Failed to create webpage: %s\n", url);
+            free(url);
+            continue;
+        }
+#ifndef NOSLEEP // build with -DNOSLEEP only to crawl a local server
         sleep(1); // Pause to avoid server overload
+#endif
         if (webpage_fetch(curr)) {
             logr("Fetched", webpage_getDepth(curr), webpage_getURL(curr));
             pagedir_save(curr, pageDirectory, docID++);
             if (webpage_getDepth(curr) < maxDepth) {
                 logr("Scanning", webpage_getDepth(curr), webpage_getURL(curr));
-                pageScan(curr, bag, ht);   
+                pageScan(curr, frontier, seen);   
             }
         } else {
             fprintf(stderr, "Failed to fetch webpage: %s\n", webpage_getURL(curr));
@@ -246,8 +302,13 @@ static void crawl(char* seedURL, char* pageDirectory, const int maxDepth)
         webpage_delete(curr); // Clean up after processing
     }
 
+    if (frontier_count(frontier) > 0) {
+        fprintf(stderr, "Failed to read %zu URLs back from the frontier.\n",
+                frontier_count(frontier));
+    }
+
     /* Clean up data structures */
-    hashtable_delete(ht, NULL);
-    bag_delete(bag, webpage_delete);
+    seen_delete(seen);
+    frontier_delete(frontier);
 }
 
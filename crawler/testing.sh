@@ -49,4 +49,51 @@ echo "Crawling wikipedia_2, depth = 1"
 ./crawler http://cs50tse.cs.dartmouth.edu/tse/wikipedia/index.html ../data/crawldata/wikipedia_2 1
 echo -e "Sample a file in wikipedia\n"
 head -3 ../data/crawldata/wikipedia_2/6
-echo "-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-"
\ No newline at end of file
+echo "-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-"
+
+# Testing the options with a missing value, and an unknown option
+echo -e "Testing options with a missing value, and an unknown option\n"
+./crawler http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/crawldata/letters-0 2 --seen-dir
+./crawler http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/crawldata/letters-0 2 --seen dir
+echo "-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-"
+
+# Keeping the URLs seen on disk saves the same pages as keeping them in memory
+echo "Crawling letters-3 with and without --seen-dir, depth = 10"
+echo "-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-"
+mkdir -p ../data/crawldata/letters-3 ../data/crawldata/letters-3-seen
+seenDir=$(mktemp -d)
+./crawler http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/crawldata/letters-3 10
+./crawler http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/crawldata/letters-3-seen 10 \
+    --seen-dir $seenDir
+diff -r ../data/crawldata/letters-3 ../data/crawldata/letters-3-seen \
+    && echo "The crawl with --seen-dir saved the same pages."
+rm -rf $seenDir
+
+# The crawl is breadth-first: no page is deeper than the page after it
+echo "Checking that letters-3 is numbered breadth-first"
+for doc in $(ls ../data/crawldata/letters-3 | grep '^[0-9]*$' | sort -n); do
+    sed -n 2p ../data/crawldata/letters-3/$doc
+done | sort -n -c && echo "The pages are numbered breadth-first."
+echo "-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-"
+
+# Testing --frontier-max errors: not positive, and without --frontier-dir
+echo -e "Testing --frontier-max errors\n"
+./crawler http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/crawldata/letters-0 2 \
+    --frontier-dir /tmp --frontier-max 0
+./crawler http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/crawldata/letters-0 2 \
+    --frontier-max 5
+echo "-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-"
+
+# A frontier holding one URL in memory spills the rest to disk and reads them back
+# segment by segment, still saving the same pages, in the same order, as toscrape-3
+echo "Crawling toscrape-3 with --frontier-max 1, depth = 1"
+echo "-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-"
+mkdir -p ../data/crawldata/toscrape-3-frontier
+frontierDir=$(mktemp -d)
+./crawler http://cs50tse.cs.dartmouth.edu/tse/toscrape/index.html ../data/crawldata/toscrape-3-frontier 1 \
+    --frontier-dir $frontierDir --frontier-max 1
+diff -r ../data/crawldata/toscrape-3 ../data/crawldata/toscrape-3-frontier \
+    && echo "The crawl with --frontier-max 1 saved the same pages."
+ls -A $frontierDir | wc -l | xargs echo "Segment files left behind:"
+rm -rf $frontierDir
+echo "-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-"
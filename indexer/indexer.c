@@ -2,9 +2,14 @@
  * indexer.c - CS50 'indexer' module
  *
  * see indexer.h for more information.
- * Usage: ./indexer pageDirectory indexFilename
+ * Usage: ./indexer pageDirectory indexFilename [--binary] [--shards n] [--partition range|hash]
  * reads the document files produced by the TSE crawler from pageDirectory dir, builds an index, 
  * and writes that index to a file named indexFilename
+ * (in the text format, or in the compressed binary format with --binary),
+ * along with the per-document word counts in indexFilename.stats
+ * With --shards n, the documents are split into n shards (by docID range, or by a hash of
+ * the docID with --partition hash), each indexed on its own in indexFilename.0 .. .n-1
+ * with its statistics, and indexFilename becomes the manifest that lists them
  *
  * Tasnim Chowdhury, 2/4/24
  */
@@ -21,9 +26,29 @@
 #include "indexer.h"
 
 //given arguments from command like, validate them into function parameters
-void parseArgs(const int argc, char* argv[], char** pageDirectory, char** indexFilename) {
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s pageDirectory indexFilename\n", argv[0]);
+void parseArgs(const int argc, char* argv[], char** pageDirectory, char** indexFilename, bool* binary,
+               int* numShards, bool* byHash) {
+    *binary = false;
+    *numShards = 0;
+    *byHash = false;
+    bool ok = argc >= 3;
+    for (int i = 3; ok && i < argc; i++) {
+        char extra;
+        if (strcmp(argv[i], "--binary") == 0) {
+            *binary = true;
+        } else if (strcmp(argv[i], "--shards") == 0 && i + 1 < argc) {
+            ok = sscanf(argv[++i], "%d%c", numShards, &extra) == 1
+                 && *numShards >= 1 && *numShards <= INDEX_MAX_SHARDS;
+        } else if (strcmp(argv[i], "--partition") == 0 && i + 1 < argc) {
+            *byHash = strcmp(argv[++i], "hash") == 0;
+            ok = *byHash || strcmp(argv[i], "range") == 0;
+        } else {
+            ok = false;
+        }
+    }
+    if (!ok) {
+        fprintf(stderr, "Usage: %s pageDirectory indexFilename [--binary] [--shards n] "
+                "[--partition range|hash]\n", argv[0]);
         exit(1);
     }
 
@@ -103,16 +128,103 @@ index_t* indexBuild(const char* dir)
         docID++;
         
     }
+    index_finish(index);  // pack the last partial block of every word
     return index;
 
 }
 
+//read the documents contents from page directory into numShards indexes, each page going
+//to the shard index_shardOf picks for it
+index_t** indexBuildShards(const char* dir, int numShards, bool byHash, int* numDocs)
+{
+    *numDocs = pagedir_count(dir);
+    if (*numDocs < numShards) {
+        fprintf(stderr, "Cannot split %d pages into %d shards.\n", *numDocs, numShards);
+        return NULL;
+    }
+    index_t** shards = calloc(numShards, sizeof(index_t*));
+    for (int s = 0; shards != NULL && s < numShards; s++) {
+        if ((shards[s] = index_new()) == NULL) {
+            indexDeleteShards(shards, numShards);
+            return NULL;
+        }
+    }
+    for (int docID = 1; shards != NULL && docID <= *numDocs; docID++) {
+        webpage_t* page = pagedir_load(dir, docID);
+        if (page == NULL) {
+            indexDeleteShards(shards, numShards);  // the directory changed under us
+            return NULL;
+        }
+        indexPage(shards[index_shardOf(docID, *numDocs, numShards, byHash)], page, docID);
+    }
+    for (int s = 0; shards != NULL && s < numShards; s++) {
+        index_finish(shards[s]);
+    }
+    return shards;
+}
+
+//write each shard with its statistics, then the manifest that lists them
+bool indexSaveShards(index_t** shards, int numShards, int numDocs, bool byHash,
+                     const char* indexFilename, bool binary)
+{
+    // Every shard's statistics carry the collection's counts, so BM25 ranks each
+    // shard's documents on the collection's scale
+    index_t collection = { .numDocs = numDocs };
+    for (int s = 0; s < numShards; s++) {
+        collection.totalWords += shards[s]->totalWords;
+    }
+    bool ok = true;
+    for (int s = 0; ok && s < numShards; s++) {
+        char shardFilename[strlen(indexFilename) + 16];
+        sprintf(shardFilename, INDEX_SHARD_FORMAT, indexFilename, s);
+        shards[s]->statsFrom = &collection;
+        ok = index_saveStats(shards[s], shardFilename);
+        shards[s]->statsFrom = NULL;
+        if (binary) {
+            ok = ok && index_save(shards[s], shardFilename);
+        } else if (ok) {
+            indexToFile(shards[s], shardFilename);
+        }
+    }
+    return ok && index_saveShards(indexFilename, numShards, byHash);
+}
+
+//free the shards built by indexBuildShards
+void indexDeleteShards(index_t** shards, int numShards)
+{
+    if (shards != NULL) {
+        for (int s = 0; s < numShards; s++) {
+            index_delete(shards[s]);
+        }
+        free(shards);
+    }
+}
+
 int main(const int argc, char* argv[]) {
     char *pageDirectory = NULL;
     char *indexFilename = NULL;
+    bool binary = false;
+    int numShards = 0;
+    bool byHash = false;
 
     // Parse command-line arguments and allocate memory for pageDirectory and indexFilename
-    parseArgs(argc, argv, &pageDirectory, &indexFilename);
+    parseArgs(argc, argv, &pageDirectory, &indexFilename, &binary, &numShards, &byHash);
+
+    // Build and write the shards, if asked to, instead of one index
+    if (numShards > 0) {
+        int numDocs = 0;
+        index_t** shards = indexBuildShards(pageDirectory, numShards, byHash, &numDocs);
+        bool ok = shards != NULL;
+        if (!ok) {
+            fprintf(stderr, "Failed to build index.\n");
+        } else if (!(ok = indexSaveShards(shards, numShards, numDocs, byHash, indexFilename, binary))) {
+            fprintf(stderr, "Failed to write the shards of %s.\n", indexFilename);
+        }
+        indexDeleteShards(shards, numShards);
+        free(pageDirectory);
+        free(indexFilename);
+        exit(ok ? 0 : 1);
+    }
 
     // Build the index using the validated and stored pageDirectory
     index_t *index = indexBuild(pageDirectory);
@@ -124,8 +236,20 @@ int main(const int argc, char* argv[]) {
         exit(1);
     }
 
+    // Write the document statistics that BM25 ranking needs beside the index, first,
+    // so that a querier that reloads when the index file changes finds them up to date
+    if (!index_saveStats(index, indexFilename)) {
+        fprintf(stderr, "Failed to write document statistics for %s.\n", indexFilename);
+    }
+
     // Write the index to the file specified by indexFilename
-    indexToFile(index, indexFilename);
+    if (binary) {
+        if (!index_save(index, indexFilename)) {
+            fprintf(stderr, "Failed to write index to %s.\n", indexFilename);
+        }
+    } else {
+        indexToFile(index, indexFilename);
+    }
 
     // Clean up: delete the index and free dynamically allocated memory
     index_delete(index);
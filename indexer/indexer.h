@@ -12,6 +12,7 @@
  *  - parseArgs: Validates and parses command-line arguments for the indexer.
  *  - indexPage: Processes a single webpage, extracting words and adding them to the index.
  *  - indexBuild: Constructs the index by processing all documents within a given directory.
+ *  - indexBuildShards, indexSaveShards, indexDeleteShards: the same, split into shards.
  *
  * CS50, February 2024
  * Tasnim Chowdhury
@@ -25,16 +26,21 @@
 
 /**
  * Validates command-line arguments and initializes function parameters.
- * Ensures exactly two arguments are passed and validates the provided pageDirectory
+ * Ensures two arguments are passed, optionally followed by --binary, --shards n (1 to
+ * INDEX_MAX_SHARDS) and --partition range|hash, and validates the provided pageDirectory
  * and indexFilename for their respective purposes.
  *
  * @param argc Number of command-line arguments.
  * @param argv Array of command-line arguments.
  * @param pageDirectory Pointer to char* that will be updated with the pageDirectory argument.
  * @param indexFilename Pointer to char* that will be updated with the indexFilename argument.
+ * @param binary Pointer to bool set to true if the index should be written in binary format.
+ * @param numShards Pointer to int set to the number of shards, or 0 for one unsharded index.
+ * @param byHash Pointer to bool set to true if shards are picked by hash, not by docID range.
  * Exits program on failure with appropriate error message.
  */
-void parseArgs(const int argc, char* argv[], char** pageDirectory, char** indexFilename);
+void parseArgs(const int argc, char* argv[], char** pageDirectory, char** indexFilename, bool* binary,
+               int* numShards, bool* byHash);
 
 /**
  * Adds words from a file into the index. Reads the content of a webpage file,
@@ -56,5 +62,40 @@ bool indexPage(index_t* index, webpage_t* page, int docID);
  */
 index_t* indexBuild(const char* dir);
 
+/**
+ * Builds numShards indexes from the contents of the page directory, adding each document
+ * to the shard index_shardOf picks for it. Each page is read once.
+ *
+ * @param dir The directory containing the crawler-produced files.
+ * @param numShards The number of shards; there must be at least as many pages.
+ * @param byHash Whether shards are picked by a hash of the docID rather than by docID range.
+ * @param numDocs Pointer to int set to the number of pages in the directory.
+ * @return An array of numShards indexes, to be freed with indexDeleteShards, or NULL on failure.
+ */
+index_t** indexBuildShards(const char* dir, int numShards, bool byHash, int* numDocs);
+
+/**
+ * Writes each shard to indexFilename.s (with the collection's document count and word
+ * total in its statistics), then the manifest listing them to indexFilename.
+ *
+ * @param shards The shards built by indexBuildShards.
+ * @param numShards The number of shards.
+ * @param numDocs The number of documents in the collection.
+ * @param byHash Whether the shards were picked by hash, recorded in the manifest.
+ * @param indexFilename The name of the manifest; the shards' names are built from it.
+ * @param binary Whether the shards are written in the binary format.
+ * @return True if every file was written, false otherwise.
+ */
+bool indexSaveShards(index_t** shards, int numShards, int numDocs, bool byHash,
+                     const char* indexFilename, bool binary);
+
+/**
+ * Frees the shards built by indexBuildShards; ignores NULL.
+ *
+ * @param shards The shards.
+ * @param numShards The number of shards.
+ */
+void indexDeleteShards(index_t** shards, int numShards);
+
 
 #endif // __INDEXER_H
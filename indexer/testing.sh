@@ -20,6 +20,33 @@ for dataset in "${datasets[@]}"; do
     fi
 done
 
+# The binary format must hold exactly the same index as the text format
+echo "Testing the binary index format..."
+for dataset in "letters-3" "toscrape-2" "wikipedia_1"; do
+    ./indexer ../data/crawldata/$dataset/ ../data/crawldata/$dataset/.index --binary
+    ./indextest ../data/crawldata/$dataset/.index ../data/crawldata/$dataset/.index2
+    ./indexer ../data/crawldata/$dataset/ ../data/crawldata/$dataset/.index
+    ~/cs50-dev/shared/tse/indexcmp ../data/crawldata/$dataset/.index ../data/crawldata/$dataset/.index2 &>../data/crawldata/output/cs-$dataset-binary.out
+    if [ -s ../data/crawldata/output/cs-$dataset-binary.out ]; then
+        echo "Failure in $dataset binary comparison. Check cs-$dataset-binary.out for details."
+    else
+        echo "$dataset binary passed."
+    fi
+done
+
+# Sharded indexes: a manifest, and shards that each load as an index of their own
+echo "Testing sharded indexes..."
+./indexer ../data/crawldata/toscrape-2/ ../data/crawldata/toscrape-2/.index --shards 3 --partition hash
+cat ../data/crawldata/toscrape-2/.index
+for shard in 0 1 2; do
+    ./indextest ../data/crawldata/toscrape-2/.index.$shard ../data/crawldata/toscrape-2/.index2 && echo "shard $shard loaded."
+done
+./indexer ../data/crawldata/toscrape-2/ ../data/crawldata/toscrape-2/.index --shards 2 --binary
+./indexer ../data/crawldata/letters-0/ ../data/crawldata/letters-0/.index --shards 4
+./indexer ../data/crawldata/letters-0/ ../data/crawldata/letters-0/.index --shards 0
+./indexer ../data/crawldata/letters-0/ ../data/crawldata/letters-0/.index --partition random
+rm -f ../data/crawldata/toscrape-2/.index.* ../data/crawldata/letters-0/.index.*
+
 # Memory leak checks with Valgrind on a subset
 echo "Performing memory leak checks with Valgrind..."
 valgrind --leak-check=full ./indexer ../data/crawldata/wikipedia_1/ ../data/crawldata/wikipedia_1/.index
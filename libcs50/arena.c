@@ -0,0 +1,149 @@
+/* 
+ * arena.c - CS50 'arena' module
+ *
+ * see arena.h for more information.
+ *
+ * Each slab is one anonymous mapping that starts with a slab_t header
+ * linking it to the slab mapped before it; allocations are carved from the
+ * rest of the newest slab in order. A request that does not fit what is
+ * left of that slab starts a new one, abandoning the remainder, so at most
+ * half of each slab is lost that way (bigger requests get a slab of their
+ * own, linked behind the current one so it stays in use). Fresh mappings
+ * are zero-filled, so allocations are too.
+ */
+
+#define _DEFAULT_SOURCE         // for MAP_ANONYMOUS
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include "arena.h"
+#include "mem.h"
+
+/**************** local types ****************/
+typedef struct slab {
+  struct slab* next;          // slab mapped before this one
+  size_t size;                // bytes mapped, header included
+  _Alignas(max_align_t) unsigned char data[];
+} slab_t;
+
+/**************** global types ****************/
+typedef struct arena {
+  slab_t* slabs;              // newest slab first
+  unsigned char* next;        // next free byte of the newest slab
+  unsigned char* end;         // end of the newest slab
+  size_t slab_size;           // size of the next slab to map
+  size_t bytes;               // bytes mapped in all
+} arena_t;
+
+/**************** local functions ****************/
+/* not visible outside this file */
+static slab_t* slab_map(arena_t* arena, const size_t size);
+
+/**************** arena_new() ****************/
+/* see arena.h for description */
+arena_t*
+arena_new(const size_t slab_size)
+{
+  arena_t* arena = mem_malloc(sizeof(arena_t));
+
+  if (arena == NULL) {
+    return NULL;              // error allocating arena
+  }
+  arena->slabs = NULL;
+  arena->next = arena->end = NULL;
+  arena->slab_size = slab_size > sizeof(slab_t) ? slab_size : ARENA_SLAB;
+  arena->bytes = 0;
+  return arena;
+}
+
+/**************** arena_alloc() ****************/
+/* see arena.h for description */
+void*
+arena_alloc(arena_t* arena, const size_t size)
+{
+  if (arena == NULL) {
+    return NULL;
+  }
+  size_t align = _Alignof(max_align_t);
+  size_t rounded = (size + align - 1) & ~(align - 1);
+  if (rounded < size) {
+    return NULL;              // size overflows
+  }
+  if ((size_t)(arena->end - arena->next) >= rounded) {
+    void* p = arena->next;
+    arena->next += rounded;
+    return p;
+  }
+
+  if (rounded > (arena->slab_size - sizeof(slab_t)) / 2) {
+    // a slab of its own, behind the newest so that one stays current
+    slab_t* slab = slab_map(arena, sizeof(slab_t) + rounded);
+    if (slab == NULL) {
+      return NULL;
+    }
+    if (arena->slabs != NULL) {
+      slab->next = arena->slabs->next;
+      arena->slabs->next = slab;
+    } else {
+      slab->next = NULL;
+      arena->slabs = slab;
+    }
+    return slab->data;
+  }
+
+  slab_t* slab = slab_map(arena, arena->slab_size);
+  if (slab == NULL) {
+    return NULL;
+  }
+  slab->next = arena->slabs;
+  arena->slabs = slab;
+  arena->next = slab->data + rounded;
+  arena->end = (unsigned char*)slab + slab->size;
+  if (arena->slab_size < ARENA_MAX_SLAB) {
+    arena->slab_size *= 2;
+  }
+  return slab->data;
+}
+
+/**************** arena_bytes() ****************/
+/* see arena.h for description */
+size_t
+arena_bytes(arena_t* arena)
+{
+  return arena == NULL ? 0 : arena->bytes;
+}
+
+/**************** arena_delete() ****************/
+/* see arena.h for description */
+void
+arena_delete(arena_t* arena)
+{
+  if (arena != NULL) {
+    slab_t* slab = arena->slabs;
+    while (slab != NULL) {
+      slab_t* next = slab->next;
+      munmap(slab, slab->size);
+      slab = next;
+    }
+    mem_free(arena);
+  }
+}
+
+/**************** slab_map() ****************/
+/* Map a slab of at least size bytes and count it; NULL if out of memory.
+ * The caller links it in.
+ */
+static slab_t*
+slab_map(arena_t* arena, const size_t size)
+{
+  void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) {
+    return NULL;
+  }
+  slab_t* slab = p;
+  slab->size = size;
+  arena->bytes += size;
+  return slab;
+}
@@ -0,0 +1,75 @@
+/* 
+ * arena.h - header file for CS50 'arena' module
+ *
+ * An *arena* hands out memory from a few large slabs, each allocation a
+ * bump of a pointer, and gives it all back at once when deleted: there is
+ * no freeing of single allocations. It suits structures that are built up
+ * and torn down whole, such as an index's hashtable entries and postings
+ * lists, which would otherwise be millions of small mallocs (each with
+ * the allocator's overhead) and as many frees.
+ *
+ * Slabs are mapped straight from the operating system, each twice the
+ * size of the one before (up to ARENA_MAX_SLAB), so deleting an arena
+ * takes a handful of munmap calls however much it holds. An arena is not
+ * safe to allocate from in two threads at once; memory it has handed out
+ * may be read by any number of threads.
+ */
+
+#ifndef __ARENA_H
+#define __ARENA_H
+
+#include <stddef.h>
+
+/**************** global types ****************/
+typedef struct arena arena_t;  // opaque to users of the module
+
+#define ARENA_SLAB (1 << 20)         // default size of the first slab
+#define ARENA_MAX_SLAB (64 << 20)    // slabs stop doubling at this size
+
+/**************** functions ****************/
+
+/**************** arena_new ****************/
+/* Create a new (empty) arena.
+ *
+ * Caller provides:
+ *   size of its first slab in bytes, or 0 for ARENA_SLAB.
+ * We return:
+ *   pointer to the new arena; NULL if error.
+ * Notes:
+ *   no slab is mapped until the first allocation.
+ * Caller is responsible for:
+ *   later calling arena_delete.
+ */
+arena_t* arena_new(const size_t slab_size);
+
+/**************** arena_alloc ****************/
+/* Allocate size bytes from the arena.
+ *
+ * Caller provides:
+ *   valid arena pointer, number of bytes.
+ * We return:
+ *   pointer to size bytes aligned for any type, zero-filled;
+ *   NULL if arena is NULL or out of memory.
+ * Notes:
+ *   the memory lives until arena_delete; it must not be passed to free.
+ *   A request larger than half a slab gets a slab of its own.
+ */
+void* arena_alloc(arena_t* arena, const size_t size);
+
+/**************** arena_bytes ****************/
+/* Return the number of bytes the arena has mapped (0 if arena is NULL),
+ * which bounds the memory it holds; useful when reporting memory use.
+ */
+size_t arena_bytes(arena_t* arena);
+
+/**************** arena_delete ****************/
+/* Delete the arena and every allocation made from it.
+ *
+ * Caller provides:
+ *   valid arena pointer, or NULL (ignored).
+ * Notes:
+ *   every pointer arena_alloc returned is invalid afterwards.
+ */
+void arena_delete(arena_t* arena);
+
+#endif // __ARENA_H
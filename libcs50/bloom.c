@@ -0,0 +1,115 @@
+/*
+ * bloom.c - CS50 'bloom' module
+ *
+ * see bloom.h for more information.
+ *
+ * The bits are an array of 512-bit blocks, aligned to 64 bytes. The low
+ * 32 bits of a hash pick its block, scaled onto the number of blocks by a
+ * multiply and shift; BLOOM_PROBES products of the hash with powers of an
+ * odd constant give, in their top 9 bits, the bits it sets in the block.
+ * With BLOOM_BITS bits per item, a blocked filter errs a little more
+ * often than one whose bits may fall anywhere, about 1% of the time at
+ * capacity, as blocks fill unevenly.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "bloom.h"
+#include "mem.h"
+
+/**************** file-local global variables ****************/
+static const uint64_t BLOOM_MIX = 0x9e3779b97f4a7c15;  // odd: 2^64 / golden ratio
+#define BLOCK_WORDS 8                                   // 64-bit words per block
+
+/**************** global types ****************/
+typedef struct bloom {
+  void* memory;               // what was allocated, for freeing
+  uint64_t* bits;             // num_blocks blocks of BLOCK_WORDS words
+  size_t num_blocks;
+} bloom_t;
+
+/**************** bloom_new() ****************/
+/* see bloom.h for description */
+bloom_t*
+bloom_new(const size_t capacity)
+{
+  bloom_t* bloom = mem_malloc(sizeof(bloom_t));
+  if (bloom == NULL) {
+    return NULL;
+  }
+  size_t block_bits = BLOCK_WORDS * 64;
+  bloom->num_blocks = (capacity * BLOOM_BITS + block_bits - 1) / block_bits;
+  if (bloom->num_blocks == 0) {
+    bloom->num_blocks = 1;
+  }
+  // one more block than needed, to align the first on a cache line
+  bloom->memory = mem_calloc(bloom->num_blocks + 1, BLOCK_WORDS * sizeof(uint64_t));
+  if (bloom->memory == NULL) {
+    mem_free(bloom);
+    return NULL;
+  }
+  uintptr_t address = (uintptr_t)bloom->memory;
+  bloom->bits = (uint64_t*)((address + 63) & ~(uintptr_t)63);
+  return bloom;
+}
+
+/**************** bloom_insert() ****************/
+/* see bloom.h for description */
+void
+bloom_insert(bloom_t* bloom, const uint64_t hash)
+{
+  if (bloom == NULL) {
+    return;
+  }
+  uint64_t* block = bloom->bits
+                    + ((hash & 0xffffffff) * bloom->num_blocks >> 32) * BLOCK_WORDS;
+  uint64_t probe = hash;
+  for (int i = 0; i < BLOOM_PROBES; i++) {
+    probe *= BLOOM_MIX;
+    int bit = (int)(probe >> 55);       // 0 to 511
+    block[bit >> 6] |= (uint64_t)1 << (bit & 63);
+  }
+}
+
+/**************** bloom_find() ****************/
+/* see bloom.h for description */
+bool
+bloom_find(bloom_t* bloom, const uint64_t hash)
+{
+  if (bloom == NULL) {
+    return false;
+  }
+  const uint64_t* block = bloom->bits
+                          + ((hash & 0xffffffff) * bloom->num_blocks >> 32) * BLOCK_WORDS;
+  uint64_t probe = hash;
+  for (int i = 0; i < BLOOM_PROBES; i++) {
+    probe *= BLOOM_MIX;
+    int bit = (int)(probe >> 55);
+    if ((block[bit >> 6] & ((uint64_t)1 << (bit & 63))) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**************** bloom_bytes() ****************/
+/* see bloom.h for description */
+size_t
+bloom_bytes(bloom_t* bloom)
+{
+  return bloom != NULL ? bloom->num_blocks * BLOCK_WORDS * sizeof(uint64_t) : 0;
+}
+
+/**************** bloom_delete() ****************/
+/* see bloom.h for description */
+void
+bloom_delete(bloom_t* bloom)
+{
+  if (bloom != NULL) {
+    mem_free(bloom->memory);
+    mem_free(bloom);
+  }
+}
@@ -0,0 +1,67 @@
+/*
+ * bloom.h - header file for CS50 'bloom' module
+ *
+ * A *bloom* filter is a compact, inexact set of 64-bit hashes (such as
+ * hash_bytes of strings, see hash.h): asked whether it holds a hash, it
+ * answers either "certainly not", or "perhaps", which is wrong for about
+ * 1% of hashes never inserted when the filter holds as many as it was
+ * made for. It takes BLOOM_BITS bits per item it was made for, whatever
+ * the items are, so it can sit in front of a large exact set (in memory
+ * or on disk) and spare it most lookups of items it does not hold.
+ * Items cannot be removed, and a filter past its capacity answers
+ * "perhaps" more and more often; the holder rebuilds a larger one.
+ *
+ * The filter is split into blocks of one cache line, and all of a hash's
+ * bits fall in the block it picks, so an insert or lookup touches one
+ * cache line.
+ */
+
+#ifndef __BLOOM_H
+#define __BLOOM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**************** global types ****************/
+typedef struct bloom bloom_t;  // opaque to users of the module
+
+#define BLOOM_BITS 10     // bits per item of capacity
+#define BLOOM_PROBES 7    // bits set per item
+
+/**************** functions ****************/
+
+/**************** bloom_new ****************/
+/* Create a new (empty) filter.
+ *
+ * Caller provides:
+ *   the number of items the filter should hold at its designed error rate.
+ * We return:
+ *   pointer to the new filter; NULL if error.
+ * Caller is responsible for:
+ *   later calling bloom_delete.
+ */
+bloom_t* bloom_new(const size_t capacity);
+
+/**************** bloom_insert ****************/
+/* Add a hash to the filter; ignores a NULL filter.
+ */
+void bloom_insert(bloom_t* bloom, const uint64_t hash);
+
+/**************** bloom_find ****************/
+/* Return false if the hash was certainly never inserted in the filter
+ * (or the filter is NULL); true if it may have been.
+ */
+bool bloom_find(bloom_t* bloom, const uint64_t hash);
+
+/**************** bloom_bytes ****************/
+/* Return the size of the filter's bits in bytes; 0 if bloom is NULL.
+ */
+size_t bloom_bytes(bloom_t* bloom);
+
+/**************** bloom_delete ****************/
+/* Delete the filter; ignores NULL.
+ */
+void bloom_delete(bloom_t* bloom);
+
+#endif // __BLOOM_H
@@ -1,8 +1,10 @@
 /* =========================================================================
- * hash.c - Jenkins' Hash, maps from string to integer
+ * hash.c - Jenkins' Hash, maps from string to integer;
+ *          and a faster 64-bit hash of byte strings (wyhash)
  *
  * Implementation details can be found at:
  *     http://www.burtleburtle.net/bob/hash/doobs.html
+ *     https://github.com/wangyi-fudan/wyhash (public domain)
  * ========================================================================= 
  */
 
@@ -32,3 +34,117 @@ hash_jenkins(const char* str, const unsigned long mod)
 
   return (hash % mod);
 }
+
+/**************** wyhash ****************/
+/* The core of wyhash is "mum": multiply two 64-bit words into 128 bits and
+ * fold the halves together, which mixes every input bit into every output
+ * bit in one multiply instruction. Keys are read with memcpy, which the
+ * compiler turns into single unaligned loads.
+ */
+
+// wyhash's default secret: four odd 64-bit constants with balanced bits
+static const uint64_t secret[4] = {
+  0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+  0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull
+};
+
+// multiply *a by *b into 128 bits: low half to *a, high half to *b
+static inline void
+mum(uint64_t* a, uint64_t* b)
+{
+#ifdef __SIZEOF_INT128__
+  __extension__ typedef unsigned __int128 uint128;
+  uint128 r = (uint128)*a * *b;
+  *a = (uint64_t)r;
+  *b = (uint64_t)(r >> 64);
+#else
+  uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+  uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  uint64_t t = rl + (rm0 << 32);
+  uint64_t c = t < rl;
+  uint64_t lo = t + (rm1 << 32);
+  c += lo < t;
+  *a = lo;
+  *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t
+mix(uint64_t a, uint64_t b)
+{
+  mum(&a, &b);
+  return a ^ b;
+}
+
+static inline uint64_t
+read8(const uint8_t* p)
+{
+  uint64_t v;
+  memcpy(&v, p, 8);
+  return v;
+}
+
+static inline uint64_t
+read4(const uint8_t* p)
+{
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+// hash_bytes - see header file for usage
+uint64_t
+hash_bytes(const void* key, const size_t len)
+{
+  const uint8_t* p = key;
+  uint64_t seed = mix(secret[0], secret[1]);
+  uint64_t a, b;
+
+  if (len <= 16) {
+    if (len >= 4) {
+      // two overlapping pairs of 4-byte reads cover 4 to 16 bytes
+      size_t skip = (len >> 3) << 2;
+      a = (read4(p) << 32) | read4(p + skip);
+      b = (read4(p + len - 4) << 32) | read4(p + len - 4 - skip);
+    } else if (len > 0) {
+      a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    size_t i = len;
+    if (i > 48) {
+      // three independent lanes of 16 bytes each
+      uint64_t seed1 = seed, seed2 = seed;
+      do {
+        seed = mix(read8(p) ^ secret[1], read8(p + 8) ^ seed);
+        seed1 = mix(read8(p + 16) ^ secret[2], read8(p + 24) ^ seed1);
+        seed2 = mix(read8(p + 32) ^ secret[3], read8(p + 40) ^ seed2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= seed1 ^ seed2;
+    }
+    while (i > 16) {
+      seed = mix(read8(p) ^ secret[1], read8(p + 8) ^ seed);
+      p += 16;
+      i -= 16;
+    }
+    // the last 16 bytes, overlapping the previous round if need be
+    a = read8(p + i - 16);
+    b = read8(p + i - 8);
+  }
+
+  a ^= secret[1];
+  b ^= seed;
+  mum(&a, &b);
+  return mix(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+// hash_string - see header file for usage
+uint64_t
+hash_string(const char* str)
+{
+  return hash_bytes(str, strlen(str));
+}
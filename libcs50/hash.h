@@ -1,14 +1,19 @@
 /* =========================================================================
- * hash.h - Jenkins' Hash, maps from string to integer
+ * hash.h - Jenkins' Hash, maps from string to integer;
+ *          and a faster 64-bit hash of byte strings (wyhash)
  *
  * Implementation details can be found at:
  *     http://www.burtleburtle.net/bob/hash/doobs.html
+ *     https://github.com/wangyi-fudan/wyhash
  * ========================================================================= 
  */
 
 #ifndef HASH_H
 #define HASH_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 /*
  * hash_jenkins - Bob Jenkins' one_at_a_time hash function
  * str: char buffer to hash (non-NULL)
@@ -18,4 +23,24 @@
  */
 unsigned long hash_jenkins(const char* str, const unsigned long mod);
 
+/*
+ * hash_bytes - Wang Yi's wyhash of len bytes at key
+ * key: the bytes to hash (may be NULL if len is 0)
+ * len: how many
+ *
+ * Returns the full 64-bit hash, every bit of which is well mixed, so a
+ * table of 2^k slots takes slot (hash & (2^k - 1)); callers may keep the
+ * hash to grow their table or to compare it before the key. It reads 8
+ * bytes per step (16 or 48 per round), so it is several times faster
+ * than hash_jenkins on all but the shortest keys. Hashes depend on the
+ * machine's byte order: use them in memory, never in files.
+ */
+uint64_t hash_bytes(const void* key, const size_t len);
+
+/*
+ * hash_string - hash_bytes of the characters of str (non-NULL), without
+ * its terminating '\0'.
+ */
+uint64_t hash_string(const char* str);
+
 #endif // HASH_H
@@ -0,0 +1,234 @@
+/*
+ * hashtable.c - CS50 'hashtable' module
+ *
+ * see hashtable.h for more information.
+ *
+ * Each slot holds a linked list of entries; each entry is one allocation
+ * holding its key's characters and the key's 64-bit hash_bytes, which
+ * lookups compare before the key itself, so a chain is walked without
+ * touching the keys that do not match. The number of slots is a power of
+ * two (num_slots rounded up), so a hash is reduced to a slot with a mask;
+ * and it doubles whenever the table holds more items than slots, moving
+ * the entries by their saved hashes, so chains stay short however many
+ * items the caller put in a table sized for few. A table made with
+ * hashtable_new_arena takes its entries from the arena and leaves freeing
+ * them to it; the slot array is always malloc'd, as it is replaced when
+ * the table grows.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "hashtable.h"
+#include "hash.h"
+#include "mem.h"
+
+/**************** local types ****************/
+typedef struct htnode {
+  struct htnode* next;        // link to next entry in this slot
+  void* item;                 // pointer to data for this item
+  uint64_t hash;              // hash_bytes of key
+  char key[];                 // copy of the key string
+} htnode_t;
+
+/**************** global types ****************/
+typedef struct hashtable {
+  htnode_t** slots;           // array of num_slots lists
+  size_t num_slots;           // a power of two
+  size_t num_items;           // items in all slots
+  arena_t* arena;             // where entries come from; NULL for malloc
+} hashtable_t;
+
+/**************** local functions ****************/
+/* not visible outside this file */
+static void hashtable_grow(hashtable_t* ht);
+
+/**************** hashtable_new() ****************/
+/* see hashtable.h for description */
+hashtable_t*
+hashtable_new(const int num_slots)
+{
+  if (num_slots <= 0) {
+    return NULL;
+  }
+  hashtable_t* ht = mem_malloc(sizeof(hashtable_t));
+  if (ht == NULL) {
+    return NULL;
+  }
+  ht->num_slots = 1;
+  while (ht->num_slots < (size_t)num_slots) {
+    ht->num_slots *= 2;
+  }
+  ht->num_items = 0;
+  ht->arena = NULL;
+  ht->slots = mem_calloc(ht->num_slots, sizeof(htnode_t*));
+  if (ht->slots == NULL) {
+    mem_free(ht);
+    return NULL;
+  }
+  return ht;
+}
+
+/**************** hashtable_new_arena() ****************/
+/* see hashtable.h for description */
+hashtable_t*
+hashtable_new_arena(const int num_slots, arena_t* arena)
+{
+  if (arena == NULL) {
+    return NULL;
+  }
+  hashtable_t* ht = hashtable_new(num_slots);
+  if (ht != NULL) {
+    ht->arena = arena;
+  }
+  return ht;
+}
+
+/**************** hashtable_insert() ****************/
+/* see hashtable.h for description */
+bool
+hashtable_insert(hashtable_t* ht, const char* key, void* item)
+{
+  if (ht == NULL || key == NULL || item == NULL) {
+    return false;
+  }
+  size_t len = strlen(key);
+  uint64_t hash = hash_bytes(key, len);
+  htnode_t** slot = &ht->slots[hash & (ht->num_slots - 1)];
+  for (htnode_t* node = *slot; node != NULL; node = node->next) {
+    if (node->hash == hash && strcmp(node->key, key) == 0) {
+      return false;           // key already exists
+    }
+  }
+
+  htnode_t* node = ht->arena != NULL ? arena_alloc(ht->arena, sizeof(htnode_t) + len + 1)
+                                      : mem_malloc(sizeof(htnode_t) + len + 1);
+  if (node == NULL) {
+    return false;             // error allocating entry
+  }
+  memcpy(node->key, key, len + 1);
+  node->hash = hash;
+  node->item = item;
+  node->next = *slot;
+  *slot = node;
+
+  if (++ht->num_items > ht->num_slots) {
+    hashtable_grow(ht);
+  }
+  return true;
+}
+
+/**************** hashtable_find() ****************/
+/* see hashtable.h for description */
+void*
+hashtable_find(hashtable_t* ht, const char* key)
+{
+  if (ht == NULL || key == NULL) {
+    return NULL;
+  }
+  uint64_t hash = hash_string(key);
+  for (htnode_t* node = ht->slots[hash & (ht->num_slots - 1)]; node != NULL;
+       node = node->next) {
+    if (node->hash == hash && strcmp(node->key, key) == 0) {
+      return node->item;
+    }
+  }
+  return NULL;
+}
+
+/**************** hashtable_print() ****************/
+/* see hashtable.h for description */
+void
+hashtable_print(hashtable_t* ht, FILE* fp,
+                void (*itemprint)(FILE* fp, const char* key, void* item))
+{
+  if (fp == NULL) {
+    return;
+  }
+  if (ht == NULL) {
+    fputs("(null)\n", fp);
+    return;
+  }
+  for (size_t i = 0; i < ht->num_slots; i++) {
+    if (itemprint != NULL) {
+      for (htnode_t* node = ht->slots[i]; node != NULL; node = node->next) {
+        (*itemprint)(fp, node->key, node->item);
+        if (node->next != NULL) {
+          fputc(',', fp);
+        }
+      }
+    }
+    fputc('\n', fp);
+  }
+}
+
+/**************** hashtable_iterate() ****************/
+/* see hashtable.h for description */
+void
+hashtable_iterate(hashtable_t* ht, void* arg,
+                  void (*itemfunc)(void* arg, const char* key, void* item) )
+{
+  if (ht == NULL || itemfunc == NULL) {
+    return;
+  }
+  for (size_t i = 0; i < ht->num_slots; i++) {
+    for (htnode_t* node = ht->slots[i]; node != NULL; node = node->next) {
+      (*itemfunc)(arg, node->key, node->item);
+    }
+  }
+}
+
+/**************** hashtable_delete() ****************/
+/* see hashtable.h for description */
+void
+hashtable_delete(hashtable_t* ht, void (*itemdelete)(void* item) )
+{
+  if (ht == NULL) {
+    return;
+  }
+  for (size_t i = 0; i < ht->num_slots; i++) {
+    htnode_t* node = ht->slots[i];
+    while (node != NULL) {
+      htnode_t* next = node->next;
+      if (itemdelete != NULL) {
+        (*itemdelete)(node->item);
+      }
+      if (ht->arena == NULL) {
+        mem_free(node);
+      }
+      node = next;
+    }
+  }
+  mem_free(ht->slots);
+  mem_free(ht);
+}
+
+/**************** hashtable_grow() ****************/
+/* Double the number of slots, moving every entry to the slot its saved
+ * hash picks in the new table. If memory for the new slots cannot be had,
+ * keep the old ones: the table still works, with longer chains.
+ */
+static void
+hashtable_grow(hashtable_t* ht)
+{
+  size_t num_slots = ht->num_slots * 2;
+  htnode_t** slots = mem_calloc(num_slots, sizeof(htnode_t*));
+  if (slots == NULL) {
+    return;
+  }
+  for (size_t i = 0; i < ht->num_slots; i++) {
+    htnode_t* node = ht->slots[i];
+    while (node != NULL) {
+      htnode_t* next = node->next;
+      htnode_t** slot = &slots[node->hash & (num_slots - 1)];
+      node->next = *slot;
+      *slot = node;
+      node = next;
+    }
+  }
+  mem_free(ht->slots);
+  ht->slots = slots;
+  ht->num_slots = num_slots;
+}
@@ -13,6 +13,7 @@
 
 #include <stdio.h>
 #include <stdbool.h>
+#include "arena.h"
 
 /**************** global types ****************/
 typedef struct hashtable hashtable_t;  // opaque to users of the module
@@ -33,6 +34,21 @@ typedef struct hashtable hashtable_t;  // opaque to users of the module
  */
 hashtable_t* hashtable_new(const int num_slots);
 
+/**************** hashtable_new_arena ****************/
+/* Create a new (empty) hashtable whose entries come from an arena.
+ *
+ * Caller provides:
+ *   number of slots, as for hashtable_new;
+ *   valid pointer to an arena (see arena.h).
+ * We return:
+ *   pointer to the new hashtable; return NULL if error.
+ * Notes:
+ *   each entry, with its copy of the key, is allocated from the arena
+ *   rather than with malloc, and hashtable_delete does not free them:
+ *   the arena does, when deleted, which must be after hashtable_delete.
+ */
+hashtable_t* hashtable_new_arena(const int num_slots, arena_t* arena);
+
 /**************** hashtable_insert ****************/
 /* Insert item, identified by key (string), into the given hashtable.
  *
@@ -0,0 +1,239 @@
+/* 
+ * intern.c - CS50 'intern' module
+ *
+ * see intern.h for more information.
+ *
+ * Strings are copied into blocks of INTERN_BLOCK bytes taken from the
+ * arena, one after the other with their terminating '\0's; a string too
+ * long for what is left of the current block starts a new block (of its
+ * own, if longer than a block). strings[id] points at the copy of string
+ * id, and hashes[id] holds the low 32 bits of its hash_bytes, enough to
+ * place it in the table and to rule out most mismatches without reading
+ * the string. The table holds id+1 in each used slot and 0 in free ones,
+ * and is probed linearly; it doubles before it would be more than half full.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "intern.h"
+#include "arena.h"
+#include "hash.h"
+#include "mem.h"
+
+/**************** file-local global variables ****************/
+static const size_t INTERN_BLOCK = 64 * 1024;  // bytes of strings per block
+static const int INTERN_SLOTS = 64;            // initial table size
+
+/**************** global types ****************/
+typedef struct intern {
+  arena_t* arena;             // holds the strings' bytes
+  bool own_arena;             // whether intern_delete deletes the arena
+  char* next;                 // next free byte of the current block
+  char* end;                  // end of the current block
+  const char** strings;       // strings[id]: the copy of string id
+  uint32_t* hashes;           // hashes[id]: low bits of its hash
+  int count;                  // strings in the table
+  int capacity;               // entries allocated in strings and hashes
+  int32_t* slots;             // open-addressing table of id+1, 0 if free
+  int num_slots;              // a power of two, more than twice count
+} intern_t;
+
+/**************** local functions ****************/
+/* not visible outside this file */
+static int32_t* intern_slot(intern_t* intern, const char* str, const uint32_t hash);
+static bool intern_grow(intern_t* intern);
+static const char* intern_copy(intern_t* intern, const char* str, const size_t len);
+
+/**************** intern_new() ****************/
+/* see intern.h for description */
+intern_t*
+intern_new(arena_t* arena)
+{
+  intern_t* intern = mem_malloc(sizeof(intern_t));
+  if (intern == NULL) {
+    return NULL;
+  }
+  intern->own_arena = arena == NULL;
+  intern->arena = arena != NULL ? arena : arena_new(0);
+  intern->next = intern->end = NULL;
+  intern->strings = NULL;
+  intern->hashes = NULL;
+  intern->count = intern->capacity = 0;
+  intern->num_slots = INTERN_SLOTS;
+  intern->slots = mem_calloc(intern->num_slots, sizeof(int32_t));
+  if (intern->arena == NULL || intern->slots == NULL) {
+    if (intern->own_arena) {
+      arena_delete(intern->arena);
+    }
+    mem_free(intern->slots);
+    mem_free(intern);
+    return NULL;
+  }
+  return intern;
+}
+
+/**************** intern_add() ****************/
+/* see intern.h for description */
+int
+intern_add(intern_t* intern, const char* str)
+{
+  if (intern == NULL || str == NULL) {
+    return -1;
+  }
+  size_t len = strlen(str);
+  uint32_t hash = (uint32_t)hash_bytes(str, len);
+  int32_t* slot = intern_slot(intern, str, hash);
+  if (*slot != 0) {
+    return *slot - 1;         // already interned
+  }
+  if ((intern->count + 1) * 2 > intern->num_slots) {
+    // keep the table at most half full; if it cannot grow, it may fill
+    // further, but always keeps a free slot to end probes
+    if (!intern_grow(intern) && intern->count + 2 > intern->num_slots) {
+      return -1;
+    }
+    slot = intern_slot(intern, str, hash);
+  }
+
+  if (intern->count == intern->capacity) {
+    int capacity = intern->capacity == 0 ? 64 : intern->capacity * 2;
+    const char** strings = realloc(intern->strings, sizeof(char*) * capacity);
+    if (strings == NULL) {
+      return -1;
+    }
+    intern->strings = strings;
+    uint32_t* hashes = realloc(intern->hashes, sizeof(uint32_t) * capacity);
+    if (hashes == NULL) {
+      return -1;
+    }
+    intern->hashes = hashes;
+    intern->capacity = capacity;
+  }
+  const char* copy = intern_copy(intern, str, len);
+  if (copy == NULL) {
+    return -1;
+  }
+  int id = intern->count++;
+  intern->strings[id] = copy;
+  intern->hashes[id] = hash;
+  *slot = id + 1;
+  return id;
+}
+
+/**************** intern_find() ****************/
+/* see intern.h for description */
+int
+intern_find(intern_t* intern, const char* str)
+{
+  if (intern == NULL || str == NULL) {
+    return -1;
+  }
+  return *intern_slot(intern, str, (uint32_t)hash_string(str)) - 1;
+}
+
+/**************** intern_string() ****************/
+/* see intern.h for description */
+const char*
+intern_string(intern_t* intern, const int id)
+{
+  if (intern == NULL || id < 0 || id >= intern->count) {
+    return NULL;
+  }
+  return intern->strings[id];
+}
+
+/**************** intern_count() ****************/
+/* see intern.h for description */
+int
+intern_count(intern_t* intern)
+{
+  return intern == NULL ? 0 : intern->count;
+}
+
+/**************** intern_delete() ****************/
+/* see intern.h for description */
+void
+intern_delete(intern_t* intern)
+{
+  if (intern != NULL) {
+    if (intern->own_arena) {
+      arena_delete(intern->arena);
+    }
+    free(intern->strings);
+    free(intern->hashes);
+    mem_free(intern->slots);
+    mem_free(intern);
+  }
+}
+
+/**************** intern_slot() ****************/
+/* Return the slot holding str's id+1, or the free slot where it belongs.
+ * The table is never full, so the probe ends.
+ */
+static int32_t*
+intern_slot(intern_t* intern, const char* str, const uint32_t hash)
+{
+  uint32_t mask = intern->num_slots - 1;
+  for (uint32_t i = hash & mask; ; i = (i + 1) & mask) {
+    int32_t* slot = &intern->slots[i];
+    if (*slot == 0 || (intern->hashes[*slot - 1] == hash
+                       && strcmp(intern->strings[*slot - 1], str) == 0)) {
+      return slot;
+    }
+  }
+}
+
+/**************** intern_grow() ****************/
+/* Double the table, placing every id by its saved hash; false if out of
+ * memory, leaving the table as it was.
+ */
+static bool
+intern_grow(intern_t* intern)
+{
+  int num_slots = intern->num_slots * 2;
+  int32_t* slots = mem_calloc(num_slots, sizeof(int32_t));
+  if (slots == NULL) {
+    return false;
+  }
+  uint32_t mask = num_slots - 1;
+  for (int id = 0; id < intern->count; id++) {
+    uint32_t i = intern->hashes[id] & mask;
+    while (slots[i] != 0) {
+      i = (i + 1) & mask;
+    }
+    slots[i] = id + 1;
+  }
+  mem_free(intern->slots);
+  intern->slots = slots;
+  intern->num_slots = num_slots;
+  return true;
+}
+
+/**************** intern_copy() ****************/
+/* Copy the len characters of str, and a '\0', into the current block
+ * (or a new one); return the copy, or NULL if out of memory.
+ */
+static const char*
+intern_copy(intern_t* intern, const char* str, const size_t len)
+{
+  if ((size_t)(intern->end - intern->next) < len + 1) {
+    size_t size = len + 1 > INTERN_BLOCK ? len + 1 : INTERN_BLOCK;
+    char* block = arena_alloc(intern->arena, size);
+    if (block == NULL) {
+      return NULL;
+    }
+    if (size > INTERN_BLOCK) {
+      memcpy(block, str, len + 1);
+      return block;           // a block of its own; keep the current one
+    }
+    intern->next = block;
+    intern->end = block + size;
+  }
+  char* copy = intern->next;
+  memcpy(copy, str, len + 1);
+  intern->next += len + 1;
+  return copy;
+}
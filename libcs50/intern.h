@@ -0,0 +1,78 @@
+/* 
+ * intern.h - header file for CS50 'intern' module
+ *
+ * An *intern* table gives each distinct string a small integer ID: 0 for
+ * the first string added, 1 for the next, and so on. A string's ID never
+ * changes, and the table keeps one copy of each string's bytes, packed end
+ * to end in large blocks of an arena (see arena.h), so a million short
+ * strings cost a million terminated strings and a few pointers each,
+ * rather than a malloc each. Holders of IDs compare and hash integers,
+ * and can keep per-string data in plain arrays indexed by ID.
+ *
+ * Lookups hash the string with hash_bytes into an open-addressing table of
+ * IDs. Reading (intern_find, intern_string) is safe from any number of
+ * threads while no thread adds.
+ */
+
+#ifndef __INTERN_H
+#define __INTERN_H
+
+#include <stdbool.h>
+#include "arena.h"
+
+/**************** global types ****************/
+typedef struct intern intern_t;  // opaque to users of the module
+
+/**************** functions ****************/
+
+/**************** intern_new ****************/
+/* Create a new (empty) intern table.
+ *
+ * Caller provides:
+ *   an arena to hold the strings' bytes, or NULL for the table to make
+ *   (and later delete) its own.
+ * We return:
+ *   pointer to the new table; NULL if error.
+ * Caller is responsible for:
+ *   later calling intern_delete, and then arena_delete on the arena, if
+ *   it provided one.
+ */
+intern_t* intern_new(arena_t* arena);
+
+/**************** intern_add ****************/
+/* Return the ID of str, adding a copy of str if it is not yet in the table.
+ *
+ * Caller provides:
+ *   valid pointer to table, valid string.
+ * We return:
+ *   the string's ID (>= 0); -1 if a parameter is NULL or out of memory.
+ * Notes:
+ *   the caller may reuse or free str afterwards.
+ */
+int intern_add(intern_t* intern, const char* str);
+
+/**************** intern_find ****************/
+/* Return the ID of str, or -1 if it is not in the table (or either
+ * parameter is NULL). The table is unchanged.
+ */
+int intern_find(intern_t* intern, const char* str);
+
+/**************** intern_string ****************/
+/* Return the table's copy of the string with the given ID, or NULL if
+ * there is no such ID. The copy lives as long as the table (and its
+ * arena) and must not be modified or freed.
+ */
+const char* intern_string(intern_t* intern, const int id);
+
+/**************** intern_count ****************/
+/* Return the number of strings in the table, which is one more than the
+ * largest ID; 0 if intern is NULL.
+ */
+int intern_count(intern_t* intern);
+
+/**************** intern_delete ****************/
+/* Delete the table, and its arena if it made its own; ignores NULL.
+ */
+void intern_delete(intern_t* intern);
+
+#endif // __INTERN_H
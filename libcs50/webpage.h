@@ -210,8 +210,13 @@ char* normalizeURL(const char* url);
  */
 bool isInternalURL(const char* url);
 
-// All normalized URLs beginning with this prefix are considered "internal"
+// All normalized URLs beginning with this prefix are considered "internal".
+// Build with -DTSE_INTERNAL_PREFIX='"http://host:port/path/"' to crawl another
+// site, such as the benchmark's local stand-in server.
+#ifndef TSE_INTERNAL_PREFIX
+#define TSE_INTERNAL_PREFIX "http://cs50tse.cs.dartmouth.edu/tse/"
+#endif
 static const
-char INTERNAL_PREFIX[] = "http://cs50tse.cs.dartmouth.edu/tse/";
+char INTERNAL_PREFIX[] = TSE_INTERNAL_PREFIX;
 
 #endif // __WEBPAGE_H
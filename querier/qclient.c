@@ -0,0 +1,116 @@
+/*
+ * qclient.c - client for the querier's server mode
+ *
+ * Usage: ./qclient address [--reload | --flush | --ingest]
+ *
+ * Connects to a querier started with --serve address, sends it each line of
+ * stdin as a query, and prints each answer as the querier's batch mode
+ * would: results to stdout, complaints to stderr, and a separator line on
+ * stdout after every valid query. The connection is kept for all the
+ * queries, so each one costs a round trip and nothing more.
+ *
+ * With --reload, reads no queries: asks the server to reload its index and
+ * prints the outcome once the server has switched to the new index. With
+ * --flush, asks the server to write the documents ingested so far into its
+ * index file. With --ingest, reads lines of the form "docID pageFile" from
+ * stdin and asks the server to index each page file (in the Crawler's format,
+ * a path the server can read) as document docID, stopping at the first that
+ * fails; each is searchable once its outcome is printed.
+ *
+ * Exits 0 when stdin is exhausted (or the command succeeded), 1 on bad
+ * arguments, if the server cannot be reached or goes away, or if a command
+ * failed.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include "../common/protocol.h"
+
+// Sends a control command on fd and prints the server's answer.
+// Returns true if the command succeeded.
+static bool control(int fd, const char* command) {
+    size_t commandLength = strlen(command) + 1;
+    char request[commandLength];
+    request[0] = PROTOCOL_CONTROL;
+    memcpy(request + 1, command, commandLength - 1);
+    size_t length = 0;
+    char* reply = NULL;
+    if (!protocol_send(fd, request, commandLength)
+        || (reply = protocol_recv(fd, PROTOCOL_MAX_REPLY, &length)) == NULL || length == 0) {
+        fprintf(stderr, "Lost the connection to the server.\n");
+        free(reply);
+        return false;
+    }
+    bool ok = reply[0] == PROTOCOL_RESULTS;
+    fwrite(reply + 1, 1, length - 1, ok ? stdout : stderr);
+    free(reply);
+    return ok;
+}
+
+int main(const int argc, char* argv[]) {
+    const char* mode = argc == 3 ? argv[2] : "";
+    if (argc != 2 && !(argc == 3 && (strcmp(mode, "--reload") == 0
+                                     || strcmp(mode, "--flush") == 0
+                                     || strcmp(mode, "--ingest") == 0))) {
+        fprintf(stderr, "Usage: %s address [--reload | --flush | --ingest]\n", argv[0]);
+        exit(1);
+    }
+    int fd = protocol_connect(argv[1]);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot connect to %s: %s\n", argv[1], strerror(errno));
+        exit(1);
+    }
+    if (strcmp(mode, "--reload") == 0 || strcmp(mode, "--flush") == 0) {
+        bool done = control(fd, mode + 2);
+        close(fd);
+        exit(done ? 0 : 1);
+    }
+
+    char* line = NULL;
+    size_t lineCap = 0;
+    ssize_t lineLength;
+    bool ok = true;
+    while (argc == 3 && ok && (lineLength = getline(&line, &lineCap, stdin)) >= 0) {
+        if (lineLength > 0 && line[lineLength - 1] == '\n') {
+            line[--lineLength] = '\0';
+        }
+        if (lineLength == 0 || lineLength > PROTOCOL_MAX_QUERY - 8) {
+            continue; // Blank, or too long for the server to take.
+        }
+        char command[lineLength + 8];
+        sprintf(command, "ingest %s", line);
+        ok = control(fd, command);
+    }
+    while (argc == 2 && ok && (lineLength = getline(&line, &lineCap, stdin)) >= 0) {
+        if (lineLength > 0 && line[lineLength - 1] == '\n') {
+            line[--lineLength] = '\0'; // Send the query without its newline.
+        }
+        size_t length = 0;
+        char* reply = NULL;
+        ok = protocol_send(fd, line, lineLength)
+             && (reply = protocol_recv(fd, PROTOCOL_MAX_REPLY, &length)) != NULL
+             && length > 0;
+        if (!ok) {
+            fprintf(stderr, "Lost the connection to %s.\n", argv[1]);
+        } else if (reply[0] == PROTOCOL_RESULTS) {
+            fwrite(reply + 1, 1, length - 1, stdout);
+            printf("-----------------------------------------------\n");
+        } else if (reply[0] == PROTOCOL_NOMATCH) {
+            fflush(stdout);
+            fwrite(reply + 1, 1, length - 1, stderr);
+            printf("-----------------------------------------------\n");
+        } else {
+            fflush(stdout);
+            fwrite(reply + 1, 1, length - 1, stderr);
+        }
+        free(reply);
+    }
+    free(line);
+    close(fd);
+    exit(ok ? 0 : 1);
+}
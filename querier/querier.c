@@ -3,9 +3,33 @@
  * The TSE Querier reads the index file produced by the TSE Indexer, and page
  * files produced by the TSE Crawler, and answers search queries submitted via stdin.
  * 
- * Usage: ./querier pageDirectory indexFilename
+ * Usage: ./querier pageDirectory indexFilename [--top k] [--rank count|bm25] [--cache KB]
+ *                  [--batch queryFile | --serve address] [--threads n] [--ranges n]
+ *                  [--timing ms] [--explain plan|analyze]
  * where pageDirectory is the pathname of a directory produced by the Crawler, and
- * where indexFilename is the pathname of a file produced by the Indexer.
+ * where indexFilename is the pathname of a file produced by the Indexer (an index, or the
+ * manifest of a sharded index, whose shards are all loaded and queried together).
+ * With --top k, only the k best-scoring documents of each query are printed.
+ * With --rank bm25, documents are scored with Okapi BM25 instead of word counts.
+ * With --cache KB, up to KB kilobytes of recent results are kept (default 1024; 0 turns
+ * the cache off); the index is reloaded, and the cache emptied, when the index file changes.
+ * With --batch queryFile, the queries in queryFile ("-" for stdin) are answered by n worker
+ * threads (default: one per online processor) and printed in input order, without prompts.
+ * With --serve address, the querier becomes a server: it loads the index once and answers
+ * queries sent by qclient over a Unix domain socket (address is a path) or loopback TCP
+ * (address is localhost:port), on n worker threads, until SIGINT or SIGTERM. SIGHUP, or
+ * "qclient address --reload", makes the server reload the index in the background and
+ * switch to it without stopping.
+ * With --ranges n, each query is evaluated on n docID ranges in parallel, by n - 1 range
+ * threads and the thread that asked, and the partial results are merged. A sharded index
+ * gets one range thread per shard as well, so each query is scattered over all its shards.
+ * With --timing ms, each query's phases are timed: their latency percentiles are printed to
+ * stderr at exit and on SIGUSR1, and every query that takes at least ms milliseconds is
+ * logged to stderr with its breakdown.
+ * With --explain plan, each query's results are followed by its plan: the tree of AND and OR
+ * operators it was compiled into and each word's document frequency. With --explain analyze,
+ * the query is also run again, instrumented, and the plan shows what each operator read and
+ * produced and how long it took.
  * 
  * Tasnim Chowdhury, 2/8/24
  */
@@ -15,46 +39,596 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/socket.h>
 #include "../libcs50/mem.h"
 #include "../common/index.h"
 #include "../common/word.h"
 #include "../common/pagedir.h"
-#include "../libcs50/hashtable.h"
-#include "../libcs50/counters.h"
+#include "../common/postings.h"
+#include "../common/query.h"
+#include "../common/cache.h"
+#include "../common/protocol.h"
+#include "../common/latency.h"
 #include "../libcs50/file.h"
+#include "../libcs50/webpage.h"
 #include "querier.h"
 
 const int MAX_WORDS = 20;
 const int WORD_LENGTH = 10;
+const int CACHE_KB = 1024; // Default result cache budget, in kilobytes.
+const int MAX_THREADS = 256; // Most worker threads a batch may use.
+const int RANGE_MIN_DOCS = 1024; // Narrowest docID range a query is split into.
+const int REWARM_KEYS = 256; // Most recent cached queries re-answered when reloading.
+const int FLUSH_DOCS = 1000; // Ingested documents that trigger a flush to the index file.
+const int FLUSH_SECONDS = 30; // Longest an ingested document waits for a flush.
 
-typedef struct duo {
-    counters_t* first;
-    counters_t* second;
-} duo_t;
+// Phases of answering a query, as --timing reports them: checking and tokenizing it, looking
+// it up in the cache (scoring excluded), scoring it on a miss, printing the results, and all
+// of them together.
+enum { PHASE_PARSE, PHASE_LOOKUP, PHASE_SCORE, PHASE_RANK, PHASE_TOTAL, NUM_PHASES };
+static const char* const PHASE_NAMES[NUM_PHASES] = { "parse", "lookup", "score", "rank",
+                                                     "total" };
 
 
 // Parses and validates command line arguments for pageDirectory and indexFilename.
-// Expects exactly two arguments (excluding the program name), copies them for further use,
-// and validates the pageDirectory to ensure it was created by the Crawler.
-static void parseArgs(const int argc, char* argv[], char** pageDirectory, char** indexFilename) {
-    if (argc != 3) { // Ensure exactly two arguments are provided.
-        fprintf(stderr, "Usage: %s pageDirectory indexFilename\n", argv[0]);
-        exit(1); // Exit with error if incorrect number of arguments.
+// Expects two arguments (excluding the program name), optionally followed by "--top k",
+// "--rank count|bm25" and "--cache KB" in any order, copies them into the querier for
+// further use, and validates the pageDirectory to ensure it was created by the Crawler.
+// top is set to k, or to 0 (print every match) without the option; ranking defaults to
+// QUERY_COUNT; *cacheKB is set to KB, or to CACHE_KB without the option. "--batch
+// queryFile" sets *batchFile and "--serve address" sets *serveAddress (each NULL
+// otherwise; at most one may be given), and either may come with "--threads n", which
+// sets *numThreads (by default, the number of online processors). "--ranges n" sets
+// querier->ranges, the docID ranges each query is split into (1 without the option).
+// "--timing ms" sets querier->slowMs, the threshold of the slow query log (-1 without the
+// option, which leaves queries untimed). "--explain plan|analyze" sets querier->explain
+// (EXPLAIN_NONE without the option).
+static void parseArgs(const int argc, char* argv[], querier_t* querier, int* cacheKB,
+                      char** batchFile, char** serveAddress, int* numThreads) {
+    char excess; // Catches trailing characters after k, KB and n.
+    bool ok = argc >= 3 && argc % 2 == 1;
+    bool threadsGiven = false;
+    querier->top = 0;
+    querier->ranking = QUERY_COUNT;
+    querier->ranges = 1;
+    querier->slowMs = -1;
+    querier->explain = EXPLAIN_NONE;
+    *cacheKB = CACHE_KB;
+    *batchFile = NULL;
+    *serveAddress = NULL;
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    *numThreads = processors > 0 ? (int)processors : 1;
+    for (int i = 3; ok && i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--batch") == 0) {
+            *batchFile = argv[i + 1];
+        } else if (strcmp(argv[i], "--serve") == 0) {
+            *serveAddress = argv[i + 1];
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            ok = sscanf(argv[i + 1], "%d%c", numThreads, &excess) == 1
+                 && *numThreads >= 1 && *numThreads <= MAX_THREADS;
+            threadsGiven = true;
+        } else if (strcmp(argv[i], "--ranges") == 0) {
+            ok = sscanf(argv[i + 1], "%d%c", &querier->ranges, &excess) == 1
+                 && querier->ranges >= 1 && querier->ranges <= MAX_THREADS;
+        } else if (strcmp(argv[i], "--timing") == 0) {
+            ok = sscanf(argv[i + 1], "%lf%c", &querier->slowMs, &excess) == 1
+                 && querier->slowMs >= 0;
+        } else if (strcmp(argv[i], "--top") == 0) {
+            ok = sscanf(argv[i + 1], "%d%c", &querier->top, &excess) == 1 && querier->top >= 1;
+        } else if (strcmp(argv[i], "--cache") == 0) {
+            ok = sscanf(argv[i + 1], "%d%c", cacheKB, &excess) == 1 && *cacheKB >= 0;
+        } else if (strcmp(argv[i], "--explain") == 0 && strcmp(argv[i + 1], "plan") == 0) {
+            querier->explain = EXPLAIN_PLAN;
+        } else if (strcmp(argv[i], "--explain") == 0 && strcmp(argv[i + 1], "analyze") == 0) {
+            querier->explain = EXPLAIN_ANALYZE;
+        } else if (strcmp(argv[i], "--rank") == 0 && strcmp(argv[i + 1], "count") == 0) {
+            querier->ranking = QUERY_COUNT;
+        } else if (strcmp(argv[i], "--rank") == 0 && strcmp(argv[i + 1], "bm25") == 0) {
+            querier->ranking = QUERY_BM25;
+        } else {
+            ok = false;
+        }
+    }
+    if (!ok || (*batchFile != NULL && *serveAddress != NULL)
+        || (threadsGiven && *batchFile == NULL && *serveAddress == NULL)) {
+        fprintf(stderr, "Usage: %s pageDirectory indexFilename [--top k] [--rank count|bm25] "
+                "[--cache KB] [--batch queryFile | --serve address] [--threads n] [--ranges n] "
+                "[--timing ms] [--explain plan|analyze]\n", argv[0]);
+        exit(1); // Exit with error if the arguments are malformed.
     }
 
     // Duplicate arguments to ensure memory management and modification safety.
-    *pageDirectory = strdup(argv[1]);
-    *indexFilename = strdup(argv[2]);
+    querier->pageDirectory = strdup(argv[1]);
+    querier->indexFilename = strdup(argv[2]);
 
     // Validate the pageDirectory to confirm it's a crawler-produced directory.
-    if (!pagedir_validate(*pageDirectory)) {
-        fprintf(stderr, "pageDirectory %s is not a directory produced by the Crawler.\n", *pageDirectory);
-        free(*pageDirectory); // Clean up allocated memory to avoid leaks.
-        free(*indexFilename);
+    if (!pagedir_validate(querier->pageDirectory)) {
+        fprintf(stderr, "pageDirectory %s is not a directory produced by the Crawler.\n",
+                querier->pageDirectory);
+        free(querier->pageDirectory); // Clean up allocated memory to avoid leaks.
+        free(querier->indexFilename);
         exit(1); // Exit with error if validation fails.
     }
 }
 
+// Loads the index from indexFilename, with the document statistics BM25 needs when
+// ranking is QUERY_BM25, so that queries never touch the page directory or the
+// statistics file while scoring. Returns the index, or NULL (after printing an error)
+// if either file cannot be read.
+static index_t* loadIndex(const char* indexFilename, queryRank_t ranking) {
+    index_t* index = index_new();
+    if (index == NULL || fileToIndex(index, (char*)indexFilename) == NULL) {
+        index_delete(index);
+        return NULL;
+    }
+    if (ranking == QUERY_BM25 && !index_loadStats(index, indexFilename)) {
+        fprintf(stderr, "Cannot read document statistics %s%s; re-run the indexer.\n",
+                indexFilename, INDEX_STATS_SUFFIX);
+        index_delete(index);
+        return NULL;
+    }
+    return index;
+}
+
+// Returns true if indexFilename starts with INDEX_MAGIC, as index_save writes it, so that
+// a flush writes the index back in the format it was loaded in.
+static bool isBinaryIndex(const char* indexFilename) {
+    char magic[sizeof(INDEX_MAGIC)] = "";
+    FILE* fp = fopen(indexFilename, "rb");
+    if (fp != NULL) {
+        if (fread(magic, 1, strlen(INDEX_MAGIC), fp) != strlen(INDEX_MAGIC)) {
+            magic[0] = '\0';
+        }
+        fclose(fp);
+    }
+    return strcmp(magic, INDEX_MAGIC) == 0;
+}
+
+// Loads the numShards shards listed by the manifest at indexFilename, as loadIndex loads
+// an index, and joins them so that BM25 counts every word's documents in all of them.
+// Returns the shards, or NULL (after printing an error) if one cannot be loaded.
+static index_t** loadShards(const char* indexFilename, int numShards, queryRank_t ranking) {
+    index_t** shards = calloc(numShards, sizeof(index_t*));
+    for (int s = 0; shards != NULL && s < numShards; s++) {
+        char shardFilename[strlen(indexFilename) + 16];
+        sprintf(shardFilename, INDEX_SHARD_FORMAT, indexFilename, s);
+        if ((shards[s] = loadIndex(shardFilename, ranking)) == NULL) {
+            while (s > 0) {
+                index_delete(shards[--s]);
+            }
+            free(shards);
+            return NULL;
+        }
+    }
+    if (shards != NULL) {
+        index_joinShards(shards, numShards);
+    }
+    return shards;
+}
+
+// Loads a snapshot of the index: the index itself (or every shard, if the index file is
+// a shard manifest), with a URL table when the querier keeps one, plus a segment of the
+// documents ingested since the last flush. A server also loads the document statistics
+// when it does not rank by BM25, so that a flush can write them out. Returns the snapshot
+// with no references, or NULL if the index cannot be loaded.
+static snapshot_t* loadSnapshot(querier_t* querier) {
+    snapshot_t* snapshot = calloc(1, sizeof(snapshot_t));
+    if (snapshot == NULL) {
+        return NULL;
+    }
+    snapshot->ownsBase = true;
+    int numShards = index_loadShards(querier->indexFilename);
+    if (numShards > 0) {
+        snapshot->shards = loadShards(querier->indexFilename, numShards, querier->ranking);
+        snapshot->numShards = snapshot->shards != NULL ? numShards : 0;
+    } else if (numShards == 0) {
+        snapshot->index = loadIndex(querier->indexFilename, querier->ranking);
+        snapshot->binary = isBinaryIndex(querier->indexFilename);
+    } else {
+        fprintf(stderr, "Cannot read index file %s.\n", querier->indexFilename);
+    }
+    if (snapshot->index == NULL && snapshot->shards == NULL) {
+        free(snapshot);
+        return NULL;
+    }
+    if (querier->urlTable && snapshot->index != NULL) {
+        if (snapshot->index->docLengths == NULL) {
+            index_loadStats(snapshot->index, querier->indexFilename); // Optional here.
+        }
+    }
+    if (querier->urlTable) {
+        loadURLs(querier->pageDirectory, snapshot);
+    }
+    if (!attachSegment(querier, snapshot)) {
+        deleteSnapshot(snapshot);
+        return NULL;
+    }
+    return snapshot;
+}
+
+// Builds the snapshot's segment from the documents ingested since the last flush: an
+// index of their words, scored with the base index's statistics, and copies of their
+// docIDs and URLs. Leaves the snapshot without a segment if nothing was ingested.
+// Returns false if out of memory, or if the base is sharded (documents are not ingested
+// into shards).
+static bool attachSegment(querier_t* querier, snapshot_t* snapshot) {
+    int numDocs = querier->numIngested;
+    if (numDocs == 0) {
+        return true;
+    }
+    if (snapshot->index == NULL) {
+        fprintf(stderr, "Cannot keep ingested documents over the shards of %s; flush them "
+                "first.\n", querier->indexFilename);
+        return false;
+    }
+    snapshot->segment = index_new();
+    snapshot->segmentDocs = malloc(sizeof(int) * numDocs);
+    snapshot->segmentURLs = calloc(numDocs, sizeof(char*));
+    if (snapshot->segment == NULL || snapshot->segmentDocs == NULL
+        || snapshot->segmentURLs == NULL) {
+        return false;
+    }
+    snapshot->numSegmentDocs = numDocs;
+    for (int i = 0; i < numDocs; i++) {
+        ingestDoc_t* doc = &querier->ingested[i];
+        snapshot->segmentDocs[i] = doc->docID;
+        if ((snapshot->segmentURLs[i] = strdup(doc->url)) == NULL) {
+            return false;
+        }
+        for (int w = 0; w < doc->numWords; w++) {
+            if (!index_add(snapshot->segment, doc->words[w], doc->docID)) {
+                return false;
+            }
+        }
+    }
+    index_finish(snapshot->segment);
+    if (snapshot->index->docNorms != NULL && snapshot->segment->docLengths != NULL) {
+        return index_computeNorms(snapshot->segment, snapshot->index);
+    }
+    return true;
+}
+
+// Frees a snapshot nobody uses any more: its segment, and its base index (or shards) and
+// URL table unless a newer snapshot has taken them over.
+static void deleteSnapshot(snapshot_t* snapshot) {
+    if (snapshot != NULL) {
+        if (snapshot->ownsBase) {
+            index_delete(snapshot->index);
+            for (int s = 0; s < snapshot->numShards; s++) {
+                index_delete(snapshot->shards[s]);
+            }
+            free(snapshot->shards);
+            for (int docID = 1; docID <= snapshot->numURLs; docID++) {
+                free(snapshot->urls[docID]);
+            }
+            free(snapshot->urls);
+        }
+        index_delete(snapshot->segment);
+        if (snapshot->segmentURLs != NULL) {
+            for (int i = 0; i < snapshot->numSegmentDocs; i++) {
+                free(snapshot->segmentURLs[i]);
+            }
+        }
+        free(snapshot->segmentURLs);
+        free(snapshot->segmentDocs);
+        free(snapshot);
+    }
+}
+
+// Takes a reference to the current snapshot, which stays valid (even if a reload
+// replaces it meanwhile) until releaseSnapshot.
+static snapshot_t* acquireSnapshot(querier_t* querier) {
+    pthread_mutex_lock(&querier->lock);
+    snapshot_t* snapshot = querier->current;
+    snapshot->refs++;
+    pthread_mutex_unlock(&querier->lock);
+    return snapshot;
+}
+
+// Drops a reference taken by acquireSnapshot. The last query on a replaced snapshot wakes
+// the reload waiting to free it, so no query ever pays for freeing an index.
+static void releaseSnapshot(querier_t* querier, snapshot_t* snapshot) {
+    pthread_mutex_lock(&querier->lock);
+    if (--snapshot->refs == 0) {
+        pthread_cond_broadcast(&querier->drained);
+    }
+    pthread_mutex_unlock(&querier->lock);
+}
+
+// Makes snapshot current; the first snapshot installed is generation 1. A snapshot that
+// shares its predecessor's base index takes the base over. Returns the snapshot it
+// replaced, still referenced by the queries running on it, or NULL.
+static snapshot_t* installSnapshot(querier_t* querier, snapshot_t* snapshot) {
+    pthread_mutex_lock(&querier->lock);
+    snapshot_t* old = querier->current;
+    snapshot->generation = old != NULL ? old->generation + 1 : 1;
+    snapshot->refs = 1; // The querier's own reference, while it is current.
+    querier->current = snapshot;
+    if (old != NULL) {
+        old->refs--;
+        if (old->index == snapshot->index && old->shards == snapshot->shards) {
+            old->ownsBase = false;
+            snapshot->ownsBase = true;
+        }
+    }
+    pthread_mutex_unlock(&querier->lock);
+    return old;
+}
+
+// Answers the most recently cached queries of the old snapshot again on the fresh one and
+// caches the results under the fresh generation, so that popular queries still hit the
+// cache once the fresh snapshot is installed. Returns the number of results carried over.
+static int rewarmCache(querier_t* querier, snapshot_t* old, snapshot_t* fresh) {
+    char* keys[REWARM_KEYS];
+    int numKeys = cache_recent(querier->cache, keys, REWARM_KEYS);
+    int carried = 0;
+    for (int i = 0; i < numKeys; i++) {
+        unsigned long generation;
+        int top, offset = 0;
+        char ranking[8];
+        if (sscanf(keys[i], "%lu %d %7s %n", &generation, &top, ranking, &offset) == 3
+            && offset > 0 && generation == old->generation) {
+            char* canonical = keys[i] + offset;
+            char* key = malloc(strlen(canonical) + 48);
+            char** words = malloc(sizeof(char*) * (strlen(canonical) / 2 + 1));
+            if (key != NULL && words != NULL) {
+                sprintf(key, "%lu %d %s %s", fresh->generation, top, ranking, canonical);
+                int numWords = 0;
+                char* rest = NULL;
+                for (char* word = strtok_r(canonical, " ", &rest); word != NULL;
+                     word = strtok_r(NULL, " ", &rest)) {
+                    words[numWords++] = word;
+                }
+                match_t* matches = NULL;
+                int numMatches = scoreSnapshot(querier, fresh, numWords, words, &matches);
+                if (cache_put(querier->cache, key, matches, sizeof(match_t) * numMatches)) {
+                    carried++;
+                }
+                free(matches);
+            }
+            free(words);
+            free(key);
+        }
+        free(keys[i]);
+    }
+    return carried;
+}
+
+// Switches to a fresh snapshot: the cache is rewarmed for it while queries keep running on
+// the current one, the switch is a pointer swap, and the old snapshot is freed here once
+// the last query using it has finished. Queries never wait for any of it. Only one thread
+// may change snapshots. Returns the number of cached results carried over.
+static int swapSnapshot(querier_t* querier, snapshot_t* fresh) {
+    pthread_mutex_lock(&querier->lock);
+    fresh->generation = querier->current->generation + 1; // So the rewarmed keys match.
+    pthread_mutex_unlock(&querier->lock);
+    int carried = rewarmCache(querier, querier->current, fresh);
+
+    snapshot_t* old = installSnapshot(querier, fresh);
+    pthread_mutex_lock(&querier->lock);
+    while (old->refs > 0) {
+        pthread_cond_wait(&querier->drained, &querier->lock); // The grace period.
+    }
+    pthread_mutex_unlock(&querier->lock);
+    deleteSnapshot(old);
+    return carried;
+}
+
+// Loads the index file again and switches to it, keeping the documents ingested since the
+// last flush on top of it. Stores the number of cached results carried over in *carried.
+// Returns false, keeping the current snapshot, if the index cannot be loaded.
+static bool reloadIndex(querier_t* querier, int* carried) {
+    *carried = 0;
+    snapshot_t* fresh = loadSnapshot(querier);
+    if (fresh == NULL) {
+        return false;
+    }
+    *carried = swapSnapshot(querier, fresh);
+    return true;
+}
+
+// Orders ingested documents by docID.
+static int compareIngested(const void* a, const void* b) {
+    const ingestDoc_t* x = a;
+    const ingestDoc_t* y = b;
+    return (x->docID > y->docID) - (x->docID < y->docID);
+}
+
+// Frees an ingested document's page and words.
+static void freeIngested(ingestDoc_t* doc) {
+    for (int w = 0; w < doc->numWords; w++) {
+        free(doc->words[w]);
+    }
+    free(doc->words);
+    free(doc->url);
+    free(doc->html);
+}
+
+// Returns true if doc is the very document (not a newer version of it) that docs, sorted
+// by docID, holds.
+static bool ingestedIn(const ingestDoc_t* doc, const ingestDoc_t* docs, int numDocs) {
+    const ingestDoc_t* found = bsearch(doc, docs, numDocs, sizeof(ingestDoc_t),
+                                       compareIngested);
+    return found != NULL && found->url == doc->url;
+}
+
+// Adds newly ingested documents (taking them over) to those ingested since the last flush,
+// a document ingested again replacing its earlier version, and switches to a snapshot whose
+// segment holds them all, over the same base index. Returns false, keeping the current
+// snapshot and the documents ingested before, and dropping the new ones, if out of memory.
+static bool publishIngested(querier_t* querier, ingestDoc_t* docs, int numDocs, int* carried) {
+    *carried = 0;
+    // The documents as they were, so that a failure can put them back; the versions the new
+    // ones replace are freed only once the switch is made.
+    int numBefore = querier->numIngested;
+    ingestDoc_t* before = malloc(sizeof(ingestDoc_t) * (numBefore > 0 ? numBefore : 1));
+    if (before != NULL && numBefore + numDocs > querier->ingestedCap) {
+        int cap = (numBefore + numDocs) * 2;
+        ingestDoc_t* grown = realloc(querier->ingested, sizeof(ingestDoc_t) * cap);
+        if (grown != NULL) {
+            querier->ingested = grown;
+            querier->ingestedCap = cap;
+        }
+    }
+    if (before == NULL || numBefore + numDocs > querier->ingestedCap) {
+        for (int i = 0; i < numDocs; i++) {
+            freeIngested(&docs[i]);
+        }
+        free(before);
+        return false;
+    }
+    memcpy(before, querier->ingested, sizeof(ingestDoc_t) * numBefore);
+    for (int i = 0; i < numDocs; i++) {
+        ingestDoc_t* old = bsearch(&docs[i], querier->ingested, querier->numIngested,
+                                   sizeof(ingestDoc_t), compareIngested);
+        if (old != NULL) {
+            if (!ingestedIn(old, before, numBefore)) {
+                freeIngested(old); // An earlier version from this same batch.
+            }
+            *old = docs[i];
+        } else {
+            querier->ingested[querier->numIngested++] = docs[i];
+            qsort(querier->ingested, querier->numIngested, sizeof(ingestDoc_t), compareIngested);
+        }
+    }
+
+    snapshot_t* current = querier->current;
+    snapshot_t* fresh = current->index != NULL ? calloc(1, sizeof(snapshot_t)) : NULL;
+    bool ok = fresh != NULL; // Out of memory, or a reload switched to a sharded index.
+    if (ok) {
+        fresh->index = current->index; // Shared, and taken over once fresh is installed.
+        fresh->urls = current->urls;
+        fresh->numURLs = current->numURLs;
+        fresh->binary = current->binary;
+        ok = attachSegment(querier, fresh);
+        if (!ok) {
+            fresh->ownsBase = false;
+            deleteSnapshot(fresh);
+        }
+    }
+    if (!ok) {
+        for (int i = 0; i < querier->numIngested; i++) {
+            if (!ingestedIn(&querier->ingested[i], before, numBefore)) {
+                freeIngested(&querier->ingested[i]);
+            }
+        }
+        memcpy(querier->ingested, before, sizeof(ingestDoc_t) * numBefore);
+        querier->numIngested = numBefore;
+        free(before);
+        return false;
+    }
+    *carried = swapSnapshot(querier, fresh);
+    for (int i = 0; i < numBefore; i++) {
+        if (!ingestedIn(&before[i], querier->ingested, querier->numIngested)) {
+            freeIngested(&before[i]); // Replaced by a newer version.
+        }
+    }
+    free(before);
+    return true;
+}
+
+// Writes an ingested document's page file, as the Crawler does (URL, depth, then the HTML),
+// under a temporary name renamed into place. Returns false if the file cannot be written.
+static bool writePage(const char* pageDirectory, const ingestDoc_t* doc) {
+    char filename[strlen(pageDirectory) + 16];
+    sprintf(filename, "%s/%d", pageDirectory, doc->docID);
+    char temp[sizeof(filename) + 8];
+    sprintf(temp, "%s.flush", filename);
+    FILE* fp = fopen(temp, "w");
+    if (fp == NULL) {
+        return false;
+    }
+    bool ok = fprintf(fp, "%s\n%d\n%s", doc->url, doc->depth, doc->html) >= 0;
+    ok = fclose(fp) == 0 && ok && rename(temp, filename) == 0;
+    if (!ok) {
+        unlink(temp);
+    }
+    return ok;
+}
+
+// Merges the current snapshot's segment into its base index, writes the ingested pages
+// into the page directory and the merged index (and its statistics, when known) over the
+// index file, and switches to a snapshot of the merged index with an empty segment. So the
+// page directory always holds every document of the index file, and re-running the
+// Indexer over it gives the same index. Each file is written under a temporary name and
+// renamed into place, pages and statistics before the index, so the index file is never
+// seen half written. Returns false, keeping the segment, if the merge or a file fails.
+static bool flushSegment(querier_t* querier, int* carried) {
+    *carried = 0;
+    snapshot_t* current = querier->current;
+    if (current->segment == NULL) {
+        return true;
+    }
+    index_t* merged = index_merge(current->index, current->segment, current->segmentDocs,
+                                  current->numSegmentDocs);
+    snapshot_t* fresh = merged != NULL ? calloc(1, sizeof(snapshot_t)) : NULL;
+    if (fresh == NULL) {
+        index_delete(merged);
+        return false;
+    }
+    fresh->ownsBase = true;
+    fresh->index = merged;
+    fresh->binary = current->binary;
+    bool ok = merged->docLengths == NULL || index_computeNorms(merged, NULL);
+
+    // The URL table: the base's, with the segment's documents added or replaced.
+    if (ok && current->urls != NULL) {
+        int numURLs = current->numURLs;
+        for (int i = 0; i < current->numSegmentDocs; i++) {
+            numURLs = current->segmentDocs[i] > numURLs ? current->segmentDocs[i] : numURLs;
+        }
+        fresh->urls = calloc(numURLs + 1, sizeof(char*));
+        ok = fresh->urls != NULL;
+        if (ok) {
+            fresh->numURLs = numURLs;
+            for (int docID = 1; docID <= current->numURLs; docID++) {
+                if (current->urls[docID] != NULL) {
+                    fresh->urls[docID] = strdup(current->urls[docID]);
+                }
+            }
+            for (int i = 0; i < current->numSegmentDocs; i++) {
+                int docID = current->segmentDocs[i];
+                free(fresh->urls[docID]);
+                fresh->urls[docID] = strdup(current->segmentURLs[i]);
+            }
+        }
+    }
+
+    char temp[strlen(querier->indexFilename) + 16];
+    sprintf(temp, "%s.flush", querier->indexFilename);
+    char tempStats[sizeof(temp) + strlen(INDEX_STATS_SUFFIX)];
+    sprintf(tempStats, "%s%s", temp, INDEX_STATS_SUFFIX);
+    char stats[strlen(querier->indexFilename) + strlen(INDEX_STATS_SUFFIX) + 1];
+    sprintf(stats, "%s%s", querier->indexFilename, INDEX_STATS_SUFFIX);
+    for (int i = 0; ok && i < querier->numIngested; i++) {
+        ok = writePage(querier->pageDirectory, &querier->ingested[i]);
+    }
+    bool withStats = merged->docLengths != NULL;
+    ok = ok && (current->binary ? index_save(merged, temp) : indexToFile(merged, temp))
+         && (!withStats || index_saveStats(merged, temp))
+         && (!withStats || rename(tempStats, stats) == 0)
+         && rename(temp, querier->indexFilename) == 0;
+    if (!ok) {
+        unlink(temp);
+        unlink(tempStats);
+        deleteSnapshot(fresh);
+        return false;
+    }
+
+    for (int i = 0; i < querier->numIngested; i++) {
+        freeIngested(&querier->ingested[i]);
+    }
+    querier->numIngested = 0;
+    *carried = swapSnapshot(querier, fresh);
+    return true;
+}
+
 // Validates the syntax of a given query, ensuring it contains only letters and spaces.
 // This is a preliminary check before further processing and tokenization.
 static bool isValidQuery(char *query) {
@@ -112,280 +686,1291 @@ void tokenize(char* query, char* words[], int* numWords, bool* isValid) {
     }
 }
 
+// Set by SIGUSR1 to ask for the latency report of --timing.
+static volatile sig_atomic_t timingReport = 0;
+
+// Prints the latency report to stderr if SIGUSR1 asked for one since the last report.
+static void reportTiming(querier_t* querier) {
+    if (!timingReport) {
+        return;
+    }
+    pthread_mutex_lock(&querier->lock);
+    bool due = timingReport; // Only one of the threads that saw the request prints.
+    timingReport = 0;
+    pthread_mutex_unlock(&querier->lock);
+    if (due) {
+        latency_print(querier->latency, stderr);
+    }
+}
+
+// Records the phases of a query, ns[phase] nanoseconds each, in the querier's latency
+// histograms; logs the query to stderr with its breakdown if it took at least slowMs.
+static void recordTiming(querier_t* querier, const uint64_t ns[], char* words[],
+                         int numWords) {
+    latency_record(querier->latency, ns);
+    if (ns[PHASE_TOTAL] >= querier->slowMs * 1e6) {
+        char line[1200];
+        int length = snprintf(line, sizeof(line), "Slow query: %.3f ms (", ns[PHASE_TOTAL] / 1e6);
+        for (int p = 0; p < PHASE_TOTAL; p++) {
+            length += snprintf(line + length, sizeof(line) - length, "%s%s %.3f",
+                               p > 0 ? ", " : "", PHASE_NAMES[p], ns[p] / 1e6);
+        }
+        length += snprintf(line + length, sizeof(line) - length, "):");
+        int i = 0;
+        for (; i < numWords && length < (int)sizeof(line) - 1; i++) {
+            length += snprintf(line + length, sizeof(line) - length, " %s", words[i]);
+        }
+        if (length > (int)sizeof(line) - 1 || i < numWords) {
+            strcpy(line + sizeof(line) - 4, "..."); // Long words cut short.
+        }
+        fprintf(stderr, "%s\n", line); // One write, so concurrent queries' lines stay whole.
+    }
+    reportTiming(querier);
+}
+
+// Prints the plan of a query on every part of a snapshot to out, as query_explain does: on the
+// index, or on each of its shards, and on the segment of ingested documents. With
+// EXPLAIN_ANALYZE each part is first evaluated again as score would evaluate it (query_top
+// for the top documents, or every match), on this thread, bypassing the cache and the ranges.
+static void explainQuery(querier_t* querier, snapshot_t* snapshot, int numWords,
+                         char* words[], FILE* out) {
+    index_t** shards = snapshot->shards != NULL ? snapshot->shards : &snapshot->index;
+    int numShards = snapshot->shards != NULL ? snapshot->numShards : 1;
+    for (int s = 0; s <= numShards; s++) {
+        index_t* index = s < numShards ? shards[s] : snapshot->segment;
+        if (index == NULL) {
+            continue; // No segment.
+        }
+        if (s == numShards) {
+            fprintf(out, "Plan on the ingested documents:\n");
+        } else if (snapshot->shards != NULL) {
+            fprintf(out, "Plan on shard %d of %d:\n", s + 1, numShards);
+        } else {
+            fprintf(out, "Plan:\n");
+        }
+        query_t* query = querier->explain == EXPLAIN_ANALYZE
+                         ? query_newAnalyzed(index, words, numWords, querier->ranking)
+                         : query_new(index, words, numWords, querier->ranking);
+        if (query == NULL) {
+            fprintf(out, "Out of memory.\n");
+            continue;
+        }
+        if (querier->explain == EXPLAIN_ANALYZE && querier->top > 0) {
+            int* docs = query_alloc(query, sizeof(int) * querier->top);
+            double* scores = query_alloc(query, sizeof(double) * querier->top);
+            if (docs != NULL && scores != NULL) {
+                query_top(query, querier->top, docs, scores);
+            }
+        } else if (querier->explain == EXPLAIN_ANALYZE) {
+            double docScore;
+            while (query_next(query, &docScore) != POSTINGS_END) {
+                // Only the node statistics are wanted.
+            }
+        }
+        query_explain(query, out);
+        query_delete(query);
+    }
+}
+
+// Answers one line of input: validates, tokenizes, scores and ranks it, writing the
+// "Query:" line and the ranked documents to out and any complaint to err. Returns true if
+// the line was a valid query (whether or not anything matched), false if it was rejected.
+// Touches nothing shared but the index (read-only) and the cache (locked), so batch
+// workers call it concurrently. With --timing, valid queries are timed phase by phase;
+// without it the clock is never read.
+static bool answerQuery(querier_t* querier, char* query, FILE* out, FILE* err) {
+    bool timed = querier->latency != NULL;
+    uint64_t start = timed ? latency_now() : 0;
+    char* words[100]; // Array to store tokenized words.
+    int numWords = 0; // Number of words in the query.
+    bool isValid = true; // Flag to indicate if the query is syntactically valid.
+
+    // Check if the query only contains letters and spaces.
+    if (!isValidQuery(query)) {
+        fprintf(err, "Error: Query must only contain letters and spaces.\n");
+        return false; // Prompt for another query if invalid.
+    }
+
+    // Tokenize the query into individual words and operators.
+    tokenize(query, words, &numWords, &isValid);
+
+    // Handle invalid syntax or empty queries.
+    if (!isValid || numWords == 0) {
+        fprintf(err, "Invalid query.\n");
+        return false;
+    }
+
+    // Look the query up in the cache, or score and rank it and remember the results, all
+    // on one snapshot of the index, whatever reloads happen meanwhile.
+    uint64_t ns[NUM_PHASES] = { 0 };
+    uint64_t parsed = timed ? latency_now() : 0;
+    snapshot_t* snapshot = acquireSnapshot(querier);
+    match_t* matches = NULL;
+    int numMatches = lookup(querier, snapshot, numWords, words, &matches,
+                            timed ? &ns[PHASE_SCORE] : NULL);
+    uint64_t looked = timed ? latency_now() : 0;
+
+    // Print and rank results if there are any matches.
+    if (numMatches > 0) {
+        fprintf(out, "Query: ");
+        for (int i = 0; i < numWords; i++) {
+            fprintf(out, "%s ", words[i]);
+        }
+        fprintf(out, "\n");
+        rank(out, querier, snapshot, matches, numMatches); // Print the results.
+        free(matches); // Clean up the matches array.
+    } else {
+        fprintf(err, "No documents match or invalid query.\n");
+    }
+    if (querier->explain != EXPLAIN_NONE) {
+        explainQuery(querier, snapshot, numWords, words, out);
+    }
+    releaseSnapshot(querier, snapshot);
+    if (timed) {
+        uint64_t done = latency_now();
+        ns[PHASE_PARSE] = parsed - start;
+        ns[PHASE_LOOKUP] = looked - parsed - ns[PHASE_SCORE];
+        ns[PHASE_RANK] = done - looked;
+        ns[PHASE_TOTAL] = done - start;
+        recordTiming(querier, ns, words, numWords);
+    }
+    return true;
+}
+
 // Processes each user query: reads from stdin, validates, tokenizes, scores, and ranks results.
 // Continuously prompts for queries until EOF is encountered. Each query is processed to identify
 // matching documents, which are then ranked based on relevance and printed to stdout.
-static void processQuery(index_t* index, char* pageDir) {
+// Before each query the index file is checked: if it changed, the cache has emptied itself
+// and the index is reloaded (the old one stays in use if the new one cannot be read).
+static void processQuery(querier_t* querier) {
     char query[1000]; // Buffer to store the user's input query.
 
     // Prompt user for a query.
     printf("Query? ");
     while (fgets(query, sizeof(query), stdin) != NULL) {
-        char* words[100]; // Array to store tokenized words.
-        int numWords = 0; // Number of words in the query.
-        bool isValid = true; // Flag to indicate if the query is syntactically valid.
+        int carried;
+        if (cache_watch(querier->cache, querier->indexFilename)
+            && !reloadIndex(querier, &carried)) {
+            fprintf(stderr, "Keeping the index loaded before %s changed.\n",
+                    querier->indexFilename);
+        }
 
-        // Check if the query only contains letters and spaces.
-        if (!isValidQuery(query)) {
-            fprintf(stderr, "Error: Query must only contain letters and spaces.\n");
+        if (!answerQuery(querier, query, stdout, stderr)) {
             printf("Query? ");
             continue; // Prompt for another query if invalid.
         }
+        printf("-----------------------------------------------\nQuery? "); // Prepare for the next query.
+    }
+}
 
-        // Tokenize the query into individual words and operators.
-        tokenize(query, words, &numWords, &isValid);
+// Worker thread of a batch: repeatedly claims the next unanswered query (waiting while it
+// is too far ahead of the writer), answers it into memory buffers, and marks it done.
+static void* batchWorker(void* arg) {
+    batch_t* batch = arg;
+    pthread_mutex_lock(&batch->lock);
+    while (true) {
+        while (batch->next < batch->numItems && batch->next >= batch->written + batch->window) {
+            pthread_cond_wait(&batch->room, &batch->lock);
+        }
+        if (batch->next >= batch->numItems) {
+            break;
+        }
+        batchItem_t* item = &batch->items[batch->next++];
+        pthread_mutex_unlock(&batch->lock);
 
-        // Handle invalid syntax or empty queries.
-        if (!isValid || numWords == 0) {
-            fprintf(stderr, "Invalid query.\n");
-            printf("Query? ");
-            continue;
+        FILE* out = open_memstream(&item->out, &item->outLen);
+        FILE* err = open_memstream(&item->err, &item->errLen);
+        if (out != NULL && err != NULL) {
+            if (answerQuery(batch->querier, item->line, out, err)) {
+                fprintf(out, "-----------------------------------------------\n");
+            }
+        } else {
+            fprintf(stderr, "Out of memory answering query: %s\n", item->line);
+        }
+        if (out != NULL) {
+            fclose(out);
+        }
+        if (err != NULL) {
+            fclose(err);
         }
 
-        // Score the query based on the index and rank the results.
-        counters_t* result = NULL;
-        score(index, numWords, words, &result);
+        pthread_mutex_lock(&batch->lock);
+        item->done = true;
+        pthread_cond_broadcast(&batch->answered);
+    }
+    pthread_mutex_unlock(&batch->lock);
+    return NULL;
+}
 
-        // Print and rank results if there are any matches.
-        if (result != NULL) {
-            printf("Query: ");
-            for (int i = 0; i < numWords; i++) {
-                printf("%s ", words[i]);
+// Answers every query (one per line) in queryFile with numThreads worker threads sharing
+// the read-only index, and writes each query's output in input order, through a large
+// stdout buffer. Workers may run at most a window of queries ahead of the writer, which
+// bounds the memory held by finished but unwritten answers. Returns false if queryFile
+// cannot be read or no thread can be started.
+static bool processBatch(querier_t* querier, const char* queryFile, int numThreads) {
+    FILE* fp = strcmp(queryFile, "-") == 0 ? stdin : fopen(queryFile, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Cannot read queries from %s.\n", queryFile);
+        return false;
+    }
+    batch_t batch = { .querier = querier, .window = 64 * numThreads };
+    int capacity = 0;
+    char* line;
+    while ((line = file_readLine(fp)) != NULL) {
+        if (batch.numItems == capacity) {
+            capacity = capacity == 0 ? 1024 : capacity * 2;
+            batchItem_t* grown = realloc(batch.items, sizeof(batchItem_t) * capacity);
+            if (grown == NULL) {
+                free(line);
+                break; // Out of memory: answer the queries read so far.
             }
-            printf("\n");
-            rank(result, pageDir); // Rank and print the results.
-            counters_delete(result); // Clean up the counters structure.
-        } else {
-            fprintf(stderr, "No documents match or invalid query.\n");
+            batch.items = grown;
+        }
+        batch.items[batch.numItems++] = (batchItem_t){ .line = line };
+    }
+    if (fp != stdin) {
+        fclose(fp);
+    }
+
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.answered, NULL);
+    pthread_cond_init(&batch.room, NULL);
+    pthread_t threads[numThreads];
+    int started = 0;
+    while (started < numThreads
+           && pthread_create(&threads[started], NULL, batchWorker, &batch) == 0) {
+        started++;
+    }
+
+    // Write the answers in input order as they become available.
+    static char buffer[1 << 16];
+    setvbuf(stdout, buffer, _IOFBF, sizeof(buffer));
+    pthread_mutex_lock(&batch.lock);
+    for (int i = 0; i < batch.numItems && started > 0; i++) {
+        batchItem_t* item = &batch.items[i];
+        while (!item->done) {
+            pthread_cond_wait(&batch.answered, &batch.lock);
         }
+        pthread_mutex_unlock(&batch.lock);
+        fwrite(item->out, 1, item->outLen, stdout);
+        fwrite(item->err, 1, item->errLen, stderr);
+        free(item->out);
+        free(item->err);
+        free(item->line);
+        pthread_mutex_lock(&batch.lock);
+        batch.written++;
+        pthread_cond_broadcast(&batch.room);
+    }
+    pthread_mutex_unlock(&batch.lock);
 
-        printf("-----------------------------------------------\nQuery? "); // Prepare for the next query.
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    fflush(stdout);
+    if (started == 0) {
+        fprintf(stderr, "Cannot start batch threads.\n");
+        for (int i = 0; i < batch.numItems; i++) {
+            free(batch.items[i].line);
+        }
     }
+    pthread_cond_destroy(&batch.room);
+    pthread_cond_destroy(&batch.answered);
+    pthread_mutex_destroy(&batch.lock);
+    free(batch.items);
+    return started > 0;
 }
 
-// Scores a query by evaluating each word's presence in the index and applying boolean logic.
-// Constructs a counter of document IDs (keys) and their scores (values) based on the query.
-void score(index_t *index, int numWords, char *words[], counters_t **orSequence) {
-    counters_t *andSequence = NULL; // Temporarily stores results of 'AND' operations.
-    bool shortCircuit = false; // Used to optimize processing by skipping unnecessary checks.
+// Write end of the running server's wake-up pipe, for the signal handler.
+static volatile sig_atomic_t serverStopping = 0;
+static volatile sig_atomic_t serverReload = 0;
+static int serverWakeFd = -1;
 
-    if (*orSequence == NULL) {
-        *orSequence = counters_new(); // Initialize the OR sequence counter if not already done.
+// Signal handler of the server: SIGHUP asks the main loop for a reload, SIGINT and
+// SIGTERM ask it to stop.
+static void signalServer(int signum) {
+    if (signum == SIGHUP) {
+        serverReload = 1;
+    } else {
+        serverStopping = 1;
+    }
+    int saved = errno;
+    if (write(serverWakeFd, "s", 1) < 0) {
+        // Nothing to do: the pipe is full, so the main loop is about to wake anyway.
     }
+    errno = saved;
+}
+
+// Signal handler of --timing: SIGUSR1 asks for the latency report, which the next query to
+// finish prints, or a server's main loop at once.
+static void signalTiming(int signum) {
+    timingReport = 1;
+    int saved = errno;
+    if (serverWakeFd >= 0 && write(serverWakeFd, "t", 1) < 0) {
+        // Nothing to do: the pipe is full, so the main loop is about to wake anyway.
+    }
+    errno = saved;
+}
+
+// Worker thread of the server: takes connections that have a request waiting, reads one
+// request, answers it with answerQuery, sends the response, and hands the connection back
+// to the main loop to wait for the next request. Connections whose client has gone away,
+// or that send something that is not a request, are closed.
+static void* serverWorker(void* arg) {
+    server_t* server = arg;
+    while (true) {
+        pthread_mutex_lock(&server->lock);
+        while (server->numReady == 0 && !server->stopping) {
+            pthread_cond_wait(&server->hasReady, &server->lock);
+        }
+        if (server->numReady == 0) {
+            pthread_mutex_unlock(&server->lock);
+            return NULL;
+        }
+        int fd = server->ready[--server->numReady];
+        pthread_mutex_unlock(&server->lock);
 
-    for (int i = 0; i < numWords; i++) {
-        if (strcmp(words[i], "or") == 0) {
-            // Merge the current AND sequence into the OR sequence and reset for the next sequence.
-            myUnion(orSequence, andSequence);
-            andSequence = NULL; // Prepare for the next AND sequence.
-            shortCircuit = false; // Reset the short-circuit flag.
-        } else if (shortCircuit) {
-            // Skip processing until the next OR is found if short-circuiting.
+        size_t length = 0;
+        char* request = protocol_recv(fd, PROTOCOL_MAX_QUERY, &length);
+        bool ok = request != NULL && strlen(request) == length;
+        if (ok && request[0] == PROTOCOL_CONTROL) {
+            ok = serverControl(server, request + 1, fd);
+        } else if (ok) {
+            char* out = NULL;
+            char* err = NULL;
+            size_t outLen = 0, errLen = 0;
+            FILE* outStream = open_memstream(&out, &outLen);
+            FILE* errStream = open_memstream(&err, &errLen);
+            bool valid = false;
+            if (outStream != NULL && errStream != NULL) {
+                valid = answerQuery(server->querier, request, outStream, errStream);
+            }
+            if (outStream != NULL) {
+                fclose(outStream);
+            }
+            if (errStream != NULL) {
+                fclose(errStream);
+            }
+            ok = out != NULL && err != NULL;
+            if (ok && outLen > 0) {
+                ok = protocol_sendReply(fd, PROTOCOL_RESULTS, out, outLen);
+            } else if (ok) {
+                ok = protocol_sendReply(fd, valid ? PROTOCOL_NOMATCH : PROTOCOL_INVALID, err, errLen);
+            }
+            free(out);
+            free(err);
+        }
+        free(request);
+
+        if (!ok) {
+            close(fd);
             continue;
-        } else if (strcmp(words[i], "and") == 0) {
-            // Skip explicit 'AND' since it's implied between sequential words not separated by 'OR'.
+        }
+        pthread_mutex_lock(&server->lock);
+        server->returned[server->numReturned++] = fd;
+        pthread_mutex_unlock(&server->lock);
+        if (write(server->wake[1], "r", 1) < 0) {
+            // The pipe is full of wake-ups already; the main loop will see this one too.
+        }
+    }
+}
+
+// Thread that changes the served index, one change at a time: it reloads the index file
+// when asked to (by SIGHUP or a reload command), publishes newly ingested documents as
+// soon as they are queued (so ingests arriving during a publish go out together in the
+// next one), and flushes the ingested documents to the index file when asked to, once
+// FLUSH_DOCS have accumulated, or FLUSH_SECONDS after the first of them. Every change
+// starts after the requests it answers, and its outcome is published for them. When the
+// server stops it flushes whatever was ingested, so that no document is lost.
+static void* serverIndexer(void* arg) {
+    server_t* server = arg;
+    querier_t* querier = server->querier;
+    pthread_mutex_lock(&server->lock);
+    while (!server->stopping) {
+        bool reload = server->reloadsDone < server->reloadsRequested;
+        bool publish = server->numPending > 0;
+        bool flush = server->flushesDone < server->flushesRequested
+                     || (querier->numIngested > 0 && time(NULL) >= server->flushDue);
+        if (!reload && !publish && !flush) {
+            if (querier->numIngested > 0) {
+                struct timespec due = { .tv_sec = server->flushDue };
+                pthread_cond_timedwait(&server->hasWork, &server->lock, &due);
+            } else {
+                pthread_cond_wait(&server->hasWork, &server->lock);
+            }
             continue;
+        }
+
+        unsigned long target = reload ? server->reloadsRequested
+                               : publish ? server->ingestsQueued : server->flushesRequested;
+        ingestDoc_t* docs = server->pending;
+        int numDocs = server->numPending;
+        if (!reload && publish) {
+            server->pending = NULL;
+            server->numPending = server->pendingCap = 0;
+        }
+        bool wasEmpty = querier->numIngested == 0;
+        pthread_mutex_unlock(&server->lock);
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int carried = 0;
+        int flushed = querier->numIngested;
+        bool ok = reload ? reloadIndex(querier, &carried)
+                  : publish ? publishIngested(querier, docs, numDocs, &carried)
+                  : flushSegment(querier, &carried);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+        if (!reload && publish) {
+            free(docs);
+        }
+        if (reload && ok) {
+            fprintf(stderr, "Reloaded %s in %.1f ms: generation %lu, %d cached results "
+                    "carried over.\n", querier->indexFilename, ms, querier->current->generation,
+                    carried);
+        } else if (reload) {
+            fprintf(stderr, "Cannot reload %s; still serving the index loaded before.\n",
+                    querier->indexFilename);
+        } else if (!publish && ok && flushed > 0) {
+            fprintf(stderr, "Flushed %d ingested documents to %s in %.1f ms.\n", flushed,
+                    querier->indexFilename, ms);
+        } else if (!ok) {
+            fprintf(stderr, "Cannot %s ingested documents; %s.\n", publish ? "publish" : "flush",
+                    publish ? "they are dropped" : "they stay in memory");
+        }
+
+        pthread_mutex_lock(&server->lock);
+        if (reload) {
+            server->reloadsDone = target;
+            server->reloadOk = ok;
+        } else if (publish) {
+            server->ingestsPublished = target;
+            server->publishOk = ok;
+            if (querier->numIngested >= FLUSH_DOCS) {
+                server->flushDue = time(NULL);
+            } else if (wasEmpty) {
+                server->flushDue = time(NULL) + FLUSH_SECONDS;
+            }
         } else {
-            // Process individual words, scoring them against the index.
-            counters_t *wordCounterOG = index_find(index, words[i]);
-            if (wordCounterOG == NULL) {
-                // If no results for this word, then AND operations with it will always fail.
-                shortCircuit = true;
-                andSequence = NULL;
-            } else {
-                counters_t *wordCounter = counters_new();
-                counters_copy(wordCounterOG, wordCounter);
-                if (andSequence == NULL) {
-                    // Start a new AND sequence if this is the first word.
-                    andSequence = counters_new();
-                    myUnion(&andSequence, wordCounter);
-                } else {
-                    // Continue the existing AND sequence by intersecting with the current word's results.
-                    intersect(&andSequence, wordCounter);
-                }
+            if (server->flushesDone < target) {
+                server->flushesDone = target;
+                server->flushOk = ok;
+            }
+            if (!ok) {
+                server->flushDue = time(NULL) + FLUSH_SECONDS; // Try again later.
             }
         }
+        pthread_cond_broadcast(&server->workDone);
     }
 
-    // Ensure any remaining AND sequence content is merged into the final OR sequence.
-    myUnion(orSequence, andSequence);
-
-    // Check if the final OR sequence is empty, indicating no results.
-    if (counters_empty(*orSequence) == 0) {
-        *orSequence = NULL;
+    // Flush the documents ingested so far, including any queued but not yet published.
+    ingestDoc_t* docs = server->pending;
+    int numDocs = server->numPending;
+    server->pending = NULL;
+    server->numPending = server->pendingCap = 0;
+    pthread_mutex_unlock(&server->lock);
+    int carried;
+    if (numDocs > 0 && !publishIngested(querier, docs, numDocs, &carried)) {
+        fprintf(stderr, "Cannot publish %d ingested documents; they are lost.\n", numDocs);
+    }
+    free(docs);
+    int flushed = querier->numIngested;
+    if (flushed > 0 && flushSegment(querier, &carried)) {
+        fprintf(stderr, "Flushed %d ingested documents to %s.\n", flushed,
+                querier->indexFilename);
+    } else if (flushed > 0) {
+        fprintf(stderr, "Cannot flush %d ingested documents to %s; they are lost.\n", flushed,
+                querier->indexFilename);
     }
+    return NULL;
 }
 
-// intersect_itemfunc: Applies intersection logic to two counters.
-// Used as a helper for counters_iterate in the intersect function.
-void intersect_itemfunc(void *arg, const int key, int count) {
-    duo_t* args = (duo_t*)arg;
-    counters_t* final = args->first;
-    counters_t* newCounter = args->second;
+// Asks the indexer for a reload and returns its ticket: the reload that covers this
+// request is done once reloadsDone reaches the ticket. The caller holds the lock.
+static unsigned long requestReload(server_t* server) {
+    unsigned long ticket = ++server->reloadsRequested;
+    pthread_cond_signal(&server->hasWork);
+    return ticket;
+}
 
-    int countInNew = counters_get(newCounter, key); // Get count for the key in newCounter.
-    if (countInNew > 0) {
-        // Set count in final counter to the minimum of the two counts.
-        counters_set(final, key, countInNew < count ? countInNew : count);
+// Reads a page file (in the Crawler's format) into an ingested document: the page, and its
+// words of three letters or more, normalized, as the Indexer takes them. Returns false if
+// the file cannot be read or memory runs out.
+static bool ingestPage(const char* filename, int docID, ingestDoc_t* doc) {
+    webpage_t* page = pagedir_loadFile(filename);
+    if (page == NULL) {
+        return false;
+    }
+    *doc = (ingestDoc_t){ .docID = docID, .url = strdup(webpage_getURL(page)),
+                          .depth = webpage_getDepth(page),
+                          .html = strdup(webpage_getHTML(page)) };
+    int cap = 0;
+    bool ok = doc->url != NULL && doc->html != NULL;
+    int pos = 0;
+    char* word;
+    while (ok && (word = webpage_getNextWord(page, &pos)) != NULL) {
+        if (strlen(word) < 3) {
+            free(word);
+            continue;
+        }
+        normalize(word);
+        if (doc->numWords == cap) {
+            cap = cap == 0 ? 256 : cap * 2;
+            char** grown = realloc(doc->words, sizeof(char*) * cap);
+            if (grown == NULL) {
+                free(word);
+                ok = false;
+                break;
+            }
+            doc->words = grown;
+        }
+        doc->words[doc->numWords++] = word;
+    }
+    webpage_delete(page);
+    if (!ok) {
+        freeIngested(doc);
+    }
+    return ok;
+}
+
+// Carries out a control command (the request minus its PROTOCOL_CONTROL byte) and sends
+// the response:
+//   "reload" reloads the index file;
+//   "ingest docID pageFile" indexes a page file (in the Crawler's format) as document
+//       docID, replacing any earlier version of it;
+//   "flush" writes the documents ingested so far into the index file.
+// Each answers once what it asked for is done: an ingested document is searchable by the
+// time its response is sent. The page is read and tokenized here, in the worker, so that
+// the indexer only has to fold it in. Returns false if the response cannot be sent.
+static bool serverControl(server_t* server, const char* command, int fd) {
+    char reply[512];
+    char status = PROTOCOL_RESULTS;
+    const char* indexFilename = server->querier->indexFilename;
+    int docID = 0, offset = 0;
+    if (strcmp(command, "reload") == 0) {
+        pthread_mutex_lock(&server->lock);
+        unsigned long ticket = requestReload(server);
+        while (server->reloadsDone < ticket && !server->stopping) {
+            pthread_cond_wait(&server->workDone, &server->lock);
+        }
+        bool ok = server->reloadsDone >= ticket && server->reloadOk;
+        pthread_mutex_unlock(&server->lock);
+        if (ok) {
+            snprintf(reply, sizeof(reply), "Reloaded %s.\n", indexFilename);
+        } else {
+            status = PROTOCOL_INVALID;
+            snprintf(reply, sizeof(reply), "Cannot reload %s; still serving the index loaded "
+                     "before.\n", indexFilename);
+        }
+    } else if (sscanf(command, "ingest %d %n", &docID, &offset) == 1 && offset > 0
+               && docID >= 1 && command[offset] != '\0') {
+        const char* filename = command + offset;
+        // A document is new, or replaces one; a new one takes the next docID after every
+        // document served, in the page directory or ingested, so the page directory keeps
+        // no holes (which would end the Indexer's walk of it) and no docID sizes the
+        // index's arrays far beyond its documents.
+        snapshot_t* snapshot = acquireSnapshot(server->querier);
+        bool sharded = snapshot->shards != NULL;
+        int maxDocID = snapshot->numURLs;
+        if (snapshot->index != NULL && snapshot->index->numDocs > maxDocID) {
+            maxDocID = snapshot->index->numDocs;
+        }
+        if (snapshot->numSegmentDocs > 0
+            && snapshot->segmentDocs[snapshot->numSegmentDocs - 1] > maxDocID) {
+            maxDocID = snapshot->segmentDocs[snapshot->numSegmentDocs - 1];
+        }
+        releaseSnapshot(server->querier, snapshot);
+        ingestDoc_t doc;
+        if (sharded) {
+            status = PROTOCOL_INVALID;
+            snprintf(reply, sizeof(reply), "Cannot ingest into the sharded index %.400s; "
+                     "re-run the indexer instead.\n", indexFilename);
+            return protocol_sendReply(fd, status, reply, strlen(reply));
+        }
+        pthread_mutex_lock(&server->lock);
+        for (int i = 0; i < server->numPending; i++) {
+            maxDocID = server->pending[i].docID > maxDocID ? server->pending[i].docID : maxDocID;
+        }
+        pthread_mutex_unlock(&server->lock);
+        if (docID > maxDocID + 1) {
+            status = PROTOCOL_INVALID;
+            snprintf(reply, sizeof(reply), "Cannot ingest doc %d: a new document must be doc "
+                     "%d.\n", docID, maxDocID + 1);
+            return protocol_sendReply(fd, status, reply, strlen(reply));
+        }
+        if (!ingestPage(filename, docID, &doc)) {
+            status = PROTOCOL_INVALID;
+            snprintf(reply, sizeof(reply), "Cannot read page file %.400s.\n", filename);
+            return protocol_sendReply(fd, status, reply, strlen(reply));
+        }
+        int numWords = doc.numWords;
+        pthread_mutex_lock(&server->lock);
+        bool ok = true;
+        if (server->numPending == server->pendingCap) {
+            int cap = server->pendingCap == 0 ? 16 : server->pendingCap * 2;
+            ingestDoc_t* grown = realloc(server->pending, sizeof(ingestDoc_t) * cap);
+            if (grown != NULL) {
+                server->pending = grown;
+                server->pendingCap = cap;
+            }
+            ok = grown != NULL;
+        }
+        if (ok) {
+            server->pending[server->numPending++] = doc;
+            unsigned long ticket = ++server->ingestsQueued;
+            pthread_cond_signal(&server->hasWork);
+            while (server->ingestsPublished < ticket && !server->stopping) {
+                pthread_cond_wait(&server->workDone, &server->lock);
+            }
+            ok = server->ingestsPublished >= ticket && server->publishOk;
+        } else {
+            freeIngested(&doc);
+        }
+        pthread_mutex_unlock(&server->lock);
+        if (ok) {
+            snprintf(reply, sizeof(reply), "Ingested doc %d: %d words.\n", docID, numWords);
+        } else {
+            status = PROTOCOL_INVALID;
+            snprintf(reply, sizeof(reply), "Doc %d is not searchable: out of memory, or the "
+                     "server is stopping.\n", docID);
+        }
+    } else if (strcmp(command, "flush") == 0) {
+        pthread_mutex_lock(&server->lock);
+        unsigned long ticket = ++server->flushesRequested;
+        pthread_cond_signal(&server->hasWork);
+        while (server->flushesDone < ticket && !server->stopping) {
+            pthread_cond_wait(&server->workDone, &server->lock);
+        }
+        bool ok = server->flushesDone >= ticket && server->flushOk;
+        pthread_mutex_unlock(&server->lock);
+        if (ok) {
+            snprintf(reply, sizeof(reply), "Flushed ingested documents to %s.\n", indexFilename);
+        } else {
+            status = PROTOCOL_INVALID;
+            snprintf(reply, sizeof(reply), "Cannot flush ingested documents to %s.\n",
+                     indexFilename);
+        }
     } else {
-        // Key doesn't exist in newCounter, so it's not included in the intersection.
-        counters_set(final, key, 0);
+        status = PROTOCOL_INVALID;
+        snprintf(reply, sizeof(reply), "Unknown command.\n");
+    }
+    return protocol_sendReply(fd, status, reply, strlen(reply));
+}
+
+// Adds fd to the connections the main loop waits on. Returns false if out of memory.
+static bool addConnection(server_t* server, int fd) {
+    if (server->numIdle == server->idleCap) {
+        // Each array is replaced as soon as it has grown; the capacity only
+        // changes once all three have.
+        int cap = server->idleCap == 0 ? 64 : server->idleCap * 2;
+        int* idle = realloc(server->idle, sizeof(int) * cap);
+        if (idle == NULL) {
+            return false;
+        }
+        server->idle = idle;
+        int* ready = realloc(server->ready, sizeof(int) * cap);
+        if (ready == NULL) {
+            return false;
+        }
+        server->ready = ready;
+        int* returned = realloc(server->returned, sizeof(int) * cap);
+        if (returned == NULL) {
+            return false;
+        }
+        server->returned = returned;
+        server->idleCap = cap;
     }
+    server->idle[server->numIdle++] = fd;
+    return true;
 }
 
-// intersect: Modifies the first counter to include only keys present in both counters.
-// Counts are set to the minimum found in either counter, applying 'AND' logic.
-void intersect(counters_t **result, counters_t *newCounter) {
-    if (*result == NULL || newCounter == NULL) {
-        return; // If either counter is NULL, no operation is performed.
+// Serves queries on address until SIGINT or SIGTERM. The main thread waits (poll) on the
+// listening socket, on every idle connection and on a wake-up pipe; new connections are
+// accepted into the idle set, and a connection with a request waiting moves to the ready
+// queue, where the first free worker takes it. Workers hand connections back through the
+// pipe once they have answered. So numThreads workers serve any number of clients, and a
+// client waiting between requests holds no worker. An indexer thread swaps in a freshly
+// loaded index on SIGHUP or a reload command, and folds in ingested documents, while the
+// workers keep answering. Returns false if the server cannot start.
+static bool processServer(querier_t* querier, const char* address, int numThreads) {
+    server_t server = { .querier = querier };
+    server.listener = protocol_listen(address);
+    if (server.listener < 0) {
+        fprintf(stderr, "Cannot listen on %s: %s\n", address, strerror(errno));
+        return false;
+    }
+    if (pipe(server.wake) != 0) {
+        close(server.listener);
+        return false;
     }
+    serverWakeFd = server.wake[1];
+    struct sigaction action = { .sa_handler = signalServer };
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGHUP, &action, NULL);
+    signal(SIGPIPE, SIG_IGN); // A client that hangs up mid-response is just closed.
 
-    counters_t* final = counters_new(); // Create a new counter for the intersection result.
-    duo_t args = {.first = final, .second = newCounter};
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_cond_init(&server.hasReady, NULL);
+    pthread_cond_init(&server.hasWork, NULL);
+    pthread_cond_init(&server.workDone, NULL);
+    pthread_t indexer;
+    pthread_t threads[numThreads];
+    int started = 0;
+    if (pthread_create(&indexer, NULL, serverIndexer, &server) == 0) {
+        while (started < numThreads
+               && pthread_create(&threads[started], NULL, serverWorker, &server) == 0) {
+            started++;
+        }
+    }
+    fprintf(stderr, "Serving %s on %s with %d threads.\n", querier->indexFilename, address, started);
 
-    counters_iterate(*result, &args, intersect_itemfunc); // Apply intersection logic.
+    struct pollfd* fds = NULL;
+    int fdsCap = 0;
+    while (!serverStopping && started > 0) {
+        if (fdsCap < server.numIdle + 2) {
+            fdsCap = server.idleCap + 2;
+            struct pollfd* grown = realloc(fds, sizeof(struct pollfd) * fdsCap);
+            if (grown == NULL) {
+                break;
+            }
+            fds = grown;
+        }
+        fds[0] = (struct pollfd){ .fd = server.listener, .events = POLLIN };
+        fds[1] = (struct pollfd){ .fd = server.wake[0], .events = POLLIN };
+        int numIdle = server.numIdle;
+        for (int i = 0; i < numIdle; i++) {
+            fds[i + 2] = (struct pollfd){ .fd = server.idle[i], .events = POLLIN };
+        }
+        if (poll(fds, numIdle + 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
 
-    counters_delete(*result); // Clean up the original result counter.
-    *result = final; // Update result to point to the new intersection result.
-}
+        if (querier->latency != NULL) {
+            reportTiming(querier);
+        }
 
-/*
-// MIRROR 
-// This function adds count from 'temp' to 'result' for each key.
-void union_itemfunc(void *arg, const int key, int count1) {
-    duo_t* args = (duo_t*)arg;
-    counters_t* final = args->first;
-    counters_t* temp = args->second;
+        // Connections with a request (or a hang-up) waiting go to the workers.
+        pthread_mutex_lock(&server.lock);
+        if (serverReload) {
+            serverReload = 0;
+            requestReload(&server);
+        }
+        int kept = 0;
+        for (int i = 0; i < numIdle; i++) {
+            if (fds[i + 2].revents != 0) {
+                server.ready[server.numReady++] = server.idle[i];
+            } else {
+                server.idle[kept++] = server.idle[i];
+            }
+        }
+        server.numIdle = kept;
+        pthread_cond_broadcast(&server.hasReady);
 
-    //counters_t *result = (counters_t *)arg;
-    int count2 = counters_get(temp, key);
+        // Connections the workers are done with wait for their next request.
+        if (fds[1].revents != 0) {
+            char drain[64];
+            if (read(server.wake[0], drain, sizeof(drain)) < 0) {
+                // Nothing to drain after all.
+            }
+            for (int i = 0; i < server.numReturned; i++) {
+                server.idle[server.numIdle++] = server.returned[i];
+            }
+            server.numReturned = 0;
+        }
+        pthread_mutex_unlock(&server.lock);
 
-    counters_set(final, key, count1 + count2); // Add counts together
+        if (fds[0].revents != 0) {
+            int fd = accept(server.listener, NULL, NULL);
+            pthread_mutex_lock(&server.lock);
+            if (fd >= 0 && !addConnection(&server, fd)) {
+                close(fd);
+            }
+            pthread_mutex_unlock(&server.lock);
+        }
+    }
+
+    // Let the workers finish the requests they hold and any reload finish, then close
+    // everything.
+    pthread_mutex_lock(&server.lock);
+    server.stopping = true;
+    pthread_cond_broadcast(&server.hasReady);
+    pthread_cond_broadcast(&server.hasWork);
+    pthread_cond_broadcast(&server.workDone);
+    pthread_mutex_unlock(&server.lock);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    if (started > 0) {
+        pthread_join(indexer, NULL);
+    }
+    for (int i = 0; i < server.numIdle; i++) {
+        close(server.idle[i]);
+    }
+    for (int i = 0; i < server.numReturned; i++) {
+        close(server.returned[i]);
+    }
+    close(server.listener);
+    if (strchr(address, '/') != NULL || strchr(address, ':') == NULL) {
+        unlink(address); // Remove the Unix socket.
+    }
+    serverWakeFd = -1;
+    close(server.wake[0]);
+    close(server.wake[1]);
+    pthread_cond_destroy(&server.hasReady);
+    pthread_cond_destroy(&server.hasWork);
+    pthread_cond_destroy(&server.workDone);
+    pthread_mutex_destroy(&server.lock);
+    free(fds);
+    free(server.idle);
+    free(server.ready);
+    free(server.returned);
+    fprintf(stderr, "Server on %s stopped.\n", address);
+    return started > 0;
 }
 
-// Modifies 'result' to be the union of 'result' and 'temp'.
-void myUnion(counters_t **result, counters_t *temp) {
-    // Create a new counters set for the union operation
-    counters_t *final = counters_new();
-    if (final == NULL) {
-        fprintf(stderr, "Failed to create new counters for union operation.\n");
-        return; // Early return on failure to allocate new counters
+// Loads every document's URL (the first line of its page file) into the snapshot, so that
+// printing results reads no files. Stops at the first docID without a page file.
+static void loadURLs(const char* pageDirectory, snapshot_t* snapshot) {
+    int cap = 0;
+    for (int docID = 1; ; docID++) {
+        char filename[256];
+        snprintf(filename, sizeof(filename), "%s/%d", pageDirectory, docID);
+        FILE* file = fopen(filename, "r");
+        if (file == NULL) {
+            break;
+        }
+        char* url = file_readLine(file);
+        fclose(file);
+        if (docID >= cap) {
+            cap = cap == 0 ? 1024 : cap * 2;
+            char** grown = realloc(snapshot->urls, sizeof(char*) * cap);
+            if (grown == NULL) {
+                free(url);
+                break;
+            }
+            snapshot->urls = grown;
+        }
+        snapshot->urls[docID] = url;
+        snapshot->numURLs = docID;
     }
+}
 
-    // Add counts from the first counters set, if it exists
-    if (*result != NULL) {
-        counters_iterate(*result, final, (void (*)(void *, const int, int))counters_set);
+// Answers a query from the querier's cache if it can, and otherwise with scoreSnapshot,
+// caching the result. The cache key is the query's canonical form
+// (query_canonical) prefixed with the snapshot's generation and the options that change
+// results, so "b and a" hits the entry that "a b" left, and no result outlives its index. Fills
+// *matches with the ranked matches and returns their number, as score does. If scoreNs is not
+// NULL, stores in it the nanoseconds spent scoring (0 on a cache hit).
+int lookup(querier_t* querier, snapshot_t* snapshot, int numWords, char* words[],
+           match_t** matches, uint64_t* scoreNs) {
+    char* canonical = query_canonical(words, numWords);
+    char* key = canonical != NULL ? malloc(strlen(canonical) + 48) : NULL;
+    if (key != NULL) {
+        sprintf(key, "%lu %d %s %s", snapshot->generation, querier->top,
+                querier->ranking == QUERY_BM25 ? "bm25" : "count", canonical);
     }
+    free(canonical);
 
-    // Add counts from the second counters set, if it exists
-    if (temp != NULL) {
-        counters_iterate(temp, final, (void (*)(void *, const int, int))counters_set);
+    void* value = NULL;
+    size_t size = 0;
+    int numMatches = 0;
+    if (key != NULL && cache_get(querier->cache, key, &value, &size)) {
+        *matches = value;
+        numMatches = size / sizeof(match_t);
+    } else {
+        uint64_t start = scoreNs != NULL ? latency_now() : 0;
+        numMatches = scoreSnapshot(querier, snapshot, numWords, words, matches);
+        if (scoreNs != NULL) {
+            *scoreNs = latency_now() - start;
+        }
+        cache_put(querier->cache, key, *matches, sizeof(match_t) * numMatches);
     }
+    free(key);
+    return numMatches;
+}
 
-    // Clean up the old counters set if it exists
-    if (*result != NULL) {
-        counters_delete(*result);
+// Scores a query on a snapshot: on its base index (scattered over its shards and docID
+// ranges by scoreIndex)
+// and, if it has one, on its segment of
+// ingested documents, whose versions of a document replace the base's. The base is asked
+// for as many extra matches as the segment holds documents, so the top ones survive the
+// replaced being dropped, and the two lists are merged. Fills *matches and returns their
+// number, as score does.
+static int scoreSnapshot(querier_t* querier, snapshot_t* snapshot, int numWords,
+                         char* words[], match_t** matches) {
+    int top = querier->top;
+    index_t** shards = snapshot->shards != NULL ? snapshot->shards : &snapshot->index;
+    int numShards = snapshot->shards != NULL ? snapshot->numShards : 1;
+    if (snapshot->segment == NULL) {
+        return scoreIndex(querier, shards, numShards, numWords, words, top, matches);
+    }
+    match_t* base = NULL;
+    match_t* recent = NULL;
+    int numBase = scoreIndex(querier, shards, numShards, numWords, words,
+                             top > 0 ? top + snapshot->numSegmentDocs : 0, &base);
+    int numRecent = score(snapshot->segment, numWords, words, top, querier->ranking, &recent);
+    match_t* all = malloc(sizeof(match_t) * (numBase + numRecent + 1));
+    int numMatches = 0;
+    if (all != NULL) {
+        for (int i = 0; i < numBase; i++) {
+            if (bsearch(&base[i].docID, snapshot->segmentDocs, snapshot->numSegmentDocs,
+                        sizeof(int), compareDocIDs) == NULL) {
+                all[numMatches++] = base[i];
+            }
+        }
+        for (int i = 0; i < numRecent; i++) {
+            all[numMatches++] = recent[i];
+        }
+        qsort(all, numMatches, sizeof(match_t), compareMatches);
+        if (top > 0 && numMatches > top) {
+            numMatches = top;
+        }
     }
+    if (numMatches == 0) {
+        free(all);
+        all = NULL;
+    }
+    free(base);
+    free(recent);
+    *matches = all;
+    return numMatches;
+}
 
-    // Point *result to the new combined counters set
-    *result = final;
-    // If temp is NULL, there's nothing to add to the result.
+// Orders docIDs, for searching a snapshot's sorted segmentDocs.
+static int compareDocIDs(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
 }
-*/
 
+// Scores a query by compiling it into an operator tree (see common/query.h) and walking
+// its matches document-at-a-time, scored as ranking says. Fills *matches with an array of
+// document IDs and their scores, ranked best first by compareMatches, and returns its
+// length; *matches is left NULL if no document matches. With top > 0 only the top
+// best-scoring documents are kept, found (already ranked) by query_top without scoring
+// every match.
+int score(index_t *index, int numWords, char *words[], int top, queryRank_t ranking,
+          match_t **matches) {
+    *matches = NULL;
+    query_t *query = query_new(index, words, numWords, ranking);
+    if (query == NULL) {
+        return 0; // No words to look up, or out of memory.
+    }
+    return scoreQuery(query, top, matches);
+}
 
-// WORKING VERSION
-// This function adds count from 'temp' to 'result' for each key.
-void union_itemfunc(void *arg, const int key, int count1) {
-    counters_t *result = (counters_t *)arg;
-    int count2 = counters_get(result, key);
+// Scores an already built query as score does: its top best matches found with query_top,
+// or every match, ranked with compareMatches. Deletes the query. Fills *matches (NULL if
+// nothing matches) and returns their number. query_top's output arrays are the query's own
+// scratch memory, so only the matches themselves are malloc'd.
+static int scoreQuery(query_t* query, int top, match_t** matches) {
+    *matches = NULL;
+    int numMatches = 0;
+    if (top > 0) {
+        int *docs = query_alloc(query, sizeof(int) * top);
+        double *scores = query_alloc(query, sizeof(double) * top);
+        int found = docs != NULL && scores != NULL ? query_top(query, top, docs, scores) : -1;
+        *matches = found > 0 ? malloc(sizeof(match_t) * found) : NULL;
+        for (numMatches = 0; *matches != NULL && numMatches < found; numMatches++) {
+            (*matches)[numMatches].docID = docs[numMatches];
+            (*matches)[numMatches].score = scores[numMatches];
+        }
+    } else {
+        int capacity = 0;
+        double docScore = 0;
+        for (int docID = query_next(query, &docScore); docID != POSTINGS_END;
+             docID = query_next(query, &docScore)) {
+            if (numMatches == capacity) {
+                capacity = capacity == 0 ? 64 : capacity * 2;
+                match_t *grown = realloc(*matches, sizeof(match_t) * capacity);
+                if (grown == NULL) {
+                    break; // Out of memory: rank what was found so far.
+                }
+                *matches = grown;
+            }
+            (*matches)[numMatches].docID = docID;
+            (*matches)[numMatches].score = docScore;
+            numMatches++;
+        }
+        if (numMatches > 1) {
+            qsort(*matches, numMatches, sizeof(match_t), compareMatches);
+        }
+    }
+    query_delete(query);
 
-    counters_set(result, key, count1 + count2); // Add counts together
+    // Check if the result is empty, indicating no matches.
+    if (numMatches == 0) {
+        free(*matches);
+        *matches = NULL;
+    }
+    return numMatches;
 }
 
-// myUnion: Combines two counters, modifying the first to include all keys from both,
-// with their counts summed, applying 'OR' logic to query processing.
-void myUnion(counters_t **result, counters_t *temp) {
-    if (*result == NULL) {
-        *result = temp; // If result is NULL, simply use temp as the result.
-    } else if (temp != NULL) {
-        counters_iterate(temp, *result, union_itemfunc); // Apply union logic to combine counters.
-        counters_delete(temp); // Clean up temp counter after merging.
+// Scores range r of a job: the job's query on the range's index, restricted to the range's
+// docIDs unless the range was left whole. Returns false if out of memory.
+static bool scoreRange(rangeJob_t* job, int r) {
+    rangePart_t* range = &job->ranges[r];
+    query_t* query = range->query;
+    if (query == NULL) {
+        query = query_newRange(range->index, job->words, job->numWords, job->ranking,
+                               range->first, range->last);
     }
-    // If temp is NULL, no modification is made to result.
+    range->query = NULL;
+    range->matches = NULL;
+    range->numMatches = query != NULL ? scoreQuery(query, job->top, &range->matches) : 0;
+    return query != NULL;
 }
 
+// Claims the next range of the pool's first job, taking the job off the queue once all its
+// ranges are claimed. The caller holds the pool's lock. Returns the range, or -1.
+static int claimRange(rangePool_t* pool, rangeJob_t* job) {
+    if (job->next == job->numRanges) {
+        return -1;
+    }
+    int r = job->next++;
+    if (job->next == job->numRanges) {
+        rangeJob_t** link = &pool->queue;
+        while (*link != job) {
+            link = &(*link)->nextJob;
+        }
+        *link = job->nextJob;
+    }
+    return r;
+}
 
-// Function to copy one counters structure to another
-void counters_copy(counters_t *source, counters_t *destination) {
-    // Iterate over the source counters, setting each key-count pair in the destination
-    counters_iterate(source, destination, (void (*)(void *, const int, int))counters_set);
+// Thread of the range pool: scores ranges of queued jobs until the pool stops.
+static void* rangeWorker(void* arg) {
+    rangePool_t* pool = arg;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->queue == NULL && !pool->stopping) {
+            pthread_cond_wait(&pool->hasJob, &pool->lock);
+        }
+        if (pool->queue == NULL) {
+            break;
+        }
+        rangeJob_t* job = pool->queue;
+        int r = claimRange(pool, job);
+        pthread_mutex_unlock(&pool->lock);
+        bool ok = scoreRange(job, r);
+        pthread_mutex_lock(&pool->lock);
+        job->failed |= !ok;
+        job->done++;
+        pthread_cond_broadcast(&pool->rangeDone);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
 }
 
-// Checks if a counters structure is empty (i.e., contains no keys with positive counts).
-// Iterates over all keys in the counters structure and sums their counts to determine if any positive counts exist.
-// Returns 0 if the counters structure has no keys with positive counts, indicating it's "empty" for our purposes.
-int counters_empty(counters_t *source) {
-    int sum = 0; // Initialize sum of counts to 0.
-    counters_iterate(source, &sum, counters_additemfunc); // Sum all counts in the counters.
-    return sum; // Return the total sum of counts. A non-zero value indicates the counters is not empty.
+// Starts a pool of numThreads range threads for the querier. Returns false if none starts.
+static bool startRangePool(querier_t* querier, int numThreads) {
+    rangePool_t* pool = calloc(1, sizeof(rangePool_t));
+    pthread_t* threads = calloc(numThreads, sizeof(pthread_t));
+    if (pool == NULL || threads == NULL) {
+        free(pool);
+        free(threads);
+        return false;
+    }
+    pool->threads = threads;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->hasJob, NULL);
+    pthread_cond_init(&pool->rangeDone, NULL);
+    while (pool->numThreads < numThreads
+           && pthread_create(&threads[pool->numThreads], NULL, rangeWorker, pool) == 0) {
+        pool->numThreads++;
+    }
+    querier->pool = pool;
+    if (pool->numThreads == 0) {
+        stopRangePool(querier);
+        return false;
+    }
+    return true;
 }
 
-// Helper function for counters_iterate that adds a specified count to a cumulative total.
-// Used in conjunction with counters_iterate to aggregate counts from a counters structure.
-// @param arg Pointer to an integer acting as the cumulative total of counts.
-// @param key The key for the current counters item (unused in this function).
-// @param count The count associated with the current key, to be added to the total.
-void counters_additemfunc(void* arg, int key, int count) {
-    int *total = (int*)arg; // Cast arg back to pointer to int for the total count.
-    *total += count; // Add the count of the current key to the total.
+// Stops the range pool's threads, once they have finished the ranges they hold, and frees
+// the pool. Does nothing without a pool.
+static void stopRangePool(querier_t* querier) {
+    rangePool_t* pool = querier->pool;
+    if (pool == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->hasJob);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->numThreads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_cond_destroy(&pool->rangeDone);
+    pthread_cond_destroy(&pool->hasJob);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool);
+    querier->pool = NULL;
 }
 
-// Identifies the document (key) with the maximum score (count) within a counters structure.
-// Used with counters_iterate to scan all counters items, keeping track of the max score and corresponding document ID.
-// @param arg Pointer to an array of two integers where [0] holds the maximum score found so far, and [1] holds the corresponding document ID.
-// @param key The current document ID being examined.
-// @param count The score associated with the current document ID.
-void findMaxScore(void *arg, const int key, const int count) {
-    int *maxData = (int *)arg; // Cast arg to pointer to array of two integers.
-    if (count > maxData[0]) { // Check if the current score exceeds the max score found so far.
-        maxData[0] = count; // Update the maximum score.
-        maxData[1] = key; // Update the document ID associated with the maximum score.
+// Splits a query on one index (or shard) into the ranges scoreIndex scatters: none if
+// nothing can match, the whole index if there is no range pool or the span of docIDs the
+// query can match is too narrow to be worth splitting, and otherwise querier->ranges ranges
+// of equal width over that span. Returns the number of ranges filled in.
+static int splitQuery(querier_t* querier, index_t* index, int numWords, char* words[],
+                      rangePart_t* ranges) {
+    query_t* query = query_new(index, words, numWords, querier->ranking);
+    int first, last;
+    if (query == NULL || !query_span(query, &first, &last)) {
+        query_delete(query);
+        return 0; // No words to look up, nothing matches, or out of memory.
+    }
+    int numRanges = querier->pool != NULL ? querier->ranges : 1;
+    if ((long)last - first + 1 < (long)numRanges * RANGE_MIN_DOCS) {
+        ranges[0] = (rangePart_t){ .index = index, .query = query, .first = first,
+                                   .last = last };
+        return 1;
     }
+    query_delete(query);
+    int width = (int)(((long)last - first + 1) / numRanges);
+    for (int r = 0; r < numRanges; r++) {
+        ranges[r] = (rangePart_t){ .index = index, .first = first + r * width,
+                                   .last = r == numRanges - 1 ? last : first + (r + 1) * width - 1 };
+    }
+    return numRanges;
 }
 
-// Ranks documents based on their scores and prints the ranked list.
-// Iterates through the counters structure to find and print documents in descending order of score.
-// Utilizes the findMaxScore function to identify the highest scoring document on each iteration.
-// @param result The counters structure containing document IDs as keys and scores as counts.
-// @param pageDir The directory containing the page files produced by the Crawler.
-void rank(counters_t *result, char* pageDir) {
-    while(true) {
-        int maxData[2] = {0, -1}; // Array to store the highest score found and corresponding document ID.
-        counters_iterate(result, maxData, findMaxScore); // Find the highest scoring document.
+// Scores a query on a base index of numShards shards (or on one index) as score does, but
+// scattered over the range pool: every shard's matches are a range of their own, cut into
+// querier->ranges ranges of equal width when they span enough docIDs (splitQuery). The
+// ranges are evaluated by the range pool's threads and this one, taking ranges until none
+// is left, and the partial rankings are gathered and merged. Each range finds its own top
+// best matches, so the merge holds exactly the top of the whole ranking, with the same
+// scores; shards joined by index_joinShards score as the unsharded index would.
+static int scoreIndex(querier_t* querier, index_t** shards, int numShards, int numWords,
+                      char* words[], int top, match_t** matches) {
+    *matches = NULL;
+    rangePool_t* pool = querier->pool;
+    if (pool == NULL && numShards == 1) {
+        return score(shards[0], numWords, words, top, querier->ranking, matches);
+    }
+    rangePart_t ranges[numShards * querier->ranges];
+    int numRanges = 0;
+    for (int s = 0; s < numShards; s++) {
+        numRanges += splitQuery(querier, shards[s], numWords, words, ranges + numRanges);
+    }
+    rangeJob_t job = { .words = words, .numWords = numWords, .top = top,
+                       .ranking = querier->ranking, .ranges = ranges, .numRanges = numRanges };
+    if (numRanges == 1 || (pool == NULL && numRanges > 0)) {
+        for (int r = 0; r < numRanges; r++) {
+            job.failed |= !scoreRange(&job, r); // One range, or no threads to share them.
+        }
+        if (numRanges == 1) {
+            *matches = ranges[0].matches;
+            return ranges[0].numMatches;
+        }
+    } else if (numRanges > 1) {
+        pthread_mutex_lock(&pool->lock);
+        rangeJob_t** link = &pool->queue;
+        while (*link != NULL) {
+            link = &(*link)->nextJob;
+        }
+        *link = &job;
+        pthread_cond_broadcast(&pool->hasJob);
+        int r;
+        while ((r = claimRange(pool, &job)) >= 0) {
+            pthread_mutex_unlock(&pool->lock);
+            bool ok = scoreRange(&job, r);
+            pthread_mutex_lock(&pool->lock);
+            job.failed |= !ok;
+            job.done++;
+        }
+        while (job.done < numRanges) {
+            pthread_cond_wait(&pool->rangeDone, &pool->lock);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
 
-        if (maxData[1] == -1) {
-            break; // Exit loop if no document has a positive score (i.e., all have been processed).
+    // Gather the partial rankings, which cover disjoint docIDs.
+    int total = 0;
+    for (int r = 0; r < numRanges; r++) {
+        total += ranges[r].numMatches;
+    }
+    match_t* merged = !job.failed && total > 0 ? malloc(sizeof(match_t) * total) : NULL;
+    int numMatches = 0;
+    for (int r = 0; r < numRanges; r++) {
+        if (merged != NULL && ranges[r].numMatches > 0) {
+            memcpy(merged + numMatches, ranges[r].matches, sizeof(match_t) * ranges[r].numMatches);
+            numMatches += ranges[r].numMatches;
         }
+        free(ranges[r].matches);
+    }
+    if (numMatches > 1) {
+        qsort(merged, numMatches, sizeof(match_t), compareMatches);
+    }
+    if (top > 0 && numMatches > top) {
+        numMatches = top;
+    }
+    if (numMatches == 0) {
+        free(merged);
+        merged = NULL;
+    }
+    *matches = merged;
+    return numMatches;
+}
 
-        // Construct the filename to open the document file.
-        char filename[256];
-        sprintf(filename, "%s/%d", pageDir, maxData[1]);
-        FILE* file = fopen(filename, "r");
+// Orders matches best first: higher scores first, and lower document IDs first among
+// equal scores. Used with qsort by score.
+int compareMatches(const void *a, const void *b) {
+    const match_t *x = a, *y = b;
+    if (x->score != y->score) {
+        return x->score > y->score ? -1 : 1;
+    }
+    return (x->docID > y->docID) - (x->docID < y->docID);
+}
 
-        if (file == NULL) {
-            fprintf(stderr, "Error opening file %s", filename);
-            exit(1); // Exit with error if the file cannot be opened.
-        }
+// Prints the ranked list of documents to out: each document's score, ID and URL, in the
+// order score ranked them; count scores print as integers, BM25 scores with four decimals.
+// URLs come from the snapshot's URL table when it has one, else from the page files.
+// @param out Where to print.
+// @param querier The page directory and ranking.
+// @param snapshot The snapshot the matches came from.
+// @param matches The document IDs and scores of the matching documents, best first.
+// @param numMatches The number of matches.
+void rank(FILE *out, querier_t *querier, snapshot_t *snapshot, match_t *matches,
+          int numMatches) {
+    for (int i = 0; i < numMatches; i++) {
+        int docID = matches[i].docID;
+        char *url = NULL;
+        int* recent = snapshot->numSegmentDocs > 0
+                      ? bsearch(&docID, snapshot->segmentDocs, snapshot->numSegmentDocs,
+                                sizeof(int), compareDocIDs)
+                      : NULL;
+        if (recent != NULL) {
+            url = strdup(snapshot->segmentURLs[recent - snapshot->segmentDocs]); // Ingested.
+        } else if (docID <= snapshot->numURLs && snapshot->urls[docID] != NULL) {
+            url = strdup(snapshot->urls[docID]); // The URL was loaded up front.
+        } else {
+            // Construct the filename to open the document file.
+            char filename[256];
+            sprintf(filename, "%s/%d", querier->pageDirectory, docID);
+            FILE* file = fopen(filename, "r");
 
-        char *url = file_readLine(file); // Read the document's URL from the file.
-        fclose(file); // Close the file after reading the URL.
+            // A page file removed since the index was built leaves its URL unknown; a
+            // server's workers must answer the query rather than exit.
+            if (file != NULL) {
+                url = file_readLine(file); // Read the document's URL from the file.
+                fclose(file); // Close the file after reading the URL.
+            }
+        }
+        const char* shown = url != NULL ? url : "(page file missing)";
 
         // Print the document's score, ID, and URL.
-        printf("score %d doc %d: %s\n", maxData[0], maxData[1], url);
+        if (querier->ranking == QUERY_BM25) {
+            fprintf(out, "score %.4f doc %d: %s\n", matches[i].score, docID, shown);
+        } else {
+            fprintf(out, "score %d doc %d: %s\n", (int)matches[i].score, docID, shown);
+        }
         free(url); // Free the memory allocated for the URL.
-
-        counters_set(result, maxData[1], 0); // Set the score for this document to 0 to avoid re-selecting it.
     }
 }
 
@@ -393,24 +1978,86 @@ void rank(counters_t *result, char* pageDir) {
 // Main function: Entry point of the querier program.
 // Validates command line arguments, loads the index from the file, and processes queries.
 int main(const int argc, char* argv[]) {
-    char* pageDirectory = NULL; // Pointer to store the path to the page directory.
-    char* indexFilename = NULL; // Pointer to store the path to the index file.
+    querier_t querier = { NULL }; // Index snapshot, page directory, options and cache.
+    int cacheKB = CACHE_KB; // Result cache budget, in kilobytes.
+    char* batchFile = NULL; // File of queries to answer in batch mode, or NULL.
+    char* serveAddress = NULL; // Address to serve queries on in server mode, or NULL.
+    int numThreads = 1; // Worker threads in batch and server mode.
 
     // Parse and validate command line arguments.
-    parseArgs(argc, argv, &pageDirectory, &indexFilename);
+    parseArgs(argc, argv, &querier, &cacheKB, &batchFile, &serveAddress, &numThreads);
+    querier.urlTable = serveAddress != NULL; // A long-running server reads no page files.
+    if (querier.slowMs >= 0) {
+        querier.latency = latency_new(NUM_PHASES, PHASE_NAMES);
+        if (querier.latency == NULL) {
+            fprintf(stderr, "Cannot time queries; answering them untimed.\n");
+        } else {
+            struct sigaction action = { .sa_handler = signalTiming, .sa_flags = SA_RESTART };
+            sigemptyset(&action.sa_mask);
+            sigaction(SIGUSR1, &action, NULL);
+        }
+    }
+    pthread_mutex_init(&querier.lock, NULL);
+    pthread_cond_init(&querier.drained, NULL);
 
-    // Load the index from the file.
-    index_t* index = index_new();
-    if (fileToIndex(index, indexFilename) == NULL) {
+    // Note the index file's identity before loading it, so that a change made while it
+    // loads is noticed before the first query; then load the index.
+    querier.cache = cache_new((size_t)cacheKB * 1024);
+    snapshot_t* snapshot = NULL;
+    if (querier.cache != NULL) {
+        cache_watch(querier.cache, querier.indexFilename);
+        snapshot = loadSnapshot(&querier);
+    }
+    if (snapshot != NULL) {
+        installSnapshot(&querier, snapshot);
+    } else {
+        cache_delete(querier.cache);
+        free(querier.pageDirectory);
+        free(querier.indexFilename);
         exit(1); // Exit with error if loading the index fails.
     }
 
-    // Process queries from the user.
-    processQuery(index, pageDirectory);
+    // Start the threads that share each query's docID ranges, --ranges of them for each
+    // shard; without them, every query runs on one thread.
+    int rangeThreads = querier.ranges * (snapshot->shards != NULL ? snapshot->numShards : 1);
+    rangeThreads = (rangeThreads < MAX_THREADS ? rangeThreads : MAX_THREADS) - 1;
+    if (rangeThreads > 0 && !startRangePool(&querier, rangeThreads)) {
+        fprintf(stderr, "Cannot start range threads; each query runs on one thread.\n");
+    }
+
+    // Process queries from the user, or the batch.
+    bool ok = true;
+    if (batchFile != NULL) {
+        ok = processBatch(&querier, batchFile, numThreads);
+    } else if (serveAddress != NULL) {
+        ok = processServer(&querier, serveAddress, numThreads);
+    } else {
+        processQuery(&querier);
+    }
+
+    // Report how well the cache did, and how long the queries took.
+    if (cacheKB > 0) {
+        fflush(stdout);
+        cache_stats(querier.cache, stderr);
+    }
+    if (querier.latency != NULL) {
+        fflush(stdout);
+        latency_print(querier.latency, stderr);
+    }
 
     // Cleanup: Free allocated resources.
-    index_delete(index); // Delete the index structure.
-    free(pageDirectory); // Free the page directory path string.
-    free(indexFilename); // Free the index file path string.
-    exit(0); // Exit successfully.
+    stopRangePool(&querier); // Stop the range threads.
+    cache_delete(querier.cache); // Delete the result cache.
+    latency_delete(querier.latency); // Delete the latency histograms.
+    deleteSnapshot(querier.current); // Delete the index structure and URL table.
+    query_freeSpares(); // Free this thread's kept query scratch memory.
+    for (int i = 0; i < querier.numIngested; i++) {
+        freeIngested(&querier.ingested[i]); // Documents a failed flush left in memory.
+    }
+    free(querier.ingested);
+    pthread_cond_destroy(&querier.drained);
+    pthread_mutex_destroy(&querier.lock);
+    free(querier.pageDirectory); // Free the page directory path string.
+    free(querier.indexFilename); // Free the index file path string.
+    exit(ok ? 0 : 1); // Exit successfully, unless the batch or server could not be run.
 }
@@ -9,30 +9,264 @@
  * search terms were found.
  *
  * Usage:
- * ./querier pageDirectory indexFilename
+ * ./querier pageDirectory indexFilename [--top k] [--rank count|bm25] [--cache KB]
+ *           [--batch queryFile | --serve address] [--threads n] [--ranges n]
+ *           [--timing ms] [--explain plan|analyze]
  * - pageDirectory: the pathname of a directory produced by the Crawler
  * - indexFilename: the pathname of a file produced by the Indexer
+ * - k: print only the k best-scoring documents of each query (default: all)
+ * - count|bm25: score documents by word counts (default) or with Okapi BM25,
+ *   using the document statistics the Indexer writes to indexFilename.stats
+ * - KB: memory budget of the result cache in kilobytes (default 1024; 0 turns
+ *   it off)
+ * - queryFile: answer the queries in this file, one per line ("-" for stdin),
+ *   without prompting, using n worker threads (default: one per processor)
+ * - address: serve queries from qclient on this Unix socket path, or on
+ *   localhost:port, with n worker threads, until SIGINT or SIGTERM; SIGHUP
+ *   (or "qclient address --reload") reloads the index without stopping, and
+ *   "qclient address --ingest" adds page files to the served index (written
+ *   into indexFilename by "qclient address --flush", and periodically)
+ * - ranges: evaluate each query on this many docID ranges in parallel and
+ *   merge the partial results (default 1), which cuts the latency of heavy
+ *   queries on an otherwise idle many-core machine
+ * - ms: time every query phase by phase (parse, lookup, score, rank), print
+ *   each phase's latency percentiles to stderr at exit and on SIGUSR1, and
+ *   log each query that takes at least ms milliseconds to stderr (0 logs
+ *   them all)
+ * - plan|analyze: after each query's results, print its plan (the operator
+ *   tree and each word's document frequency) on every shard; analyze also
+ *   runs the query again and shows what each operator read, produced and
+ *   spent
  *
  * The querier supports boolean operators 'AND' and 'OR' (in lowercase) to combine
  * search terms. It validates the queries for syntax correctness, tokenizes and
  * normalizes the query terms, evaluates the query against the index, and ranks
- * the results by the frequency of query terms in the documents. The documents are
+ * the results by the frequency of query terms in the documents (or by their BM25
+ * relevance, which also weighs how rare each word is and how long each document
+ * is). The documents are
  * displayed in descending order of their relevance along with their URLs.
  *
  * Input:
- * Queries are read from stdin, one per line. Each query can include one or more
+ * Queries are read from stdin (or the batch file), one per line. Each query can include one or more
  * search terms, optionally combined using 'AND' and 'OR' operators. The querier
  * is case-insensitive and treats operators and search terms uniformly by
  * converting them to lowercase.
  *
  * Output:
  * For each query, the Querier outputs the ranked list of document IDs, their
- * match score (based on term frequency), and the document's URL. If no documents
+ * match score (based on term frequency, or BM25 with four decimals), and the
+ * document's URL. If no documents
  * match the query, a message indicating no matches is printed.
  *
  * Tasnim Chowdhury Feb 2024 
  */
 
+/**
+ * One matching document and its score.
+ */
+typedef struct match {
+    int docID;     // the document's ID
+    double score;  // its score under the chosen ranking
+} match_t;
+
+/**
+ * A document ingested by a server and not yet flushed to the index file: its
+ * page, to be written into the page directory by the flush, and its words,
+ * normalized, in page order.
+ */
+typedef struct ingestDoc {
+    int docID;
+    char* url;
+    int depth;
+    char* html;
+    char** words;
+    int numWords;
+} ingestDoc_t;
+
+/**
+ * One version of the index, as queries see it: the base index loaded from the
+ * index file, with every document's URL when the querier keeps a URL table (a
+ * server does, so that answering a query reads no files), and a segment
+ * indexing the documents ingested since the last flush, whose versions of a
+ * document replace the base's. A query holds a reference for as long as it
+ * runs, and the querier holds one while the snapshot is current, so a reload,
+ * an ingest or a flush can replace it under running queries and free it once
+ * the last of them lets go. Successive snapshots may share a base index; the
+ * newest of them owns it.
+ */
+typedef struct snapshot {
+    index_t* index;         // the base index, or NULL if it is sharded
+    index_t** shards;       // the base index's shards, joined, or NULL
+    int numShards;
+    char** urls;            // urls[docID] for docIDs 1..numURLs, or NULL
+    int numURLs;
+    index_t* segment;       // the ingested documents, or NULL if there are none
+    int* segmentDocs;       // their docIDs, sorted
+    char** segmentURLs;     // segmentURLs[i] is the URL of segmentDocs[i]
+    int numSegmentDocs;
+    bool ownsBase;          // whether deleting the snapshot frees index, shards and urls
+    bool binary;            // whether the index file is in the binary format, which a
+                            // flush keeps
+    unsigned long generation;  // 1 for the first snapshot, then one per change
+    int refs;               // references held; guarded by the querier's lock
+} snapshot_t;
+
+/**
+ * One docID range of a shard (or of an unsharded index) that a query is
+ * scored on, with the range's ranked matches once it is scored.
+ */
+typedef struct rangePart {
+    index_t* index;             // the index or shard, only read
+    query_t* query;             // the query built on all of index, or NULL to
+                                // build it for first .. last
+    int first;                  // the docIDs covered: first .. last
+    int last;
+    match_t* matches;           // the range's ranked matches, NULL if none
+    int numMatches;
+} rangePart_t;
+
+/**
+ * One query being scored on several docID ranges at once (see scoreIndex):
+ * those of every shard, or ranges of equal width of one index. Ranges are
+ * claimed in order, under the pool's lock, by range threads and by the
+ * thread that asked, which then waits for done to reach numRanges.
+ */
+typedef struct rangeJob {
+    char** words;               // the query's tokens
+    int numWords;
+    int top;                    // matches each range keeps; 0 keeps them all
+    queryRank_t ranking;
+    rangePart_t* ranges;        // the ranges, each with its own matches
+    int numRanges;
+    int next;                   // first range not claimed
+    int done;                   // ranges scored
+    bool failed;                // whether some range ran out of memory
+    struct rangeJob* nextJob;   // next job in the pool's queue
+} rangeJob_t;
+
+/**
+ * Threads that score ranges of queries for any thread answering one. The
+ * queue holds the jobs that still have unclaimed ranges, oldest first. The
+ * lock guards the queue, stopping, and every queued job's next, done and
+ * failed.
+ */
+typedef struct rangePool {
+    pthread_t* threads;
+    int numThreads;
+    rangeJob_t* queue;          // jobs with ranges left to claim
+    bool stopping;              // threads exit once the queue is empty
+    pthread_mutex_t lock;
+    pthread_cond_t hasJob;      // a job was queued, or stopping was set
+    pthread_cond_t rangeDone;   // some job's done advanced
+} rangePool_t;
+
+/**
+ * What --explain prints after each query's results.
+ */
+typedef enum {
+    EXPLAIN_NONE,               // nothing
+    EXPLAIN_PLAN,               // the plan, with document frequencies
+    EXPLAIN_ANALYZE,            // the plan, and what each node did when run
+} explain_t;
+
+/**
+ * Everything needed to answer queries: the current snapshot of the index and
+ * the file it came from, the page directory, the output options, and a cache
+ * of the ranked results of recent queries, which also watches the index file
+ * for changes. The lock guards current and every snapshot's refs; the
+ * ingested documents belong to the one thread that changes snapshots.
+ */
+typedef struct querier {
+    snapshot_t* current;    // the snapshot new queries use
+    pthread_mutex_t lock;
+    pthread_cond_t drained; // a snapshot's last reference was dropped
+    char* pageDirectory;    // directory produced by the Crawler
+    char* indexFilename;    // file produced by the Indexer
+    int top;                // documents to print per query; 0 prints them all
+    queryRank_t ranking;    // how matching documents are scored
+    cache_t* cache;         // ranked results of recent queries
+    bool urlTable;          // whether snapshots load every document's URL
+    int ranges;             // docID ranges each query is split into
+    rangePool_t* pool;      // threads scoring the ranges, or NULL for 1 range
+    ingestDoc_t* ingested;  // documents ingested since the last flush, by docID
+    int numIngested;
+    int ingestedCap;
+    latency_t* latency;     // per-phase query latencies, or NULL without --timing
+    double slowMs;          // queries taking this long (ms) are logged with --timing
+    explain_t explain;      // what to print after each query's results
+} querier_t;
+
+/**
+ * One line of a batch, and once a worker has answered it, its output.
+ */
+typedef struct batchItem {
+    char* line;             // the query as read
+    char* out;              // what it prints to stdout
+    size_t outLen;
+    char* err;              // what it prints to stderr
+    size_t errLen;
+    bool done;              // whether out and err are complete
+} batchItem_t;
+
+/**
+ * A batch of queries shared by its worker threads and its writer. The lock
+ * guards next, written and every item's done flag.
+ */
+typedef struct batch {
+    querier_t* querier;         // index, options and cache; the index is only read
+    batchItem_t* items;         // the queries, in input order
+    int numItems;
+    int next;                   // first item no worker has claimed
+    int written;                // items already written out
+    int window;                 // how far workers may run ahead of the writer
+    pthread_mutex_t lock;
+    pthread_cond_t answered;    // an item became done
+    pthread_cond_t room;        // written advanced
+} batch_t;
+
+/**
+ * A running query server. The main thread polls the listener and the idle
+ * connections and queues those with a request waiting in ready; a worker
+ * answers one request and queues the connection in returned, writing to the
+ * wake pipe so that the main thread polls it again. An indexer thread makes
+ * every change to the served index: it reloads the index when
+ * reloadsRequested runs ahead of reloadsDone, publishes the documents queued
+ * in pending, and flushes them to the index file when flushesRequested runs
+ * ahead of flushesDone or a flush is due. The lock guards ready, returned,
+ * stopping, pending and the counters; idle belongs to the main thread. The three arrays share one capacity, so that every
+ * connection fits in any of them.
+ */
+typedef struct server {
+    querier_t* querier;         // index, options and cache; the index is only read
+    int listener;               // listening socket
+    int wake[2];                // self-pipe that wakes the main thread's poll
+    int* idle;                  // connections waiting for their next request
+    int numIdle;
+    int idleCap;                // capacity of idle, ready and returned
+    int* ready;                 // connections with a request, for the workers
+    int numReady;
+    int* returned;              // connections answered, for the main thread
+    int numReturned;
+    bool stopping;              // workers exit once ready is empty
+    unsigned long reloadsRequested;  // reloads asked for (SIGHUP, reload commands)
+    unsigned long reloadsDone;  // reloadsRequested as of the last reload's start
+    bool reloadOk;              // whether the last reload succeeded
+    ingestDoc_t* pending;       // documents read but not yet published
+    int numPending;
+    int pendingCap;
+    unsigned long ingestsQueued;     // documents ever queued in pending
+    unsigned long ingestsPublished;  // ingestsQueued as of the last publish's start
+    bool publishOk;             // whether the last publish succeeded
+    unsigned long flushesRequested;  // flushes asked for by flush commands
+    unsigned long flushesDone;  // flushesRequested as of the last flush's start
+    bool flushOk;               // whether the last flush succeeded
+    time_t flushDue;            // when ingested documents are flushed anyway
+    pthread_mutex_t lock;
+    pthread_cond_t hasReady;    // ready gained connections, or stopping was set
+    pthread_cond_t hasWork;     // a reload, publish or flush was requested, or stopping was set
+    pthread_cond_t workDone;    // one of them finished, or stopping was set
+} server_t;
+
 /**
  * Checks if a given query is valid according to the querier's requirements.
  * A valid query contains only letters (case-insensitive) and spaces, and it
@@ -59,127 +293,514 @@ static bool isValidQuery(char* query);
 void tokenize(char* query, char* words[], int* numWords, bool* isValid);
 
 /**
- * A counters item function for intersection operations. Compares counts of a
- * given key in two counters and updates the count in the destination counter to
- * the minimum of the two counts. If a key does not exist in the second counter,
- * it is removed (count set to 0) from the destination counter.
+ * Answers a query from the querier's result cache when it holds the query,
+ * and otherwise with scoreSnapshot(), storing the ranked result in the cache. The
+ * cache key is the query's canonical form (query_canonical: "and" dropped,
+ * each AND sequence's words sorted and deduplicated) together with the
+ * snapshot's generation, top and the ranking, so equivalent queries share an
+ * entry and results computed on a replaced index are never served.
+ *
+ * @param querier The options and cache to use.
+ * @param snapshot The index to answer on, acquired by the caller.
+ * @param numWords The number of words in the query.
+ * @param words Array of words (tokens) from the query.
+ * @param matches Pointer to an array pointer, which will be allocated and filled
+ *                with the ranked matches; the caller frees it.
+ * @param scoreNs Where to store the nanoseconds spent scoring (0 on a cache
+ *                hit), or NULL to leave scoring untimed.
+ * @return The number of matches.
+ */
+int lookup(querier_t* querier, snapshot_t* snapshot, int numWords, char* words[],
+           match_t** matches, uint64_t* scoreNs);
+
+/**
+ * Scores a query on a snapshot: with score() on its base index and on its
+ * segment, dropping the base's matches for documents the segment replaces,
+ * and merging the two rankings. The base is asked for top plus the number of
+ * segment documents, so that its top documents survive the drop.
+ *
+ * @param querier The top and ranking to score with.
+ * @param snapshot The snapshot, acquired by the caller.
+ * @param numWords The number of words in the query.
+ * @param words Array of words (tokens) from the query.
+ * @param matches Pointer to an array pointer, which will be allocated and filled
+ *                with the ranked matches (NULL if none); the caller frees it.
+ * @return The number of matches.
+ */
+static int scoreSnapshot(querier_t* querier, snapshot_t* snapshot, int numWords,
+                         char* words[], match_t** matches);
+
+/**
+ * A bsearch and qsort comparison function for docIDs, in ascending order.
+ *
+ * @param a Pointer to an int.
+ * @param b Pointer to an int.
+ * @return Negative, zero or positive as *a is below, equal to or above *b.
+ */
+static int compareDocIDs(const void* a, const void* b);
+
+/**
+ * Scores a query on a base index of one or more shards as score() does,
+ * scattering it over the range pool when the querier has one: every shard is
+ * a range of its own, and with --ranges the docIDs the query can match in a
+ * shard (query_span) are cut into ranges of equal width (splitQuery). Each
+ * range is evaluated (query_newRange) by a range thread or by the calling
+ * thread, and the partial rankings are gathered and merged. Every range
+ * keeps its own top matches, so the result is exactly score()'s on the
+ * unsharded index.
+ *
+ * @param querier The ranking, ranges and range pool.
+ * @param shards The index's shards, joined with index_joinShards, or the index.
+ * @param numShards The number of shards; 1 for an unsharded index.
+ * @param numWords The number of words in the query.
+ * @param words Array of words (tokens) from the query.
+ * @param top Keep only this many best-scoring documents; 0 keeps them all.
+ * @param matches Pointer to an array pointer, which will be allocated and filled
+ *                with the ranked matches (NULL if none); the caller frees it.
+ * @return The number of matches.
+ */
+static int scoreIndex(querier_t* querier, index_t** shards, int numShards, int numWords,
+                      char* words[], int top, match_t** matches);
+
+/**
+ * Fills ranges with the docID ranges of one index (or shard) a query is to
+ * be scored on: none if nothing can match, the whole index (its query
+ * already built) if it has no range pool or the query's span is narrower
+ * than RANGE_MIN_DOCS per range, else querier->ranges ranges of equal width.
+ *
+ * @param querier The ranking, ranges and range pool.
+ * @param index The index or shard.
+ * @param numWords The number of words in the query.
+ * @param words Array of words (tokens) from the query.
+ * @param ranges Room for querier->ranges ranges.
+ * @return The number of ranges filled.
+ */
+static int splitQuery(querier_t* querier, index_t* index, int numWords, char* words[],
+                      rangePart_t* ranges);
+
+/**
+ * Evaluates a compiled query as score() does and deletes it.
+ *
+ * @param query The query, fresh from query_new or query_newRange.
+ * @param top Keep only this many best-scoring documents; 0 keeps them all.
+ * @param matches Set to the ranked matches (NULL if none); the caller frees it.
+ * @return The number of matches.
+ */
+static int scoreQuery(query_t* query, int top, match_t** matches);
+
+/**
+ * Scores one range of a job into the range's slot.
+ *
+ * @param job The job.
+ * @param r The range, claimed by the caller.
+ * @return false if out of memory.
+ */
+static bool scoreRange(rangeJob_t* job, int r);
+
+/**
+ * Claims a job's next range, dropping the job from the pool's queue once
+ * every range is claimed.
  *
- * @param arg A pointer to the destination counter (as void* to match counters itemfunc signature).
- * @param key The document ID.
- * @param count1 The count for the document ID in the destination counter.
+ * @param pool The pool; the caller holds its lock.
+ * @param job A job in the pool's queue.
+ * @return The range, or -1 if all are claimed.
  */
-void intersect_itemfunc(void *arg, const int key, int count1);
+static int claimRange(rangePool_t* pool, rangeJob_t* job);
 
 /**
- * Intersects two counters, modifying the first to include only keys present in both
- * counters, with their counts set to the minimum found in either counter. This function
- * is used to apply the 'AND' logic in query processing.
+ * Body of a range thread: scores ranges of the oldest queued job until the
+ * pool stops.
  *
- * @param result Pointer to a pointer of the first counter, which will be modified
- *               to store the intersection result.
- * @param newCounter The second counter, to intersect with the first.
+ * @param arg The rangePool_t.
+ * @return NULL.
  */
-void intersect(counters_t **result, counters_t *newCounter);
+static void* rangeWorker(void* arg);
 
 /**
- * A counters item function for union operations. Adds the count of a given key
- * from one counter to its count in another counter, effectively merging the two.
+ * Starts the querier's range pool.
  *
- * @param arg A pointer to the destination counter (as void* to match counters itemfunc signature).
- * @param key The document ID.
- * @param count1 The count for the document ID to be added to the destination counter.
+ * @param querier The querier; its pool is set.
+ * @param numThreads The number of range threads.
+ * @return false, leaving the querier without a pool, if no thread starts.
  */
-void union_itemfunc(void *arg, const int key, int count1);
+static bool startRangePool(querier_t* querier, int numThreads);
 
 /**
- * Unions two counters, modifying the first to include all keys from both counters,
- * with their counts summed. This function is used to apply the 'OR' logic in query processing.
+ * Stops and frees the querier's range pool, if it has one.
  *
- * @param result Pointer to a pointer of the first counter, which will be modified
- *               to store the union result.
- * @param temp The second counter, to union with the first.
+ * @param querier The querier.
  */
-void myUnion(counters_t **result, counters_t *temp);
+static void stopRangePool(querier_t* querier);
 
 /**
  * Processes a query against the given index, applying 'AND' and 'OR' logic as
- * specified by the query tokens. The result is a counter with document IDs as
- * keys and the count of matched words as values.
+ * specified by the query tokens. The query is compiled into an operator tree
+ * (query_new) whose matches are read one document at a time, so no per-word or
+ * per-operator results are built. The result is an array of matching documents
+ * and their scores, ranked best first (see compareMatches), or NULL if nothing
+ * matches.
  *
  * @param index The index structure containing the inverted index data.
  * @param numWords The number of words in the query.
  * @param words Array of words (tokens) from the query.
- * @param result Pointer to a pointer to a counter, which will be allocated and
- *               filled with the query result.
+ * @param top Keep only this many best-scoring documents (found with query_top,
+ *            which skips documents that cannot make the cut); 0 keeps them all.
+ * @param ranking How to score documents; QUERY_BM25 needs index_loadStats first.
+ * @param matches Pointer to an array pointer, which will be allocated and filled
+ *                with the matches; the caller frees it.
+ * @return The number of matches.
  */
-void score(index_t *index, int numWords, char *words[], counters_t** result);
+int score(index_t *index, int numWords, char *words[], int top, queryRank_t ranking,
+          match_t** matches);
 
 /**
- * A counters item function to find the document with the maximum score. This
- * function is used to rank documents based on the number of times query terms
- * appear in each document.
+ * A qsort comparison function that orders matches best first: higher scores
+ * first, and lower document IDs first among equal scores.
  *
- * @param arg A pointer to an array of two integers, where the first element will
- *            be updated with the maximum count found, and the second element with
- *            the corresponding document ID.
- * @param key The document ID.
- * @param count The count for the document ID.
+ * @param a Pointer to a match_t.
+ * @param b Pointer to a match_t.
+ * @return Negative if a ranks before b, positive if after, 0 if equal.
  */
-void findMaxScore(void* arg, const int key, const int count);
+int compareMatches(const void* a, const void* b);
 
 /**
- * Ranks documents based on their scores and prints the ranked list. Documents
- * are printed in descending order of their scores along with their URL.
+ * Prints the ranked list of documents. Documents are printed in the order
+ * given, descending order of their scores, along with their URL, taken from
+ * the snapshot's segment for ingested documents, from its URL table when it
+ * has one, and from the page file otherwise.
  *
- * @param result The counter containing document IDs and their scores.
- * @param pageDir The directory containing the page files produced by the Crawler.
+ * @param out The stream to print to.
+ * @param querier The page directory and ranking (BM25 scores print with
+ *                decimals).
+ * @param snapshot The snapshot the matches were found in.
+ * @param matches The matching documents and their scores, ranked by score().
+ * @param numMatches The number of matches.
  */
-void rank(counters_t* result, char* pageDir);
+void rank(FILE* out, querier_t* querier, snapshot_t* snapshot, match_t* matches,
+          int numMatches);
+
+/**
+ * Prints the latency histograms to stderr if SIGUSR1 has asked for them since
+ * they were last printed; of several threads calling at once, one prints.
+ *
+ * @param querier The querier, timing with --timing.
+ */
+static void reportTiming(querier_t* querier);
+
+/**
+ * Records one query's phase timings in the latency histograms, and logs the
+ * query to stderr as a slow query, with the time of each phase, if it took
+ * at least slowMs milliseconds. Then prints a report SIGUSR1 asked for.
+ *
+ * @param querier The querier, timing with --timing.
+ * @param ns Nanoseconds spent in each phase, indexed by PHASE_PARSE etc.
+ * @param words The query's tokens, for the log.
+ * @param numWords The number of tokens.
+ */
+static void recordTiming(querier_t* querier, const uint64_t ns[], char* words[],
+                         int numWords);
+
+/**
+ * Prints a query's plan (query_explain) on the snapshot's index or each of
+ * its shards, and on its segment, each under a heading. With
+ * EXPLAIN_ANALYZE, each is first evaluated on the calling thread with
+ * query_newAnalyzed as score() would evaluate it, without the cache or
+ * ranges, so the statistics are those of the whole shard.
+ *
+ * @param querier The top, ranking and explain option.
+ * @param snapshot The snapshot the query was answered on, acquired.
+ * @param numWords The number of words in the query.
+ * @param words Array of words (tokens) from the query.
+ * @param out Where to print.
+ */
+static void explainQuery(querier_t* querier, snapshot_t* snapshot, int numWords,
+                         char* words[], FILE* out);
+
+/**
+ * Answers one line of input: validates and tokenizes it, looks it up (or
+ * scores it), and prints the "Query:" line and the ranked documents to out
+ * and any complaint to err. Safe to call from several threads at once. With
+ * --timing, times the phases of a valid query and records them.
+ *
+ * @param querier The index, page directory, options and cache to use.
+ * @param query The line; tokenized in place.
+ * @param out Where results go.
+ * @param err Where complaints go.
+ * @return true if the line was a valid query, false if it was rejected.
+ */
+static bool answerQuery(querier_t* querier, char* query, FILE* out, FILE* err);
 
 /**
  * Processes each query read from stdin by tokenizing, validating, scoring, and
  * ranking the results. Continues to prompt for queries until EOF is encountered.
+ * Before each query, reloads the index if its file has changed (which also
+ * empties the result cache).
  *
- * @param index The index structure containing the inverted index data.
- * @param pageDir The directory containing the page files produced by the Crawler.
+ * @param querier The index, page directory, options and cache to use.
  */
-static void processQuery(index_t* index, char* pageDir);
+static void processQuery(querier_t* querier);
 
 /**
- * Copies the content of one counters structure to another. This function iterates through
- * all keys in the source counters structure and sets their corresponding counts in the
- * destination counters structure. If a key exists in the destination that is not in the
- * source, its count remains unchanged.
- * 
- * @param source The counters structure from which to copy counts.
- * @param destination The counters structure where counts will be copied to.
+ * Body of a batch worker thread: claims queries one at a time, answers each
+ * into memory buffers with answerQuery, and marks it done for the writer.
+ *
+ * @param arg The batch_t.
+ * @return NULL.
  */
-void counters_copy(counters_t *source, counters_t *destination);
+static void* batchWorker(void* arg);
 
 /**
- * Determines if a counters structure is empty (i.e., contains no keys with positive counts).
- * This function iterates through the counters structure and checks if there is any key with
- * a count greater than zero.
- * 
- * @param source The counters structure to check for emptiness.
- * @return Returns 1 if the counters structure is empty (no keys with positive counts),
- *         or 0 otherwise.
+ * Answers all the queries of a file with a pool of worker threads sharing the
+ * read-only index, and writes their results in input order through a large
+ * stdout buffer, exactly as interactive mode would print them minus the
+ * prompts. The index is not reloaded during a batch.
+ *
+ * @param querier The index, page directory, options and cache to use.
+ * @param queryFile The file of queries, one per line, or "-" for stdin.
+ * @param numThreads The number of worker threads.
+ * @return false if the file cannot be read or no thread can start.
  */
-int counters_empty(counters_t *source);
+static bool processBatch(querier_t* querier, const char* queryFile, int numThreads);
 
 /**
- * A helper function designed to be used with counters_iterate() that adds a specified
- * count to a key in a counters structure. This function is typically used in the context
- * of aggregating or summing counts across multiple counters structures, such as during
- * a union operation. The function directly modifies the counters structure passed as an
- * argument to counters_iterate().
- * 
- * @param arg A pointer to the counters structure in which the count will be added. This
- *            argument is passed as a void pointer to match the signature expected by
- *            counters_iterate(), and should be cast to (counters_t *) inside the function.
- * @param key The key to which the count will be added.
- * @param count The count to add to the key. If the key does not exist in the counters
- *              structure, it will be added with this count. If the key exists, its count
- *              will be increased by this amount.
+ * Signal handler of server mode: SIGHUP sets the reload flag, SIGINT and
+ * SIGTERM the stop flag; either way the main thread is woken through the
+ * wake pipe.
+ *
+ * @param signum The signal.
+ */
+static void signalServer(int signum);
+
+/**
+ * Signal handler of --timing: SIGUSR1 sets the report flag, and wakes a
+ * server's main thread through the wake pipe.
+ *
+ * @param signum The signal.
+ */
+static void signalTiming(int signum);
+
+/**
+ * Body of a server worker thread: takes a connection with a request waiting,
+ * answers the request with answerQuery, sends the response, and returns the
+ * connection to the main thread; closes connections that hang up or send a
+ * malformed request. Requests starting with PROTOCOL_CONTROL go to
+ * serverControl instead.
+ *
+ * @param arg The server_t.
+ * @return NULL once the server stops.
+ */
+static void* serverWorker(void* arg);
+
+/**
+ * Body of the server's indexer thread, the only one that changes snapshots:
+ * runs reloadIndex whenever a reload has been requested since the last one
+ * started, publishIngested whenever documents are pending, and flushSegment
+ * when a flush is requested or due, and publishes each outcome. Once the
+ * server stops, publishes and flushes whatever was ingested.
+ *
+ * @param arg The server_t.
+ * @return NULL once the server stops.
+ */
+static void* serverIndexer(void* arg);
+
+/**
+ * Asks the indexer for a reload.
+ *
+ * @param server The server; the caller holds its lock.
+ * @return The reload's ticket: it is done once reloadsDone reaches it.
+ */
+static unsigned long requestReload(server_t* server);
+
+/**
+ * Reads a page file in the Crawler's format into an ingested document, taking
+ * its words as the Indexer does: three letters or more, normalized.
+ *
+ * @param filename The page file.
+ * @param docID The docID to give the document.
+ * @param doc The document to fill; its contents are the caller's to free.
+ * @return false if the file cannot be read or memory runs out.
+ */
+static bool ingestPage(const char* filename, int docID, ingestDoc_t* doc);
+
+/**
+ * Carries out a control command and sends its response: "reload" reloads the
+ * index file, "ingest docID pageFile" adds (or replaces) a document, and
+ * "flush" writes the ingested documents into the index file. Each responds
+ * once what it asked for is done; an ingested document is searchable by then.
+ *
+ * @param server The server.
+ * @param command The request without its PROTOCOL_CONTROL byte.
+ * @param fd The connection to respond on.
+ * @return false if the response cannot be sent.
+ */
+static bool serverControl(server_t* server, const char* command, int fd);
+
+/**
+ * Adds a connection to the server's idle set, growing its arrays if needed.
+ *
+ * @param server The server; the caller holds its lock.
+ * @param fd The connection.
+ * @return false if out of memory.
+ */
+static bool addConnection(server_t* server, int fd);
+
+/**
+ * Serves queries sent by qclient (see protocol.h) on a Unix socket or loopback
+ * TCP address with a pool of worker threads sharing the read-only index, until
+ * SIGINT or SIGTERM. The index is loaded once, so a query whose result is in
+ * the cache is answered without touching the disk.
+ *
+ * @param querier The index, page directory, options and cache to use.
+ * @param address A Unix socket path, or localhost:port.
+ * @param numThreads The number of worker threads.
+ * @return false if the server cannot listen on address or no thread can start.
+ */
+static bool processServer(querier_t* querier, const char* address, int numThreads);
+
+/**
+ * Reads the URL of every document in the page directory (docIDs from 1 up to
+ * the first missing page file) into the snapshot's URL table.
+ *
+ * @param pageDirectory The directory produced by the Crawler.
+ * @param snapshot The snapshot to fill.
+ */
+static void loadURLs(const char* pageDirectory, snapshot_t* snapshot);
+
+/**
+ * Loads the index file (and the URL table, if the querier keeps one) into a
+ * new snapshot with no references, with a segment of the documents ingested
+ * since the last flush.
+ *
+ * @param querier The index file, page directory, ranking and ingested documents.
+ * @return The snapshot, or NULL if the index cannot be loaded.
+ */
+static snapshot_t* loadSnapshot(querier_t* querier);
+
+/**
+ * Indexes the documents ingested since the last flush into the snapshot's
+ * segment, scored with the base index's statistics, and copies their docIDs
+ * and URLs into it. Leaves the snapshot without a segment if there are none.
+ *
+ * @param querier The ingested documents.
+ * @param snapshot The snapshot, whose base index is loaded.
+ * @return false if out of memory.
+ */
+static bool attachSegment(querier_t* querier, snapshot_t* snapshot);
+
+/**
+ * Frees a snapshot: its segment, and its index and URL table if it owns
+ * them. Ignores NULL.
+ *
+ * @param snapshot The snapshot, which nobody references any more.
+ */
+static void deleteSnapshot(snapshot_t* snapshot);
+
+/**
+ * Takes a reference to the current snapshot.
+ *
+ * @param querier The querier.
+ * @return The snapshot, valid until releaseSnapshot.
+ */
+static snapshot_t* acquireSnapshot(querier_t* querier);
+
+/**
+ * Drops a reference taken by acquireSnapshot, waking a reload waiting for it.
+ *
+ * @param querier The querier.
+ * @param snapshot The snapshot.
+ */
+static void releaseSnapshot(querier_t* querier, snapshot_t* snapshot);
+
+/**
+ * Makes a freshly loaded snapshot current and numbers its generation.
+ *
+ * @param querier The querier.
+ * @param snapshot The new snapshot.
+ * @return The snapshot replaced, without the querier's reference, or NULL.
+ */
+static snapshot_t* installSnapshot(querier_t* querier, snapshot_t* snapshot);
+
+/**
+ * Re-answers the most recently cached queries (up to REWARM_KEYS) of the old
+ * snapshot on the fresh one and caches them under the fresh generation.
+ *
+ * @param querier The options and cache.
+ * @param old The current snapshot.
+ * @param fresh The snapshot about to be installed, its generation set.
+ * @return The number of results carried over.
+ */
+static int rewarmCache(querier_t* querier, snapshot_t* old, snapshot_t* fresh);
+
+/**
+ * Switches to a fresh snapshot without interrupting queries: rewarms the
+ * cache for it, installs it, waits for the queries still running on the old
+ * snapshot to finish (the grace period), and frees the old one.
+ *
+ * @param querier The querier.
+ * @param fresh The snapshot to switch to.
+ * @return The number of cached results carried over.
+ */
+static int swapSnapshot(querier_t* querier, snapshot_t* fresh);
+
+/**
+ * Reloads the index file without interrupting queries: loads a new snapshot,
+ * with the ingested documents on top, and swaps it in.
+ *
+ * @param querier The querier.
+ * @param carried Set to the number of cached results carried over.
+ * @return false, keeping the current snapshot, if the index cannot be loaded.
+ */
+static bool reloadIndex(querier_t* querier, int* carried);
+
+/**
+ * A qsort comparison function that orders ingested documents by docID.
+ *
+ * @param a Pointer to an ingestDoc_t.
+ * @param b Pointer to an ingestDoc_t.
+ * @return Negative, zero or positive as a's docID is below, equal to or above b's.
+ */
+static int compareIngested(const void* a, const void* b);
+
+/**
+ * Frees an ingested document's URL and words, not the document itself.
+ *
+ * @param doc The document.
+ */
+static void freeIngested(ingestDoc_t* doc);
+
+/**
+ * Adds documents to those ingested since the last flush, replacing earlier
+ * versions of the same docIDs, and swaps in a snapshot over the same base
+ * index whose segment holds them all.
+ *
+ * @param querier The querier.
+ * @param docs The documents, taken over (the array itself stays the caller's).
+ * @param numDocs The number of documents.
+ * @param carried Set to the number of cached results carried over.
+ * @return false, keeping the current snapshot, if out of memory.
+ */
+static bool publishIngested(querier_t* querier, ingestDoc_t* docs, int numDocs,
+                            int* carried);
+
+/**
+ * Writes an ingested document's page file into the page directory, in the
+ * Crawler's format, through a temporary file renamed into place.
+ *
+ * @param pageDirectory The directory produced by the Crawler.
+ * @param doc The document.
+ * @return false if the file cannot be written.
+ */
+static bool writePage(const char* pageDirectory, const ingestDoc_t* doc);
+
+/**
+ * Merges the current snapshot's segment into its base index (index_merge),
+ * writes the ingested documents' page files into the page directory and the
+ * result over the index file and its statistics file (through temporary files
+ * and renames), and swaps in a snapshot of the merged index with an empty
+ * segment.
+ *
+ * @param querier The querier.
+ * @param carried Set to the number of cached results carried over.
+ * @return false, keeping the segment, if the merge or a file fails.
  */
-void counters_additemfunc(void* arg, int key, int count );
+static bool flushSegment(querier_t* querier, int* carried);
@@ -27,10 +27,10 @@ run_query_test() {
 }
 
 run_parseargs_test() {
-    echo "Testing invalid parseArgs: $1 $2"
+    echo "Testing invalid parseArgs: $*"
     # Temporarily disable 'exit on error'
     set +e
-    ./querier "$1" "$2"
+    ./querier "$@" < /dev/null
     # Check if the last command (querier) failed
     if [ $? -ne 0 ]; then
         echo "Correctly failed. Moving on..."
@@ -71,6 +71,106 @@ run_query_test "english language and mother africa"
 
 run_query_test "mother english language"
 
+# Rare word ANDed with very common words (exercises skipping in the postings)
+run_query_test "africa and the and book"
+run_query_test "the book africa or mother the"
+
+# Planner: same results whatever the word order; missing words drop their whole AND sequence
+run_query_test "the and africa"
+run_query_test "africa and the"
+run_query_test "the computer or africa the or computer"
+
+# Top-k: the first k lines of each full result
+echo "the book or africa or mother" | ./querier $pageDirectory $indexFile --top 3
+echo "science or the or book" | ./querier $pageDirectory $indexFile --top 10
+
+# BM25: rare words and short documents rank higher; --top k keeps the first k lines
+echo "the book or africa or mother" | ./querier $pageDirectory $indexFile --rank bm25
+echo "the book or africa or mother" | ./querier $pageDirectory $indexFile --rank bm25 --top 3
+echo "africa the" | ./querier $pageDirectory $indexFile --top 2 --rank bm25
+
+# Result cache: repeated and reordered queries are answered from the cache
+printf "the book\nbook and the\nthe book the\nafrica\n" | ./querier $pageDirectory $indexFile --top 3
+printf "the book\nbook and the\n" | ./querier $pageDirectory $indexFile --top 3 --cache 0
+
+# Batch: same output as interactive mode without the prompts, in input order
+printf "the book\nafrica or mother\nbad!\nscience\n" > batch.txt
+./querier $pageDirectory $indexFile --top 3 --batch batch.txt --threads 4
+./querier $pageDirectory $indexFile --top 3 --batch batch.txt --threads 1 > batch1.out
+./querier $pageDirectory $indexFile --top 3 --batch batch.txt --threads 4 > batch4.out
+cmp batch1.out batch4.out && echo "Batch output does not depend on the thread count."
+./querier $pageDirectory $indexFile --top 3 --batch batch.txt --threads 2 --ranges 4 > ranges.out
+cmp batch1.out ranges.out && echo "Splitting queries over docID ranges does not change their results."
+
+# Explain: the plan of an OR of ANDs, and of a query with a word missing from the index
+printf "the book or travel and home\nzzqx and the\n" | ./querier $pageDirectory $indexFile --top 3 --explain plan
+
+# Timing: a threshold of 0 logs every valid query, and the latency report follows the cache's
+./querier $pageDirectory $indexFile --top 3 --batch batch.txt --timing 0 > timed.out 2> timed.err
+cmp batch1.out timed.out && echo "Timing queries does not change their results."
+grep -c "^Slow query:" timed.err
+grep -c "^latency " timed.err
+
+# Shards: an index split into shards by hash ranks every query exactly as the whole index does
+shardDir=$(mktemp -d)
+make -C ../indexer indexer
+../indexer/indexer $pageDirectory $shardDir/whole.ndx
+../indexer/indexer $pageDirectory $shardDir/sharded.ndx --shards 3 --partition hash
+./querier $pageDirectory $shardDir/whole.ndx --rank bm25 --top 3 --batch batch.txt > $shardDir/whole.out
+./querier $pageDirectory $shardDir/sharded.ndx --rank bm25 --top 3 --batch batch.txt > $shardDir/sharded.out
+cmp $shardDir/whole.out $shardDir/sharded.out && echo "A sharded index ranks queries as the whole index does."
+rm -rf $shardDir
+
+# Server: qclient prints what batch mode prints, over a Unix socket
+./querier $pageDirectory $indexFile --top 3 --serve querier.sock --threads 2 &
+serverPid=$!
+sleep 1
+./qclient querier.sock < batch.txt > client.out
+cmp batch1.out client.out && echo "Server output matches batch output."
+
+# Reload: SIGHUP and the reload command swap in the index while queries keep running
+./qclient querier.sock < batch.txt > client.out &
+kill -HUP $serverPid
+./qclient querier.sock --reload
+wait $!
+./qclient querier.sock < batch.txt > reloaded.out
+cmp batch1.out client.out && cmp batch1.out reloaded.out && echo "No query failed across reloads."
+kill -INT $serverPid
+wait $serverPid
+
+# Ingest: a page is searchable once ingested, and stays so after a flush into (copies of)
+# the index file and page directory and a reload
+ingestDir=$(mktemp -d)
+cp -r $pageDirectory $ingestDir/pages
+cp $indexFile $ingestDir/index.ndx
+cp $indexFile.stats $ingestDir/index.ndx.stats 2>/dev/null || true
+binary=$(head -c 7 $ingestDir/index.ndx | grep -c TSEIDX || true)
+newDoc=$(( $(ls $ingestDir/pages | grep -c '^[0-9]*$') + 1 ))
+printf "http://example.com/ingested.html\n0\n<html>zyzzyva ingested</html>\n" > $ingestDir/new
+./querier $ingestDir/pages $ingestDir/index.ndx --serve querier.sock --threads 2 &
+serverPid=$!
+sleep 1
+echo "$newDoc $ingestDir/new" | ./qclient querier.sock --ingest
+echo "zyzzyva" | ./qclient querier.sock > ingested.out
+./qclient querier.sock --flush
+./qclient querier.sock --reload
+echo "zyzzyva" | ./qclient querier.sock > flushed.out
+cat flushed.out
+cmp ingested.out flushed.out && echo "Ingested page survives a flush and a reload."
+[ "$(head -c 7 $ingestDir/index.ndx | grep -c TSEIDX || true)" = "$binary" ] \
+    && echo "Flushed index keeps its format."
+# A page without words is still a document, and a docID past the next one is refused
+printf "http://example.com/empty.html\n0\n<html>a b</html>\n" > $ingestDir/empty
+echo "$(( newDoc + 1 )) $ingestDir/empty" | ./qclient querier.sock --ingest
+./qclient querier.sock --flush
+if ! echo "$(( newDoc + 100 )) $ingestDir/new" | ./qclient querier.sock --ingest; then
+    echo "Correctly refused a docID past the next one."
+fi
+kill -INT $serverPid
+wait $serverPid
+rm -rf $ingestDir
+rm -f batch.txt batch1.out batch4.out ranges.out timed.out timed.err client.out reloaded.out ingested.out flushed.out
+
 echo "Running invalid parseArgs tests..."
 run_parseargs_test "" ""
 run_parseargs_test $pageDirectory
@@ -78,6 +178,16 @@ run_parseargs_test "nonexistentDir" "nonexistentIndex"
 run_parseargs_test $pageDirectory "nonexistentIndex"
 run_parseargs_test "nonexistentDir" $indexFile
 run_parseargs_test $pageDirectory $indexFile "wefwe"
+run_parseargs_test $pageDirectory $indexFile "--rank" "tfidf"
+run_parseargs_test $pageDirectory $indexFile "--rank"
+run_parseargs_test $pageDirectory $indexFile "--cache" "-1"
+run_parseargs_test $pageDirectory $indexFile "--threads" "4"
+run_parseargs_test $pageDirectory $indexFile "--ranges" "0"
+run_parseargs_test $pageDirectory $indexFile "--timing" "-1"
+run_parseargs_test $pageDirectory $indexFile "--explain" "verbose"
+run_parseargs_test $pageDirectory $indexFile "--batch" "nonexistentQueries"
+run_parseargs_test $pageDirectory $indexFile "--batch" "-" "--serve" "querier.sock"
+run_parseargs_test $pageDirectory $indexFile "--serve" "nonexistentDir/querier.sock"
 
 
 echo "All tests completed successfully."